@@ -7,6 +7,7 @@ information from a run.
 
 from CIME.XML.standard_module_setup import *
 from CIME.utils import safe_copy
+from CIME import gptl_binary
 
 import datetime, re
 
@@ -27,6 +28,7 @@ class _TimingParser:
         self.caseroot = case.get_value("CASEROOT")
         self.lid = lid
         self.finlines = None
+        self.summary = None
         self.fout = None
         self.adays = 0
         self._driver = case.get_value("COMP_INTERFACE")
@@ -90,6 +92,12 @@ class _TimingParser:
         nprocs = 0
         ncount = 0
 
+        if self.summary is not None:
+            stats = self.summary.get(heading_padded.strip())
+            if stats is None:
+                return (0, 0)
+            return (stats["processes"], stats["count"])
+
         heading = '"' + heading_padded.strip() + '"'
         for line in self.finlines:
             m = re.match(r"\s*{}\s+\S\s+(\d+)\s*\d+\s*(\S+)".format(heading), line)
@@ -134,6 +142,12 @@ class _TimingParser:
 
     def _gettime_mct(self, heading_padded):
         found = False
+        if self.summary is not None:
+            stats = self.summary.get(heading_padded.strip())
+            if stats is None:
+                return (0, 0, False)
+            return (stats["wallmin"], stats["wallmax"], True)
+
         heading = '"' + heading_padded.strip() + '"'
         minval = 0
         maxval = 0
@@ -436,6 +450,18 @@ class _TimingParser:
             logger.critical("Unable to open file {}".format(finfilename))
             raise e
 
+        # With profile_binary, the stats are also in a binary file that can
+        # be loaded without scanning the text once per timer
+        self.summary = None
+        if self._driver == "mct" or self._driver == "moab":
+            binstats = binfilename + gptl_binary.SUFFIX
+            if os.path.isfile(binstats):
+                safe_copy(binstats, finfilename + gptl_binary.SUFFIX)
+                try:
+                    self.summary = gptl_binary.summary(binstats)
+                except (IOError, gptl_binary.GPTLBinaryError) as e:
+                    logger.warning("Ignoring unreadable {}: {}".format(binstats, e))
+
         tlen = 1.0
         if ncpl_base_period == "decade":
             tlen = 3650.0
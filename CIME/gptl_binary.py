@@ -0,0 +1,272 @@
+"""
+Reader for the binary timing files (<file>.gptb) that GPTL writes next to its
+text output when the GPTLdopr_binary option (profile_binary in prof_inparm)
+is set. The layout is described in CIME/non_py/src/timing/gptl_binary.h.
+
+Tables are stored by column, so loading one is a handful of array copies
+rather than a regex scan per timer.
+
+The event traces GPTL records with the GPTLtrace option
+(timing.trace[.<rank>].gptb) can be merged into one Chrome trace JSON file,
+viewable in chrome://tracing or https://ui.perfetto.dev:
+
+    python gptl_binary.py -o trace.json timing.trace.*.gptb
+"""
+import argparse, array, json, struct, sys
+
+MAGIC = b"GPTLBIN\0"
+VERSION = 1
+BYTEORDER = 0x01020304
+
+TASK = 1
+SUMMARY = 2
+TRACE = 3
+
+TRACE_START = 0
+TRACE_STOP = 1
+
+SUFFIX = ".gptb"
+
+_HEADER = "8s6iq"
+_TABLE = "16sqii"
+_COLUMN = "24siiq"
+
+# GPTL column type -> (array typecode, stored bytes per value)
+_TYPES = {
+    ord("i"): ("i", 4),
+    ord("f"): ("f", 4),
+    ord("d"): ("d", 8),
+    ord("q"): ("q", 8),
+    ord("l"): ("Q", 8),
+}
+_STRING = ord("s")
+
+
+class GPTLBinaryError(Exception):
+    pass
+
+
+class Table(object):
+    """
+    One table of a segment. columns maps each column name to its values:
+    an array (or a list of str for string columns) with one entry per row,
+    or for columns with several values per row (e.g. hist) a list of arrays.
+    """
+
+    def __init__(self, name, nrows):
+        self.name = name
+        self.nrows = nrows
+        self.columns = {}
+
+    def __getitem__(self, name):
+        return self.columns[name]
+
+    def __contains__(self, name):
+        return name in self.columns
+
+    def rows(self):
+        """Yield each row as a dict of column name to value"""
+        names = list(self.columns)
+        for i in range(self.nrows):
+            yield dict((name, self.columns[name][i]) for name in names)
+
+
+class Segment(object):
+    """One GPTLpr_file (TASK) or GPTLpr_summary_file (SUMMARY) call"""
+
+    def __init__(self, kind, rank, nthreads):
+        self.kind = kind
+        self.rank = rank
+        self.nthreads = nthreads
+        self.tables = {}
+
+    def __getitem__(self, name):
+        return self.tables[name]
+
+
+def _cstr(raw):
+    return raw.split(b"\0", 1)[0].decode("utf-8", "replace")
+
+
+def _read_column(data, start, typ, width, offset, nrows, endian):
+    pos = start + offset
+    if typ == _STRING:
+        return [
+            _cstr(data[pos + i * width : pos + (i + 1) * width]) for i in range(nrows)
+        ]
+    if typ not in _TYPES:
+        raise GPTLBinaryError("unknown column type {!r}".format(chr(typ)))
+    code, size = _TYPES[typ]
+    values = array.array(code)
+    if values.itemsize != size:
+        raise GPTLBinaryError("no {}-byte array type for {!r}".format(size, chr(typ)))
+    values.frombytes(data[pos : pos + nrows * width * size])
+    if endian != ("<" if sys.byteorder == "little" else ">"):
+        values.byteswap()
+    if width == 1:
+        return values
+    return [values[i * width : (i + 1) * width] for i in range(nrows)]
+
+
+def read_segments(data):
+    """
+    Parse the segments in data (the bytes of a .gptb file) and return them
+    as a list of Segment, in file order.
+
+    >>> read_segments(b"")
+    []
+    """
+    segments = []
+    start = 0
+    hsize = struct.calcsize("<" + _HEADER)
+    tsize = struct.calcsize("<" + _TABLE)
+    csize = struct.calcsize("<" + _COLUMN)
+    while start + hsize <= len(data):
+        if data[start : start + 8] != MAGIC:
+            raise GPTLBinaryError("bad magic at offset {}".format(start))
+        endian = "<"
+        if struct.unpack_from("<i", data, start + 12)[0] != BYTEORDER:
+            endian = ">"
+        fields = struct.unpack_from(endian + _HEADER, data, start)
+        version, byteorder, kind, rank, nthreads, ntables, size = fields[1:]
+        if byteorder != BYTEORDER or version != VERSION:
+            raise GPTLBinaryError(
+                "unsupported version {} at offset {}".format(version, start)
+            )
+        if size < hsize or start + size > len(data):
+            raise GPTLBinaryError("truncated segment at offset {}".format(start))
+
+        segment = Segment(kind, rank, nthreads)
+        pos = start + hsize
+        for _ in range(ntables):
+            tname, nrows, ncols = struct.unpack_from(endian + _TABLE, data, pos)[:3]
+            pos += tsize
+            table = Table(_cstr(tname), nrows)
+            for _ in range(ncols):
+                cname, typ, width, offset = struct.unpack_from(
+                    endian + _COLUMN, data, pos
+                )
+                pos += csize
+                table.columns[_cstr(cname)] = _read_column(
+                    data, start, typ, width, offset, nrows, endian
+                )
+            segment.tables[table.name] = table
+        segments.append(segment)
+        start += size
+    return segments
+
+
+def read(path):
+    """Return the list of Segment in the .gptb file at path"""
+    with open(path, "rb") as fd:
+        return read_segments(fd.read())
+
+
+def summary(path):
+    """
+    Return a dict mapping each timer name in the summary segments of the
+    .gptb file at path to a dict of its summary columns (processes, count,
+    wallmax, wallmin, ...). If the file holds several summaries (append
+    mode), the first one to mention a timer wins, as when scanning the text.
+    """
+    result = {}
+    for segment in read(path):
+        if segment.kind != SUMMARY or "summary" not in segment.tables:
+            continue
+        for row in segment["summary"].rows():
+            result.setdefault(row["name"], row)
+    return result
+
+
+def trace_events(path):
+    """
+    Yield (rank, thread, name, kind, time) for each event in the trace
+    segments of the .gptb file at path, in file order. kind is TRACE_START or
+    TRACE_STOP and time is the wallclock in seconds.
+    """
+    names = {}
+    for segment in read(path):
+        if segment.kind != TRACE:
+            continue
+        thread = segment["info"]["thread"][0]
+        known = names.setdefault(thread, {})
+        table = segment["names"]
+        for i in range(table.nrows):
+            known[table["id"][i]] = table["name"][i]
+        table = segment["events"]
+        for i in range(table.nrows):
+            yield (
+                segment.rank,
+                thread,
+                known.get(table["id"][i], "?"),
+                table["kind"][i],
+                table["time"][i],
+            )
+
+
+def trace_epoch(path):
+    """
+    Return the epoch GPTLtrace_sync recorded in the trace segments of the
+    .gptb file at path: the wallclock, in seconds, at which this rank left the
+    barrier shared by all ranks. None if the file has no such segment.
+    """
+    for segment in read(path):
+        if segment.kind == TRACE and "epoch" in segment["info"]:
+            return segment["info"]["epoch"][0]
+    return None
+
+
+def chrome_trace(paths):
+    """
+    Merge the GPTL trace files in paths (one per rank) into a dict in the
+    Chrome trace event format: one process per rank and one thread per GPTL
+    thread, with times in microseconds from the earliest event. When every
+    file has an epoch (see trace_epoch), each rank's times are taken relative
+    to its own epoch, which cancels the skew between the ranks' clocks;
+    otherwise ranks are lined up only as well as their clocks agree. Files
+    written without MPI (rank -1) are numbered by their position in paths.
+    """
+    epochs = [trace_epoch(path) for path in paths]
+    if None in epochs:
+        epochs = [0.0] * len(paths)
+    events = []
+    for n, path in enumerate(paths):
+        for rank, thread, name, kind, time in trace_events(path):
+            events.append(
+                {
+                    "name": name,
+                    "ph": "B" if kind == TRACE_START else "E",
+                    "ts": time - epochs[n],
+                    "pid": rank if rank >= 0 else n,
+                    "tid": thread,
+                }
+            )
+    if events:
+        start = min(event["ts"] for event in events)
+        for event in events:
+            event["ts"] = (event["ts"] - start) * 1.0e6
+    for pid in sorted(set(event["pid"] for event in events)):
+        events.append(
+            {
+                "name": "process_name",
+                "ph": "M",
+                "pid": pid,
+                "args": {"name": "rank {}".format(pid)},
+            }
+        )
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def _main(argv):
+    parser = argparse.ArgumentParser(
+        description="Merge GPTL trace files into one Chrome trace JSON file"
+    )
+    parser.add_argument("files", nargs="+", help="timing.trace[.<rank>].gptb files")
+    parser.add_argument("-o", "--output", default="trace.json", help="output file")
+    args = parser.parse_args(argv)
+    with open(args.output, "w") as fd:
+        json.dump(chrome_trace(args.files), fd)
+
+
+if __name__ == "__main__":
+    _main(sys.argv[1:])
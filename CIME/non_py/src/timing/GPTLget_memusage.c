@@ -14,9 +14,30 @@
 **
 **   Return value: 0  = success
 **                 -1 = failure
+**
+** GPTLget_rss:
+**
+**   Current resident set size in kilobytes, cheap enough to call from
+**   GPTLstart and GPTLstop (GPTLmemory). On Linux /proc/self/statm is kept
+**   open from GPTLinitialize to GPTLfinalize (see GPTLmemusage_open), so
+**   each call is one pread. Elsewhere it is GPTLget_memusage's rss, which
+**   with getrusage is the peak rather than the current size.
+**
+**   Return value: 0  = success
+**                 -1 = failure
+**
+** GPTLmemusage_open, GPTLmemusage_close:
+**
+**   Open and close /proc/self/statm for the readers above. Called while
+**   serial, by GPTLinitialize and GPTLfinalize. Outside that window each
+**   read opens and closes the file itself.
+**
+**   Return value: 0  = success
+**                 -1 = failure
 */
 
 #include <sys/resource.h>
+#include "private.h"
 #include "gptl.h"    /* additional cpp defs and function prototypes */
 #include <stdio.h>
 
@@ -33,6 +54,8 @@
 
 #include <sys/time.h>
 #include <sys/types.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #elif (defined __APPLE__)
@@ -62,6 +85,99 @@
 
 #define PRINT_MEMUSAGE 0
 
+#if (defined HAVE_SLASHPROC) && ! (defined BGP) && ! (defined __bgq__)
+static int statm_fd = -1;          /* /proc/self/statm, open between GPTLmemusage_open and _close */
+static long statm_pgkb = -1;       /* page size in KB, set with statm_fd */
+
+/*
+** read_statm: read /proc/self/statm into buf (null terminated)
+**
+** Output arguments:
+**   pgkb: page size in KB
+**
+** Return value: 0 (success) or -1 (failure)
+*/
+
+static int read_statm (char *buf, const size_t len, long *pgkb)
+{
+  ssize_t nread;
+  int fd;
+
+  if (statm_fd >= 0) {
+    nread = pread (statm_fd, buf, len - 1, 0);
+    *pgkb = statm_pgkb;
+  } else {
+    if ((fd = open ("/proc/self/statm", O_RDONLY)) < 0) {
+      fprintf (stderr, "get_memusage: bad attempt to open /proc/self/statm\n");
+      return -1;
+    }
+    nread = pread (fd, buf, len - 1, 0);
+    (void) close (fd);
+    *pgkb = sysconf (_SC_PAGESIZE) / 1024;
+  }
+
+  if (nread <= 0)
+    return -1;
+  buf[nread] = '\0';
+  return 0;
+}
+#endif
+
+int GPTLmemusage_open (void)
+{
+#if (defined HAVE_SLASHPROC) && ! (defined BGP) && ! (defined __bgq__)
+  if (statm_fd >= 0)
+    return 0;
+  if ((statm_fd = open ("/proc/self/statm", O_RDONLY)) < 0) {
+    fprintf (stderr, "get_memusage: bad attempt to open /proc/self/statm\n");
+    return -1;
+  }
+  statm_pgkb = sysconf (_SC_PAGESIZE) / 1024;
+#endif
+  return 0;
+}
+
+int GPTLmemusage_close (void)
+{
+#if (defined HAVE_SLASHPROC) && ! (defined BGP) && ! (defined __bgq__)
+  int ret;
+
+  if (statm_fd < 0)
+    return 0;
+  ret = close (statm_fd);
+  statm_fd = -1;
+  statm_pgkb = -1;
+  if (ret != 0)
+    return -1;
+#endif
+  return 0;
+}
+
+int GPTLget_rss (long long *rss)
+{
+#if (defined HAVE_SLASHPROC) && ! (defined BGP) && ! (defined __bgq__)
+  char buf[128];
+  char *p;
+  long pgkb;
+
+  if (read_statm (buf, sizeof (buf), &pgkb) != 0)
+    return -1;
+
+  /* rss is the second field, after the total size */
+
+  for (p = buf; *p && *p != ' '; ++p);
+  *rss = strtoll (p, NULL, 10) * pgkb;
+  return 0;
+#else
+  int size, rsskb, share, text, datastack;
+
+  if (GPTLget_memusage (&size, &rsskb, &share, &text, &datastack) != 0)
+    return -1;
+  *rss = rsskb;
+  return 0;
+#endif
+}
+
 int GPTLget_memusage (int *size, int *rss, int *share, int *text, int *datastack)
 {
 #if defined (BGP)
@@ -106,42 +222,22 @@ int GPTLget_memusage (int *size, int *rss, int *share, int *text, int *datastack
   return 0;
 
 #elif (defined HAVE_SLASHPROC)
-  FILE *fd;                       /* file descriptor for fopen */
-  int pid;                        /* process id */
-  char file[19];                  /* full path to file in /proc */
+  char buf[128];                  /* contents of /proc/self/statm */
   int dum;                        /* placeholder for unused return arguments */
-  int ret;                        /* function return value */
-  static int pg_sz = -1;          /* page size */
+  int pg_sz;                      /* page size */
+  long pgkb;                      /* page size in KB, from read_statm */
 
   /*
-  ** The file we want to open is /proc/<pid>/statm
+  ** Read the desired data from the kept-open /proc/self/statm directly into
+  ** the output arguments.
   */
 
-  pid = (int) getpid ();
-  if (pid <= 0) {
-    fprintf (stderr, "get_memusage: pid %d is non-positive\n", pid);
+  if (read_statm (buf, sizeof (buf), &pgkb) != 0)
     return -1;
-  }
-
-  sprintf (file, "/proc/%d/statm", pid);
-  if ((fd = fopen (file, "r")) < 0) {
-    fprintf (stderr, "get_memusage: bad attempt to open %s\n", file);
+  if (sscanf (buf, "%d %d %d %d %d %d %d",
+	      size, rss, share, text, datastack, &dum, &dum) < 5)
     return -1;
-  }
-
-  /*
-  ** Read the desired data from the /proc filesystem directly into the output
-  ** arguments, close the file and return.
-  */
-
-  ret = fscanf (fd, "%d %d %d %d %d %d %d",
-		size, rss, share, text, datastack, &dum, &dum);
-  ret = fclose (fd);
-
-  // read page size once
-  if (pg_sz == -1) {
-    pg_sz = sysconf(_SC_PAGESIZE) / 1024;
-  }
+  pg_sz = (int) pgkb;
 
   // convert from pages to KBs
   *size      = *size      * pg_sz;
@@ -79,3 +79,87 @@ void *GPTLallocate (const int nbytes)
 
   return ptr;
 }
+
+/*
+** Arena block size, and the minimum alignment of every pointer handed out.
+** Requests larger than a quarter of a block get a block of their own.
+*/
+
+#define ARENA_BLOCKSIZE (64*1024)
+#define ARENA_ALIGN 16
+#define ARENA_HDRSIZE ((sizeof (Arenablock) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/*
+** GPTLarena_alloc: hand out zeroed space from an arena, adding a new block
+**   when the current one is full
+**
+** Input arguments:
+**   arena:  arena to allocate from
+**   nbytes: size to allocate
+**   align:  required alignment (a power of 2)
+**
+** Return value: pointer to the new space (or NULL)
+*/
+
+void *GPTLarena_alloc (Arena *arena, const size_t nbytes, const size_t align)
+{
+  Arenablock *block;   /* block to carve nbytes from */
+  char *data;          /* start of usable space in block */
+  size_t offset;       /* aligned offset of the new space within block */
+  size_t mask;         /* alignment minus 1 */
+  size_t blocksize;    /* usable size of a new block */
+
+  mask = ((align > ARENA_ALIGN) ? align : ARENA_ALIGN) - 1;
+  if ((block = arena->block)) {
+    data = (char *) block + ARENA_HDRSIZE;
+    offset = (((size_t) (data + block->used) + mask) & ~mask) - (size_t) data;
+  }
+
+  if ( ! block || offset + nbytes > block->size) {
+    blocksize = (nbytes + mask > ARENA_BLOCKSIZE/4) ? nbytes + mask : ARENA_BLOCKSIZE - ARENA_HDRSIZE;
+    if ( ! (block = (Arenablock *) calloc (1, ARENA_HDRSIZE + blocksize))) {
+      (void) GPTLerror ("GPTLarena_alloc: calloc failed for %lu bytes\n",
+			(unsigned long) (ARENA_HDRSIZE + blocksize));
+      return 0;
+    }
+    block->size = blocksize;
+    block->used = 0;
+    arena->nbytes += ARENA_HDRSIZE + blocksize;
+
+    /* A dedicated block goes behind the current one, which may still have room */
+
+    if (nbytes + mask > ARENA_BLOCKSIZE/4 && arena->block) {
+      block->next = arena->block->next;
+      arena->block->next = block;
+    } else {
+      block->next = arena->block;
+      arena->block = block;
+    }
+
+    data = (char *) block + ARENA_HDRSIZE;
+    offset = (((size_t) data + mask) & ~mask) - (size_t) data;
+  }
+
+  block->used = offset + nbytes;
+  return data + offset;
+}
+
+/*
+** GPTLarena_free: release all space handed out by an arena
+**
+** Input arguments:
+**   arena: arena to free
+*/
+
+void GPTLarena_free (Arena *arena)
+{
+  Arenablock *block;     /* block being freed */
+  Arenablock *next;      /* next block in list */
+
+  for (block = arena->block; block; block = next) {
+    next = block->next;
+    free (block);
+  }
+  arena->block = 0;
+  arena->nbytes = 0;
+}
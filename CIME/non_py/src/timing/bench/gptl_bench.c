@@ -0,0 +1,778 @@
+/*
+** gptl_bench.c
+**
+** Micro-benchmarks for the GPTL timing library. Each benchmark reports the
+** cost of the library calls themselves, measured with clock_gettime
+** independently of the underlying timer GPTL is using.
+**
+** Usage: gptl_bench [benchmark ...]   (default: run all benchmarks)
+**
+** Threaded benchmarks use OpenMP when built with it, else pthreads when built
+** with -DTHREADED_PTHREADS (to match the library), else run on one thread.
+** The thread count is OMP_NUM_THREADS, or GPTL_BENCH_THREADS for pthreads.
+**
+** Built with -DHAVE_MPI, run it under mpirun: the summary benchmark uses all
+** ranks, every other benchmark runs on rank 0 only. Built with -DHAVE_PAPI,
+** the papi benchmark measures the cost of reading counters.
+**
+** "make gptl_bench" (or the gptl_bench CMake target) builds it next to the
+** library; bench/perf_bench.F90 measures the perf_mod layer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gptl.h"
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+#if ( defined _OPENMP )
+#include <omp.h>
+#elif ( defined THREADED_PTHREADS )
+#include <pthread.h>
+#endif
+
+#define MAX_NAME 64
+#define MAX_BENCH_THREADS 128
+
+typedef struct {
+  const char *name;       /* benchmark name, as given on the command line */
+  int (*func)(void);      /* benchmark routine */
+  const char *desc;       /* descriptive string for printing */
+} Benchentry;
+
+static int bench_hash (void);
+static int bench_create (void);
+static int bench_startstop (void);
+static int bench_scaling (void);
+static int bench_depth (void);
+static int bench_parents (void);
+static int bench_namelen (void);
+static int bench_utr (void);
+#ifdef HAVE_PAPI
+static int bench_papi (void);
+#endif
+#ifdef HAVE_MPI
+static int bench_summary (void);
+#endif
+
+static Benchentry benchlist[] = {
+  {"hash",   bench_hash,   "timer lookup cost versus number of timers"},
+  {"create", bench_create, "all threads creating new timers at once"},
+  {"startstop", bench_startstop, "cost of a start/stop pair by calling interface"},
+  {"scaling", bench_scaling, "start/stop pair cost as the thread count doubles"},
+  {"depth",  bench_depth,  "start/stop pair cost versus call tree depth"},
+  {"parents", bench_parents, "start/stop pair cost of a timer called from many parents"},
+  {"namelen", bench_namelen, "start/stop pair cost versus timer name length"},
+  {"utr",    bench_utr,    "start/stop pair cost for each underlying wallclock timer"},
+#ifdef HAVE_PAPI
+  {"papi",   bench_papi,   "start/stop pair cost with PAPI counters enabled"},
+#endif
+#ifdef HAVE_MPI
+  {"summary", bench_summary, "GPTLpr_summary_file time versus number of ranks"},
+#endif
+};
+static const int nbench = sizeof (benchlist) / sizeof (Benchentry);
+
+/*
+** wtime: wallclock seconds from a monotonic clock
+*/
+
+static double wtime (void)
+{
+  struct timespec tp;
+
+  (void) clock_gettime (CLOCK_MONOTONIC, &tp);
+  return (double) tp.tv_sec + 1.e-9 * (double) tp.tv_nsec;
+}
+
+/*
+** make_names: generate n CESM-style timer names. Many share long common
+**   prefixes and differ only in a short suffix, which is the worst case for
+**   weak hash functions.
+**
+** Return value: array of n names (caller frees)
+*/
+
+static char **make_names (const int n)
+{
+  static const char *comp[] = {"atm", "lnd", "ocn", "ice", "rof", "glc", "wav", "cpl"};
+  static const char *phase[] = {"run", "init", "final", "restart"};
+  char **names;
+  int i;
+
+  if ( ! (names = (char **) malloc (n * sizeof (char *))))
+    return 0;
+
+  for (i = 0; i < n; ++i) {
+    if ( ! (names[i] = (char *) malloc (MAX_NAME)))
+      return 0;
+    snprintf (names[i], MAX_NAME, "comp_%s_%s_%d", phase[(i/8) % 4], comp[i % 8], i/32);
+  }
+  return names;
+}
+
+static void free_names (char **names, const int n)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    free (names[i]);
+  free (names);
+}
+
+/*
+** get_nthreads: number of threads used by threaded benchmarks
+*/
+
+static int get_nthreads (void)
+{
+#if ( defined _OPENMP )
+  return omp_get_max_threads ();
+#elif ( defined THREADED_PTHREADS )
+  const char *env = getenv ("GPTL_BENCH_THREADS");
+  int n = env ? atoi (env) : 4;
+  return (n < 1) ? 1 : (n > MAX_BENCH_THREADS ? MAX_BENCH_THREADS : n);
+#else
+  return 1;
+#endif
+}
+
+#if ( defined THREADED_PTHREADS ) && ! ( defined _OPENMP )
+typedef struct {
+  void (*func)(int, void *);
+  void *arg;
+  int t;
+} Threadarg;
+
+static void *thread_main (void *arg)
+{
+  Threadarg *targ = (Threadarg *) arg;
+  (*targ->func) (targ->t, targ->arg);
+  return 0;
+}
+#endif
+
+/*
+** run_threads: call func (t, arg) on each of nthreads threads concurrently
+*/
+
+static void run_threads (const int nthreads, void (*func)(int, void *), void *arg)
+{
+#if ( defined _OPENMP )
+#pragma omp parallel num_threads (nthreads)
+  (*func) (omp_get_thread_num (), arg);
+#elif ( defined THREADED_PTHREADS )
+  pthread_t tid[MAX_BENCH_THREADS];
+  Threadarg targ[MAX_BENCH_THREADS];
+  int t;
+
+  for (t = 0; t < nthreads; ++t) {
+    targ[t].func = func;
+    targ[t].arg = arg;
+    targ[t].t = t;
+    pthread_create (&tid[t], 0, thread_main, &targ[t]);
+  }
+  for (t = 0; t < nthreads; ++t)
+    pthread_join (tid[t], 0);
+#else
+  (*func) (0, arg);
+#endif
+}
+
+/*
+** bench_hash: create n distinct timers, then repeatedly start and stop each
+**   of them. The first pass measures timer creation, later passes measure the
+**   name lookup done by every GPTLstart/GPTLstop. Each size is run with a
+**   small initial GPTLtablesize, which the table must grow from, and with
+**   the default.
+*/
+
+static int bench_hash (void)
+{
+  static const int sizes[] = {1000, 10000, 100000};
+  static const int tablesizes[] = {16, 0};  /* 0: library default */
+  char **names;
+  int s, ts, i, rep, n, nreps;
+  double t1, t2, create, lookup;
+
+  printf ("%10s %10s %16s %20s\n", "ntimers", "tablesize", "create (ns)", "start+stop (ns)");
+  for (s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+    for (ts = 0; ts < sizeof (tablesizes) / sizeof (tablesizes[0]); ++ts) {
+      n = sizes[s];
+      nreps = 2000000 / n > 0 ? 2000000 / n : 1;
+      if ( ! (names = make_names (n)))
+	return -1;
+
+      if (tablesizes[ts] > 0 && GPTLsetoption (GPTLtablesize, tablesizes[ts]) < 0)
+	return -1;
+      if (GPTLinitialize () < 0)
+	return -1;
+
+      t1 = wtime ();
+      for (i = 0; i < n; ++i) {
+	GPTLstart (names[i]);
+	GPTLstop (names[i]);
+      }
+      t2 = wtime ();
+      create = 1.e9 * (t2 - t1) / n;
+
+      t1 = wtime ();
+      for (rep = 0; rep < nreps; ++rep) {
+	for (i = 0; i < n; ++i) {
+	  GPTLstart (names[i]);
+	  GPTLstop (names[i]);
+	}
+      }
+      t2 = wtime ();
+      lookup = 1.e9 * (t2 - t1) / ((double) n * nreps);
+
+      if (tablesizes[ts] > 0)
+	printf ("%10d %10d %16.1f %20.1f\n", n, tablesizes[ts], create, lookup);
+      else
+	printf ("%10d %10s %16.1f %20.1f\n", n, "default", create, lookup);
+
+      if (GPTLfinalize () < 0)
+	return -1;
+      free_names (names, n);
+    }
+  }
+  return 0;
+}
+
+/*
+** bench_create: every thread creates the same set of new timers at the same
+**   moment, which exercises thread registration and first-touch timer setup.
+**   The number of timers each thread ends up with is then checked.
+*/
+
+typedef struct {
+  char **names;           /* timer names */
+  int ntimers;            /* number of timers created by each thread */
+  double *elapsed;        /* per-thread time to create all timers */
+} Createarg;
+
+static void create_timers (int t, void *arg)
+{
+  Createarg *carg = (Createarg *) arg;
+  double t1;
+  int i;
+
+  t1 = wtime ();
+  for (i = 0; i < carg->ntimers; ++i) {
+    GPTLstart (carg->names[i]);
+    GPTLstop (carg->names[i]);
+  }
+  carg->elapsed[t] = wtime () - t1;
+}
+
+static int bench_create (void)
+{
+  static const int sizes[] = {100, 10000};
+  Createarg carg;
+  double elapsed[MAX_BENCH_THREADS];
+  double maxtime;
+  int s, t, nthreads, nregions;
+  int ret = 0;
+
+  nthreads = get_nthreads ();
+  printf ("%10s %10s %20s\n", "nthreads", "ntimers", "create (ns, slowest)");
+  for (s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+    carg.ntimers = sizes[s];
+    carg.elapsed = elapsed;
+    if ( ! (carg.names = make_names (carg.ntimers)))
+      return -1;
+
+    if (GPTLinitialize () < 0)
+      return -1;
+
+    run_threads (nthreads, create_timers, &carg);
+
+    maxtime = 0.;
+    for (t = 0; t < nthreads; ++t) {
+      maxtime = (elapsed[t] > maxtime) ? elapsed[t] : maxtime;
+      if (GPTLget_nregions (t, &nregions) < 0 || nregions != carg.ntimers) {
+	fprintf (stderr, "create: thread %d has %d timers, expected %d\n",
+		 t, nregions, carg.ntimers);
+	ret = -1;
+      }
+    }
+    printf ("%10d %10d %20.1f\n", nthreads, carg.ntimers, 1.e9 * maxtime / carg.ntimers);
+
+    if (GPTLfinalize () < 0)
+      return -1;
+    free_names (carg.names, carg.ntimers);
+  }
+  return ret;
+}
+
+/*
+** bench_startstop: ns per start/stop pair through the name, handle and
+**   registered-id interfaces, and GPTLstartf/GPTLstopf (name and length, as
+**   the Fortran wrappers call them). Cycling over more timers than fit in cache
+**   shows how many cache lines each start/stop touches.
+*/
+
+static int bench_startstop (void)
+{
+  static const int sizes[] = {1, 64, 4096, 65536};
+  char **names;
+  void **handles;
+  int *ids;
+  int s, i, rep, n, nreps;
+  double t1, byname, byhandle, byid, bynamef;
+
+  printf ("%10s %16s %16s %16s %16s\n", "ntimers", "name (ns)", "handle (ns)", "id (ns)", "startf (ns)");
+  for (s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+    n = sizes[s];
+    nreps = 2000000 / n > 0 ? 2000000 / n : 1;
+    if ( ! (names = make_names (n)) ||
+	 ! (handles = (void **) calloc (n, sizeof (void *))) ||
+	 ! (ids = (int *) malloc (n * sizeof (int))))
+      return -1;
+
+    if (GPTLinitialize () < 0)
+      return -1;
+
+    for (i = 0; i < n; ++i) {
+      GPTLregister (names[i], &ids[i]);
+      GPTLstart_handle (names[i], &handles[i]);
+      GPTLstop_handle (names[i], &handles[i]);
+    }
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < n; ++i) {
+	GPTLstart (names[i]);
+	GPTLstop (names[i]);
+      }
+    byname = 1.e9 * (wtime () - t1) / ((double) n * nreps);
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < n; ++i) {
+	GPTLstart_handle (names[i], &handles[i]);
+	GPTLstop_handle (names[i], &handles[i]);
+      }
+    byhandle = 1.e9 * (wtime () - t1) / ((double) n * nreps);
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < n; ++i) {
+	GPTLstart_id (ids[i]);
+	GPTLstop_id (ids[i]);
+      }
+    byid = 1.e9 * (wtime () - t1) / ((double) n * nreps);
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < n; ++i) {
+	GPTLstartf (names[i], strlen (names[i]));
+	GPTLstopf (names[i], strlen (names[i]));
+      }
+    bynamef = 1.e9 * (wtime () - t1) / ((double) n * nreps);
+
+    printf ("%10d %16.1f %16.1f %16.1f %16.1f\n", n, byname, byhandle, byid, bynamef);
+
+    if (GPTLfinalize () < 0)
+      return -1;
+    free_names (names, n);
+    free (handles);
+    free (ids);
+  }
+  return 0;
+}
+
+/*
+** bench_scaling: every thread does the same tight start/stop loop on one
+**   timer, for 1, 2, 4, ... MAX_BENCH_THREADS threads. With no shared state
+**   touched per call the cost should stay flat as threads are added; growth
+**   points at false sharing between threads. Thread counts above the number
+**   of cores are oversubscribed and their times are not meaningful.
+*/
+
+typedef struct {
+  int nreps;              /* start/stop pairs per thread */
+  double *elapsed;        /* per-thread time for all pairs */
+} Scalingarg;
+
+static void startstop_loop (int t, void *arg)
+{
+  Scalingarg *sarg = (Scalingarg *) arg;
+  double t1;
+  int rep;
+
+  t1 = wtime ();
+  for (rep = 0; rep < sarg->nreps; ++rep) {
+    GPTLstart ("scaling");
+    GPTLstop ("scaling");
+  }
+  sarg->elapsed[t] = wtime () - t1;
+}
+
+static int bench_scaling (void)
+{
+  Scalingarg sarg;
+  double elapsed[MAX_BENCH_THREADS];
+  double sum, maxtime;
+  int t, nthreads;
+#if ( defined _OPENMP ) || ( defined THREADED_PTHREADS )
+  const int maxn = MAX_BENCH_THREADS;
+#else
+  const int maxn = 1;
+#endif
+
+  sarg.nreps = 200000;
+  sarg.elapsed = elapsed;
+  printf ("%10s %16s %20s\n", "nthreads", "mean (ns)", "slowest (ns)");
+  for (nthreads = 1; nthreads <= maxn; nthreads *= 2) {
+    if (GPTLsetoption (GPTLmaxthreads, nthreads) < 0 || GPTLinitialize () < 0)
+      return -1;
+
+    run_threads (nthreads, startstop_loop, &sarg);
+
+    sum = 0.;
+    maxtime = 0.;
+    for (t = 0; t < nthreads; ++t) {
+      sum += elapsed[t];
+      maxtime = (elapsed[t] > maxtime) ? elapsed[t] : maxtime;
+    }
+    printf ("%10d %16.1f %20.1f\n", nthreads,
+	    1.e9 * sum / ((double) nthreads * sarg.nreps), 1.e9 * maxtime / sarg.nreps);
+
+    if (GPTLfinalize () < 0)
+      return -1;
+  }
+  return 0;
+}
+
+/*
+** pair_cost: ns per GPTLstart/GPTLstop pair of one timer inside the timers
+**   currently running
+*/
+
+static double pair_cost (const char *name, const int nreps)
+{
+  double t1;
+  int rep;
+
+  GPTLstart (name);
+  GPTLstop (name);
+  t1 = wtime ();
+  for (rep = 0; rep < nreps; ++rep) {
+    GPTLstart (name);
+    GPTLstop (name);
+  }
+  return 1.e9 * (wtime () - t1) / nreps;
+}
+
+/*
+** bench_depth: cost of the innermost start/stop pair with depth-1 other
+**   timers running around it. Parent/child bookkeeping is per pair, so the
+**   cost should not grow with depth.
+*/
+
+static int bench_depth (void)
+{
+  static const int depths[] = {1, 4, 16, 64};
+  char name[MAX_NAME];
+  int d, i;
+
+  printf ("%10s %16s\n", "depth", "start+stop (ns)");
+  for (d = 0; d < sizeof (depths) / sizeof (depths[0]); ++d) {
+    if (GPTLinitialize () < 0)
+      return -1;
+    for (i = 0; i < depths[d]-1; ++i) {
+      snprintf (name, MAX_NAME, "depth_%d", i);
+      GPTLstart (name);
+    }
+    printf ("%10d %16.1f\n", depths[d], pair_cost ("innermost", 2000000));
+    for (i = depths[d]-2; i >= 0; --i) {
+      snprintf (name, MAX_NAME, "depth_%d", i);
+      GPTLstop (name);
+    }
+    if (GPTLfinalize () < 0)
+      return -1;
+  }
+  return 0;
+}
+
+/*
+** bench_parents: cost of a start/stop pair of one timer called in turn from
+**   nparent different parents, like a shared utility routine. The cost of
+**   starting and stopping the parents themselves is measured separately and
+**   subtracted.
+*/
+
+static int bench_parents (void)
+{
+  static const int nparents[] = {1, 4, 16, 64, 256, 1024};
+  const int npairs = 1000000;
+  char **names;
+  void **handles;
+  void *uhandle;
+  double t1, tparents, tboth;
+  int p, i, rep, n, nreps;
+
+  printf ("%10s %16s\n", "nparents", "start+stop (ns)");
+  for (p = 0; p < sizeof (nparents) / sizeof (nparents[0]); ++p) {
+    n = nparents[p];
+    nreps = npairs / n;
+    if ( ! (names = make_names (n)) || ! (handles = (void **) calloc (n, sizeof (void *))))
+      return -1;
+    uhandle = 0;
+    if (GPTLinitialize () < 0)
+      return -1;
+    for (i = 0; i < n; ++i) {
+      GPTLstart_handle (names[i], &handles[i]);
+      GPTLstart_handle ("utility", &uhandle);
+      GPTLstop_handle ("utility", &uhandle);
+      GPTLstop_handle (names[i], &handles[i]);
+    }
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < n; ++i) {
+	GPTLstart_handle (names[i], &handles[i]);
+	GPTLstop_handle (names[i], &handles[i]);
+      }
+    tparents = wtime () - t1;
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < n; ++i) {
+	GPTLstart_handle (names[i], &handles[i]);
+	GPTLstart_handle ("utility", &uhandle);
+	GPTLstop_handle ("utility", &uhandle);
+	GPTLstop_handle (names[i], &handles[i]);
+      }
+    tboth = wtime () - t1;
+    printf ("%10d %16.1f\n", n, 1.e9 * (tboth - tparents) / ((double) n * nreps));
+
+    if (GPTLfinalize () < 0)
+      return -1;
+    free (handles);
+    free_names (names, n);
+  }
+  return 0;
+}
+
+/*
+** bench_namelen: start/stop pair cost versus name length. Names are hashed
+**   and compared on every call by name, so longer names cost more. 32
+**   timers share all but their last characters.
+*/
+
+static int bench_namelen (void)
+{
+  static const int lengths[] = {8, 32, 64, 127};
+  char names[32][128];
+  double t1;
+  int l, i, rep, len;
+  const int nreps = 50000;
+
+  printf ("%10s %16s %16s\n", "namelen", "name (ns)", "startf (ns)");
+  for (l = 0; l < sizeof (lengths) / sizeof (lengths[0]); ++l) {
+    len = lengths[l];
+    for (i = 0; i < 32; ++i) {
+      memset (names[i], 'x', len);
+      snprintf (names[i] + len - 2, 3, "%02d", i);
+    }
+    if (GPTLinitialize () < 0)
+      return -1;
+
+    for (i = 0; i < 32; ++i) {
+      GPTLstart (names[i]);
+      GPTLstop (names[i]);
+    }
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < 32; ++i) {
+	GPTLstart (names[i]);
+	GPTLstop (names[i]);
+      }
+    printf ("%10d %16.1f", len, 1.e9 * (wtime () - t1) / (32. * nreps));
+
+    t1 = wtime ();
+    for (rep = 0; rep < nreps; ++rep)
+      for (i = 0; i < 32; ++i) {
+	GPTLstartf (names[i], len);
+	GPTLstopf (names[i], len);
+      }
+    printf (" %16.1f\n", 1.e9 * (wtime () - t1) / (32. * nreps));
+
+    if (GPTLfinalize () < 0)
+      return -1;
+  }
+  return 0;
+}
+
+/*
+** bench_utr: start/stop pair cost with each underlying wallclock timer this
+**   build and machine provide
+*/
+
+static int bench_utr (void)
+{
+  static const struct {
+    int utr;
+    const char *name;
+  } utrs[] = {
+    {GPTLgettimeofday,   "gettimeofday"},
+    {GPTLnanotime,       "nanotime"},
+    {GPTLclockgettime,   "clock_gettime"},
+    {GPTLclockmonotonic, "clock_monotonic"},
+    {GPTLmpiwtime,       "MPI_Wtime"},
+    {GPTLpapitime,       "PAPI_get_real_usec"},
+    {GPTLautoutr,        "automatic"}
+  };
+  int u;
+
+  /* An unavailable timer is reported, not fatal */
+
+  (void) GPTLsetoption (GPTLabort_on_error, 0);
+  printf ("%20s %16s\n", "utr", "start+stop (ns)");
+  for (u = 0; u < sizeof (utrs) / sizeof (utrs[0]); ++u) {
+    if (GPTLsetutr (utrs[u].utr) < 0) {
+      printf ("%20s %16s\n", utrs[u].name, "not available");
+      continue;
+    }
+    if (GPTLinitialize () < 0)
+      return -1;
+    printf ("%20s %16.1f\n", utrs[u].name, pair_cost ("utr", 2000000));
+    if (GPTLfinalize () < 0)
+      return -1;
+  }
+  (void) GPTLsetoption (GPTLabort_on_error, 1);
+  return 0;
+}
+
+#ifdef HAVE_PAPI
+/*
+** bench_papi: start/stop pair cost with no PAPI counters, then with one and
+**   two counters enabled
+*/
+
+static int bench_papi (void)
+{
+  static const char *events[] = {"PAPI_TOT_CYC", "PAPI_TOT_INS"};
+  int code;
+  int n;
+
+  printf ("%10s %16s\n", "ncounters", "start+stop (ns)");
+  for (n = 0; n <= 2; ++n) {
+    if (n > 0 && (GPTLevent_name_to_code (events[n-1], &code) < 0 ||
+		  GPTLsetoption (code, 1) < 0))
+      return -1;
+    if (GPTLinitialize () < 0)
+      return -1;
+    printf ("%10d %16.1f\n", n, pair_cost ("papi", 200000));
+    if (GPTLfinalize () < 0)
+      return -1;
+  }
+  return 0;
+}
+#endif
+
+#ifdef HAVE_MPI
+/*
+** bench_summary: time GPTLpr_summary_file over the first 1, 2, 4, ... ranks
+**   of MPI_COMM_WORLD (and all of them), each rank holding the same set of
+**   timers. Run with as many ranks as the production case to be simulated;
+**   oversubscribed ranks make the times an upper bound.
+*/
+
+static int bench_summary (void)
+{
+  static const int sizes[] = {100, 1000};
+  MPI_Comm comm;
+  char **names;
+  double t1, elapsed;
+  int s, i, p, rank, nranks;
+  int last;  /* previous group size */
+
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+  MPI_Comm_size (MPI_COMM_WORLD, &nranks);
+  if (rank == 0)
+    printf ("%10s %10s %16s\n", "nranks", "ntimers", "summary (ms)");
+
+  for (s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+    if ( ! (names = make_names (sizes[s])))
+      return -1;
+    if (GPTLinitialize () < 0)
+      return -1;
+    for (i = 0; i < sizes[s]; ++i) {
+      GPTLstart (names[i]);
+      GPTLstop (names[i]);
+    }
+
+    for (p = 1, last = 0; last < nranks; p = (2*p < nranks) ? 2*p : nranks) {
+      MPI_Comm_split (MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &comm);
+      if (comm != MPI_COMM_NULL) {
+	MPI_Barrier (comm);
+	t1 = wtime ();
+	if (GPTLpr_summary_file (comm, "gptl_bench.summary") < 0)
+	  return -1;
+	elapsed = wtime () - t1;
+	if (rank == 0)
+	  printf ("%10d %10d %16.3f\n", p, sizes[s], 1.e3 * elapsed);
+	MPI_Comm_free (&comm);
+      }
+      MPI_Barrier (MPI_COMM_WORLD);
+      last = p;
+    }
+
+    if (GPTLfinalize () < 0)
+      return -1;
+    free_names (names, sizes[s]);
+  }
+  return 0;
+}
+#endif
+
+int main (int argc, char **argv)
+{
+  int i, b;
+  int ret = 0;
+  int found;
+  int rank = 0;
+
+#ifdef HAVE_MPI
+  MPI_Init (&argc, &argv);
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+#endif
+
+  (void) GPTLsetoption (GPTLabort_on_error, 1);
+
+  for (b = 0; b < nbench; ++b) {
+    found = (argc < 2);
+    for (i = 1; i < argc; ++i)
+      if (strcmp (argv[i], benchlist[b].name) == 0)
+	found = 1;
+    if ( ! found)
+      continue;
+
+#ifdef HAVE_MPI
+    /* Only the summary benchmark uses more than one rank */
+
+    if (rank > 0 && benchlist[b].func != bench_summary)
+      continue;
+#endif
+
+    if (rank == 0)
+      printf ("\n%s: %s\n", benchlist[b].name, benchlist[b].desc);
+    if ((*benchlist[b].func) () != 0) {
+      fprintf (stderr, "%s: benchmark failed\n", benchlist[b].name);
+      ret = 1;
+    }
+  }
+
+#ifdef HAVE_MPI
+  MPI_Finalize ();
+#endif
+  return ret;
+}
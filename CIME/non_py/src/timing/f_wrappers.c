@@ -21,26 +21,39 @@
 #define gptlpr_file GPTLPR_FILE
 #define gptlpr_summary GPTLPR_SUMMARY
 #define gptlpr_summary_FILE GPTLPR_SUMMARY_FILE
+#define gptlpr_summary_begin GPTLPR_SUMMARY_BEGIN
+#define gptlpr_summary_end GPTLPR_SUMMARY_END
+#define gptlpr_file_mpiio GPTLPR_FILE_MPIIO
 #define gptlbarrier GPTLBARRIER
+#define gptltrace_sync GPTLTRACE_SYNC
 #define gptlprefix_set GPTLPREFIX_SET
 #define gptlprefix_unset GPTLPREFIX_UNSET
 #define gptlreset GPTLRESET
+#define gptlsnapshot GPTLSNAPSHOT
+#define gptlsnapshot_file GPTLSNAPSHOT_FILE
 #define gptlstamp GPTLSTAMP
 #define gptlstart GPTLSTART
 #define gptlstart_handle GPTLSTART_HANDLE
+#define gptlregister GPTLREGISTER
+#define gptlstart_id GPTLSTART_ID
 #define gptlstop GPTLSTOP
 #define gptlstop_handle GPTLSTOP_HANDLE
+#define gptlstop_id GPTLSTOP_ID
 #define gptlstartstop_vals GPTLSTARTSTOP_VALS
 #define gptlsetoption GPTLSETOPTION
 #define gptlenable GPTLENABLE
 #define gptldisable GPTLDISABLE
 #define gptlsetutr GPTLSETUTR
+#define gptlset_sampling GPTLSET_SAMPLING
+#define gptlselect_papi GPTLSELECT_PAPI
+#define gptlset_filter GPTLSET_FILTER
 #define gptlquery GPTLQUERY
 #define gptlquerycounters GPTLQUERYCOUNTERS
 #define gptlget_wallclock GPTLGET_WALLCLOCK
 #define gptlget_eventvalue GPTLGET_EVENTVALUE
 #define gptlget_nregions GPTLGET_NREGIONS
 #define gptlget_regionname GPTLGET_REGIONNAME
+#define gptlquery_all GPTLQUERY_ALL
 #define gptlget_memusage GPTLGET_MEMUSAGE
 #define gptlprint_memusage GPTLPRINT_MEMUSAGE
 #define gptl_papilibraryinit GPTL_PAPILIBRARYINIT
@@ -57,26 +70,39 @@
 #define gptlpr_file                 FCI_GLOBAL(gptlpr_file,GPTLPR_FILE)
 #define gptlpr_summary              FCI_GLOBAL(gptlpr_summary,GPTLPR_SUMMARY)
 #define gptlpr_summary_file         FCI_GLOBAL(gptlpr_summary_file,GPTLPR_SUMMARY_FILE)
+#define gptlpr_summary_begin        FCI_GLOBAL(gptlpr_summary_begin,GPTLPR_SUMMARY_BEGIN)
+#define gptlpr_summary_end          FCI_GLOBAL(gptlpr_summary_end,GPTLPR_SUMMARY_END)
+#define gptlpr_file_mpiio           FCI_GLOBAL(gptlpr_file_mpiio,GPTLPR_FILE_MPIIO)
 #define gptlbarrier                 FCI_GLOBAL(gptlbarrier,GPTLBARRIER)
+#define gptltrace_sync              FCI_GLOBAL(gptltrace_sync,GPTLTRACE_SYNC)
 #define gptlprefix_set              FCI_GLOBAL(gptlprefix_set,GPTLPREFIX_SET)
 #define gptlprefix_unset            FCI_GLOBAL(gptlprefix_unset,GPTLPREFIX_UNSET)
 #define gptlreset                   FCI_GLOBAL(gptlreset,GPTLRESET)
+#define gptlsnapshot                FCI_GLOBAL(gptlsnapshot,GPTLSNAPSHOT)
+#define gptlsnapshot_file           FCI_GLOBAL(gptlsnapshot_file,GPTLSNAPSHOT_FILE)
 #define gptlstamp                   FCI_GLOBAL(gptlstamp,GPTLSTAMP)
 #define gptlstart                   FCI_GLOBAL(gptlstart,GPTLSTART)
 #define gptlstart_handle            FCI_GLOBAL(gptlstart_handle,GPTLSTART_HANDLE)
+#define gptlregister                FCI_GLOBAL(gptlregister,GPTLREGISTER)
+#define gptlstart_id                FCI_GLOBAL(gptlstart_id,GPTLSTART_ID)
 #define gptlstop                    FCI_GLOBAL(gptlstop,GPTLSTOP)
 #define gptlstop_handle             FCI_GLOBAL(gptlstop_handle,GPTLSTOP_HANDLE)
+#define gptlstop_id                 FCI_GLOBAL(gptlstop_id,GPTLSTOP_ID)
 #define gptlstartstop_vals          FCI_GLOBAL(gptlstartstop_vals,GPTLSTARTSTOP_VALS)
 #define gptlsetoption               FCI_GLOBAL(gptlsetoption,GPTLSETOPTION)
 #define gptlenable                  FCI_GLOBAL(gptlenable,GPTLENABLE)
 #define gptldisable                 FCI_GLOBAL(gptldisable,GPTLDISABLE)
 #define gptlsetutr                  FCI_GLOBAL(gptlsetutr,GPTLSETUTR)
+#define gptlset_sampling            FCI_GLOBAL(gptlset_sampling,GPTLSET_SAMPLING)
+#define gptlselect_papi             FCI_GLOBAL(gptlselect_papi,GPTLSELECT_PAPI)
+#define gptlset_filter              FCI_GLOBAL(gptlset_filter,GPTLSET_FILTER)
 #define gptlquery                   FCI_GLOBAL(gptlquery,GPTLQUERY)
 #define gptlquerycounters           FCI_GLOBAL(gptlquerycounters,GPTLQUERYCOUNTERS)
 #define gptlget_wallclock           FCI_GLOBAL(gptlget_wallclock,GPTLGET_WALLCLOCK)
 #define gptlget_eventvalue          FCI_GLOBAL(gptlget_eventvalue,GPTLGET_EVENTVALUE)
 #define gptlget_nregions            FCI_GLOBAL(gptlget_nregions,GPTLGET_NREGIONS)
 #define gptlget_regionname          FCI_GLOBAL(gptlget_regionname,GPTLGET_REGIONNAME)
+#define gptlquery_all               FCI_GLOBAL(gptlquery_all,GPTLQUERY_ALL)
 #define gptlget_memusage            FCI_GLOBAL(gptlget_memusage,GPTLGET_MEMUSAGE)
 #define gptlprint_memusage          FCI_GLOBAL(gptlprint_memusage,GPTLPRINT_MEMUSAGE)
 #define gptl_papilibraryinit        FCI_GLOBAL(gptl_papilibraryinit,GPTL_PAPILIBRARYINIT)
@@ -93,26 +119,39 @@
 #define gptlpr_file gptlpr_file_
 #define gptlpr_summary gptlpr_summary_
 #define gptlpr_summary_file gptlpr_summary_file_
+#define gptlpr_summary_begin gptlpr_summary_begin_
+#define gptlpr_summary_end gptlpr_summary_end_
+#define gptlpr_file_mpiio gptlpr_file_mpiio_
 #define gptlbarrier gptlbarrier_
+#define gptltrace_sync gptltrace_sync_
 #define gptlprefix_set gptlprefix_set_
 #define gptlprefix_unset gptlprefix_unset_
 #define gptlreset gptlreset_
+#define gptlsnapshot gptlsnapshot_
+#define gptlsnapshot_file gptlsnapshot_file_
 #define gptlstamp gptlstamp_
 #define gptlstart gptlstart_
 #define gptlstart_handle gptlstart_handle_
+#define gptlregister gptlregister_
+#define gptlstart_id gptlstart_id_
 #define gptlstop gptlstop_
 #define gptlstop_handle gptlstop_handle_
+#define gptlstop_id gptlstop_id_
 #define gptlstartstop_vals gptlstartstop_vals_
 #define gptlsetoption gptlsetoption_
 #define gptlenable gptlenable_
 #define gptldisable gptldisable_
 #define gptlsetutr gptlsetutr_
+#define gptlset_sampling gptlset_sampling_
+#define gptlselect_papi gptlselect_papi_
+#define gptlset_filter gptlset_filter_
 #define gptlquery gptlquery_
 #define gptlquerycounters gptlquerycounters_
 #define gptlget_wallclock gptlget_wallclock_
 #define gptlget_eventvalue gptlget_eventvalue_
 #define gptlget_nregions gptlget_nregions_
 #define gptlget_regionname gptlget_regionname_
+#define gptlquery_all gptlquery_all_
 #define gptlget_memusage gptlget_memusage_
 #define gptlprint_memusage gptlprint_memusage_
 #define gptl_papilibraryinit gptl_papilibraryinit_
@@ -129,26 +168,39 @@
 #define gptlpr_file gptlpr_file__
 #define gptlpr_summary gptlpr_summary__
 #define gptlpr_summary_file gptlpr_summary_file__
+#define gptlpr_summary_begin gptlpr_summary_begin__
+#define gptlpr_summary_end gptlpr_summary_end__
+#define gptlpr_file_mpiio gptlpr_file_mpiio__
 #define gptlbarrier gptlbarrier__
+#define gptltrace_sync gptltrace_sync__
 #define gptlprefix_set gptlprefix_set__
 #define gptlprefix_unset gptlprefix_unset__
 #define gptlreset gptlreset__
+#define gptlsnapshot gptlsnapshot__
+#define gptlsnapshot_file gptlsnapshot_file__
 #define gptlstamp gptlstamp__
 #define gptlstart gptlstart__
 #define gptlstart_handle gptlstart_handle__
+#define gptlregister gptlregister__
+#define gptlstart_id gptlstart_id__
 #define gptlstop gptlstop__
 #define gptlstop_handle gptlstop_handle__
+#define gptlstop_id gptlstop_id__
 #define gptlstartstop_vals gptlstartstop_vals__
 #define gptlsetoption gptlsetoption__
 #define gptlenable gptlenable__
 #define gptldisable gptldisable__
 #define gptlsetutr gptlsetutr__
+#define gptlset_sampling gptlset_sampling__
+#define gptlselect_papi gptlselect_papi__
+#define gptlset_filter gptlset_filter__
 #define gptlquery gptlquery__
 #define gptlquerycounters gptlquerycounters__
 #define gptlget_wallclock gptlget_wallclock__
 #define gptlget_eventvalue gptlget_eventvalue__
 #define gptlget_nregions gptlget_nregions__
 #define gptlget_regionname gptlget_regionname__
+#define gptlquery_all gptlquery_all__
 #define gptlget_memusage gptlget_memusage__
 #define gptlprint_memusage gptlprint_memusage__
 #define gptl_papilibraryinit gptl_papilibraryinit__
@@ -169,20 +221,32 @@ int gptlpr (int *procid);
 int gptlpr_file (char *file, int nc1);
 int gptlpr_summary (int *fcomm);
 int gptlpr_summary_file (int *fcomm, char *name, int nc1);
+int gptlpr_summary_begin (int *fcomm);
+int gptlpr_summary_end (char *name, int nc1);
+int gptlpr_file_mpiio (int *fcomm, char *name, char *header, int *dowrite, int nc1, int nc2);
 int gptlbarrier (int *fcomm, char *name, int nc1);
+int gptltrace_sync (int *fcomm);
 int gptlprefix_set (char *name, int nc1);
 int gptlprefix_unset (void);
 int gptlreset (void);
+int gptlsnapshot (char *tag, int nc1);
+int gptlsnapshot_file (char *file, int nc1);
 int gptlstamp (double *wall, double *usr, double *sys);
 int gptlstart (char *name, int nc1);
 int gptlstart_handle (char *name, void **, int nc1);
+int gptlregister (char *name, int *id, int nc1);
+int gptlstart_id (int *id);
 int gptlstop (char *name, int nc1);
 int gptlstop_handle (char *name, void **, int nc1);
+int gptlstop_id (int *id);
 int gptlstartstop_vals (char *name, double *val, int *cnt, int nc1);
 int gptlsetoption (int *option, int *val);
 int gptlenable (void);
 int gptldisable (void);
 int gptlsetutr (int *option);
+int gptlset_sampling (char *name, int *rate, int nc1);
+int gptlselect_papi (char *pattern, int nc1);
+int gptlset_filter (char *rules, int nc1);
 int gptlquery (const char *name, int *t, int *count, int *onflg, double *wallclock,
 		      double *usr, double *sys, long long *papicounters_out, int *maxcounters,
 		      int nc);
@@ -192,6 +256,8 @@ int gptlget_eventvalue (const char *timername, const char *eventname, int *t, do
 			int nc1, int nc2);
 int gptlget_nregions (int *t, int *nregions);
 int gptlget_regionname (int *t, int *region, char *name, int nc);
+int gptlquery_all (int *maxtimers, int *ntimers, int *thread, char *names, int *count,
+		   double *accum, double *max, double *min, int *onflg, int nc);
 int gptlget_memusage (int *size, int *rss, int *share, int *text, int *datastack);
 int gptlprint_memusage (const char *str, int nc);
 #ifdef HAVE_PAPI
@@ -298,6 +364,71 @@ int gptlpr_summary_file (int *fcomm, char *file, int nc1)
   return ret;
 }
 
+int gptlpr_summary_begin (int *fcomm)
+{
+#ifdef HAVE_MPI
+  MPI_Comm ccomm;
+#ifdef HAVE_COMM_F2C
+  ccomm = MPI_Comm_f2c (*fcomm);
+#else
+  /* Punt and try just casting the Fortran communicator */
+  ccomm = (MPI_Comm) *fcomm;
+#endif
+#else
+  int ccomm = 0;
+#endif
+
+  return GPTLpr_summary_begin (ccomm);
+}
+
+int gptlpr_summary_end (char *file, int nc1)
+{
+  char *locfile;
+  int ret;
+
+  if ( ! (locfile = (char *) malloc (nc1+1)))
+    return GPTLerror ("gptlpr_summary_end: malloc error\n");
+
+  memcpy (locfile, file, nc1);
+  locfile[nc1] = '\0';
+
+  ret = GPTLpr_summary_end (locfile);
+  free (locfile);
+  return ret;
+}
+
+int gptlpr_file_mpiio (int *fcomm, char *file, char *header, int *dowrite, int nc1, int nc2)
+{
+  char *locfile;
+  char *locheader;
+  int ret;
+
+#ifdef HAVE_MPI
+  MPI_Comm ccomm;
+#ifdef HAVE_COMM_F2C
+  ccomm = MPI_Comm_f2c (*fcomm);
+#else
+  /* Punt and try just casting the Fortran communicator */
+  ccomm = (MPI_Comm) *fcomm;
+#endif
+#else
+  int ccomm = 0;
+#endif
+
+  if ( ! (locfile = (char *) malloc (nc1+1)) || ! (locheader = (char *) malloc (nc2+1)))
+    return GPTLerror ("gptlpr_file_mpiio: malloc error\n");
+
+  memcpy (locfile, file, nc1);
+  locfile[nc1] = '\0';
+  memcpy (locheader, header, nc2);
+  locheader[nc2] = '\0';
+
+  ret = GPTLpr_file_mpiio (ccomm, locfile, locheader, *dowrite);
+  free (locfile);
+  free (locheader);
+  return ret;
+}
+
 int gptlbarrier (int *fcomm, char *name, int nc1)
 {
   char cname[MAX_CHARS+1];
@@ -324,6 +455,23 @@ int gptlbarrier (int *fcomm, char *name, int nc1)
   return GPTLbarrier (ccomm, cname);
 }
 
+int gptltrace_sync (int *fcomm)
+{
+#ifdef HAVE_MPI
+  MPI_Comm ccomm;
+#ifdef HAVE_COMM_F2C
+  ccomm = MPI_Comm_f2c (*fcomm);
+#else
+  /* Punt and try just casting the Fortran communicator */
+  ccomm = (MPI_Comm) *fcomm;
+#endif
+#else
+  int ccomm = 0;
+#endif
+
+  return GPTLtrace_sync (ccomm);
+}
+
 int gptlprefix_set (char *name, int nc1)
 {
   /*  char cname[MAX_CHARS+1]; */
@@ -346,6 +494,36 @@ int gptlreset (void)
   return GPTLreset();
 }
 
+int gptlsnapshot (char *tag, int nc1)
+{
+  char cname[MAX_CHARS+1];
+  int numchars;
+
+  numchars = MIN (nc1, MAX_CHARS);
+  strncpy (cname, tag, numchars);
+  cname[numchars] = '\0';
+  return GPTLsnapshot (cname);
+}
+
+int gptlsnapshot_file (char *file, int nc1)
+{
+  char *locfile;
+  int c;
+  int ret;
+
+  if ( ! (locfile = (char *) malloc (nc1+1)))
+    return GPTLerror ("gptlsnapshot_file: malloc error\n");
+
+  for (c = 0; c < nc1; c++) {
+    locfile[c] = file[c];
+  }
+  locfile[c] = '\0';
+
+  ret = GPTLsnapshot_file (locfile);
+  free (locfile);
+  return ret;
+}
+
 int gptlstamp (double *wall, double *usr, double *sys)
 {
   return GPTLstamp (wall, usr, sys);
@@ -379,6 +557,16 @@ int gptlstart_handle (char *name, void **handle, int nc1)
   return GPTLstartf_handle (name, nc1, handle);
 }
 
+int gptlregister (char *name, int *id, int nc1)
+{
+  return GPTLregisterf (name, nc1, id);
+}
+
+int gptlstart_id (int *id)
+{
+  return GPTLstart_id (*id);
+}
+
 int gptlstop (char *name, int nc1)
 {
   /*  char cname[MAX_CHARS+1];*/
@@ -407,6 +595,11 @@ int gptlstop_handle (char *name, void **handle, int nc1)
   return GPTLstopf_handle (name, nc1, handle);
 }
 
+int gptlstop_id (int *id)
+{
+  return GPTLstop_id (*id);
+}
+
 int gptlstartstop_vals (char *name, double *val, int *cnt, int nc1)
 {
   /*  char cname[MAX_CHARS+1];*/
@@ -443,6 +636,42 @@ int gptlsetutr (int *option)
   return GPTLsetutr (*option);
 }
 
+int gptlset_sampling (char *name, int *rate, int nc1)
+{
+  char cname[MAX_CHARS+1];
+  int numchars;
+
+  numchars = MIN (nc1, MAX_CHARS);
+  strncpy (cname, name, numchars);
+  cname[numchars] = '\0';
+  return GPTLset_sampling (cname, *rate);
+}
+
+int gptlselect_papi (char *pattern, int nc1)
+{
+  char cpattern[MAX_CHARS+1];
+  int numchars;
+
+  numchars = MIN (nc1, MAX_CHARS);
+  strncpy (cpattern, pattern, numchars);
+  cpattern[numchars] = '\0';
+  return GPTLselect_papi (cpattern);
+}
+
+int gptlset_filter (char *rules, int nc1)
+{
+  char *crules;
+  int ret;
+
+  if ( ! (crules = (char *) malloc (nc1 + 1)))
+    return GPTLerror ("gptlset_filter: malloc failure\n");
+  strncpy (crules, rules, nc1);
+  crules[nc1] = '\0';
+  ret = GPTLset_filter (crules);
+  free (crules);
+  return ret;
+}
+
 int gptlquery (const char *name, int *t, int *count, int *onflg, double *wallclock,
 	       double *usr, double *sys, long long *papicounters_out, int *maxcounters,
 	       int nc)
@@ -534,6 +763,21 @@ int gptlget_regionname (int *t, int *region, char *name, int nc)
   return ret;
 }
 
+int gptlquery_all (int *maxtimers, int *ntimers, int *thread, char *names, int *count,
+		   double *accum, double *max, double *min, int *onflg, int nc)
+{
+  int n;
+  int ret;
+
+  ret = GPTLquery_all (*maxtimers, ntimers, thread, names, nc, count, accum, max, min, onflg);
+  /* Turn nulls into spaces for fortran */
+  if (ret == 0 && *maxtimers > 0)
+    for (n = 0; n < *ntimers * nc; ++n)
+      if (names[n] == '\0')
+	names[n] = ' ';
+  return ret;
+}
+
 int gptlget_memusage (int *size, int *rss, int *share, int *text, int *datastack)
 {
   return GPTLget_memusage (size, rss, share, text, datastack);
@@ -0,0 +1,750 @@
+/*
+** f_wrappers_pmpi.c
+**
+** Fortran counterparts of the MPI wrappers in pmpi.c. Fortran MPI bindings do not go through the
+** C MPI_* entry points, so each wrapper here times the call and hands its arguments unchanged to
+** the Fortran profiling entry point of the MPI library (pmpi_send etc.). Passing the arguments
+** through untouched keeps MPI_IN_PLACE, MPI_BOTTOM and MPI_STATUS_IGNORE meaning what the MPI
+** library expects. Bytes are computed from the counts and datatypes as passed. The Fortran
+** MPI_IN_PLACE cannot be recognized from C, so the gather, scatter and alltoall families count
+** the arguments that are significant on this task whether or not MPI_IN_PLACE was given: the
+** receive side, except for the send side of gather on non-root tasks and scatter on the root.
+**
+** MPI-IO is not wrapped here: in CESM it is reached from C (PIO), where pmpi.c covers it.
+**
+** Compiled only when ENABLE_PMPI is defined.
+*/
+
+#ifdef ENABLE_PMPI
+
+#include "private.h"
+#include "gptl.h"
+
+#ifndef HAVE_MPI
+#error "ENABLE_PMPI requires HAVE_MPI"
+#endif
+
+#if ( defined FORTRANCAPS )
+
+#define mpi_send MPI_SEND
+#define pmpi_send PMPI_SEND
+#define mpi_ssend MPI_SSEND
+#define pmpi_ssend PMPI_SSEND
+#define mpi_isend MPI_ISEND
+#define pmpi_isend PMPI_ISEND
+#define mpi_issend MPI_ISSEND
+#define pmpi_issend PMPI_ISSEND
+#define mpi_recv MPI_RECV
+#define pmpi_recv PMPI_RECV
+#define mpi_irecv MPI_IRECV
+#define pmpi_irecv PMPI_IRECV
+#define mpi_sendrecv MPI_SENDRECV
+#define pmpi_sendrecv PMPI_SENDRECV
+#define mpi_wait MPI_WAIT
+#define pmpi_wait PMPI_WAIT
+#define mpi_waitall MPI_WAITALL
+#define pmpi_waitall PMPI_WAITALL
+#define mpi_waitany MPI_WAITANY
+#define pmpi_waitany PMPI_WAITANY
+#define mpi_waitsome MPI_WAITSOME
+#define pmpi_waitsome PMPI_WAITSOME
+#define mpi_probe MPI_PROBE
+#define pmpi_probe PMPI_PROBE
+#define mpi_barrier MPI_BARRIER
+#define pmpi_barrier PMPI_BARRIER
+#define mpi_bcast MPI_BCAST
+#define pmpi_bcast PMPI_BCAST
+#define mpi_reduce MPI_REDUCE
+#define pmpi_reduce PMPI_REDUCE
+#define mpi_allreduce MPI_ALLREDUCE
+#define pmpi_allreduce PMPI_ALLREDUCE
+#define mpi_reduce_scatter MPI_REDUCE_SCATTER
+#define pmpi_reduce_scatter PMPI_REDUCE_SCATTER
+#define mpi_scan MPI_SCAN
+#define pmpi_scan PMPI_SCAN
+#define mpi_exscan MPI_EXSCAN
+#define pmpi_exscan PMPI_EXSCAN
+#define mpi_gather MPI_GATHER
+#define pmpi_gather PMPI_GATHER
+#define mpi_gatherv MPI_GATHERV
+#define pmpi_gatherv PMPI_GATHERV
+#define mpi_allgather MPI_ALLGATHER
+#define pmpi_allgather PMPI_ALLGATHER
+#define mpi_allgatherv MPI_ALLGATHERV
+#define pmpi_allgatherv PMPI_ALLGATHERV
+#define mpi_scatter MPI_SCATTER
+#define pmpi_scatter PMPI_SCATTER
+#define mpi_scatterv MPI_SCATTERV
+#define pmpi_scatterv PMPI_SCATTERV
+#define mpi_alltoall MPI_ALLTOALL
+#define pmpi_alltoall PMPI_ALLTOALL
+#define mpi_alltoallv MPI_ALLTOALLV
+#define pmpi_alltoallv PMPI_ALLTOALLV
+#define mpi_finalize MPI_FINALIZE
+#define pmpi_finalize PMPI_FINALIZE
+
+#elif ( defined INCLUDE_CMAKE_FCI )
+
+#define mpi_send               FCI_GLOBAL(mpi_send,MPI_SEND)
+#define pmpi_send              FCI_GLOBAL(pmpi_send,PMPI_SEND)
+#define mpi_ssend              FCI_GLOBAL(mpi_ssend,MPI_SSEND)
+#define pmpi_ssend             FCI_GLOBAL(pmpi_ssend,PMPI_SSEND)
+#define mpi_isend              FCI_GLOBAL(mpi_isend,MPI_ISEND)
+#define pmpi_isend             FCI_GLOBAL(pmpi_isend,PMPI_ISEND)
+#define mpi_issend             FCI_GLOBAL(mpi_issend,MPI_ISSEND)
+#define pmpi_issend            FCI_GLOBAL(pmpi_issend,PMPI_ISSEND)
+#define mpi_recv               FCI_GLOBAL(mpi_recv,MPI_RECV)
+#define pmpi_recv              FCI_GLOBAL(pmpi_recv,PMPI_RECV)
+#define mpi_irecv              FCI_GLOBAL(mpi_irecv,MPI_IRECV)
+#define pmpi_irecv             FCI_GLOBAL(pmpi_irecv,PMPI_IRECV)
+#define mpi_sendrecv           FCI_GLOBAL(mpi_sendrecv,MPI_SENDRECV)
+#define pmpi_sendrecv          FCI_GLOBAL(pmpi_sendrecv,PMPI_SENDRECV)
+#define mpi_wait               FCI_GLOBAL(mpi_wait,MPI_WAIT)
+#define pmpi_wait              FCI_GLOBAL(pmpi_wait,PMPI_WAIT)
+#define mpi_waitall            FCI_GLOBAL(mpi_waitall,MPI_WAITALL)
+#define pmpi_waitall           FCI_GLOBAL(pmpi_waitall,PMPI_WAITALL)
+#define mpi_waitany            FCI_GLOBAL(mpi_waitany,MPI_WAITANY)
+#define pmpi_waitany           FCI_GLOBAL(pmpi_waitany,PMPI_WAITANY)
+#define mpi_waitsome           FCI_GLOBAL(mpi_waitsome,MPI_WAITSOME)
+#define pmpi_waitsome          FCI_GLOBAL(pmpi_waitsome,PMPI_WAITSOME)
+#define mpi_probe              FCI_GLOBAL(mpi_probe,MPI_PROBE)
+#define pmpi_probe             FCI_GLOBAL(pmpi_probe,PMPI_PROBE)
+#define mpi_barrier            FCI_GLOBAL(mpi_barrier,MPI_BARRIER)
+#define pmpi_barrier           FCI_GLOBAL(pmpi_barrier,PMPI_BARRIER)
+#define mpi_bcast              FCI_GLOBAL(mpi_bcast,MPI_BCAST)
+#define pmpi_bcast             FCI_GLOBAL(pmpi_bcast,PMPI_BCAST)
+#define mpi_reduce             FCI_GLOBAL(mpi_reduce,MPI_REDUCE)
+#define pmpi_reduce            FCI_GLOBAL(pmpi_reduce,PMPI_REDUCE)
+#define mpi_allreduce          FCI_GLOBAL(mpi_allreduce,MPI_ALLREDUCE)
+#define pmpi_allreduce         FCI_GLOBAL(pmpi_allreduce,PMPI_ALLREDUCE)
+#define mpi_reduce_scatter     FCI_GLOBAL(mpi_reduce_scatter,MPI_REDUCE_SCATTER)
+#define pmpi_reduce_scatter    FCI_GLOBAL(pmpi_reduce_scatter,PMPI_REDUCE_SCATTER)
+#define mpi_scan               FCI_GLOBAL(mpi_scan,MPI_SCAN)
+#define pmpi_scan              FCI_GLOBAL(pmpi_scan,PMPI_SCAN)
+#define mpi_exscan             FCI_GLOBAL(mpi_exscan,MPI_EXSCAN)
+#define pmpi_exscan            FCI_GLOBAL(pmpi_exscan,PMPI_EXSCAN)
+#define mpi_gather             FCI_GLOBAL(mpi_gather,MPI_GATHER)
+#define pmpi_gather            FCI_GLOBAL(pmpi_gather,PMPI_GATHER)
+#define mpi_gatherv            FCI_GLOBAL(mpi_gatherv,MPI_GATHERV)
+#define pmpi_gatherv           FCI_GLOBAL(pmpi_gatherv,PMPI_GATHERV)
+#define mpi_allgather          FCI_GLOBAL(mpi_allgather,MPI_ALLGATHER)
+#define pmpi_allgather         FCI_GLOBAL(pmpi_allgather,PMPI_ALLGATHER)
+#define mpi_allgatherv         FCI_GLOBAL(mpi_allgatherv,MPI_ALLGATHERV)
+#define pmpi_allgatherv        FCI_GLOBAL(pmpi_allgatherv,PMPI_ALLGATHERV)
+#define mpi_scatter            FCI_GLOBAL(mpi_scatter,MPI_SCATTER)
+#define pmpi_scatter           FCI_GLOBAL(pmpi_scatter,PMPI_SCATTER)
+#define mpi_scatterv           FCI_GLOBAL(mpi_scatterv,MPI_SCATTERV)
+#define pmpi_scatterv          FCI_GLOBAL(pmpi_scatterv,PMPI_SCATTERV)
+#define mpi_alltoall           FCI_GLOBAL(mpi_alltoall,MPI_ALLTOALL)
+#define pmpi_alltoall          FCI_GLOBAL(pmpi_alltoall,PMPI_ALLTOALL)
+#define mpi_alltoallv          FCI_GLOBAL(mpi_alltoallv,MPI_ALLTOALLV)
+#define pmpi_alltoallv         FCI_GLOBAL(pmpi_alltoallv,PMPI_ALLTOALLV)
+#define mpi_finalize           FCI_GLOBAL(mpi_finalize,MPI_FINALIZE)
+#define pmpi_finalize          FCI_GLOBAL(pmpi_finalize,PMPI_FINALIZE)
+
+#elif ( defined FORTRANUNDERSCORE )
+
+#define mpi_send mpi_send_
+#define pmpi_send pmpi_send_
+#define mpi_ssend mpi_ssend_
+#define pmpi_ssend pmpi_ssend_
+#define mpi_isend mpi_isend_
+#define pmpi_isend pmpi_isend_
+#define mpi_issend mpi_issend_
+#define pmpi_issend pmpi_issend_
+#define mpi_recv mpi_recv_
+#define pmpi_recv pmpi_recv_
+#define mpi_irecv mpi_irecv_
+#define pmpi_irecv pmpi_irecv_
+#define mpi_sendrecv mpi_sendrecv_
+#define pmpi_sendrecv pmpi_sendrecv_
+#define mpi_wait mpi_wait_
+#define pmpi_wait pmpi_wait_
+#define mpi_waitall mpi_waitall_
+#define pmpi_waitall pmpi_waitall_
+#define mpi_waitany mpi_waitany_
+#define pmpi_waitany pmpi_waitany_
+#define mpi_waitsome mpi_waitsome_
+#define pmpi_waitsome pmpi_waitsome_
+#define mpi_probe mpi_probe_
+#define pmpi_probe pmpi_probe_
+#define mpi_barrier mpi_barrier_
+#define pmpi_barrier pmpi_barrier_
+#define mpi_bcast mpi_bcast_
+#define pmpi_bcast pmpi_bcast_
+#define mpi_reduce mpi_reduce_
+#define pmpi_reduce pmpi_reduce_
+#define mpi_allreduce mpi_allreduce_
+#define pmpi_allreduce pmpi_allreduce_
+#define mpi_reduce_scatter mpi_reduce_scatter_
+#define pmpi_reduce_scatter pmpi_reduce_scatter_
+#define mpi_scan mpi_scan_
+#define pmpi_scan pmpi_scan_
+#define mpi_exscan mpi_exscan_
+#define pmpi_exscan pmpi_exscan_
+#define mpi_gather mpi_gather_
+#define pmpi_gather pmpi_gather_
+#define mpi_gatherv mpi_gatherv_
+#define pmpi_gatherv pmpi_gatherv_
+#define mpi_allgather mpi_allgather_
+#define pmpi_allgather pmpi_allgather_
+#define mpi_allgatherv mpi_allgatherv_
+#define pmpi_allgatherv pmpi_allgatherv_
+#define mpi_scatter mpi_scatter_
+#define pmpi_scatter pmpi_scatter_
+#define mpi_scatterv mpi_scatterv_
+#define pmpi_scatterv pmpi_scatterv_
+#define mpi_alltoall mpi_alltoall_
+#define pmpi_alltoall pmpi_alltoall_
+#define mpi_alltoallv mpi_alltoallv_
+#define pmpi_alltoallv pmpi_alltoallv_
+#define mpi_finalize mpi_finalize_
+#define pmpi_finalize pmpi_finalize_
+
+#elif ( defined FORTRANDOUBLEUNDERSCORE )
+
+#define mpi_send mpi_send__
+#define pmpi_send pmpi_send__
+#define mpi_ssend mpi_ssend__
+#define pmpi_ssend pmpi_ssend__
+#define mpi_isend mpi_isend__
+#define pmpi_isend pmpi_isend__
+#define mpi_issend mpi_issend__
+#define pmpi_issend pmpi_issend__
+#define mpi_recv mpi_recv__
+#define pmpi_recv pmpi_recv__
+#define mpi_irecv mpi_irecv__
+#define pmpi_irecv pmpi_irecv__
+#define mpi_sendrecv mpi_sendrecv__
+#define pmpi_sendrecv pmpi_sendrecv__
+#define mpi_wait mpi_wait__
+#define pmpi_wait pmpi_wait__
+#define mpi_waitall mpi_waitall__
+#define pmpi_waitall pmpi_waitall__
+#define mpi_waitany mpi_waitany__
+#define pmpi_waitany pmpi_waitany__
+#define mpi_waitsome mpi_waitsome__
+#define pmpi_waitsome pmpi_waitsome__
+#define mpi_probe mpi_probe__
+#define pmpi_probe pmpi_probe__
+#define mpi_barrier mpi_barrier__
+#define pmpi_barrier pmpi_barrier__
+#define mpi_bcast mpi_bcast__
+#define pmpi_bcast pmpi_bcast__
+#define mpi_reduce mpi_reduce__
+#define pmpi_reduce pmpi_reduce__
+#define mpi_allreduce mpi_allreduce__
+#define pmpi_allreduce pmpi_allreduce__
+#define mpi_reduce_scatter mpi_reduce_scatter__
+#define pmpi_reduce_scatter pmpi_reduce_scatter__
+#define mpi_scan mpi_scan__
+#define pmpi_scan pmpi_scan__
+#define mpi_exscan mpi_exscan__
+#define pmpi_exscan pmpi_exscan__
+#define mpi_gather mpi_gather__
+#define pmpi_gather pmpi_gather__
+#define mpi_gatherv mpi_gatherv__
+#define pmpi_gatherv pmpi_gatherv__
+#define mpi_allgather mpi_allgather__
+#define pmpi_allgather pmpi_allgather__
+#define mpi_allgatherv mpi_allgatherv__
+#define pmpi_allgatherv pmpi_allgatherv__
+#define mpi_scatter mpi_scatter__
+#define pmpi_scatter pmpi_scatter__
+#define mpi_scatterv mpi_scatterv__
+#define pmpi_scatterv pmpi_scatterv__
+#define mpi_alltoall mpi_alltoall__
+#define pmpi_alltoall pmpi_alltoall__
+#define mpi_alltoallv mpi_alltoallv__
+#define pmpi_alltoallv pmpi_alltoallv__
+#define mpi_finalize mpi_finalize__
+#define pmpi_finalize pmpi_finalize__
+
+#endif
+
+/*
+** Prototypes of the Fortran profiling entry points of the MPI library and of the wrappers
+*/
+
+void pmpi_send (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_ssend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                 MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_isend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                 MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr);
+void pmpi_issend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                  MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr);
+void pmpi_recv (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *source, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *status, MPI_Fint *ierr);
+void pmpi_irecv (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *source, MPI_Fint *tag,
+                 MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr);
+void pmpi_sendrecv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, MPI_Fint *dest,
+                    MPI_Fint *sendtag, void *recvbuf, MPI_Fint *recvcount, MPI_Fint *recvtype,
+                    MPI_Fint *source, MPI_Fint *recvtag, MPI_Fint *comm, MPI_Fint *status,
+                    MPI_Fint *ierr);
+void pmpi_wait (MPI_Fint *request, MPI_Fint *status, MPI_Fint *ierr);
+void pmpi_waitall (MPI_Fint *count, MPI_Fint *array_of_requests, MPI_Fint *array_of_statuses,
+                   MPI_Fint *ierr);
+void pmpi_waitany (MPI_Fint *count, MPI_Fint *array_of_requests, MPI_Fint *indx, MPI_Fint *status,
+                   MPI_Fint *ierr);
+void pmpi_waitsome (MPI_Fint *incount, MPI_Fint *array_of_requests, MPI_Fint *outcount,
+                    MPI_Fint *array_of_indices, MPI_Fint *array_of_statuses, MPI_Fint *ierr);
+void pmpi_probe (MPI_Fint *source, MPI_Fint *tag, MPI_Fint *comm, MPI_Fint *status, MPI_Fint *ierr);
+void pmpi_barrier (MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_bcast (void *buffer, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *root, MPI_Fint *comm,
+                 MPI_Fint *ierr);
+void pmpi_reduce (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                  MPI_Fint *root, MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_allreduce (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype,
+                     MPI_Fint *op, MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_reduce_scatter (void *sendbuf, void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *datatype,
+                          MPI_Fint *op, MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_scan (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_exscan (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                  MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_gather (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                  MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root, MPI_Fint *comm,
+                  MPI_Fint *ierr);
+void pmpi_gatherv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                   MPI_Fint *recvcounts, MPI_Fint *displs, MPI_Fint *recvtype, MPI_Fint *root,
+                   MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_allgather (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                     MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_allgatherv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                      MPI_Fint *recvcounts, MPI_Fint *displs, MPI_Fint *recvtype, MPI_Fint *comm,
+                      MPI_Fint *ierr);
+void pmpi_scatter (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                   MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root, MPI_Fint *comm,
+                   MPI_Fint *ierr);
+void pmpi_scatterv (void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *displs, MPI_Fint *sendtype,
+                    void *recvbuf, MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root,
+                    MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_alltoall (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                    MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_alltoallv (void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *sdispls, MPI_Fint *sendtype,
+                     void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *rdispls, MPI_Fint *recvtype,
+                     MPI_Fint *comm, MPI_Fint *ierr);
+void pmpi_finalize (MPI_Fint *ierr);
+
+void mpi_send (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+               MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_ssend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_isend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr);
+void mpi_issend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                 MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr);
+void mpi_recv (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *source, MPI_Fint *tag,
+               MPI_Fint *comm, MPI_Fint *status, MPI_Fint *ierr);
+void mpi_irecv (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *source, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr);
+void mpi_sendrecv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, MPI_Fint *dest,
+                   MPI_Fint *sendtag, void *recvbuf, MPI_Fint *recvcount, MPI_Fint *recvtype,
+                   MPI_Fint *source, MPI_Fint *recvtag, MPI_Fint *comm, MPI_Fint *status,
+                   MPI_Fint *ierr);
+void mpi_wait (MPI_Fint *request, MPI_Fint *status, MPI_Fint *ierr);
+void mpi_waitall (MPI_Fint *count, MPI_Fint *array_of_requests, MPI_Fint *array_of_statuses,
+                  MPI_Fint *ierr);
+void mpi_waitany (MPI_Fint *count, MPI_Fint *array_of_requests, MPI_Fint *indx, MPI_Fint *status,
+                  MPI_Fint *ierr);
+void mpi_waitsome (MPI_Fint *incount, MPI_Fint *array_of_requests, MPI_Fint *outcount,
+                   MPI_Fint *array_of_indices, MPI_Fint *array_of_statuses, MPI_Fint *ierr);
+void mpi_probe (MPI_Fint *source, MPI_Fint *tag, MPI_Fint *comm, MPI_Fint *status, MPI_Fint *ierr);
+void mpi_barrier (MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_bcast (void *buffer, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *root, MPI_Fint *comm,
+                MPI_Fint *ierr);
+void mpi_reduce (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                 MPI_Fint *root, MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_allreduce (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                    MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_reduce_scatter (void *sendbuf, void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *datatype,
+                         MPI_Fint *op, MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_scan (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+               MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_exscan (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                 MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_gather (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                 MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root, MPI_Fint *comm,
+                 MPI_Fint *ierr);
+void mpi_gatherv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                  MPI_Fint *recvcounts, MPI_Fint *displs, MPI_Fint *recvtype, MPI_Fint *root,
+                  MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_allgather (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                    MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_allgatherv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                     MPI_Fint *recvcounts, MPI_Fint *displs, MPI_Fint *recvtype, MPI_Fint *comm,
+                     MPI_Fint *ierr);
+void mpi_scatter (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                  MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root, MPI_Fint *comm,
+                  MPI_Fint *ierr);
+void mpi_scatterv (void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *displs, MPI_Fint *sendtype,
+                   void *recvbuf, MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root,
+                   MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_alltoall (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                   MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_alltoallv (void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *sdispls, MPI_Fint *sendtype,
+                    void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *rdispls, MPI_Fint *recvtype,
+                    MPI_Fint *comm, MPI_Fint *ierr);
+void mpi_finalize (MPI_Fint *ierr);
+
+/*
+** fnbytes: number of bytes in *count items of Fortran datatype *datatype
+*/
+
+static inline double fnbytes (const MPI_Fint *count,
+			      const MPI_Fint *datatype)
+{
+  int size;
+
+  MPI_Datatype type = MPI_Type_f2c (*datatype);
+
+  if (*count <= 0 || type == MPI_DATATYPE_NULL || PMPI_Type_size (type, &size) != MPI_SUCCESS)
+    return 0.;
+  return (double) *count * size;
+}
+
+/*
+** fcommsize: number of tasks in Fortran communicator *comm
+*/
+
+static inline int fcommsize (const MPI_Fint *comm)
+{
+  int size;
+
+  if (PMPI_Comm_size (MPI_Comm_f2c (*comm), &size) != MPI_SUCCESS)
+    return 0;
+  return size;
+}
+
+/*
+** fcommrank: rank of this task in Fortran communicator *comm (-1 on failure)
+*/
+
+static inline int fcommrank (const MPI_Fint *comm)
+{
+  int rank;
+
+  if (PMPI_Comm_rank (MPI_Comm_f2c (*comm), &rank) != MPI_SUCCESS)
+    return -1;
+  return rank;
+}
+
+/*
+** fsumbytes: number of bytes in the per-task counts of a "v" collective on *comm
+*/
+
+static inline double fsumbytes (const MPI_Fint *comm,
+				const MPI_Fint *counts,
+				const MPI_Fint *datatype)
+{
+  int i;
+  MPI_Fint total = 0;
+
+  for (i = 0; i < fcommsize (comm); ++i)
+    total += counts[i];
+  return fnbytes (&total, datatype);
+}
+
+/*
+** fsync_barrier: with GPTLsync_mpi set, time a barrier on Fortran communicator *comm as syncname
+*/
+
+static inline void fsync_barrier (const char *syncname,
+				  const MPI_Fint *comm)
+{
+  if (GPTLpmpi_sync_enabled ()) {
+    (void) GPTLstart (syncname);
+    (void) PMPI_Barrier (MPI_Comm_f2c (*comm));
+    (void) GPTLstop (syncname);
+  }
+}
+
+void mpi_send (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+               MPI_Fint *comm, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Send");
+  pmpi_send (buf, count, datatype, dest, tag, comm, ierr);
+  (void) GPTLstop ("MPI_Send");
+  GPTLpmpi_addbytes ("MPI_Send", fnbytes (count, datatype));
+}
+
+void mpi_ssend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Ssend");
+  pmpi_ssend (buf, count, datatype, dest, tag, comm, ierr);
+  (void) GPTLstop ("MPI_Ssend");
+  GPTLpmpi_addbytes ("MPI_Ssend", fnbytes (count, datatype));
+}
+
+void mpi_isend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Isend");
+  pmpi_isend (buf, count, datatype, dest, tag, comm, request, ierr);
+  (void) GPTLstop ("MPI_Isend");
+  GPTLpmpi_addbytes ("MPI_Isend", fnbytes (count, datatype));
+}
+
+void mpi_issend (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *dest, MPI_Fint *tag,
+                 MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Issend");
+  pmpi_issend (buf, count, datatype, dest, tag, comm, request, ierr);
+  (void) GPTLstop ("MPI_Issend");
+  GPTLpmpi_addbytes ("MPI_Issend", fnbytes (count, datatype));
+}
+
+void mpi_recv (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *source, MPI_Fint *tag,
+               MPI_Fint *comm, MPI_Fint *status, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Recv");
+  pmpi_recv (buf, count, datatype, source, tag, comm, status, ierr);
+  (void) GPTLstop ("MPI_Recv");
+  GPTLpmpi_addbytes ("MPI_Recv", fnbytes (count, datatype));
+}
+
+void mpi_irecv (void *buf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *source, MPI_Fint *tag,
+                MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Irecv");
+  pmpi_irecv (buf, count, datatype, source, tag, comm, request, ierr);
+  (void) GPTLstop ("MPI_Irecv");
+  GPTLpmpi_addbytes ("MPI_Irecv", fnbytes (count, datatype));
+}
+
+void mpi_sendrecv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, MPI_Fint *dest,
+                   MPI_Fint *sendtag, void *recvbuf, MPI_Fint *recvcount, MPI_Fint *recvtype,
+                   MPI_Fint *source, MPI_Fint *recvtag, MPI_Fint *comm, MPI_Fint *status,
+                   MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Sendrecv");
+  pmpi_sendrecv (sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype, source,
+                  recvtag, comm, status, ierr);
+  (void) GPTLstop ("MPI_Sendrecv");
+  GPTLpmpi_addbytes ("MPI_Sendrecv", fnbytes (sendcount, sendtype) + fnbytes (recvcount, recvtype));
+}
+
+void mpi_wait (MPI_Fint *request, MPI_Fint *status, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Wait");
+  pmpi_wait (request, status, ierr);
+  (void) GPTLstop ("MPI_Wait");
+}
+
+void mpi_waitall (MPI_Fint *count, MPI_Fint *array_of_requests, MPI_Fint *array_of_statuses,
+                  MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Waitall");
+  pmpi_waitall (count, array_of_requests, array_of_statuses, ierr);
+  (void) GPTLstop ("MPI_Waitall");
+}
+
+void mpi_waitany (MPI_Fint *count, MPI_Fint *array_of_requests, MPI_Fint *indx, MPI_Fint *status,
+                  MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Waitany");
+  pmpi_waitany (count, array_of_requests, indx, status, ierr);
+  (void) GPTLstop ("MPI_Waitany");
+}
+
+void mpi_waitsome (MPI_Fint *incount, MPI_Fint *array_of_requests, MPI_Fint *outcount,
+                   MPI_Fint *array_of_indices, MPI_Fint *array_of_statuses, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Waitsome");
+  pmpi_waitsome (incount, array_of_requests, outcount, array_of_indices, array_of_statuses, ierr);
+  (void) GPTLstop ("MPI_Waitsome");
+}
+
+void mpi_probe (MPI_Fint *source, MPI_Fint *tag, MPI_Fint *comm, MPI_Fint *status, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Probe");
+  pmpi_probe (source, tag, comm, status, ierr);
+  (void) GPTLstop ("MPI_Probe");
+}
+
+void mpi_barrier (MPI_Fint *comm, MPI_Fint *ierr)
+{
+  (void) GPTLstart ("MPI_Barrier");
+  pmpi_barrier (comm, ierr);
+  (void) GPTLstop ("MPI_Barrier");
+}
+
+void mpi_bcast (void *buffer, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *root, MPI_Fint *comm,
+                MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Bcast", comm);
+  (void) GPTLstart ("MPI_Bcast");
+  pmpi_bcast (buffer, count, datatype, root, comm, ierr);
+  (void) GPTLstop ("MPI_Bcast");
+  GPTLpmpi_addbytes ("MPI_Bcast", fnbytes (count, datatype));
+}
+
+void mpi_reduce (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                 MPI_Fint *root, MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Reduce", comm);
+  (void) GPTLstart ("MPI_Reduce");
+  pmpi_reduce (sendbuf, recvbuf, count, datatype, op, root, comm, ierr);
+  (void) GPTLstop ("MPI_Reduce");
+  GPTLpmpi_addbytes ("MPI_Reduce", fnbytes (count, datatype));
+}
+
+void mpi_allreduce (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                    MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Allreduce", comm);
+  (void) GPTLstart ("MPI_Allreduce");
+  pmpi_allreduce (sendbuf, recvbuf, count, datatype, op, comm, ierr);
+  (void) GPTLstop ("MPI_Allreduce");
+  GPTLpmpi_addbytes ("MPI_Allreduce", fnbytes (count, datatype));
+}
+
+void mpi_reduce_scatter (void *sendbuf, void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *datatype,
+                         MPI_Fint *op, MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Reduce_scatter", comm);
+  (void) GPTLstart ("MPI_Reduce_scatter");
+  pmpi_reduce_scatter (sendbuf, recvbuf, recvcounts, datatype, op, comm, ierr);
+  (void) GPTLstop ("MPI_Reduce_scatter");
+  GPTLpmpi_addbytes ("MPI_Reduce_scatter", fsumbytes (comm, recvcounts, datatype));
+}
+
+void mpi_scan (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+               MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Scan", comm);
+  (void) GPTLstart ("MPI_Scan");
+  pmpi_scan (sendbuf, recvbuf, count, datatype, op, comm, ierr);
+  (void) GPTLstop ("MPI_Scan");
+  GPTLpmpi_addbytes ("MPI_Scan", fnbytes (count, datatype));
+}
+
+void mpi_exscan (void *sendbuf, void *recvbuf, MPI_Fint *count, MPI_Fint *datatype, MPI_Fint *op,
+                 MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Exscan", comm);
+  (void) GPTLstart ("MPI_Exscan");
+  pmpi_exscan (sendbuf, recvbuf, count, datatype, op, comm, ierr);
+  (void) GPTLstop ("MPI_Exscan");
+  GPTLpmpi_addbytes ("MPI_Exscan", fnbytes (count, datatype));
+}
+
+void mpi_gather (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                 MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root, MPI_Fint *comm,
+                 MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Gather", comm);
+  (void) GPTLstart ("MPI_Gather");
+  pmpi_gather (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm, ierr);
+  (void) GPTLstop ("MPI_Gather");
+  GPTLpmpi_addbytes ("MPI_Gather", fcommrank (comm) == *root ? fnbytes (recvcount, recvtype)
+		                                               : fnbytes (sendcount, sendtype));
+}
+
+void mpi_gatherv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                  MPI_Fint *recvcounts, MPI_Fint *displs, MPI_Fint *recvtype, MPI_Fint *root,
+                  MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Gatherv", comm);
+  (void) GPTLstart ("MPI_Gatherv");
+  pmpi_gatherv (sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm,
+                 ierr);
+  (void) GPTLstop ("MPI_Gatherv");
+  if (fcommrank (comm) == *root)
+    GPTLpmpi_addbytes ("MPI_Gatherv", fnbytes (&recvcounts[*root], recvtype));
+  else
+    GPTLpmpi_addbytes ("MPI_Gatherv", fnbytes (sendcount, sendtype));
+}
+
+void mpi_allgather (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                    MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Allgather", comm);
+  (void) GPTLstart ("MPI_Allgather");
+  pmpi_allgather (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm, ierr);
+  (void) GPTLstop ("MPI_Allgather");
+  GPTLpmpi_addbytes ("MPI_Allgather", fnbytes (recvcount, recvtype));
+}
+
+void mpi_allgatherv (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                     MPI_Fint *recvcounts, MPI_Fint *displs, MPI_Fint *recvtype, MPI_Fint *comm,
+                     MPI_Fint *ierr)
+{
+  int rank;
+
+  fsync_barrier ("sync_Allgatherv", comm);
+  (void) GPTLstart ("MPI_Allgatherv");
+  pmpi_allgatherv (sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm, ierr);
+  (void) GPTLstop ("MPI_Allgatherv");
+  if ((rank = fcommrank (comm)) >= 0)
+    GPTLpmpi_addbytes ("MPI_Allgatherv", fnbytes (&recvcounts[rank], recvtype));
+}
+
+void mpi_scatter (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                  MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root, MPI_Fint *comm,
+                  MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Scatter", comm);
+  (void) GPTLstart ("MPI_Scatter");
+  pmpi_scatter (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm, ierr);
+  (void) GPTLstop ("MPI_Scatter");
+  GPTLpmpi_addbytes ("MPI_Scatter", fcommrank (comm) == *root ? fnbytes (sendcount, sendtype)
+		                                                : fnbytes (recvcount, recvtype));
+}
+
+void mpi_scatterv (void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *displs, MPI_Fint *sendtype,
+                   void *recvbuf, MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *root,
+                   MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Scatterv", comm);
+  (void) GPTLstart ("MPI_Scatterv");
+  pmpi_scatterv (sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm,
+                  ierr);
+  (void) GPTLstop ("MPI_Scatterv");
+  if (fcommrank (comm) == *root)
+    GPTLpmpi_addbytes ("MPI_Scatterv", fnbytes (&sendcounts[*root], sendtype));
+  else
+    GPTLpmpi_addbytes ("MPI_Scatterv", fnbytes (recvcount, recvtype));
+}
+
+void mpi_alltoall (void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype, void *recvbuf,
+                   MPI_Fint *recvcount, MPI_Fint *recvtype, MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Alltoall", comm);
+  (void) GPTLstart ("MPI_Alltoall");
+  pmpi_alltoall (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm, ierr);
+  (void) GPTLstop ("MPI_Alltoall");
+  GPTLpmpi_addbytes ("MPI_Alltoall", fcommsize (comm) * fnbytes (recvcount, recvtype));
+}
+
+void mpi_alltoallv (void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *sdispls, MPI_Fint *sendtype,
+                    void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *rdispls, MPI_Fint *recvtype,
+                    MPI_Fint *comm, MPI_Fint *ierr)
+{
+  fsync_barrier ("sync_Alltoallv", comm);
+  (void) GPTLstart ("MPI_Alltoallv");
+  pmpi_alltoallv (sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype,
+                   comm, ierr);
+  (void) GPTLstop ("MPI_Alltoallv");
+  GPTLpmpi_addbytes ("MPI_Alltoallv", fsumbytes (comm, recvcounts, recvtype));
+}
+
+/*
+** mpi_finalize: print the timers if nothing has done so yet (see MPI_Finalize in pmpi.c)
+*/
+
+void mpi_finalize (MPI_Fint *ierr)
+{
+  int rank;
+
+  if (GPTLis_initialized () && ! GPTLpr_has_been_called ()) {
+    if (PMPI_Comm_rank (MPI_COMM_WORLD, &rank) != MPI_SUCCESS)
+      rank = 0;
+    (void) GPTLpr (rank);
+  }
+  pmpi_finalize (ierr);
+}
+
+#endif
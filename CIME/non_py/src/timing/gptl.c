@@ -9,12 +9,14 @@
 #include <stdlib.h>        /* malloc */
 #include <sys/time.h>      /* gettimeofday */
 #include <sys/times.h>     /* times */
-#include <unistd.h>        /* gettimeofday, syscall */
+#include <unistd.h>        /* gettimeofday, syscall, write */
+#include <fcntl.h>         /* open */
 #include <stdio.h>
 #include <string.h>        /* memset, strcmp (via STRMATCH), strncmp (via STRNMATCH) */
 #include <ctype.h>         /* isdigit */
 #include <sys/types.h>     /* u_int8_t, u_int16_t */
 #include <float.h>         /* FLT_MAX */
+#include <math.h>          /* frexp, ldexp, ceil, sqrt */
 #include <assert.h>
 
 #ifndef HAVE_C99_INLINE
@@ -33,13 +35,42 @@
 #include <sys/systemcfg.h>
 #endif
 
+#if ( defined HAVE_NANOTIME ) && ( defined __GNUC__ ) && ( defined __x86_64__ || defined __i386__ )
+#include <cpuid.h>         /* __get_cpuid */
+#define HAVE_CPUID
+#endif
+
+#ifdef CLOCK_MONOTONIC_RAW
+#define GPTL_CLOCK_MONOTONIC CLOCK_MONOTONIC_RAW
+#else
+#define GPTL_CLOCK_MONOTONIC CLOCK_MONOTONIC
+#endif
+
 #include "private.h"
 #include "gptl.h"
+#include "gptl_binary.h"
+
+#ifdef ENABLE_PMPI
+/*
+** GPTL's own communication (summary stats, MPI-IO output) goes straight to the profiling
+** entry points, so the wrappers in pmpi.c neither time it nor add timers while lists are walked
+*/
+#define MPI_Allreduce         PMPI_Allreduce
+#define MPI_Barrier           PMPI_Barrier
+#define MPI_Bcast             PMPI_Bcast
+#define MPI_Exscan            PMPI_Exscan
+#define MPI_File_close        PMPI_File_close
+#define MPI_File_open         PMPI_File_open
+#define MPI_File_write_at_all PMPI_File_write_at_all
+#define MPI_Gather            PMPI_Gather
+#define MPI_Gatherv           PMPI_Gatherv
+#define MPI_Probe             PMPI_Probe
+#define MPI_Recv              PMPI_Recv
+#define MPI_Reduce            PMPI_Reduce
+#define MPI_Send              PMPI_Send
+#define MPI_Waitall           PMPI_Waitall
+#endif
 
-static Timer **timers = 0;           /* linked list of timers */
-static Timer **last = 0;             /* last element in list */
-static int *max_depth;               /* maximum indentation level encountered */
-static int *max_name_len;            /* max length of timer name */
 static volatile int nthreads = -1;   /* num threads. Init to bad value */
 static volatile int maxthreads = -1; /* max threads (=nthreads for OMP). Init to bad value */
 static int depthlimit = 99999;       /* max depth for timers (99999 is effectively infinite) */
@@ -50,20 +81,36 @@ static Entry eventlist[MAX_AUX];    /* list of PAPI-based events to be counted *
 static int nevents = 0;             /* number of PAPI events (init to 0) */
 static bool dousepapi = false;      /* saves a function call if stays false */
 static bool verbose = false;        /* output verbosity */
-static bool percent = false;        /* print wallclock also as percent of 1st timers[0] */
+static bool percent = false;        /* print wallclock also as percent of 1st perthread[0].timers */
+static bool dohist = false;         /* keep per-timer latency histograms */
 static bool dopr_preamble = true;   /* whether to print preamble info */
 static bool dopr_threadsort = true; /* whether to print sorted thread stats */
 static bool dopr_multparent = true; /* whether to print multiple parent info */
 static bool dopr_collision = true;  /* whether to print hash collision info */
 static bool dopr_quotes = false;    /* whether to surround timer names with double quotes */
+static bool dopr_binary = false;    /* whether to also write binary (.gptb) output */
+static bool doexclusive = false;    /* track descendant calls, print exclusive wallclock */
+static int selftop = 0;             /* print self time, and a flat profile of this many timers */
+static int tracecap = 0;            /* events per thread trace buffer (0: no event trace) */
+static bool domemory = false;       /* record resident set size change and peak per timer */
 
 static time_t ref_gettimeofday = -1; /* ref start point for gettimeofday */
 static time_t ref_clock_gettime = -1;/* ref start point for clock_gettime */
+static time_t ref_clock_monotonic = -1; /* ref start point for clock_gettime (monotonic) */
 #ifdef _AIX
 static time_t ref_read_real_time = -1; /* ref start point for read_real_time */
 #endif
 static long long ref_papitime = -1;  /* ref start point for PAPI_get_real_usec */
 
+/*
+** Thread slots are claimed with an atomic compare-and-swap so no lock is
+** needed. Compilers without the GNU builtins fall back to a critical region.
+*/
+
+#if ( defined __GNUC__ )
+#define HAVE_SYNC_CAS
+#endif
+
 #if ( defined THREADED_OMP )
 
 #include <omp.h>
@@ -80,6 +127,28 @@ static volatile pthread_mutex_t t_mutex;
 static volatile pthread_mutex_t t_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 static volatile pthread_t *threadid = 0;  /* array of thread ids */
+
+/*
+** Each thread caches its logical thread number so get_thread_num need not
+** search threadid[] on every call. Use compiler thread-local storage where
+** available, else fall back to a pthread key.
+*/
+
+#if ( defined __GNUC__ )
+#define THREAD_LOCAL __thread
+#elif ( defined __STDC_VERSION__ && __STDC_VERSION__ >= 201112L )
+#define THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef THREAD_LOCAL
+static THREAD_LOCAL int mythreadnum = -1;   /* cached logical thread number */
+static THREAD_LOCAL int mygeneration = -1;  /* value of generation when mythreadnum was set */
+static volatile int generation = 0;         /* bumped by threadinit to invalidate cached values */
+#else
+static pthread_key_t threadkey;             /* thread-specific logical thread number + 1 */
+#endif
+
+static int set_thread_num (const int); /* cache logical thread number of this thread */
 static int lock_mutex (void);      /* lock a mutex for entry into a critical region */
 static int unlock_mutex (void);    /* unlock a mutex for exit from a critical region */
 
@@ -102,9 +171,16 @@ typedef struct {
   double wallmax;
   double wallmin;
   double walltotal;
+  double selfmax;
+  double selftotal;
+  long long rssdeltamax;       /* over processes and threads (GPTLmemory) */
+  long long rssdeltamin;
+  long long rsspeakmax;
+  long long rsspeakmin;
   int onflgs;
   int processes;
   int threads;
+  int filled;                  /* set by a process that has the timer */
 #ifdef HAVE_PAPI
   double papimax[MAX_AUX];
   double papimin[MAX_AUX];
@@ -121,54 +197,288 @@ typedef struct {
   int papimin_p[MAX_AUX];
   int papimin_t[MAX_AUX];
 #endif
+  float callmax;               /* longest single start/stop pair */
+  float callmin;               /* shortest single start/stop pair */
 } Summarystats;
 
+/*
+** A summary started by GPTLpr_summary_begin and written by
+** GPTLpr_summary_end. Only one can be outstanding at a time.
+*/
+
+typedef struct {
+  bool active;                 /* begun but not yet ended */
+  int iam;                     /* rank in comm */
+  int count;                   /* number of timers */
+  const char **names;          /* name of every timer */
+  char *namebuf;               /* storage for names only other tasks have (root) */
+  Summarystats *storage;       /* stats for every timer */
+  unsigned long *hist;         /* histograms for every timer (GPTLhistogram) */
+#ifdef HAVE_MPI
+  MPI_Comm comm;
+  int nproc;                   /* size of comm */
+  int nglobal;                 /* number of distinct timers over all ranks */
+  int *gidx;                   /* global index of each local timer */
+  int *lidx;                   /* local index of each global timer (-1 if none) */
+  int *owner;                  /* lowest rank having each global timer */
+  Summarystats *global;        /* one record per global timer */
+  unsigned long *ghist;        /* one histogram per global timer */
+  MPI_Datatype rectype;        /* a Summarystats record */
+  MPI_Op op;                   /* summary_op */
+  MPI_Request req[3];          /* reductions of global, ghist and owner */
+#endif
+} Summaryreq;
+
+/*
+** For binary output (GPTLdopr_binary): a column is read from nrows records
+** stride bytes apart. The in-memory type for GPTLBIN_INT32, FLOAT32, FLOAT64,
+** INT64, UINT64 and STRING is int, float, double, long long, unsigned long
+** and char respectively.
+*/
+
+#define MAX_BINCOLS 24
+
+typedef struct {
+  const char *name;            /* column name */
+  int type;                    /* GPTLBIN_ type code */
+  int width;                   /* values per row */
+  const void *data;            /* first value of the first row */
+  size_t stride;               /* bytes between rows in memory */
+  bool indirect;               /* GPTLBIN_STRING only: each row is a char * to the string */
+} Bincol;
+
+typedef struct {
+  const char *name;            /* table name */
+  long long nrows;             /* number of rows */
+  int ncols;                   /* number of columns */
+  Bincol cols[MAX_BINCOLS];
+} Bintable;
+
+typedef struct {
+  const Timer *ptr;            /* timer */
+  int row;                     /* its row in the "timers" table */
+} Binaddr;
+
+/*
+** Snapshots (GPTLsnapshot): the change in each timer since the previous
+** snapshot is copied into a ring buffer, and from there appended to a file.
+** In threaded builds (pthreads or OpenMP) a writer thread, a pthread in both
+** cases, drains the ring, so GPTLsnapshot only copies. Unthreaded builds, and
+** OpenMP builds compiled with -DNO_SNAP_WRITER, have GPTLsnapshot drain the
+** ring itself with one write().
+** The start/stop path is untouched: the baseline for each change lives in
+** the cold part of the Timer, and the ring lock is only shared by
+** GPTLsnapshot and the writer.
+*/
+
+typedef struct {
+  int seq;                     /* snapshot number */
+  int thread;                  /* thread number, or -1 for the snapshot itself */
+  unsigned long count;         /* calls since the previous snapshot */
+  double wall;                 /* wallclock since the previous snapshot (-1: time stamp) */
+  char name[MAX_CHARS+1];      /* timer name (-1: tag) */
+} Snaprec;
+
+/*
+** Event trace (GPTLtrace): each start and stop appends one record to a
+** buffer of tracecap records owned by its thread, so recording takes no
+** lock. A full buffer is appended by its thread to the trace file as one
+** GPTLBIN_TRACE segment (see gptl_binary.h), and GPTLpr_file and
+** GPTLfinalize append what is left, so the whole run is kept. Only the file
+** append is serialized between threads.
+*/
+
+typedef struct {
+  double time;                 /* wallclock time stamp */
+  int id;                      /* timer number in its thread (Timer.traceid) */
+  int kind;                    /* GPTLBIN_TRACE_START or GPTLBIN_TRACE_STOP */
+} Tracerec;
+
+typedef struct {
+  int id;                      /* Timer.traceid */
+  const char *name;            /* timer name */
+} Tracename;
+
+static char *tracepath = 0;       /* trace file, set by the first flush */
+static bool trace_opened = false; /* trace file has been created */
+static bool trace_synced = false; /* GPTLtrace_sync has set traceepoch */
+static double traceepoch = 0.;    /* local clock at the GPTLtrace_sync barrier */
+
+#if ( defined THREADED_PTHREADS ) || ( defined THREADED_OMP && ! defined NO_SNAP_WRITER )
+#define SNAP_WRITER
+#include <pthread.h>
+#endif
+
+#define DEFAULT_SNAPSHOT_RING 8192
+static int snapring_size = DEFAULT_SNAPSHOT_RING; /* records in the ring (settable parameter) */
+static Snaprec *snapring = 0;     /* ring buffer, allocated by the first snapshot */
+static volatile long snaphead = 0;/* number of records produced */
+static volatile long snaptail = 0;/* number of records written */
+static int snapseq = 0;           /* number of snapshots taken */
+static int snapfd = -1;           /* append-only output file */
+static char *snapfile = 0;        /* output file name (GPTLsnapshot_file) */
+static double snaplast = 0.;      /* time stamp of the previous snapshot written */
+static double snapinit = 0.;      /* time stamp of GPTLinitialize */
+#ifdef SNAP_WRITER
+static pthread_mutex_t snap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snap_cond = PTHREAD_COND_INITIALIZER; /* ring gained records or space */
+static pthread_t snapthread;      /* writer thread */
+static bool snapstop = false;     /* tells the writer to finish */
+#endif
+
 /* Options, print strings, and default enable flags */
 
 static Settings cpustats =      {GPTLcpu,      "Usr       sys       usr+sys   ", false};
 static Settings wallstats =     {GPTLwall,     "   Wallclock          max          min", true };
 static Settings overheadstats = {GPTLoverhead, "     UTR Overhead "            , true };
 static Settings profileovhd   = {GPTLprofile_ovhd, "", false };
+static const char *histstr = "          p50          p95          p99";
+static const char *exclstr = " Descendants  Excl (corr) ";
+static const char *selfstr = "         self";
+static const char *memstr = " RSS delta(KB)  RSS peak(KB) ";
 
-static Hashentry **hashtable;    /* table of entries */
 static long ticks_per_sec;       /* clock ticks per second */
-static char **timerlist;         /* list of all timers */
+
+/*
+** Per-thread state, indexed by thread number. Each element is cache aligned
+** and padded to whole cache lines, so no two threads write to the same line.
+** With OpenMP the arrays it points to are allocated and first touched by
+** the owning thread (see init_thread), so they live on its NUMA node.
+*/
 
 typedef struct {
-  int val;                       /* depth in calling tree */
-  int padding[31];               /* padding is to mitigate false cache sharing */
-} Nofalse;
-static Timer ***callstack;       /* call stack */
-static Nofalse *stackidx;        /* index into callstack: */
+  Timer **callstack;             /* call stack */
+  int stackidx;                  /* index into callstack: depth in calling tree */
+  int max_depth;                 /* maximum indentation level encountered */
+  int max_name_len;              /* max length of timer name */
+  int prefix_len;                /* length of timer name prefix */
+  Timer *timers;                 /* linked list of timers */
+  Timer *last;                   /* last element in list */
+  Hashtable hashtable;           /* hash table of timers */
+  Edgetable edges;               /* (parent, child) call graph edges */
+  Arena arena;                   /* pool for timers and parent/child arrays */
+  char *prefix;                  /* timer name prefix */
+  Timer **idtimers;              /* cache mapping registered id to timer */
+  int nidtimers;                 /* size of idtimers */
+  unsigned long npairs;          /* start/stop pairs started (GPTLexclusive only) */
+  bool papifresh;                /* PAPI counters were read by the last start/stop */
+  Tracerec *trace;               /* event trace buffer (GPTLtrace only) */
+  int ntrace;                    /* records in trace */
+  Timer *trace_named;            /* last timer whose name is in the trace file */
+  unsigned long ntraced;         /* records written to the trace file */
+  unsigned long nflush;          /* number of trace flushes */
+  double flushtime;              /* wallclock spent flushing the trace */
+} CACHE_ALIGNED Perthread;
+
+static Perthread *perthread = 0; /* per-thread state */
+static char *perthread_mem;      /* space perthread is aligned within */
 
 static int prefix_len_nt;        /* length of timer name prefix set outside parallel region */
 static char *prefix_nt;          /* timer name prefix set outside of parallel region */
-static int *prefix_len;          /* length of timer name prefix for each thread */
-static char **prefix;            /* timer name prefix for each thread */
+
+/*
+** Registered timer ids (GPTLregister). Names are stored in chunks which never
+** move once allocated, so a thread resolving an id cannot race with another
+** thread registering a new one. Each thread caches the Timer for an id the
+** first time it uses it, after which GPTLstart_id/GPTLstop_id are an array index.
+*/
+
+#define IDCHUNK 256                     /* number of registered names per chunk */
+#define MAX_IDCHUNKS 4096               /* max number of chunks */
+static char **idnames[MAX_IDCHUNKS];    /* registered names */
+static volatile int nids = 0;           /* number of registered ids */
+
+static Summaryreq sumreq;      /* summary between GPTLpr_summary_begin and _end */
+
+/*
+** Timers to sample (GPTLset_sampling). The list is only searched when a timer
+** is created, which copies the rate into the Timer.
+*/
+
+typedef struct {
+  char name[MAX_CHARS+1];      /* timer name */
+  unsigned int rate;           /* read the clocks on 1 in rate calls */
+} Samplespec;
+
+static Samplespec *samplelist = 0; /* timers to sample */
+static int nsampling = 0;          /* number of entries in samplelist */
+
+/*
+** Timer name patterns: a name, or a prefix followed by '*'
+*/
+
+typedef struct {
+  char pattern[MAX_CHARS+1];
+} Namepattern;
+
+static Namepattern *papiselect = 0; /* timers which read PAPI (GPTLselect_papi) */
+static int npapiselect = 0;         /* number of entries in papiselect: 0 means all */
+
+/*
+** Filter rules (GPTLset_filter): the last rule whose pattern matches a timer
+** name decides whether it is timed. Names no rule matches are timed.
+*/
+
+typedef struct {
+  Namepattern pattern;
+  bool include;                     /* '+' rule (true) or '-' rule (false) */
+} Filterrule;
+
+static Filterrule *filterlist = 0;  /* rules in the order given */
+static int nfilter = 0;             /* number of entries in filterlist */
 
 static Method method = GPTLmost_frequent;  /* default parent/child printing mechanism */
 static PRMode print_mode = GPTLprint_write;  /* default output mode */
 
 /* Local function prototypes */
 
+static int pr_report (FILE *);
 static void printstats (const Timer *, FILE *, const int, const int, const bool, double);
 static void add (Timer *, const Timer *);
-
-static void get_threadstats (const int, const char *, Summarystats *);
+static void compute_self (Timer *);
+static int cmp_self (const void *, const void *);
+static void print_flat_profile (FILE *, const int);
+static int cmp_selftotal (const void *, const void *);
+static void print_summary_flat (FILE *, const char **, const Summarystats *, const int);
+static double sample_stderr (const Timer *);
+
+static void add_threadstats (const int, const int, const Timer *, Summarystats *, unsigned long *);
 static void get_summarystats (Summarystats *, const Summarystats *);
+static int collect_begin (Summaryreq *);
+static int collect_end (Summaryreq *);
+static void free_summaryreq (Summaryreq *);
+static int merge_thread_data (const int, const char ***, Summarystats **, unsigned long **);
+
+static int pr_binary (const char *);
+static void bin_addcol (Bintable *, const char *, const int, const int, const void *, const size_t);
+static int bin_write (const char *, const int, const int, const int, const Bintable *, const bool);
+static size_t bin_typesize (const int);
+static int bin_addrcmp (const void *, const void *);
+static int get_world_rank (void);
 #ifdef HAVE_MPI
-static int collect_data( const int, MPI_Comm, int *, Summarystats ** );
-#else
-static int collect_data( const int, const int, int *, Summarystats ** );
+static MPI_Comm comm_or_world (MPI_Comm);
+#endif
+
+static int snap_open (void);
+static int snap_push (const Snaprec *);
+static int snap_write (const long, const long);
+static int snap_close (void);
+static inline void trace_event (const int, const Timer *, const int, const double);
+static int trace_flush (const int);
+#ifdef SNAP_WRITER
+static void *snap_writer (void *);
 #endif
-static int merge_thread_data();
 
 static void print_multparentinfo (FILE *, Timer *);
 static inline int get_cpustamp (long *, long *);
-static int newchild (Timer *, Timer *);
+static int newchild (Timer *, Timer *, Arena *, Edgetable *);
+static void *grow_array (Arena *, void *, const int, const size_t);
 static int get_max_depth (const Timer *, const int);
+static inline int hist_bin (const double);
+static double hist_percentile (const unsigned long *, const double, const double, const double);
 static int num_descendants (Timer *);
-static int is_descendant (const Timer *, const Timer *);
+static int is_descendant (Timer *, const Timer *);
+static int find_descendant (Timer *, const Timer *, const unsigned int);
 static int show_descendant (const int, const Timer *, const Timer *);
 static char *methodstr (Method);
 static char *modestr (PRMode);
@@ -189,6 +499,7 @@ static inline double utr_clock_gettime (void);
 static inline double utr_papitime (void);
 static inline double utr_read_real_time (void);
 static inline double utr_gettimeofday (void);
+static inline double utr_clock_monotonic (void);
 
 static int init_nanotime (void);
 static int init_mpiwtime (void);
@@ -196,23 +507,43 @@ static int init_clock_gettime (void);
 static int init_papitime (void);
 static int init_read_real_time (void);
 static int init_gettimeofday (void);
+static int init_clock_monotonic (void);
 
 static double utr_getoverhead (void);
-static inline Timer *getentry_instr (const Hashentry *, void *, unsigned int *);
-static inline Timer *getentry (const Hashentry *, const char *, unsigned int *);
-static inline Timer *getentryf (const Hashentry *, const char *, const int, unsigned int *);
+static double utr_getresolution (void);
+static bool utr_is_usable (const Funcoption);
+static int select_utr (void);
+static inline Timer *getentry_instr (const Hashtable *, void *, unsigned int *);
+static inline Timer *getentry (const Hashtable *, const char *, unsigned int *);
+static inline Timer *getentryf (const Hashtable *, const char *, const int, unsigned int *);
+static int grow_hashtable (Hashtable *);
 static void printself_andchildren (const Timer *, FILE *, const int, const int, const double);
-static inline int update_parent_info (Timer *, Timer **, int);
-static inline int update_stats (Timer *, const double, const long, const long, const int);
+static inline int update_parent_info (Timer *, Timer **, int, Arena *, Edgetable *);
+static inline unsigned int edge_hash (const Timer *, const Timer *);
+static inline Edgeslot *find_edge (const Edgetable *, const Timer *, const Timer *);
+static int add_edge (Edgetable *, const Timer *, const Timer *, const unsigned int);
+static int grow_edgetable (Edgetable *);
+static inline int update_stats (Timer *, double, long, long, const int, const bool);
 static int update_ll_hash (Timer *, const int, const unsigned int);
+static int init_thread (const int);
+static unsigned int get_sampling (const char *);
+static bool name_matches (const Namepattern *, const int, const char *);
+static int add_filter (const char *);
+static bool is_filtered (const char *);
+static inline bool skip_stamp (const int);
+static inline unsigned long nstamped (const Timer *);
 static inline int update_ptr (Timer *, const int);
-static int construct_tree (Timer *, Method);
+static int construct_tree (Timer *, Method, Arena *, Edgetable *);
 
-static int cmp (const void *, const void *);
-static int ncmp (const void *, const void *);
-static int get_index ( const char *, const char *);
 
 static int add_prefix( char *, const char *, const int, const int);
+static int register_name (const char *, const int);
+static int find_name (const char *, const int);
+static int add_name (const char *, const int);
+#ifdef THREADED_PTHREADS
+static int claim_index (volatile int *, const int);
+#endif
+static inline Timer *getentry_id (const int, const int, const bool);
 
 typedef struct {
   const Funcoption option;
@@ -227,27 +558,44 @@ static Funcentry funclist[] = {
   {GPTLmpiwtime,       utr_mpiwtime,       init_mpiwtime,      "MPI_Wtime"},
   {GPTLclockgettime,   utr_clock_gettime,  init_clock_gettime, "clock_gettime"},
   {GPTLpapitime,       utr_papitime,       init_papitime,      "PAPI_get_real_usec"},
-  {GPTLread_real_time, utr_read_real_time, init_read_real_time,"read_real_time"}     /* AIX only */
+  {GPTLread_real_time, utr_read_real_time, init_read_real_time,"read_real_time"},    /* AIX only */
+  {GPTLclockmonotonic, utr_clock_monotonic, init_clock_monotonic, "clock_gettime(MONOTONIC_RAW)"}
 };
-static const int nfuncentries = sizeof (funclist) / sizeof (Funcentry);
+#define NFUNCENTRIES (sizeof (funclist) / sizeof (Funcentry))
+static const int nfuncentries = NFUNCENTRIES;
 
 static double (*ptr2wtimefunc)() = 0; /* init to invalid */
 static int funcidx = 0;               /* default timer is gettimeofday */
 
+/*
+** GPTLautoutr: GPTLinitialize measures every usable candidate and keeps the
+** cheapest. The effective cost of a candidate is the larger of its per-call
+** overhead and its resolution, so a cheap but coarse clock does not win.
+*/
+
+static bool autoutr = false;                /* choose the utr at GPTLinitialize */
+static double utr_cost[NFUNCENTRIES];       /* effective cost per candidate (< 0 if rejected) */
+
 #ifdef HAVE_NANOTIME
 static float cpumhz = -1.;                        /* init to bad value */
 static double cyc2sec = -1;                       /* init to bad value */
+static bool tsc_calibrated = false;               /* cpumhz measured (not from /proc/cpuinfo) */
 static unsigned inline long long nanotime (void); /* read counter (assembler) */
 static float get_clockfreq (void);                /* cycles/sec */
+static float calibrate_clockfreq (void);          /* cycles/sec, measured */
+static bool tsc_is_invariant (void);              /* TSC ticks at a constant rate */
 #endif
 
 #define DEFAULT_TABLE_SIZE 2048
-static int tablesize = DEFAULT_TABLE_SIZE;  /* per-thread size of hash table (settable parameter) */
+static int tablesize = DEFAULT_TABLE_SIZE;  /* initial per-thread size of hash table (settable parameter) */
+#define EDGE_TABLE_SIZE 256   /* initial per-thread size of the edge table */
+#define EDGE_SCAN 4           /* parents searched directly before the edge table is used */
 static char *outdir = 0;      /* dir to write output files to (currently unused) */
 
 static double overhead_utr   = 0.0;                 /* timer cost estimate */
 static double overhead_est   = 0.0;                 /* direct measurement of overhead for thread 0 */
 static double overhead_bound = 0.0;                 /* direct measurement of overhead for thread 0 */
+static double pair_overhead  = 0.0;                 /* cost of a start/stop pair, set by pr_report */
 
 /* VERBOSE is a debugging ifdef local to the rest of this file */
 #undef VERBOSE
@@ -321,6 +669,11 @@ int GPTLsetoption (const int option,  /* option */
     if (verbose)
       printf ("%s: boolean percent = %d\n", thisfunc, val);
     return 0;
+  case GPTLhistogram:
+    dohist = (bool) val;
+    if (verbose)
+      printf ("%s: boolean dohist = %d\n", thisfunc, val);
+    return 0;
   case GPTLdopr_preamble:
     dopr_preamble = (bool) val;
     if (verbose)
@@ -346,6 +699,35 @@ int GPTLsetoption (const int option,  /* option */
     if (verbose)
       printf ("%s: boolean dopr_quotes = %d\n", thisfunc, val);
     return 0;
+  case GPTLdopr_binary:
+    dopr_binary = (bool) val;
+    if (verbose)
+      printf ("%s: boolean dopr_binary = %d\n", thisfunc, val);
+    return 0;
+  case GPTLexclusive:
+    doexclusive = (bool) val;
+    if (verbose)
+      printf ("%s: boolean doexclusive = %d\n", thisfunc, val);
+    return 0;
+  case GPTLselftime:
+    if (val < 0)
+      return GPTLerror ("%s: selftime must be non-negative. %d is invalid\n", thisfunc, val);
+    selftop = val;
+    if (verbose)
+      printf ("%s: selftime flat profile size = %d\n", thisfunc, val);
+    return 0;
+  case GPTLmemory:
+    domemory = (bool) val;
+    if (verbose)
+      printf ("%s: boolean domemory = %d\n", thisfunc, val);
+    return 0;
+  case GPTLtrace:
+    if (val < 0)
+      return GPTLerror ("%s: trace buffer size must be non-negative. %d is invalid\n", thisfunc, val);
+    tracecap = val;
+    if (verbose)
+      printf ("%s: trace buffer size = %d events per thread\n", thisfunc, val);
+    return 0;
   case GPTLprint_mode:
     print_mode = (PRMode) val;
     if (verbose)
@@ -363,6 +745,13 @@ int GPTLsetoption (const int option,  /* option */
     if (verbose)
       printf ("%s: tablesize = %d\n", thisfunc, tablesize);
     return 0;
+  case GPTLsnapshot_ring:
+    if (val < 1)
+      return GPTLerror ("%s: snapshot_ring must be positive. %d is invalid\n", thisfunc, val);
+    snapring_size = val;
+    if (verbose)
+      printf ("%s: snapshot_ring = %d\n", thisfunc, snapring_size);
+    return 0;
   case GPTLsync_mpi:
 #ifdef ENABLE_PMPI
     if (GPTLpmpi_setoption (option, val) != 0)
@@ -422,6 +811,13 @@ int GPTLsetutr (const int option)
   if (initialized)
     return GPTLerror ("%s: must be called BEFORE GPTLinitialize\n", thisfunc);
 
+  autoutr = (option == (int) GPTLautoutr);
+  if (autoutr) {
+    if (verbose)
+      printf ("%s: underlying wallclock timer will be chosen by GPTLinitialize\n", thisfunc);
+    return 0;
+  }
+
   for (i = 0; i < nfuncentries; i++) {
     if (option == (int) funclist[i].option) {
       if (verbose)
@@ -442,6 +838,216 @@ int GPTLsetutr (const int option)
   return GPTLerror ("%s: unknown option %d\n", thisfunc, option);
 }
 
+/*
+** GPTLset_sampling: time only 1 in rate calls of a timer. The call count
+**   stays exact; wallclock, cpu and PAPI values are read on the sampled calls
+**   and scaled up to all calls, and the printed output gives the standard
+**   error of the wallclock estimate. Applies to timers of that name created
+**   after the call, on all threads. Call from a serial region.
+**
+** Input arguments:
+**   name: timer name (including any prefix)
+**   rate: sample 1 in rate calls (1 means time every call)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLset_sampling (const char *name, const int rate)
+{
+  Samplespec *newlist;
+  int n;              /* index over samplelist */
+  static const char *thisfunc = "GPTLset_sampling";
+
+  if (rate < 1)
+    return GPTLerror ("%s: rate must be positive. %d is invalid\n", thisfunc, rate);
+
+  if (strlen (name) > MAX_CHARS)
+    return GPTLerror ("%s: name %s is longer than %d characters\n", thisfunc, name, MAX_CHARS);
+
+  for (n = 0; n < nsampling; ++n) {
+    if (STRMATCH (samplelist[n].name, name)) {
+      samplelist[n].rate = rate;
+      return 0;
+    }
+  }
+
+  if ( ! (newlist = (Samplespec *) realloc (samplelist, (nsampling + 1) * sizeof (Samplespec))))
+    return GPTLerror ("%s: realloc failure\n", thisfunc);
+  samplelist = newlist;
+  strcpy (samplelist[nsampling].name, name);
+  samplelist[nsampling].rate = rate;
+  ++nsampling;
+
+  if (verbose)
+    printf ("%s: timer %s will be sampled 1 in %d calls\n", thisfunc, name, rate);
+  return 0;
+}
+
+/*
+** GPTLselect_papi: limit PAPI counting to timers matching pattern. Once any
+**   pattern is given, only timers whose names match one (exactly, or by the
+**   prefix before a trailing '*') read the counters; the PAPI columns of the
+**   others are zero. By default all timers read them. Applies to timers
+**   created after the call, on all threads. Call from a serial region.
+**
+** Input arguments:
+**   pattern: timer name (including any prefix), or a prefix followed by '*'
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLselect_papi (const char *pattern)
+{
+  Namepattern *newlist;
+  static const char *thisfunc = "GPTLselect_papi";
+
+  if (strlen (pattern) > MAX_CHARS)
+    return GPTLerror ("%s: pattern %s is longer than %d characters\n", thisfunc, pattern, MAX_CHARS);
+
+  if (name_matches (papiselect, npapiselect, pattern))
+    return 0;
+
+  if ( ! (newlist = (Namepattern *) realloc (papiselect, (npapiselect + 1) * sizeof (Namepattern))))
+    return GPTLerror ("%s: realloc failure\n", thisfunc);
+  papiselect = newlist;
+  strcpy (papiselect[npapiselect].pattern, pattern);
+  ++npapiselect;
+
+  if (verbose)
+    printf ("%s: timers matching %s will read PAPI counters\n", thisfunc, pattern);
+  return 0;
+}
+
+/*
+** GPTLset_filter: add rules choosing which timers are timed, e.g.
+**   "-*,+atm_*" to time only timers whose names start with atm_. Each rule is
+**   an optional '+' (time) or '-' (do not time) followed by a pattern: a
+**   timer name (including any prefix), or a prefix followed by '*'. Rules are
+**   separated by commas or blanks and apply in order, the last match winning;
+**   names matching no rule are timed. Each timer is checked once, when it is
+**   created: after that a start or stop of an excluded timer returns right
+**   after finding it, and the timer does not appear in any output. Applies to
+**   timers created after the call, on all threads. Call from a serial region.
+**   GPTLinitialize adds the rules in environment variable GPTL_FILTER.
+**
+** Input arguments:
+**   rules: list of rules
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLset_filter (const char *rules)
+{
+  char rule[MAX_CHARS+2];   /* one rule, with its sign */
+  const char *c;            /* position in rules */
+  size_t len;               /* length of a rule */
+  static const char *thisfunc = "GPTLset_filter";
+
+  for (c = rules; *c; c += len) {
+    c += strspn (c, ", \t");
+    if ((len = strcspn (c, ", \t")) == 0)
+      break;
+    if (len > MAX_CHARS+1)
+      return GPTLerror ("%s: rule %.*s is too long\n", thisfunc, (int) len, c);
+    strncpy (rule, c, len);
+    rule[len] = '\0';
+    if (add_filter (rule) != 0)
+      return GPTLerror ("%s: bad rule %s\n", thisfunc, rule);
+  }
+  return 0;
+}
+
+/*
+** add_filter: append one GPTLset_filter rule to filterlist
+**
+** Input arguments:
+**   rule: optional '+' or '-', then a pattern
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int add_filter (const char *rule)
+{
+  Filterrule *newlist;
+  bool include = true;
+  static const char *thisfunc = "add_filter";
+
+  if (*rule == '+' || *rule == '-')
+    include = (*rule++ == '+');
+  if (*rule == '\0')
+    return GPTLerror ("%s: no pattern\n", thisfunc);
+  if (strlen (rule) > MAX_CHARS)
+    return GPTLerror ("%s: pattern %s is longer than %d characters\n", thisfunc, rule, MAX_CHARS);
+
+  if ( ! (newlist = (Filterrule *) realloc (filterlist, (nfilter + 1) * sizeof (Filterrule))))
+    return GPTLerror ("%s: realloc failure\n", thisfunc);
+  filterlist = newlist;
+  strcpy (filterlist[nfilter].pattern.pattern, rule);
+  filterlist[nfilter].include = include;
+  ++nfilter;
+
+  if (verbose)
+    printf ("%s: timers matching %s will%s be timed\n", thisfunc, rule, include ? "" : " not");
+  return 0;
+}
+
+/*
+** is_filtered: whether the GPTLset_filter rules exclude a timer name
+*/
+
+static bool is_filtered (const char *name)
+{
+  int n;
+  bool filtered = false;
+
+  for (n = 0; n < nfilter; ++n)
+    if (name_matches (&filterlist[n].pattern, 1, name))
+      filtered = ! filterlist[n].include;
+  return filtered;
+}
+
+/*
+** name_matches: whether a timer name matches any of a list of patterns
+**
+** Input arguments:
+**   list:  patterns: a name, or a prefix followed by '*'
+**   nlist: number of patterns
+**   name:  timer name
+*/
+
+static bool name_matches (const Namepattern *list, const int nlist, const char *name)
+{
+  int n;
+  size_t len;
+
+  for (n = 0; n < nlist; ++n) {
+    len = strlen (list[n].pattern);
+    if (len > 0 && list[n].pattern[len-1] == '*') {
+      if (strncmp (list[n].pattern, name, len-1) == 0)
+	return true;
+    } else if (STRMATCH (list[n].pattern, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+** get_sampling: sampling rate set by GPTLset_sampling for a timer name
+**
+** Return value: rate, or 0 if the timer is timed on every call
+*/
+
+static unsigned int get_sampling (const char *name)
+{
+  int n;
+
+  for (n = 0; n < nsampling; ++n)
+    if (STRMATCH (samplelist[n].name, name))
+      return samplelist[n].rate;
+  return 0;
+}
+
 /*
 ** GPTLinitialize (): Initialization routine must be called from single-threaded
 **   region before any other timing routines may be called.  The need for this
@@ -453,63 +1059,48 @@ int GPTLsetutr (const int option)
 
 int GPTLinitialize (void)
 {
-  int i;          /* loop index */
   int t;          /* thread index */
+  int nfail;      /* number of threads whose init_thread failed */
   double t1, t2;  /* returned from underlying timer */
+  long long rss;  /* returned from GPTLget_rss */
+  char *filterenv;  /* GPTL_FILTER rules */
   static const char *thisfunc = "GPTLinitialize";
 
   if (initialized)
     return GPTLerror ("%s: has already been called\n", thisfunc);
 
+  /* Filter rules from the environment follow any set by GPTLset_filter */
+
+  if ((filterenv = getenv ("GPTL_FILTER")) && GPTLset_filter (filterenv) != 0)
+    return GPTLerror ("%s: bad GPTL_FILTER %s\n", thisfunc, filterenv);
+
   if (threadinit () < 0)
     return GPTLerror ("%s: bad return from threadinit\n", thisfunc);
 
   if ((ticks_per_sec = sysconf (_SC_CLK_TCK)) == -1)
     return GPTLerror ("%s: failure from sysconf (_SC_CLK_TCK)\n", thisfunc);
 
-  /* Allocate space for global arrays */
-
-  callstack     = (Timer ***)    GPTLallocate (maxthreads * sizeof (Timer **));
-  stackidx      = (Nofalse *)    GPTLallocate (maxthreads * sizeof (Nofalse));
-  timers        = (Timer **)     GPTLallocate (maxthreads * sizeof (Timer *));
-  last          = (Timer **)     GPTLallocate (maxthreads * sizeof (Timer *));
-  max_depth     = (int *)        GPTLallocate (maxthreads * sizeof (int));
-  max_name_len  = (int *)        GPTLallocate (maxthreads * sizeof (int));
-  hashtable     = (Hashentry **) GPTLallocate (maxthreads * sizeof (Hashentry *));
-  prefix_len    = (int *)        GPTLallocate (maxthreads * sizeof (int));
-  prefix        = (char **)      GPTLallocate (maxthreads * sizeof (char *));
-
-  /* Initialize array values */
-
-  for (t = 0; t < maxthreads; t++) {
-    max_depth[t]    = -1;
-    max_name_len[t] = 0;
-    callstack[t] = (Timer **) GPTLallocate (MAX_STACK * sizeof (Timer *));
-    hashtable[t] = (Hashentry *) GPTLallocate (tablesize * sizeof (Hashentry));
-    for (i = 0; i < tablesize; i++) {
-      hashtable[t][i].nument = 0;
-      hashtable[t][i].entries = 0;
-    }
-
-    /*
-    ** Make a timer "GPTL_ROOT" to ensure no orphans, and to simplify printing.
-    */
+  /* Allocate space for per-thread state, aligned to a cache line */
 
-    timers[t] = (Timer *) GPTLallocate (sizeof (Timer));
-    memset (timers[t], 0, sizeof (Timer));
-    strcpy (timers[t]->name, "GPTL_ROOT");
-    timers[t]->onflg = true;
-    last[t] = timers[t];
+  if ( ! (perthread_mem = (char *) GPTLallocate (maxthreads * sizeof (Perthread) + CACHE_LINE)))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  perthread = (Perthread *) (((size_t) perthread_mem + CACHE_LINE - 1) & ~((size_t) CACHE_LINE - 1));
+  memset (perthread, 0, maxthreads * sizeof (Perthread));
 
-    stackidx[t].val = 0;
-    callstack[t][0] = timers[t];
-    for (i = 1; i < MAX_STACK; i++)
-      callstack[t][i] = 0;
+  /*
+  ** With OpenMP, thread t initializes its own state (schedule(static,1)
+  ** hands iteration t to thread t), so first touch places it on its NUMA node
+  */
 
-    prefix_len[t] = 0;
-    prefix[t] = (char *) GPTLallocate ((MAX_CHARS+1) * sizeof (char));
-    prefix[t][0] = '\0';
-  }
+  nfail = 0;
+#ifdef THREADED_OMP
+#pragma omp parallel for schedule(static,1) reduction(+:nfail)
+#endif
+  for (t = 0; t < maxthreads; t++)
+    if (init_thread (t) != 0)
+      ++nfail;
+  if (nfail > 0)
+    return GPTLerror ("%s: init_thread failed\n", thisfunc);
 
   prefix_len_nt = 0;
   prefix_nt = (char *) GPTLallocate ((MAX_CHARS+1) * sizeof (char));
@@ -521,16 +1112,25 @@ int GPTLinitialize (void)
 #endif
 
   /*
-  ** Call init routine for underlying timing routine.
+  ** Call init routine for underlying timing routine, or measure all of them
+  ** and pick one if GPTLautoutr was requested.
   */
 
-  if ((*funclist[funcidx].funcinit)() < 0) {
+  if (autoutr) {
+    if (select_utr () < 0) {
+      fprintf (stderr, "%s: No usable timer found. Reverting underlying timer to %s\n",
+	       thisfunc, funclist[0].name);
+      funcidx = 0;
+      (void) (*funclist[funcidx].funcinit)();
+    }
+  } else if ((*funclist[funcidx].funcinit)() < 0) {
     fprintf (stderr, "%s: Failure initializing %s. Reverting underlying timer to %s\n",
 	     thisfunc, funclist[funcidx].name, funclist[0].name);
     funcidx = 0;
   }
 
   ptr2wtimefunc = funclist[funcidx].func;
+  snapinit = (*ptr2wtimefunc) ();
 
   if (verbose) {
     t1 = (*ptr2wtimefunc) ();
@@ -547,10 +1147,89 @@ int GPTLinitialize (void)
     overhead_utr = utr_getoverhead ();
   }
 
+  /* Open the memory usage source while serial; threads then only read it */
+
+  if (GPTLmemusage_open () != 0 && domemory)
+    return GPTLerror ("%s: GPTLmemory is set but memory usage cannot be read\n", thisfunc);
+  if (domemory && GPTLget_rss (&rss) != 0)
+    return GPTLerror ("%s: GPTLmemory is set but memory usage cannot be read\n", thisfunc);
+
   initialized = true;
   return 0;
 }
 
+/*
+** init_thread: Allocate and initialize the state of thread t. Called by
+**   GPTLinitialize, from thread t itself with OpenMP.
+**
+** Input arguments:
+**   t: thread index
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int init_thread (const int t)
+{
+  Perthread *pt = &perthread[t];
+  int i;          /* loop index */
+  static const char *thisfunc = "init_thread";
+
+  pt->max_depth    = -1;
+  pt->max_name_len = 0;
+  if ( ! (pt->callstack = (Timer **) GPTLallocate (MAX_STACK * sizeof (Timer *))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+
+  /*
+  ** Hash table size must be a power of 2 so the hash value can be masked.
+  ** The table grows automatically, so tablesize is just the starting size.
+  */
+
+  for (pt->hashtable.size = 1; pt->hashtable.size < tablesize; pt->hashtable.size *= 2);
+  if ( ! (pt->hashtable.slots = (Hashslot *) GPTLallocate (pt->hashtable.size * sizeof (Hashslot))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  memset (pt->hashtable.slots, 0, pt->hashtable.size * sizeof (Hashslot));
+  pt->hashtable.nument = 0;
+
+  pt->edges.size = EDGE_TABLE_SIZE;
+  if ( ! (pt->edges.slots = (Edgeslot *) GPTLallocate (pt->edges.size * sizeof (Edgeslot))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  memset (pt->edges.slots, 0, pt->edges.size * sizeof (Edgeslot));
+  pt->edges.nument = 0;
+
+  /*
+  ** Make a timer "GPTL_ROOT" to ensure no orphans, and to simplify printing.
+  */
+
+  pt->arena.block = 0;
+  pt->arena.nbytes = 0;
+  if ( ! (pt->timers = (Timer *) GPTLarena_alloc (&pt->arena, sizeof (Timer), CACHE_LINE)))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  memset (pt->timers, 0, sizeof (Timer));
+  strcpy (pt->timers->name, "GPTL_ROOT");
+  pt->timers->onflg = true;
+  pt->last = pt->timers;
+
+  pt->stackidx = 0;
+  pt->callstack[0] = pt->timers;
+  for (i = 1; i < MAX_STACK; i++)
+    pt->callstack[i] = 0;
+
+  pt->prefix_len = 0;
+  if ( ! (pt->prefix = (char *) GPTLallocate ((MAX_CHARS+1) * sizeof (char))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  pt->prefix[0] = '\0';
+
+  pt->idtimers = 0;
+  pt->nidtimers = 0;
+
+  pt->ntrace = 0;
+  pt->trace_named = pt->timers;
+  if (tracecap > 0 &&
+      ! (pt->trace = (Tracerec *) GPTLallocate (tracecap * sizeof (Tracerec))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  return 0;
+}
+
 /*
 ** GPTLfinalize (): Finalization routine must be called from single-threaded
 **   region. Free all malloc'd space
@@ -562,44 +1241,48 @@ int GPTLfinalize (void)
 {
   int t;                /* thread index */
   int n;                /* array index */
-  Timer *ptr, *ptrnext; /* ll indices */
   static const char *thisfunc = "GPTLfinalize";
 
   if ( ! initialized)
     return GPTLerror ("%s: initialization was not completed\n", thisfunc);
 
+  if (snap_close () != 0)
+    fprintf (stderr, "%s: error writing snapshots\n", thisfunc);
+
+  if (tracecap > 0)
+    for (t = 0; t < nthreads; ++t)
+      if (trace_flush (t) != 0)
+	fprintf (stderr, "%s: error writing trace of thread %d\n", thisfunc, t);
+
   for (t = 0; t < maxthreads; ++t) {
-    for (n = 0; n < tablesize; ++n) {
-      if (hashtable[t][n].nument > 0)
-	free (hashtable[t][n].entries);
-    }
-    free (hashtable[t]);
-    hashtable[t] = NULL;
-    free (callstack[t]);
-    free (prefix[t]);
-    for (ptr = timers[t]; ptr; ptr = ptrnext) {
-      ptrnext = ptr->next;
-      if (ptr->nparent > 0) {
-	free (ptr->parent);
-	free (ptr->parent_count);
-      }
-      if (ptr->nchildren > 0)
-	free (ptr->children);
-      free (ptr);
+    free (perthread[t].trace);
+    free (perthread[t].hashtable.slots);
+    perthread[t].hashtable.slots = NULL;
+    free (perthread[t].edges.slots);
+    perthread[t].edges.slots = NULL;
+    free (perthread[t].callstack);
+    free (perthread[t].prefix);
+    free (perthread[t].idtimers);
+    GPTLarena_free (&perthread[t].arena);
+  }
+
+  free (perthread_mem);
+  free (prefix_nt);
+  free (samplelist);
+  free (papiselect);
+  free (filterlist);
+  free (tracepath);
+  if (GPTLmemusage_close () != 0)
+    fprintf (stderr, "%s: error closing the memory usage source\n", thisfunc);
+
+  for (n = 0; n < nids; ++n) {
+    free (idnames[n/IDCHUNK][n%IDCHUNK]);
+    if (n % IDCHUNK == IDCHUNK-1 || n == nids-1) {
+      free (idnames[n/IDCHUNK]);
+      idnames[n/IDCHUNK] = 0;
     }
   }
 
-  free (callstack);
-  free (stackidx);
-  free (timers);
-  free (last);
-  free (max_depth);
-  free (max_name_len);
-  free (hashtable);
-  free (prefix_len);
-  free (prefix);
-  free (prefix_nt);
-
   threadfinalize ();
 
 #ifdef HAVE_PAPI
@@ -608,10 +1291,14 @@ int GPTLfinalize (void)
 
   /* Reset initial values */
 
-  timers = 0;
-  last = 0;
-  max_depth = 0;
-  max_name_len = 0;
+  perthread = 0;
+  perthread_mem = 0;
+  samplelist = 0;
+  nsampling = 0;
+  papiselect = 0;
+  npapiselect = 0;
+  filterlist = 0;
+  nfilter = 0;
   nthreads = -1;
   maxthreads = -1;
   depthlimit = 99999;
@@ -621,25 +1308,42 @@ int GPTLfinalize (void)
   dousepapi = false;
   verbose = false;
   percent = false;
+  dohist = false;
   dopr_preamble = true;
   dopr_threadsort = true;
   dopr_multparent = true;
   dopr_collision = true;
+  dopr_binary = false;
+  doexclusive = false;
+  selftop = 0;
+  tracecap = 0;
+  domemory = false;
+  tracepath = 0;
+  trace_opened = false;
+  trace_synced = false;
+  snapring_size = DEFAULT_SNAPSHOT_RING;
   print_mode = GPTLprint_write;
   ref_gettimeofday = -1;
   ref_clock_gettime = -1;
+  ref_clock_monotonic = -1;
 #ifdef _AIX
   ref_read_real_time = -1;
 #endif
   ref_papitime = -1;
   funcidx = 0;
+  autoutr = false;
+#ifdef ENABLE_PMPI
+  (void) GPTLpmpi_setoption (GPTLsync_mpi, 0);
+#endif
 #ifdef HAVE_NANOTIME
   cpumhz= 0;
   cyc2sec = -1;
+  tsc_calibrated = false;
 #endif
   outdir = 0;
   tablesize = DEFAULT_TABLE_SIZE;
   prefix_len_nt = 0;
+  nids = 0;
 
   return 0;
 }
@@ -696,8 +1400,8 @@ int GPTLprefix_set (const char *prefixname)      /* prefix string */
     if ((t = get_thread_num ()) < 0)
       return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
 
-    prefix_len[t] = len_prefix;
-    ptr_prefix = prefix[t];
+    perthread[t].prefix_len = len_prefix;
+    ptr_prefix = perthread[t].prefix;
 
   }
 
@@ -761,8 +1465,8 @@ int GPTLprefix_setf (const char *prefixname, const int prefixlen)  /* prefix str
     if ((t = get_thread_num ()) < 0)
       return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
 
-    prefix_len[t] = len_prefix;
-    ptr_prefix = prefix[t];
+    perthread[t].prefix_len = len_prefix;
+    ptr_prefix = perthread[t].prefix;
 
   }
 
@@ -821,8 +1525,8 @@ int GPTLprefix_unset ()
     if ((t = get_thread_num ()) < 0)
       return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
 
-    prefix_len[t] = 0;
-    ptr_prefix = prefix[t];
+    perthread[t].prefix_len = 0;
+    ptr_prefix = perthread[t].prefix;
 
   }
 
@@ -861,12 +1565,17 @@ int GPTLstart_instr (void *self)
   ** increment and return
   */
 
-  if (stackidx[t].val >= depthlimit) {
-    ++stackidx[t].val;
+  if (perthread[t].stackidx >= depthlimit) {
+    ++perthread[t].stackidx;
     return 0;
   }
 
-  ptr = getentry_instr (hashtable[t], self, &indx);
+  ptr = getentry_instr (&perthread[t].hashtable, self, &indx);
+
+  /* Timers excluded by GPTLset_filter are never timed */
+
+  if (ptr && ptr->filtered)
+    return 0;
 
   /*
   ** Recursion => increment depth in recursion and return.  We need to return
@@ -884,11 +1593,11 @@ int GPTLstart_instr (void *self)
   ** behavior when GPTLstop_instr decrements stackidx[t] unconditionally.
   */
 
-  if (++stackidx[t].val > MAX_STACK-1)
+  if (++perthread[t].stackidx > MAX_STACK-1)
     return GPTLerror ("%s: stack too big\n", thisfunc);
 
   if ( ! ptr) {     /* Add a new entry and initialize */
-    ptr = (Timer *) GPTLallocate (sizeof (Timer));
+    ptr = (Timer *) GPTLarena_alloc (&perthread[t].arena, sizeof (Timer), CACHE_LINE);
     memset (ptr, 0, sizeof (Timer));
 
     /*
@@ -901,9 +1610,15 @@ int GPTLstart_instr (void *self)
 
     if (update_ll_hash (ptr, t, indx) != 0)
       return GPTLerror ("%s: update_ll_hash error\n", thisfunc);
+
+    if (ptr->filtered) {
+      --perthread[t].stackidx;
+      return 0;
+    }
   }
 
-  if (update_parent_info (ptr, callstack[t], stackidx[t].val) != 0)
+  if (update_parent_info (ptr, perthread[t].callstack, perthread[t].stackidx, &perthread[t].arena,
+			  &perthread[t].edges) != 0)
     return GPTLerror ("%s: update_parent_info error\n", thisfunc);
 
   if (update_ptr (ptr, t) != 0)
@@ -948,8 +1663,8 @@ int GPTLstart (const char *timername)                  /* timer name */
   ** increment and return
   */
 
-  if (stackidx[t].val >= depthlimit) {
-    ++stackidx[t].val;
+  if (perthread[t].stackidx >= depthlimit) {
+    ++perthread[t].stackidx;
     return 0;
   }
 
@@ -966,7 +1681,7 @@ int GPTLstart (const char *timername)                  /* timer name */
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -980,7 +1695,12 @@ int GPTLstart (const char *timername)                  /* timer name */
   ** or NULL if this is a new entry
   */
 
-  ptr = getentry (hashtable[t], name, &indx);
+  ptr = getentry (&perthread[t].hashtable, name, &indx);
+
+  /* Timers excluded by GPTLset_filter are never timed */
+
+  if (ptr && ptr->filtered)
+    return 0;
 
   /*
   ** Recursion => increment depth in recursion and return.  We need to return
@@ -1009,11 +1729,11 @@ int GPTLstart (const char *timername)                  /* timer name */
   ** behavior when GPTLstop decrements stackidx[t] unconditionally.
   */
 
-  if (++stackidx[t].val > MAX_STACK-1)
+  if (++perthread[t].stackidx > MAX_STACK-1)
     return GPTLerror ("%s: stack too big\n", thisfunc);
 
   if ( ! ptr) { /* Add a new entry and initialize */
-    ptr = (Timer *) GPTLallocate (sizeof (Timer));
+    ptr = (Timer *) GPTLarena_alloc (&perthread[t].arena, sizeof (Timer), CACHE_LINE);
     memset (ptr, 0, sizeof (Timer));
 
     //pw    numchars = MIN (strlen (name), MAX_CHARS);
@@ -1022,9 +1742,15 @@ int GPTLstart (const char *timername)                  /* timer name */
 
     if (update_ll_hash (ptr, t, indx) != 0)
       return GPTLerror ("%s: update_ll_hash error\n", thisfunc);
+
+    if (ptr->filtered) {
+      --perthread[t].stackidx;
+      return 0;
+    }
   }
 
-  if (update_parent_info (ptr, callstack[t], stackidx[t].val) != 0)
+  if (update_parent_info (ptr, perthread[t].callstack, perthread[t].stackidx, &perthread[t].arena,
+			  &perthread[t].edges) != 0)
     return GPTLerror ("%s: update_parent_info error\n", thisfunc);
 
   if (update_ptr (ptr, t) != 0)
@@ -1079,8 +1805,8 @@ int GPTLstart_handle (const char *name,  /* timer name */
   ** increment and return
   */
 
-  if (stackidx[t].val >= depthlimit) {
-    ++stackidx[t].val;
+  if (perthread[t].stackidx >= depthlimit) {
+    ++perthread[t].stackidx;
     return 0;
   }
 
@@ -1090,7 +1816,7 @@ int GPTLstart_handle (const char *name,  /* timer name */
   ** might be ignored if the handle has already been set.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     *handle = 0;
     return GPTLstart (name);
   }
@@ -1110,7 +1836,14 @@ int GPTLstart_handle (const char *name,  /* timer name */
   if (*handle) {
     ptr = (Timer *) *handle;
   } else {
-    ptr = getentry (hashtable[t], name, &indx);
+    ptr = getentry (&perthread[t].hashtable, name, &indx);
+  }
+
+  /* Timers excluded by GPTLset_filter are never timed */
+
+  if (ptr && ptr->filtered) {
+    *handle = (void *) ptr;
+    return 0;
   }
 
   /*
@@ -1141,11 +1874,11 @@ int GPTLstart_handle (const char *name,  /* timer name */
   ** behavior when GPTLstop decrements stackidx[t] unconditionally.
   */
 
-  if (++stackidx[t].val > MAX_STACK-1)
+  if (++perthread[t].stackidx > MAX_STACK-1)
     return GPTLerror ("%s: stack too big\n", thisfunc);
 
   if ( ! ptr) { /* Add a new entry and initialize */
-    ptr = (Timer *) GPTLallocate (sizeof (Timer));
+    ptr = (Timer *) GPTLarena_alloc (&perthread[t].arena, sizeof (Timer), CACHE_LINE);
     memset (ptr, 0, sizeof (Timer));
 
     numchars = MIN (strlen (name), MAX_CHARS);
@@ -1154,9 +1887,16 @@ int GPTLstart_handle (const char *name,  /* timer name */
 
     if (update_ll_hash (ptr, t, indx) != 0)
       return GPTLerror ("%s: update_ll_hash error\n", thisfunc);
+
+    if (ptr->filtered) {
+      --perthread[t].stackidx;
+      *handle = (void *) ptr;
+      return 0;
+    }
   }
 
-  if (update_parent_info (ptr, callstack[t], stackidx[t].val) != 0)
+  if (update_parent_info (ptr, perthread[t].callstack, perthread[t].stackidx, &perthread[t].arena,
+			  &perthread[t].edges) != 0)
     return GPTLerror ("%s: update_parent_info error\n", thisfunc);
 
   if (update_ptr (ptr, t) != 0)
@@ -1220,8 +1960,8 @@ int GPTLstartf (const char *timername, const int namelen)    /* timer name and l
   ** increment and return
   */
 
-  if (stackidx[t].val >= depthlimit) {
-    ++stackidx[t].val;
+  if (perthread[t].stackidx >= depthlimit) {
+    ++perthread[t].stackidx;
     return 0;
   }
 
@@ -1238,7 +1978,7 @@ int GPTLstartf (const char *timername, const int namelen)    /* timer name and l
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
   } else {
@@ -1251,7 +1991,12 @@ int GPTLstartf (const char *timername, const int namelen)    /* timer name and l
   ** or NULL if this is a new entry
   */
 
-  ptr = getentryf (hashtable[t], name, numchars, &indx);
+  ptr = getentryf (&perthread[t].hashtable, name, numchars, &indx);
+
+  /* Timers excluded by GPTLset_filter are never timed */
+
+  if (ptr && ptr->filtered)
+    return 0;
 
   /*
   ** Recursion => increment depth in recursion and return.  We need to return
@@ -1281,11 +2026,11 @@ int GPTLstartf (const char *timername, const int namelen)    /* timer name and l
   ** behavior when GPTLstop decrements stackidx[t] unconditionally.
   */
 
-  if (++stackidx[t].val > MAX_STACK-1)
+  if (++perthread[t].stackidx > MAX_STACK-1)
     return GPTLerror ("%s: stack too big\n", thisfunc);
 
   if ( ! ptr) { /* Add a new entry and initialize */
-    ptr = (Timer *) GPTLallocate (sizeof (Timer));
+    ptr = (Timer *) GPTLarena_alloc (&perthread[t].arena, sizeof (Timer), CACHE_LINE);
     memset (ptr, 0, sizeof (Timer));
 
     //pw    numchars = MIN (namelen, MAX_CHARS);
@@ -1297,9 +2042,15 @@ int GPTLstartf (const char *timername, const int namelen)    /* timer name and l
 
     if (update_ll_hash (ptr, t, indx) != 0)
       return GPTLerror ("%s: update_ll_hash error\n", thisfunc);
+
+    if (ptr->filtered) {
+      --perthread[t].stackidx;
+      return 0;
+    }
   }
 
-  if (update_parent_info (ptr, callstack[t], stackidx[t].val) != 0)
+  if (update_parent_info (ptr, perthread[t].callstack, perthread[t].stackidx, &perthread[t].arena,
+			  &perthread[t].edges) != 0)
     return GPTLerror ("%s: update_parent_info error\n", thisfunc);
 
   if (update_ptr (ptr, t) != 0)
@@ -1358,8 +2109,8 @@ int GPTLstartf_handle (const char *name,  /* timer name */
   ** increment and return
   */
 
-  if (stackidx[t].val >= depthlimit) {
-    ++stackidx[t].val;
+  if (perthread[t].stackidx >= depthlimit) {
+    ++perthread[t].stackidx;
     return 0;
   }
 
@@ -1369,7 +2120,7 @@ int GPTLstartf_handle (const char *name,  /* timer name */
   ** might be ignored if the handle has already been set.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     *handle = 0;
     return GPTLstartf (name, namelen);
   }
@@ -1390,7 +2141,14 @@ int GPTLstartf_handle (const char *name,  /* timer name */
     ptr = (Timer *) *handle;
   } else {
     numchars = MIN (namelen, MAX_CHARS);
-    ptr = getentryf (hashtable[t], name, numchars, &indx);
+    ptr = getentryf (&perthread[t].hashtable, name, numchars, &indx);
+  }
+
+  /* Timers excluded by GPTLset_filter are never timed */
+
+  if (ptr && ptr->filtered) {
+    *handle = (void *) ptr;
+    return 0;
   }
 
   /*
@@ -1421,11 +2179,11 @@ int GPTLstartf_handle (const char *name,  /* timer name */
   ** behavior when GPTLstop decrements stackidx[t] unconditionally.
   */
 
-  if (++stackidx[t].val > MAX_STACK-1)
+  if (++perthread[t].stackidx > MAX_STACK-1)
     return GPTLerror ("%s: stack too big\n", thisfunc);
 
   if ( ! ptr) { /* Add a new entry and initialize */
-    ptr = (Timer *) GPTLallocate (sizeof (Timer));
+    ptr = (Timer *) GPTLarena_alloc (&perthread[t].arena, sizeof (Timer), CACHE_LINE);
     memset (ptr, 0, sizeof (Timer));
 
     numchars = MIN (namelen, MAX_CHARS);
@@ -1437,9 +2195,16 @@ int GPTLstartf_handle (const char *name,  /* timer name */
 
     if (update_ll_hash (ptr, t, indx) != 0)
       return GPTLerror ("%s: update_ll_hash error\n", thisfunc);
+
+    if (ptr->filtered) {
+      --perthread[t].stackidx;
+      *handle = (void *) ptr;
+      return 0;
+    }
   }
 
-  if (update_parent_info (ptr, callstack[t], stackidx[t].val) != 0)
+  if (update_parent_info (ptr, perthread[t].callstack, perthread[t].stackidx, &perthread[t].arena,
+			  &perthread[t].edges) != 0)
     return GPTLerror ("%s: update_parent_info error\n", thisfunc);
 
   if (update_ptr (ptr, t) != 0)
@@ -1467,471 +2232,886 @@ int GPTLstartf_handle (const char *name,  /* timer name */
 }
 
 /*
-** add_prefix: add prefix string to timer name
+** GPTLregister: register a timer name and return an integer id for it. The id
+**   is valid on all threads and may be passed to GPTLstart_id/GPTLstop_id,
+**   which avoid hashing the name on every call. Registering a name more than
+**   once returns the same id.
 **
 ** Input arguments:
-**   new_name:  new name
-**   timername: timer name
-**   namelen:   length of timer name
-**   t:         thread id
+**   name: timer name
 **
-** Return value: length of new name
+** Output arguments:
+**   id: timer id
+**
+** Return value: 0 (success) or GPTLerror (failure)
 */
 
-static int add_prefix (char *new_name, const char *timername, const int namelen, const int t)
+int GPTLregister (const char *name,  /* timer name */
+		  int *id)           /* timer id (output) */
 {
-  int numchars;               /* number of characters to copy */
-  int c;                      /* character index */
-
-  /* add prefix from serial region */
-  numchars = MIN (prefix_len_nt, MAX_CHARS);
-  for (c = 0; c < numchars; c++) {
-    new_name[c] = prefix_nt[c];
-  }
-
-  /* add thread-specific prefix */
-  numchars = MIN (prefix_len[t], MAX_CHARS-prefix_len_nt);
-  for (c = 0; c < numchars; c++) {
-    new_name[c+prefix_len_nt] = prefix[t][c];
-  }
+  static const char *thisfunc = "GPTLregister";
 
-  /* add timer name */
-  numchars = MIN (namelen, MAX_CHARS-prefix_len_nt-prefix_len[t]);
-  for (c = 0; c < numchars; c++) {
-    new_name[c+prefix_len_nt+prefix_len[t]] = timername[c];
-  }
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
 
-  /* add string terminator */
-  numchars = MIN (namelen+prefix_len_nt+prefix_len[t], MAX_CHARS);
-  new_name[numchars] = '\0';
+  if ((*id = register_name (name, strlen (name))) < 0)
+    return GPTLerror ("%s: unable to register %s\n", thisfunc, name);
 
-  return numchars;
+  return 0;
 }
 
 /*
-** update_ll_hash: Update linked list and hash table.
-**                 Called by GPTLstart(f), GPTLstart_instr,
-**                 and GPTLstart(f)_handle.
+** GPTLregisterf: register a timer name when the name may not be null terminated
 **
 ** Input arguments:
-**   ptr:  pointer to timer
-**   t:    thread index
-**   indx: hash index
+**   name:    timer name
+**   namelen: number of characters in timer name
+**
+** Output arguments:
+**   id: timer id
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-static int update_ll_hash (Timer *ptr, const int t, const unsigned int indx)
+int GPTLregisterf (const char *name,   /* timer name */
+		   const int namelen,  /* timer name length */
+		   int *id)            /* timer id (output) */
 {
-  int nchars;      /* number of chars */
-  int nument;      /* number of entries */
-  Timer **eptr;    /* for realloc */
+  static const char *thisfunc = "GPTLregisterf";
 
-  nchars = strlen (ptr->name);
-  if (nchars > max_name_len[t])
-    max_name_len[t] = nchars;
-
-  last[t]->next = ptr;
-  last[t] = ptr;
-  ++hashtable[t][indx].nument;
-  nument = hashtable[t][indx].nument;
-
-  eptr = (Timer **) realloc (hashtable[t][indx].entries, nument * sizeof (Timer *));
-  if ( ! eptr)
-    return GPTLerror ("update_ll_hash: realloc error\n");
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
 
-  hashtable[t][indx].entries           = eptr;
-  hashtable[t][indx].entries[nument-1] = ptr;
+  if ((*id = register_name (name, namelen)) < 0)
+    return GPTLerror ("%s: unable to register timer\n", thisfunc);
 
   return 0;
 }
 
 /*
-** update_ptr: Update timer contents.
-**  Called by GPTLstart(f), GPTLstart_instr, and GPTLstart(f)_handle.
+** GPTLstart_id: start a timer previously registered with GPTLregister
 **
 ** Input arguments:
-**   ptr:  pointer to timer
-**   t:    thread index
+**   id: timer id
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-static inline int update_ptr (Timer *ptr, const int t)
+int GPTLstart_id (const int id)  /* timer id */
 {
-  double tp2;    /* time stamp */
+  Timer *ptr;                    /* linked list pointer */
+  int t;                         /* thread index (of this thread) */
+  double tpa = 0.0;              /* time stamp */
+  double tpb = 0.0;              /* time stamp */
+  static const char *thisfunc = "GPTLstart_id";
 
-  ptr->onflg = true;
+  if (disabled)
+    return 0;
 
-  if (cpustats.enabled && get_cpustamp (&ptr->cpu.last_utime, &ptr->cpu.last_stime) < 0)
-    return GPTLerror ("update_ptr: get_cpustamp error");
+  if ( ! initialized)
+    return 0;
 
-  if (wallstats.enabled) {
-    tp2 = (*ptr2wtimefunc) ();
-    ptr->wall.last = tp2;
-  }
+  if (id < 0 || id >= nids)
+    return GPTLerror ("%s: invalid timer id %d\n", thisfunc, id);
 
-#ifdef HAVE_PAPI
-  if (dousepapi && GPTL_PAPIstart (t, &ptr->aux) < 0)
-    return GPTLerror ("update_ptr: error from GPTL_PAPIstart\n");
-#endif
-  return 0;
-}
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
 
-/*
-** update_parent_info: update info about parent, and in the parent about this child
-**
-** Arguments:
-**   ptr:  pointer to timer
-**   callstackt: callstack for this thread
-**   stackidxt:  stack index for this thread
-**
-** Return value: 0 (success) or GPTLerror (failure)
-*/
+  /*
+  ** If current depth exceeds a user-specified limit for print, just
+  ** increment and return
+  */
 
-static inline int update_parent_info (Timer *ptr,
-				      Timer **callstackt,
-				      int stackidxt)
-{
-  int n;             /* loop index through known parents */
-  Timer *pptr;       /* pointer to parent in callstack */
-  Timer **pptrtmp;   /* for realloc parent pointer array */
-  int nparent;       /* number of parents */
-  int *parent_count; /* number of times parent invoked this child */
-  static const char *thisfunc = "update_parent_info";
+  if (perthread[t].stackidx >= depthlimit) {
+    ++perthread[t].stackidx;
+    return 0;
+  }
 
-  if ( ! ptr )
-    return -1;
+  /*
+  ** If prefix string is defined, the timer name depends on the prefix
+  ** so the cached timer cannot be used.
+  */
 
-  if (stackidxt < 0)
-    return GPTLerror ("%s: called with negative stackidx\n", thisfunc);
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0))
+    return GPTLstart (idnames[id/IDCHUNK][id%IDCHUNK]);
 
-  callstackt[stackidxt] = ptr;
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* first caliper timestamp */
+      tpa = (*ptr2wtimefunc) ();
+    }
+  }
 
-  /*
-  ** If the region has no parent, bump its orphan count
-  ** (should never happen since "GPTL_ROOT" added).
-  */
+  if ( ! (ptr = getentry_id (id, t, true)))
+    return GPTLerror ("%s: getentry_id error\n", thisfunc);
 
-  if (stackidxt == 0) {
-    ++ptr->norphan;
+  /* Timers excluded by GPTLset_filter are never timed */
+
+  if (ptr->filtered)
     return 0;
-  }
 
-  pptr = callstackt[stackidxt-1];
+  /*
+  ** Recursion => increment depth in recursion and return.  We need to return
+  ** because we don't want to restart the timer.  We want the reported time for
+  ** the timer to reflect the outermost layer of recursion.
+  */
 
-  /* If this parent occurred before, bump its count */
+  if (ptr->onflg) {
+    ++ptr->recurselvl;
 
-  for (n = 0; n < ptr->nparent; ++n) {
-    if (ptr->parent[n] == pptr) {
-      ++ptr->parent_count[n];
-      break;
+    if (wallstats.enabled && profileovhd.enabled){
+      if (t == 0){
+        /* second caliper timestamp */
+        tpb = (*ptr2wtimefunc) ();
+        /* subtract out additional overhead from caliper timing calls */
+        overhead_est += ((tpb - tpa) - overhead_utr);
+        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+        overhead_bound += ((tpb - tpa) + 2*overhead_utr);
+      }
     }
+
+    return 0;
   }
 
-  /* If this is a new parent, update info */
+  /*
+  ** Increment stackidx[t] unconditionally. This is necessary to ensure the correct
+  ** behavior when GPTLstop decrements stackidx[t] unconditionally.
+  */
+
+  if (++perthread[t].stackidx > MAX_STACK-1)
+    return GPTLerror ("%s: stack too big\n", thisfunc);
 
-  if (n == ptr->nparent) {
-    ++ptr->nparent;
-    nparent = ptr->nparent;
-    pptrtmp = (Timer **) realloc (ptr->parent, nparent * sizeof (Timer *));
-    if ( ! pptrtmp)
-      return GPTLerror ("%s: realloc error pptrtmp nparent=%d\n", thisfunc, nparent);
+  if (update_parent_info (ptr, perthread[t].callstack, perthread[t].stackidx, &perthread[t].arena,
+			  &perthread[t].edges) != 0)
+    return GPTLerror ("%s: update_parent_info error\n", thisfunc);
 
-    ptr->parent = pptrtmp;
-    ptr->parent[nparent-1] = pptr;
-    parent_count = (int *) realloc (ptr->parent_count, nparent * sizeof (int));
-    if ( ! parent_count)
-      return GPTLerror ("%s: realloc error parent_count nparent=%d\n", thisfunc, nparent);
+  if (update_ptr (ptr, t) != 0)
+    return GPTLerror ("%s: update_ptr error\n", thisfunc);
 
-    ptr->parent_count = parent_count;
-    ptr->parent_count[nparent-1] = 1;
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* second caliper timestamp */
+      tpb = (*ptr2wtimefunc) ();
+      /* subtract out additional overhead from caliper timing calls */
+      overhead_est += ((tpb - tpa) - overhead_utr);
+      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+      overhead_bound += ((tpb - tpa) + 2*overhead_utr);
+    }
   }
 
-  return 0;
+  return (0);
 }
 
 /*
-** GPTLstop_instr: stop a timer (auto-instrumented)
+** register_name: find the id of a registered name, adding it if not already
+**   present. Names are only added, never moved, and nids is raised only after
+**   the new name is in its slot, so the lookup needs no lock. A name not found
+**   is looked up again and added under a lock, so registering the same name
+**   from several threads at once returns one id.
 **
 ** Input arguments:
-**   self: function address
+**   name:    timer name
+**   namelen: number of characters in timer name
 **
-** Return value: 0 (success) or GPTLerror (failure)
+** Return value: id (success) or -1 (failure)
 */
 
-int GPTLstop_instr (void *self)
+static int register_name (const char *name, const int namelen)
 {
-  double tp1 = 0.0;          /* time stamp */
-  Timer *ptr;                /* linked list pointer */
-  int t;                     /* thread number for this process */
-  unsigned int indx;         /* index into hash table */
-  long usr = 0;              /* user time (returned from get_cpustamp) */
-  long sys = 0;              /* system time (returned from get_cpustamp) */
-  static const char *thisfunc = "GPTLstop_instr";
-
-  if (disabled)
-    return 0;
+  int id;          /* return value */
+  int numchars;    /* number of characters to compare or copy */
 
-  if ( ! initialized)
-    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+  numchars = MIN (namelen, MAX_CHARS);
 
-  /* Get the timestamp */
+  if ((id = find_name (name, numchars)) >= 0)
+    return id;
 
-  if (wallstats.enabled) {
-    tp1 = (*ptr2wtimefunc) ();
+#if ( defined THREADED_OMP )
+#pragma omp critical (GPTLregister)
+#elif ( defined THREADED_PTHREADS )
+  if (lock_mutex () < 0)
+    return -1;
+#endif
+  {
+    if ((id = find_name (name, numchars)) < 0)
+      id = add_name (name, numchars);
   }
+#if ( defined THREADED_PTHREADS )
+  if (unlock_mutex () < 0)
+    return -1;
+#endif
 
-  if (cpustats.enabled && get_cpustamp (&usr, &sys) < 0)
-    return GPTLerror ("%s: bad return from get_cpustamp\n", thisfunc);
+  return id;
+}
 
-  if ((t = get_thread_num ()) < 0)
-    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+/*
+** find_name: look up a registered name
+**
+** Input arguments:
+**   name:     timer name
+**   numchars: number of characters to compare
+**
+** Return value: id (found) or -1 (not registered)
+*/
 
-  /*
-  ** If current depth exceeds a user-specified limit for print, just
-  ** decrement and return
-  */
+static int find_name (const char *name, const int numchars)
+{
+  int n;           /* loop index over registered ids */
+  const char *str; /* registered name */
 
-  if (stackidx[t].val > depthlimit) {
-    --stackidx[t].val;
-    return 0;
+  for (n = 0; n < nids; ++n) {
+    str = idnames[n/IDCHUNK][n%IDCHUNK];
+    if (strncmp (str, name, numchars) == 0 && str[numchars] == '\0')
+      return n;
   }
+  return -1;
+}
 
-  ptr = getentry_instr (hashtable[t], self, &indx);
+/*
+** add_name: register a new name. Must be called with the register lock held.
+**
+** Input arguments:
+**   name:     timer name
+**   numchars: number of characters to copy
+**
+** Return value: id (success) or -1 (failure)
+*/
 
-  if ( ! ptr)
-    return GPTLerror ("%s: timer for %p had not been started.\n", thisfunc, self);
+static int add_name (const char *name, const int numchars)
+{
+  int id;          /* return value */
+  int c;           /* character index */
+  char *str;       /* registered name */
+  char **chunk;    /* chunk of registered names */
 
-  if ( ! ptr->onflg )
-    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+  if ((id = nids) >= IDCHUNK*MAX_IDCHUNKS)
+    return -1;
 
-  ++ptr->count;
+  if ( ! (str = (char *) GPTLallocate (numchars+1)))
+    return -1;
+  for (c = 0; c < numchars; c++)
+    str[c] = name[c];
+  str[numchars] = '\0';
+
+  if ( ! (chunk = idnames[id/IDCHUNK])) {
+    if ( ! (chunk = (char **) GPTLallocate (IDCHUNK * sizeof (char *)))) {
+      free (str);
+      return -1;
+    }
+    memset (chunk, 0, IDCHUNK * sizeof (char *));
+    idnames[id/IDCHUNK] = chunk;
+  }
+  chunk[id%IDCHUNK] = str;
 
-  /*
-  ** Recursion => decrement depth in recursion and return.  We need to return
-  ** because we don't want to stop the timer.  We want the reported time for
-  ** the timer to reflect the outermost layer of recursion.
-  */
+  /* Publish the name before the lock-free lookups can see the new count */
+#ifdef HAVE_SYNC_CAS
+  __sync_synchronize ();
+#else
+#if ( defined THREADED_OMP )
+#pragma omp flush
+#endif
+#endif
+  nids = id + 1;
+  return id;
+}
 
-  if (ptr->recurselvl > 0) {
-    ++ptr->nrecurse;
-    --ptr->recurselvl;
-    return 0;
-  }
+#ifdef THREADED_PTHREADS
+/*
+** claim_index: atomically claim the next index from a counter
+**
+** Input arguments:
+**   counter: counter to increment
+**   limit:   number of indices available
+**
+** Return value: claimed index (success) or -1 (all indices taken)
+*/
 
-  if (update_stats (ptr, tp1, usr, sys, t) != 0)
-    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+static int claim_index (volatile int *counter, const int limit)
+{
+  int n;     /* return value */
 
-  return 0;
+#ifdef HAVE_SYNC_CAS
+  do {
+    if ((n = *counter) >= limit)
+      return -1;
+  } while ( ! __sync_bool_compare_and_swap (counter, n, n+1));
+#else
+  if (lock_mutex () < 0)
+    return -1;
+  if ((n = *counter) >= limit)
+    n = -1;
+  else
+    ++*counter;
+  if (unlock_mutex () < 0)
+    return -1;
+#endif
+
+  return n;
 }
+#endif
 
 /*
-** GPTLstop: stop a timer
+** getentry_id: return the timer for a registered id on this thread. The
+**   first time a thread uses an id the timer is looked up by name (and created
+**   if create is set), and the result cached in perthread[t].idtimers.
 **
 ** Input arguments:
-**   timername: timer name
+**   id:     timer id
+**   t:      thread index
+**   create: whether to create the timer if it does not yet exist
 **
-** Return value: 0 (success) or -1 (failure)
+** Return value: pointer to timer, or NULL if not found or on error
 */
 
-int GPTLstop (const char *timername)         /* timer name */
+static inline Timer *getentry_id (const int id, const int t, const bool create)
 {
-  double tp1 = 0.0;           /* time stamp */
-  Timer *ptr;                 /* linked list pointer */
-  int t;                      /* thread number for this process */
-  int numchars;               /* number of characters to copy */
-  int namelen;                /* number of characters in timer name */
-  int len_prefix;             /* number of characters in prefix */
-  unsigned int indx;          /* index into hash table */
-  long usr = 0;               /* user time (returned from get_cpustamp) */
-  long sys = 0;               /* system time (returned from get_cpustamp) */
-  double tpa = 0.0;           /* time stamp */
-  double tpb = 0.0;           /* time stamp */
-  char *ptr_prefix;           /* pointer to prefix string */
-  char new_name[MAX_CHARS+1]; /* timer name with prefix, if there is one */
-  const char *name;           /* pointer to timer name */
-  static const char *thisfunc = "GPTLstop";
+  Timer *ptr;                            /* linked list pointer */
+  Timer **newcache;                      /* for realloc */
+  int newsize;                           /* new size of perthread[t].idtimers */
+  int n;                                 /* loop index */
+  int numchars;                          /* number of characters to copy */
+  const char *name;                      /* registered name */
+  unsigned int indx = (unsigned int) -1; /* hash table index */
 
-  if (disabled)
-    return 0;
+  if (id < perthread[t].nidtimers && perthread[t].idtimers[id])
+    return perthread[t].idtimers[id];
 
-  if ( ! initialized)
-    return 0;
+  name = idnames[id/IDCHUNK][id%IDCHUNK];
+  if ( ! (ptr = getentry (&perthread[t].hashtable, name, &indx))) {
+    if ( ! create)
+      return 0;
 
-  /* Get the timestamp */
+    if ( ! (ptr = (Timer *) GPTLarena_alloc (&perthread[t].arena, sizeof (Timer), CACHE_LINE)))
+      return 0;
+    memset (ptr, 0, sizeof (Timer));
 
-  if (wallstats.enabled) {
-    tp1 = (*ptr2wtimefunc) ();
+    numchars = MIN (strlen (name), MAX_CHARS);
+    memcpy (ptr->name, name, numchars);
+    ptr->name[numchars] = '\0';
+
+    if (update_ll_hash (ptr, t, indx) != 0)
+      return 0;
   }
 
-  if (cpustats.enabled && get_cpustamp (&usr, &sys) < 0)
-    return GPTLerror ("%s: get_cpustamp error", thisfunc);
+  /* Grow the per-thread cache geometrically so it is rarely reallocated */
 
-  if ((t = get_thread_num ()) < 0)
-    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+  if (id >= perthread[t].nidtimers) {
+    newsize = MAX (2*perthread[t].nidtimers, id+1);
+    newsize = MAX (newsize, IDCHUNK);
+    if ( ! (newcache = (Timer **) realloc (perthread[t].idtimers, newsize * sizeof (Timer *)))) {
+      GPTLerror ("getentry_id: realloc error\n");
+      return 0;
+    }
+    for (n = perthread[t].nidtimers; n < newsize; ++n)
+      newcache[n] = 0;
+    perthread[t].idtimers = newcache;
+    perthread[t].nidtimers = newsize;
+  }
 
-  /*
-  ** If current depth exceeds a user-specified limit for print, just
-  ** decrement and return
-  */
+  perthread[t].idtimers[id] = ptr;
+  return ptr;
+}
 
-  if (stackidx[t].val > depthlimit) {
-    --stackidx[t].val;
-    return 0;
+/*
+** add_prefix: add prefix string to timer name
+**
+** Input arguments:
+**   new_name:  new name
+**   timername: timer name
+**   namelen:   length of timer name
+**   t:         thread id
+**
+** Return value: length of new name
+*/
+
+static int add_prefix (char *new_name, const char *timername, const int namelen, const int t)
+{
+  int numchars;               /* number of characters to copy */
+  int c;                      /* character index */
+
+  /* add prefix from serial region */
+  numchars = MIN (prefix_len_nt, MAX_CHARS);
+  for (c = 0; c < numchars; c++) {
+    new_name[c] = prefix_nt[c];
   }
 
-  if (wallstats.enabled && profileovhd.enabled){
-    if (t == 0){
-      /* dummy clock call, to capture earlier tp1 call */
-      tpa = (*ptr2wtimefunc) ();
-    }
+  /* add thread-specific prefix */
+  numchars = MIN (perthread[t].prefix_len, MAX_CHARS-prefix_len_nt);
+  for (c = 0; c < numchars; c++) {
+    new_name[c+prefix_len_nt] = perthread[t].prefix[c];
+  }
+
+  /* add timer name */
+  numchars = MIN (namelen, MAX_CHARS-prefix_len_nt-perthread[t].prefix_len);
+  for (c = 0; c < numchars; c++) {
+    new_name[c+prefix_len_nt+perthread[t].prefix_len] = timername[c];
   }
 
+  /* add string terminator */
+  numchars = MIN (namelen+prefix_len_nt+perthread[t].prefix_len, MAX_CHARS);
+  new_name[numchars] = '\0';
+
+  return numchars;
+}
+
+/*
+** update_ll_hash: Update linked list and hash table.
+**                 Called by GPTLstart(f), GPTLstart_instr,
+**                 and GPTLstart(f)_handle.
+**
+** Input arguments:
+**   ptr:  pointer to timer
+**   t:    thread index
+**   indx: hash value (as returned by getentry, getentryf or getentry_instr)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int update_ll_hash (Timer *ptr, const int t, const unsigned int indx)
+{
+  int nchars;          /* number of chars */
+  unsigned int mask;   /* hash table size minus 1 */
+  unsigned int i;      /* slot index */
+  Hashtable *table;    /* hash table for this thread */
+
   /*
-  ** If prefix string is defined, prepend it to timername
-  ** and assign the name pointer to the new string.
-  ** Otherwise assign the name pointer to the original string.
+  ** A filtered timer goes in the hash table only, so lookups find it but it
+  ** is left out of the linked list and so of all output
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
-    namelen = strlen(timername);
-    numchars = add_prefix(new_name, timername, namelen, t);
-    name = new_name;
-  } else {
-    name = timername;
-  }
+  ptr->filtered = (nfilter > 0 && is_filtered (ptr->name));
 
-  if ( ! (ptr = getentry (hashtable[t], name, &indx)))
-    return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, name);
+  if ( ! ptr->filtered) {
+    nchars = strlen (ptr->name);
+    if (nchars > perthread[t].max_name_len)
+      perthread[t].max_name_len = nchars;
 
-  if ( ! ptr->onflg )
-    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+    if (nsampling > 0)
+      ptr->sample = get_sampling (ptr->name);
 
-  ++ptr->count;
+#ifdef HAVE_PAPI
+    ptr->dopapi = (npapiselect == 0 || name_matches (papiselect, npapiselect, ptr->name));
+#endif
+
+    /* Histogram space is set aside now so update_stats never allocates */
+
+    if (dohist &&
+	! (ptr->hist = (unsigned long *) GPTLarena_alloc (&perthread[t].arena, HIST_NBINS * sizeof (unsigned long),
+							   sizeof (unsigned long))))
+      return GPTLerror ("update_ll_hash: no space for histogram\n");
+
+    perthread[t].last->next = ptr;
+    perthread[t].last = ptr;
+  }
 
   /*
-  ** Recursion => decrement depth in recursion and return.  We need to return
-  ** because we don't want to stop the timer.  We want the reported time for
-  ** the timer to reflect the outermost layer of recursion.
+  ** Keep the load factor at or below 1/2 so probe sequences stay short
   */
 
-  if (ptr->recurselvl > 0) {
-    ++ptr->nrecurse;
-    --ptr->recurselvl;
+  table = &perthread[t].hashtable;
+  if (2*(table->nument + 1) > table->size && grow_hashtable (table) != 0)
+    return GPTLerror ("update_ll_hash: grow_hashtable error\n");
 
-    if (wallstats.enabled && profileovhd.enabled){
-      if (t == 0){
-        /* second caliper timestamp */
-        tpb = (*ptr2wtimefunc) ();
-        /* subtract out additional overhead from caliper timing calls */
-        overhead_est += ((tpb - tp1) - overhead_utr);
-        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
-        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
-      }
-    }
+  mask = table->size - 1;
+  for (i = indx & mask; table->slots[i].entry; i = (i + 1) & mask);
+  table->slots[i].hash  = indx;
+  table->slots[i].entry = ptr;
+  ptr->traceid = table->nument++;
 
-    return 0;
-  }
+  return 0;
+}
 
-  if (update_stats (ptr, tp1, usr, sys, t) != 0)
-    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+/*
+** grow_hashtable: double the size of a hash table, re-inserting the existing
+**                 entries using their saved hash values
+**
+** Input/output arguments:
+**   table: hash table
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
 
-  if (wallstats.enabled && profileovhd.enabled){
-    if (t == 0){
-      /* second caliper timestamp */
-      tpb = (*ptr2wtimefunc) ();
-      /* subtract out additional overhead from caliper timing calls */
-      overhead_est += ((tpb - tp1) - overhead_utr);
-      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
-      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+static int grow_hashtable (Hashtable *table)
+{
+  Hashslot *newslots;  /* new array of slots */
+  unsigned int mask;   /* new hash table size minus 1 */
+  unsigned int n;      /* index into old slots */
+  unsigned int i;      /* index into new slots */
+
+  newslots = (Hashslot *) GPTLallocate (2 * table->size * sizeof (Hashslot));
+  if ( ! newslots)
+    return GPTLerror ("grow_hashtable: allocation error\n");
+  memset (newslots, 0, 2 * table->size * sizeof (Hashslot));
+
+  mask = 2 * table->size - 1;
+  for (n = 0; n < table->size; ++n) {
+    if (table->slots[n].entry) {
+      for (i = table->slots[n].hash & mask; newslots[i].entry; i = (i + 1) & mask);
+      newslots[i] = table->slots[n];
     }
   }
 
+  free (table->slots);
+  table->slots = newslots;
+  table->size *= 2;
   return 0;
 }
 
 /*
-** GPTLstop_handle: stop a timer based on a handle
+** update_ptr: Update timer contents.
+**  Called by GPTLstart(f), GPTLstart_instr, and GPTLstart(f)_handle.
 **
 ** Input arguments:
-**   name: timer name (used only for diagnostics)
-**   handle: pointer to timer
+**   ptr:  pointer to timer
+**   t:    thread index
 **
-** Return value: 0 (success) or -1 (failure)
+** Return value: 0 (success) or GPTLerror (failure)
 */
 
-int GPTLstop_handle (const char *name,     /* timer name */
-		     void **handle)        /* handle (output if input value is 0) */
+static inline int update_ptr (Timer *ptr, const int t)
 {
-  double tp1 = 0.0;          /* time stamp */
-  Timer *ptr;                /* linked list pointer */
-  int t;                     /* thread number for this process */
-  unsigned int indx;         /* index into hash table */
-  long usr = 0;              /* user time (returned from get_cpustamp) */
-  long sys = 0;              /* system time (returned from get_cpustamp) */
-  double tpa = 0.0;          /* time stamp */
-  double tpb = 0.0;          /* time stamp */
-  static const char *thisfunc = "GPTLstop_handle";
+  double tp2;    /* time stamp */
+#ifdef HAVE_PAPI
+  bool fresh = false;  /* counters read by the previous start/stop on this thread */
 
-  if (disabled)
-    return 0;
+  if (dousepapi) {
+    fresh = perthread[t].papifresh;
+    perthread[t].papifresh = false;
+  }
+#endif
 
-  if ( ! initialized)
-    return 0;
+  /* Make room in the trace before the stamps, so a flush is not timed */
 
-  if ((t = get_thread_num ()) < 0)
-    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+  if (tracecap > 0 && perthread[t].ntrace == tracecap && trace_flush (t) != 0)
+    return GPTLerror ("update_ptr: error from trace_flush\n");
 
-  /*
-  ** If prefix string is defined, then call GPTLstop and
-  ** return a handle of 0. Otherwise a change in the prefix
-  ** might be ignored if the handle has already been set.
-  */
+  ptr->onflg = true;
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
-    *handle = 0;
-    return GPTLstop (name);
-  }
+  if (doexclusive)
+    ptr->descmark = perthread[t].npairs++;
 
-  /* Get the timestamp */
+  /* A sampled timer reads the clocks on 1 in sample calls, starting with the first */
 
-  if (wallstats.enabled) {
-    tp1 = (*ptr2wtimefunc) ();
+  ptr->sampled = (ptr->sample < 2 || ptr->count % ptr->sample == 0);
+  if ( ! ptr->sampled) {
+    if (tracecap > 0)
+      trace_event (t, ptr, GPTLBIN_TRACE_START, (*ptr2wtimefunc) ());
+    return 0;
   }
 
-  if (cpustats.enabled && get_cpustamp (&usr, &sys) < 0)
-    return GPTLerror (0);
+  if (domemory && GPTLget_rss (&ptr->rss_last) != 0)
+    return GPTLerror ("update_ptr: GPTLget_rss error\n");
 
-  /*
-  ** If current depth exceeds a user-specified limit for print, just
-  ** decrement and return
-  */
+  if (cpustats.enabled && get_cpustamp (&ptr->cpu.last_utime, &ptr->cpu.last_stime) < 0)
+    return GPTLerror ("update_ptr: get_cpustamp error");
 
-  if (stackidx[t].val > depthlimit) {
-    --stackidx[t].val;
-    return 0;
+  if (wallstats.enabled) {
+    tp2 = (*ptr2wtimefunc) ();
+    ptr->wall.last = tp2;
   }
 
-  if (wallstats.enabled && profileovhd.enabled){
-    if (t == 0){
-      /* dummy clock call, to capture earlier tp1 call */
-      tpa = (*ptr2wtimefunc) ();
-    }
-  }
+#ifdef HAVE_PAPI
+  /* A start right after a stop on this thread reuses the values that stop read */
 
-  /*
-  ** If on input, handle references a non-zero value, assume it's a previously returned Timer*
-  ** passed in by the user. If zero, generate the hash entry and return it to the user.
-  */
+  if (dousepapi && ptr->dopapi && GPTL_PAPIstart (t, &ptr->aux, fresh) < 0)
+    return GPTLerror ("update_ptr: error from GPTL_PAPIstart\n");
+#endif
 
-  if (*handle) {
-    ptr = (Timer *) *handle;
-  } else {
-    if ( ! (ptr = getentry (hashtable[t], name, &indx)))
-    return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, name);
+  if (tracecap > 0)
+    trace_event (t, ptr, GPTLBIN_TRACE_START, wallstats.enabled ? tp2 : (*ptr2wtimefunc) ());
+  return 0;
+}
+
+/*
+** skip_stamp: whether a stop on thread t can skip reading the clocks. The
+**   timer being stopped is normally the one on top of the call stack, so if
+**   that is a sampled timer whose start did not read them, neither need the
+**   stop. The timer is not known yet because the stamps are taken before the
+**   lookup, to keep its cost out of the timed interval.
+**
+** Input arguments:
+**   t: thread index
+*/
+
+static inline bool skip_stamp (const int t)
+{
+  const Timer *top;
+
+  if (nsampling == 0 || profileovhd.enabled ||
+      perthread[t].stackidx < 0 || perthread[t].stackidx >= MAX_STACK)
+    return false;
+  top = perthread[t].callstack[perthread[t].stackidx];
+  return top && top->sample > 1 && ! top->sampled;
+}
+
+/*
+** nstamped: number of calls of a timer which read the clocks
+*/
+
+static inline unsigned long nstamped (const Timer *ptr)
+{
+  return (ptr->sample > 1) ? ptr->samp.n : ptr->count;
+}
+
+/*
+** update_parent_info: update info about parent, and in the parent about this child
+**
+** Arguments:
+**   ptr:  pointer to timer
+**   callstackt: callstack for this thread
+**   stackidxt:  stack index for this thread
+**   arena:      arena for this thread
+**   edges:      call graph edges for this thread
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static inline int update_parent_info (Timer *ptr,
+				      Timer **callstackt,
+				      int stackidxt,
+				      Arena *arena,
+				      Edgetable *edges)
+{
+  int n;             /* loop index through known parents */
+  Timer *pptr;       /* pointer to parent in callstack */
+  Edgeslot *edge;    /* edge from parent to this timer */
+  Timer **pptrtmp;   /* for growing parent pointer array */
+  int nparent;       /* number of parents */
+  int *parent_count; /* number of times parent invoked this child */
+  static const char *thisfunc = "update_parent_info";
+
+  if ( ! ptr )
+    return -1;
+
+  if (stackidxt < 0)
+    return GPTLerror ("%s: called with negative stackidx\n", thisfunc);
+
+  callstackt[stackidxt] = ptr;
+
+  /*
+  ** If the region has no parent, bump its orphan count
+  ** (should never happen since "GPTL_ROOT" added).
+  */
+
+  if (stackidxt == 0) {
+    ++ptr->norphan;
+    return 0;
+  }
+
+  pptr = callstackt[stackidxt-1];
+
+  /*
+  ** If this parent occurred before, bump its count. A few parents are quicker
+  ** to search directly; timers called from many places use the edge table.
+  */
+
+  if (ptr->nparent <= EDGE_SCAN) {
+    for (n = 0; n < ptr->nparent; ++n) {
+      if (ptr->parent[n] == pptr) {
+	++ptr->parent_count[n];
+	return 0;
+      }
+    }
+  } else if ((edge = find_edge (edges, pptr, ptr))) {
+    ++ptr->parent_count[edge->n];
+    return 0;
+  }
+
+  /* This is a new parent: append it to the parent arrays and record the edge */
+
+  nparent = ptr->nparent;
+  pptrtmp = (Timer **) grow_array (arena, ptr->parent, nparent, sizeof (Timer *));
+  if ( ! pptrtmp)
+    return GPTLerror ("%s: grow_array error pptrtmp nparent=%d\n", thisfunc, nparent+1);
+
+  ptr->parent = pptrtmp;
+  ptr->parent[nparent] = pptr;
+  parent_count = (int *) grow_array (arena, ptr->parent_count, nparent, sizeof (int));
+  if ( ! parent_count)
+    return GPTLerror ("%s: grow_array error parent_count nparent=%d\n", thisfunc, nparent+1);
+
+  ptr->parent_count = parent_count;
+  ptr->parent_count[nparent] = 1;
+  ++ptr->nparent;
+
+  if (add_edge (edges, pptr, ptr, nparent) != 0)
+    return GPTLerror ("%s: add_edge error\n", thisfunc);
+
+  return 0;
+}
+
+/*
+** edge_hash: hash value of the call graph edge from parent to child, from
+**            their ids
+*/
+
+static inline unsigned int edge_hash (const Timer *parent,
+				      const Timer *child)
+{
+  unsigned int h;
+
+  h = (unsigned int) parent->traceid * 2654435761U ^ (unsigned int) child->traceid;
+  return h ^ (h >> 16);
+}
+
+/*
+** find_edge: look up the call graph edge from parent to child
+**
+** Input arguments:
+**   edges:  edge table
+**   parent: calling timer
+**   child:  called timer
+**
+** Return value: pointer to the edge's slot, or NULL if there is no such edge
+*/
+
+static inline Edgeslot *find_edge (const Edgetable *edges,
+				   const Timer *parent,
+				   const Timer *child)
+{
+  unsigned int mask;   /* edge table size minus 1 */
+  unsigned int i;      /* slot index */
+
+  mask = edges->size - 1;
+  for (i = edge_hash (parent, child) & mask; edges->slots[i].parent; i = (i + 1) & mask)
+    if (edges->slots[i].parent == parent && edges->slots[i].child == child)
+      return &edges->slots[i];
+  return 0;
+}
+
+/*
+** add_edge: record a new call graph edge from parent to child
+**
+** Input arguments:
+**   parent: calling timer
+**   child:  called timer
+**   n:      index of parent in child's parent arrays
+** Input/output arguments:
+**   edges:  edge table
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int add_edge (Edgetable *edges,
+		     const Timer *parent,
+		     const Timer *child,
+		     const unsigned int n)
+{
+  unsigned int hash;   /* hash of the edge */
+  unsigned int mask;   /* edge table size minus 1 */
+  unsigned int i;      /* slot index */
+
+  /* Same load factor limit as the timer hash table */
+
+  if (2*(edges->nument + 1) > edges->size && grow_edgetable (edges) != 0)
+    return GPTLerror ("add_edge: grow_edgetable error\n");
+
+  hash = edge_hash (parent, child);
+  mask = edges->size - 1;
+  for (i = hash & mask; edges->slots[i].parent; i = (i + 1) & mask);
+  edges->slots[i].hash   = hash;
+  edges->slots[i].n      = n;
+  edges->slots[i].parent = parent;
+  edges->slots[i].child  = child;
+  edges->slots[i].linked = false;
+  ++edges->nument;
+  return 0;
+}
+
+/*
+** grow_edgetable: double the size of an edge table, re-inserting the existing
+**                 edges using their saved hash values
+**
+** Input/output arguments:
+**   edges: edge table
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int grow_edgetable (Edgetable *edges)
+{
+  Edgeslot *newslots;  /* new array of slots */
+  unsigned int mask;   /* new edge table size minus 1 */
+  unsigned int n;      /* index into old slots */
+  unsigned int i;      /* index into new slots */
+
+  newslots = (Edgeslot *) GPTLallocate (2 * edges->size * sizeof (Edgeslot));
+  if ( ! newslots)
+    return GPTLerror ("grow_edgetable: allocation error\n");
+  memset (newslots, 0, 2 * edges->size * sizeof (Edgeslot));
+
+  mask = 2 * edges->size - 1;
+  for (n = 0; n < edges->size; ++n) {
+    if (edges->slots[n].parent) {
+      for (i = edges->slots[n].hash & mask; newslots[i].parent; i = (i + 1) & mask);
+      newslots[i] = edges->slots[n];
+    }
+  }
+
+  free (edges->slots);
+  edges->slots = newslots;
+  edges->size *= 2;
+  return 0;
+}
+
+/*
+** GPTLstop_instr: stop a timer (auto-instrumented)
+**
+** Input arguments:
+**   self: function address
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLstop_instr (void *self)
+{
+  double tp1 = 0.0;          /* time stamp */
+  bool stamped;              /* whether the time stamps were read */
+  Timer *ptr;                /* linked list pointer */
+  int t;                     /* thread number for this process */
+  unsigned int indx;         /* index into hash table */
+  long usr = 0;              /* user time (returned from get_cpustamp) */
+  long sys = 0;              /* system time (returned from get_cpustamp) */
+  static const char *thisfunc = "GPTLstop_instr";
+
+  if (disabled)
+    return 0;
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+
+  /* Get the timestamp */
+
+  stamped = ! skip_stamp (t);
+  if (wallstats.enabled && stamped) {
+    tp1 = (*ptr2wtimefunc) ();
+  }
+
+  if (cpustats.enabled && stamped && get_cpustamp (&usr, &sys) < 0)
+    return GPTLerror ("%s: bad return from get_cpustamp\n", thisfunc);
+
+
+  /*
+  ** If current depth exceeds a user-specified limit for print, just
+  ** decrement and return
+  */
+
+  if (perthread[t].stackidx > depthlimit) {
+    --perthread[t].stackidx;
+    return 0;
   }
 
+  ptr = getentry_instr (&perthread[t].hashtable, self, &indx);
+
+  if ( ! ptr)
+    return GPTLerror ("%s: timer for %p had not been started.\n", thisfunc, self);
+
+  if (ptr->filtered)
+    return 0;
+
   if ( ! ptr->onflg )
     return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
 
@@ -1946,71 +3126,42 @@ int GPTLstop_handle (const char *name,     /* timer name */
   if (ptr->recurselvl > 0) {
     ++ptr->nrecurse;
     --ptr->recurselvl;
-
-    if (wallstats.enabled && profileovhd.enabled){
-      if (t == 0){
-        /* second caliper timestamp */
-        tpb = (*ptr2wtimefunc) ();
-        /* subtract out additional overhead from caliper timing calls */
-        overhead_est += ((tpb - tp1) - overhead_utr);
-        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
-        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
-      }
-    }
-
     return 0;
   }
 
-  if (update_stats (ptr, tp1, usr, sys, t) != 0)
+  if (update_stats (ptr, tp1, usr, sys, t, stamped) != 0)
     return GPTLerror ("%s: error from update_stats\n", thisfunc);
 
-  /*
-  ** If on input, *handle was 0, return the pointer to the timer for future input
-  */
-
-  if ( ! *handle)
-    *handle = (void *) ptr;
-
-  if (wallstats.enabled && profileovhd.enabled){
-    if (t == 0){
-      /* second caliper timestamp */
-      tpb = (*ptr2wtimefunc) ();
-      /* subtract out additional overhead from caliper timing calls */
-      overhead_est += ((tpb - tp1) - overhead_utr);
-      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
-      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
-    }
-  }
-
   return 0;
 }
 
 /*
-** GPTLstopf: stop a timer when the timer name may not be null terminated
+** GPTLstop: stop a timer
 **
 ** Input arguments:
 **   timername: timer name
-**   namelen:   number of characters in timer name
 **
 ** Return value: 0 (success) or -1 (failure)
 */
 
-int GPTLstopf (const char *timername, const int namelen) /* timer name and length */
+int GPTLstop (const char *timername)         /* timer name */
 {
   double tp1 = 0.0;           /* time stamp */
+  bool stamped;               /* whether the time stamps were read */
   Timer *ptr;                 /* linked list pointer */
   int t;                      /* thread number for this process */
-  int c;                      /* character index */
   int numchars;               /* number of characters to copy */
+  int namelen;                /* number of characters in timer name */
+  int len_prefix;             /* number of characters in prefix */
   unsigned int indx;          /* index into hash table */
   long usr = 0;               /* user time (returned from get_cpustamp) */
   long sys = 0;               /* system time (returned from get_cpustamp) */
-  char strname[MAX_CHARS+1];  /* null terminated version of name */
   double tpa = 0.0;           /* time stamp */
   double tpb = 0.0;           /* time stamp */
+  char *ptr_prefix;           /* pointer to prefix string */
   char new_name[MAX_CHARS+1]; /* timer name with prefix, if there is one */
   const char *name;           /* pointer to timer name */
-  static const char *thisfunc = "GPTLstopf";
+  static const char *thisfunc = "GPTLstop";
 
   if (disabled)
     return 0;
@@ -2018,25 +3169,27 @@ int GPTLstopf (const char *timername, const int namelen) /* timer name and lengt
   if ( ! initialized)
     return 0;
 
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+
   /* Get the timestamp */
 
-  if (wallstats.enabled) {
+  stamped = ! skip_stamp (t);
+  if (wallstats.enabled && stamped) {
     tp1 = (*ptr2wtimefunc) ();
   }
 
-  if (cpustats.enabled && get_cpustamp (&usr, &sys) < 0)
+  if (cpustats.enabled && stamped && get_cpustamp (&usr, &sys) < 0)
     return GPTLerror ("%s: get_cpustamp error", thisfunc);
 
-  if ((t = get_thread_num ()) < 0)
-    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
 
   /*
   ** If current depth exceeds a user-specified limit for print, just
   ** decrement and return
   */
 
-  if (stackidx[t].val > depthlimit) {
-    --stackidx[t].val;
+  if (perthread[t].stackidx > depthlimit) {
+    --perthread[t].stackidx;
     return 0;
   }
 
@@ -2053,23 +3206,19 @@ int GPTLstopf (const char *timername, const int namelen) /* timer name and lengt
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
+    namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
   } else {
-    numchars = MIN (namelen, MAX_CHARS);
     name = timername;
   }
 
-  if ( ! (ptr = getentryf (hashtable[t], name, numchars, &indx))){
-    //pw    numchars = MIN (namelen, MAX_CHARS);
-    //pw    strncpy (strname, name, numchars);
-    for (c = 0; c < numchars; c++) {
-      strname[c] = name[c];
-    }
-    strname[numchars] = '\0';
-    return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, strname);
-  }
+  if ( ! (ptr = getentry (&perthread[t].hashtable, name, &indx)))
+    return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, name);
+
+  if (ptr->filtered)
+    return 0;
 
   if ( ! ptr->onflg )
     return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
@@ -2100,7 +3249,7 @@ int GPTLstopf (const char *timername, const int namelen) /* timer name and lengt
     return 0;
   }
 
-  if (update_stats (ptr, tp1, usr, sys, t) != 0)
+  if (update_stats (ptr, tp1, usr, sys, t, stamped) != 0)
     return GPTLerror ("%s: error from update_stats\n", thisfunc);
 
   if (wallstats.enabled && profileovhd.enabled){
@@ -2118,382 +3267,2079 @@ int GPTLstopf (const char *timername, const int namelen) /* timer name and lengt
 }
 
 /*
-** GPTLstopf_handle: stop a timer based on a handle
-**  when the timer name may not be null terminated
+** GPTLstop_handle: stop a timer based on a handle
 **
 ** Input arguments:
 **   name: timer name (used only for diagnostics)
-**   namelen: number of characters in timer name
 **   handle: pointer to timer
 **
 ** Return value: 0 (success) or -1 (failure)
 */
 
-int GPTLstopf_handle (const char *name,     /* timer name */
-                      const int namelen,    /* timer name length */
-                      void **handle)        /* handle (output if input value is 0) */
+int GPTLstop_handle (const char *name,     /* timer name */
+		     void **handle)        /* handle (output if input value is 0) */
+{
+  double tp1 = 0.0;          /* time stamp */
+  bool stamped;              /* whether the time stamps were read */
+  Timer *ptr;                /* linked list pointer */
+  int t;                     /* thread number for this process */
+  unsigned int indx;         /* index into hash table */
+  long usr = 0;              /* user time (returned from get_cpustamp) */
+  long sys = 0;              /* system time (returned from get_cpustamp) */
+  double tpa = 0.0;          /* time stamp */
+  double tpb = 0.0;          /* time stamp */
+  static const char *thisfunc = "GPTLstop_handle";
+
+  if (disabled)
+    return 0;
+
+  if ( ! initialized)
+    return 0;
+
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+
+  /*
+  ** If prefix string is defined, then call GPTLstop and
+  ** return a handle of 0. Otherwise a change in the prefix
+  ** might be ignored if the handle has already been set.
+  */
+
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
+    *handle = 0;
+    return GPTLstop (name);
+  }
+
+  /* Get the timestamp */
+
+  stamped = ! skip_stamp (t);
+  if (wallstats.enabled && stamped) {
+    tp1 = (*ptr2wtimefunc) ();
+  }
+
+  if (cpustats.enabled && stamped && get_cpustamp (&usr, &sys) < 0)
+    return GPTLerror (0);
+
+  /*
+  ** If current depth exceeds a user-specified limit for print, just
+  ** decrement and return
+  */
+
+  if (perthread[t].stackidx > depthlimit) {
+    --perthread[t].stackidx;
+    return 0;
+  }
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* dummy clock call, to capture earlier tp1 call */
+      tpa = (*ptr2wtimefunc) ();
+    }
+  }
+
+  /*
+  ** If on input, handle references a non-zero value, assume it's a previously returned Timer*
+  ** passed in by the user. If zero, generate the hash entry and return it to the user.
+  */
+
+  if (*handle) {
+    ptr = (Timer *) *handle;
+  } else {
+    if ( ! (ptr = getentry (&perthread[t].hashtable, name, &indx)))
+    return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, name);
+  }
+
+  if (ptr->filtered)
+    return 0;
+
+  if ( ! ptr->onflg )
+    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+
+  ++ptr->count;
+
+  /*
+  ** Recursion => decrement depth in recursion and return.  We need to return
+  ** because we don't want to stop the timer.  We want the reported time for
+  ** the timer to reflect the outermost layer of recursion.
+  */
+
+  if (ptr->recurselvl > 0) {
+    ++ptr->nrecurse;
+    --ptr->recurselvl;
+
+    if (wallstats.enabled && profileovhd.enabled){
+      if (t == 0){
+        /* second caliper timestamp */
+        tpb = (*ptr2wtimefunc) ();
+        /* subtract out additional overhead from caliper timing calls */
+        overhead_est += ((tpb - tp1) - overhead_utr);
+        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+      }
+    }
+
+    return 0;
+  }
+
+  if (update_stats (ptr, tp1, usr, sys, t, stamped) != 0)
+    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+
+  /*
+  ** If on input, *handle was 0, return the pointer to the timer for future input
+  */
+
+  if ( ! *handle)
+    *handle = (void *) ptr;
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* second caliper timestamp */
+      tpb = (*ptr2wtimefunc) ();
+      /* subtract out additional overhead from caliper timing calls */
+      overhead_est += ((tpb - tp1) - overhead_utr);
+      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+    }
+  }
+
+  return 0;
+}
+
+/*
+** GPTLstopf: stop a timer when the timer name may not be null terminated
+**
+** Input arguments:
+**   timername: timer name
+**   namelen:   number of characters in timer name
+**
+** Return value: 0 (success) or -1 (failure)
+*/
+
+int GPTLstopf (const char *timername, const int namelen) /* timer name and length */
+{
+  double tp1 = 0.0;           /* time stamp */
+  bool stamped;               /* whether the time stamps were read */
+  Timer *ptr;                 /* linked list pointer */
+  int t;                      /* thread number for this process */
+  int c;                      /* character index */
+  int numchars;               /* number of characters to copy */
+  unsigned int indx;          /* index into hash table */
+  long usr = 0;               /* user time (returned from get_cpustamp) */
+  long sys = 0;               /* system time (returned from get_cpustamp) */
+  char strname[MAX_CHARS+1];  /* null terminated version of name */
+  double tpa = 0.0;           /* time stamp */
+  double tpb = 0.0;           /* time stamp */
+  char new_name[MAX_CHARS+1]; /* timer name with prefix, if there is one */
+  const char *name;           /* pointer to timer name */
+  static const char *thisfunc = "GPTLstopf";
+
+  if (disabled)
+    return 0;
+
+  if ( ! initialized)
+    return 0;
+
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+
+  /* Get the timestamp */
+
+  stamped = ! skip_stamp (t);
+  if (wallstats.enabled && stamped) {
+    tp1 = (*ptr2wtimefunc) ();
+  }
+
+  if (cpustats.enabled && stamped && get_cpustamp (&usr, &sys) < 0)
+    return GPTLerror ("%s: get_cpustamp error", thisfunc);
+
+
+  /*
+  ** If current depth exceeds a user-specified limit for print, just
+  ** decrement and return
+  */
+
+  if (perthread[t].stackidx > depthlimit) {
+    --perthread[t].stackidx;
+    return 0;
+  }
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* dummy clock call, to capture earlier tp1 call */
+      tpa = (*ptr2wtimefunc) ();
+    }
+  }
+
+  /*
+  ** If prefix string is defined, prepend it to timername
+  ** and assign the name pointer to the new string.
+  ** Otherwise assign the name pointer to the original string.
+  */
+
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
+    numchars = add_prefix(new_name, timername, namelen, t);
+    name = new_name;
+  } else {
+    numchars = MIN (namelen, MAX_CHARS);
+    name = timername;
+  }
+
+  if ( ! (ptr = getentryf (&perthread[t].hashtable, name, numchars, &indx))){
+    //pw    numchars = MIN (namelen, MAX_CHARS);
+    //pw    strncpy (strname, name, numchars);
+    for (c = 0; c < numchars; c++) {
+      strname[c] = name[c];
+    }
+    strname[numchars] = '\0';
+    return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, strname);
+  }
+
+  if (ptr->filtered)
+    return 0;
+
+  if ( ! ptr->onflg )
+    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+
+  ++ptr->count;
+
+  /*
+  ** Recursion => decrement depth in recursion and return.  We need to return
+  ** because we don't want to stop the timer.  We want the reported time for
+  ** the timer to reflect the outermost layer of recursion.
+  */
+
+  if (ptr->recurselvl > 0) {
+    ++ptr->nrecurse;
+    --ptr->recurselvl;
+
+    if (wallstats.enabled && profileovhd.enabled){
+      if (t == 0){
+        /* second caliper timestamp */
+        tpb = (*ptr2wtimefunc) ();
+        /* subtract out additional overhead from caliper timing calls */
+        overhead_est += ((tpb - tp1) - overhead_utr);
+        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+      }
+    }
+
+    return 0;
+  }
+
+  if (update_stats (ptr, tp1, usr, sys, t, stamped) != 0)
+    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* second caliper timestamp */
+      tpb = (*ptr2wtimefunc) ();
+      /* subtract out additional overhead from caliper timing calls */
+      overhead_est += ((tpb - tp1) - overhead_utr);
+      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+    }
+  }
+
+  return 0;
+}
+
+/*
+** GPTLstopf_handle: stop a timer based on a handle
+**  when the timer name may not be null terminated
+**
+** Input arguments:
+**   name: timer name (used only for diagnostics)
+**   namelen: number of characters in timer name
+**   handle: pointer to timer
+**
+** Return value: 0 (success) or -1 (failure)
+*/
+
+int GPTLstopf_handle (const char *name,     /* timer name */
+                      const int namelen,    /* timer name length */
+                      void **handle)        /* handle (output if input value is 0) */
+{
+  double tp1 = 0.0;          /* time stamp */
+  bool stamped;              /* whether the time stamps were read */
+  Timer *ptr;                /* linked list pointer */
+  int t;                     /* thread number for this process */
+  int c;                      /* character index */
+  unsigned int indx;         /* index into hash table */
+  long usr = 0;              /* user time (returned from get_cpustamp) */
+  long sys = 0;              /* system time (returned from get_cpustamp) */
+  int numchars;              /* number of characters to copy */
+  char strname[MAX_CHARS+1]; /* null terminated version of name */
+  double tpa = 0.0;          /* time stamp */
+  double tpb = 0.0;          /* time stamp */
+  static const char *thisfunc = "GPTLstopf_handle";
+
+  if (disabled)
+    return 0;
+
+  if ( ! initialized)
+    return 0;
+
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+
+  /*
+  ** If prefix string is defined, then call GPTLstopf and
+  ** return a handle of 0. Otherwise a change in the prefix
+  ** might be ignored if the handle has already been set.
+  */
+
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
+    *handle = 0;
+    return GPTLstopf (name, namelen);
+  }
+
+  /* Get the timestamp */
+
+  stamped = ! skip_stamp (t);
+  if (wallstats.enabled && stamped) {
+    tp1 = (*ptr2wtimefunc) ();
+  }
+
+  if (cpustats.enabled && stamped && get_cpustamp (&usr, &sys) < 0)
+    return GPTLerror (0);
+
+  /*
+  ** If current depth exceeds a user-specified limit for print, just
+  ** decrement and return
+  */
+
+  if (perthread[t].stackidx > depthlimit) {
+    --perthread[t].stackidx;
+    return 0;
+  }
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* dummy clock call, to capture earlier tp1 call */
+      tpa = (*ptr2wtimefunc) ();
+    }
+  }
+
+  /*
+  ** If on input, handle references a non-zero value, assume it's a previously returned Timer*
+  ** passed in by the user. If zero, generate the hash entry and return it to the user.
+  */
+
+  if (*handle) {
+    ptr = (Timer *) *handle;
+  } else {
+    if ( ! (ptr = getentryf (&perthread[t].hashtable, name, namelen, &indx))){
+      numchars = MIN (namelen, MAX_CHARS);
+      //pw      strncpy (strname, name, numchars);
+      for (c = 0; c < numchars; c++) {
+        strname[c] = name[c];
+      }
+      strname[numchars] = '\0';
+      return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, strname);
+    }
+  }
+
+  if (ptr->filtered)
+    return 0;
+
+  if ( ! ptr->onflg )
+    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+
+  ++ptr->count;
+
+  /*
+  ** Recursion => decrement depth in recursion and return.  We need to return
+  ** because we don't want to stop the timer.  We want the reported time for
+  ** the timer to reflect the outermost layer of recursion.
+  */
+
+  if (ptr->recurselvl > 0) {
+    ++ptr->nrecurse;
+    --ptr->recurselvl;
+
+    if (wallstats.enabled && profileovhd.enabled){
+      if (t == 0){
+        /* second caliper timestamp */
+        tpb = (*ptr2wtimefunc) ();
+        /* subtract out additional overhead from caliper timing calls */
+        overhead_est += ((tpb - tp1) - overhead_utr);
+        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+      }
+    }
+
+    return 0;
+  }
+
+  if (update_stats (ptr, tp1, usr, sys, t, stamped) != 0)
+    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+
+  /*
+  ** If on input, *handle was 0, return the pointer to the timer for future input
+  */
+
+  if ( ! *handle)
+    *handle = (void *) ptr;
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* second caliper timestamp */
+      tpb = (*ptr2wtimefunc) ();
+      /* subtract out additional overhead from caliper timing calls */
+      overhead_est += ((tpb - tp1) - overhead_utr);
+      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+    }
+  }
+
+  return 0;
+}
+
+/*
+** GPTLstop_id: stop a timer previously registered with GPTLregister
+**
+** Input arguments:
+**   id: timer id
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLstop_id (const int id)  /* timer id */
+{
+  double tp1 = 0.0;             /* time stamp */
+  bool stamped;                 /* whether the time stamps were read */
+  Timer *ptr;                   /* linked list pointer */
+  int t;                        /* thread number for this process */
+  long usr = 0;                 /* user time (returned from get_cpustamp) */
+  long sys = 0;                 /* system time (returned from get_cpustamp) */
+  double tpb = 0.0;             /* time stamp */
+  static const char *thisfunc = "GPTLstop_id";
+
+  if (disabled)
+    return 0;
+
+  if ( ! initialized)
+    return 0;
+
+  if (id < 0 || id >= nids)
+    return GPTLerror ("%s: invalid timer id %d\n", thisfunc, id);
+
+  if ((t = get_thread_num ()) < 0)
+    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+
+  /*
+  ** If prefix string is defined, the timer name depends on the prefix
+  ** so the cached timer cannot be used.
+  */
+
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0))
+    return GPTLstop (idnames[id/IDCHUNK][id%IDCHUNK]);
+
+  /* Get the timestamp */
+
+  stamped = ! skip_stamp (t);
+  if (wallstats.enabled && stamped) {
+    tp1 = (*ptr2wtimefunc) ();
+  }
+
+  if (cpustats.enabled && stamped && get_cpustamp (&usr, &sys) < 0)
+    return GPTLerror (0);
+
+  /*
+  ** If current depth exceeds a user-specified limit for print, just
+  ** decrement and return
+  */
+
+  if (perthread[t].stackidx > depthlimit) {
+    --perthread[t].stackidx;
+    return 0;
+  }
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* dummy clock call, to capture earlier tp1 call */
+      (void) (*ptr2wtimefunc) ();
+    }
+  }
+
+  if ( ! (ptr = getentry_id (id, t, false)))
+    return GPTLerror ("%s thread %d: timer for %s had not been started.\n",
+		      thisfunc, t, idnames[id/IDCHUNK][id%IDCHUNK]);
+
+  if (ptr->filtered)
+    return 0;
+
+  if ( ! ptr->onflg )
+    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+
+  ++ptr->count;
+
+  /*
+  ** Recursion => decrement depth in recursion and return.  We need to return
+  ** because we don't want to stop the timer.  We want the reported time for
+  ** the timer to reflect the outermost layer of recursion.
+  */
+
+  if (ptr->recurselvl > 0) {
+    ++ptr->nrecurse;
+    --ptr->recurselvl;
+
+    if (wallstats.enabled && profileovhd.enabled){
+      if (t == 0){
+        /* second caliper timestamp */
+        tpb = (*ptr2wtimefunc) ();
+        /* subtract out additional overhead from caliper timing calls */
+        overhead_est += ((tpb - tp1) - overhead_utr);
+        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+      }
+    }
+
+    return 0;
+  }
+
+  if (update_stats (ptr, tp1, usr, sys, t, stamped) != 0)
+    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+
+  if (wallstats.enabled && profileovhd.enabled){
+    if (t == 0){
+      /* second caliper timestamp */
+      tpb = (*ptr2wtimefunc) ();
+      /* subtract out additional overhead from caliper timing calls */
+      overhead_est += ((tpb - tp1) - overhead_utr);
+      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
+      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+    }
+  }
+
+  return 0;
+}
+
+/*
+** update_stats: update stats inside ptr. Called by GPTLstop(f), GPTLstop_instr,
+**               GPTLstop(f)_handle
+**
+** Input arguments:
+**   ptr: pointer to timer
+**   tp1: input time stapm
+**   usr: user time
+**   sys: system time
+**   t: thread index
+**   stamped: whether tp1, usr and sys were read (see skip_stamp)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static inline int update_stats (Timer *ptr,
+				double tp1,
+				long usr,
+				long sys,
+				const int t,
+				const bool stamped)
+{
+  double delta;         /* difference */
+  unsigned long weight; /* number of calls this one stands for */
+  Timer *parent = 0;    /* timer this one was started inside (GPTLexclusive only) */
+  long long rss;        /* resident set size at the stop (GPTLmemory only) */
+#ifdef HAVE_PAPI
+  long long papiaccum[MAX_AUX]; /* PAPI accumulators before this call */
+  int n;                /* index over PAPI events */
+#endif
+  static const char *thisfunc = "update_stats";
+
+  ptr->onflg = false;
+#ifdef HAVE_PAPI
+  if (dousepapi)
+    perthread[t].papifresh = false;
+#endif
+  if (tracecap > 0 && perthread[t].ntrace == tracecap && trace_flush (t) != 0)
+    return GPTLerror ("%s: error from trace_flush\n", thisfunc);
+  --perthread[t].stackidx;
+  if (perthread[t].stackidx < -1) {
+    perthread[t].stackidx = -1;
+    return GPTLerror ("%s: tree depth has become negative.\n", thisfunc);
+  }
+
+  /*
+  ** Every start/stop pair since ptr started belongs to a descendant. The
+  ** enclosing timer is the one now on top of the stack (unless ptr was
+  ** stopped out of order).
+  */
+
+  if (doexclusive) {
+    ptr->ndesc += perthread[t].npairs - ptr->descmark - 1;
+    if (perthread[t].stackidx >= 0 && perthread[t].callstack[perthread[t].stackidx] != ptr) {
+      parent = perthread[t].callstack[perthread[t].stackidx];
+      ++parent->nchildcalls;
+    }
+  }
+
+  if ( ! ptr->sampled) {
+    if (tracecap > 0)
+      trace_event (t, ptr, GPTLBIN_TRACE_STOP, (*ptr2wtimefunc) ());
+    return 0;
+  }
+
+  /* Timers stopped out of order can reach here without the stamps having been read */
+
+  if ( ! stamped) {
+    if (wallstats.enabled)
+      tp1 = (*ptr2wtimefunc) ();
+    if (cpustats.enabled && get_cpustamp (&usr, &sys) < 0)
+      return GPTLerror ("%s: get_cpustamp error", thisfunc);
+  }
+
+  if (tracecap > 0)
+    trace_event (t, ptr, GPTLBIN_TRACE_STOP, wallstats.enabled ? tp1 : (*ptr2wtimefunc) ());
+
+  /* Read after the stop stamps, so the cost is not charged to the timer */
+
+  if (domemory) {
+    if (GPTLget_rss (&rss) != 0)
+      return GPTLerror ("%s: GPTLget_rss error\n", thisfunc);
+    ptr->rss_delta += rss - ptr->rss_last;
+    ptr->rss_peak = MAX (ptr->rss_peak, MAX (rss, ptr->rss_last));
+  }
+
+  weight = 1;
+  if (ptr->sample > 1) {
+    weight = ptr->count - ptr->samp.lastcount;
+    ptr->samp.lastcount = ptr->count;
+    ++ptr->samp.n;
+  }
+
+#ifdef HAVE_PAPI
+  if (dousepapi && ptr->dopapi) {
+    if (weight > 1)
+      memcpy (papiaccum, ptr->aux.accum, sizeof (papiaccum));
+    if (GPTL_PAPIstop (t, &ptr->aux) < 0)
+      return GPTLerror ("%s: error from GPTL_PAPIstop\n", thisfunc);
+    perthread[t].papifresh = true;
+    if (weight > 1)
+      for (n = 0; n < MAX_AUX; ++n)   /* leaves a BADCOUNT as is */
+	if (ptr->aux.accum[n] > papiaccum[n])
+	  ptr->aux.accum[n] = papiaccum[n] + weight * (ptr->aux.accum[n] - papiaccum[n]);
+  }
+#endif
+
+  if (wallstats.enabled) {
+    delta = tp1 - ptr->wall.last;
+
+    if (delta < 0.) {
+      fprintf (stderr, "%s: negative delta=%g\n", thisfunc, delta);
+      delta = 0.0;
+    }
+
+    if (ptr->sample > 1) {
+      ptr->samp.sum   += delta;
+      ptr->samp.sumsq += delta * delta;
+    }
+
+    ptr->wall.accum += delta * weight;
+    if (parent)
+      parent->child_wall += delta * weight;
+    ptr->wall.latest = delta;
+
+    if (ptr->count == 1) {
+      ptr->wall.max = delta;
+
+      ptr->wall.prev_min = FLT_MAX;
+      ptr->wall.min = delta;
+      ptr->wall.latest_is_min = 1;
+    } else {
+      if (delta > ptr->wall.max)
+	ptr->wall.max = delta;
+      if (delta < ptr->wall.min){
+        ptr->wall.prev_min = ptr->wall.min;
+	ptr->wall.min = delta;
+        ptr->wall.latest_is_min = 1;
+      } else {
+        ptr->wall.latest_is_min = 0;
+      }
+    }
+
+    if (ptr->hist)
+      ++ptr->hist[hist_bin (delta)];
+  }
+
+  if (cpustats.enabled) {
+    ptr->cpu.accum_utime += weight * (usr - ptr->cpu.last_utime);
+    ptr->cpu.accum_stime += weight * (sys - ptr->cpu.last_stime);
+    ptr->cpu.last_utime   = usr;
+    ptr->cpu.last_stime   = sys;
+  }
+  return 0;
+}
+
+/*
+** GPTLenable: enable timers
+**
+** Return value: 0 (success)
+*/
+
+int GPTLenable (void)
+{
+  disabled = false;
+  return (0);
+}
+
+/*
+** GPTLdisable: disable timers
+**
+** Return value: 0 (success)
+*/
+
+int GPTLdisable (void)
+{
+  disabled = true;
+  return (0);
+}
+
+/*
+** GPTLstamp: Compute timestamp of usr, sys, and wallclock time (seconds)
+**
+** Output arguments:
+**   wall: wallclock
+**   usr:  user time
+**   sys:  system time
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLstamp (double *wall, double *usr, double *sys)
+{
+  struct tms buf;            /* argument to times */
+
+  if ( ! initialized)
+    return GPTLerror ("GPTLstamp: GPTLinitialize has not been called\n");
+
+#ifdef HAVE_TIMES
+  *usr = 0;
+  *sys = 0;
+
+  if (times (&buf) == -1)
+    return GPTLerror ("GPTLstamp: times() failed. Results bogus\n");
+
+  *usr = buf.tms_utime / (double) ticks_per_sec;
+  *sys = buf.tms_stime / (double) ticks_per_sec;
+#endif
+  *wall = (*ptr2wtimefunc) ();
+  return 0;
+}
+
+/*
+** GPTLreset: reset all timers to 0
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLreset (void)
+{
+  int t;             /* index over threads */
+  Timer *ptr;        /* linked list index */
+  static const char *thisfunc = "GPTLreset";
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+
+  for (t = 0; t < nthreads; t++) {
+    for (ptr = perthread[t].timers; ptr; ptr = ptr->next) {
+      ptr->onflg = false;
+      ptr->count = 0;
+      memset (&ptr->wall, 0, sizeof (ptr->wall));
+      memset (&ptr->cpu, 0, sizeof (ptr->cpu));
+      if (ptr->hist)
+	memset (ptr->hist, 0, HIST_NBINS * sizeof (unsigned long));
+      memset (&ptr->samp, 0, sizeof (ptr->samp));
+      ptr->child_wall = 0.;
+      ptr->nchildcalls = 0;
+      ptr->ndesc = 0;
+#ifdef HAVE_PAPI
+      memset (&ptr->aux, 0, sizeof (ptr->aux));
+#endif
+      ptr->snap_count = 0;
+      ptr->snap_accum = 0.;
+    }
+  }
+
+  if (verbose)
+    printf ("%s: accumulators for all timers set to zero\n", thisfunc);
+
+  return 0;
+}
+
+/*
+** trace_event: append one record to the trace buffer of thread t. The caller
+**   has made room (see trace_flush).
+**
+** Input arguments:
+**   t:     thread index
+**   ptr:   timer
+**   kind:  GPTLBIN_TRACE_START or GPTLBIN_TRACE_STOP
+**   stamp: wallclock time stamp
+*/
+
+static inline void trace_event (const int t, const Timer *ptr, const int kind, const double stamp)
+{
+  Tracerec *rec = &perthread[t].trace[perthread[t].ntrace++];
+
+  rec->time = stamp;
+  rec->id   = ptr->traceid;
+  rec->kind = kind;
+}
+
+/*
+** trace_flush: append the trace records of thread t, and the names of its
+**   timers created since its previous flush, to the trace file
+**   (timing.trace[.<rank>].gptb) as one segment, then empty its buffer.
+**   Called by thread t when its buffer is full, and from GPTLpr_file and
+**   GPTLfinalize.
+**
+** Input arguments:
+**   t: thread index
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int trace_flush (const int t)
+{
+  Perthread *pt = &perthread[t];
+  Bintable tables[3];
+  Tracename *names;         /* timers new since the previous flush */
+  Timer *ptr;
+  Timer *named;             /* last timer in names */
+  char name[40];            /* default file name */
+  double tp1;               /* time at the start of the flush */
+  int n;
+  int nnames = 0;
+  int namelen = 1;          /* longest new name */
+  int rank;
+  int ret = 0;
+  static const char *thisfunc = "trace_flush";
+
+  for (ptr = pt->trace_named->next; ptr; ptr = ptr->next) {
+    ++nnames;
+    namelen = MAX (namelen, (int) strlen (ptr->name));
+  }
+  if (pt->ntrace == 0 && nnames == 0)
+    return 0;
+
+  tp1 = (*ptr2wtimefunc) ();
+  if ( ! (names = (Tracename *) GPTLallocate (MAX (nnames, 1) * sizeof (Tracename))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+
+  /* Bounded by nnames in case thread t made a timer since the count */
+
+  named = pt->trace_named;
+  for (n = 0; n < nnames; ++n) {
+    named = named->next;
+    names[n].id = named->traceid;
+    names[n].name = named->name;
+  }
+
+  memset (tables, 0, sizeof (tables));
+  tables[0].name = "info";
+  tables[0].nrows = 1;
+  bin_addcol (&tables[0], "thread", GPTLBIN_INT32, 1, &t, sizeof (int));
+  if (trace_synced)
+    bin_addcol (&tables[0], "epoch", GPTLBIN_FLOAT64, 1, &traceepoch, sizeof (double));
+
+  tables[1].name = "names";
+  tables[1].nrows = nnames;
+  bin_addcol (&tables[1], "id", GPTLBIN_INT32, 1, &names[0].id, sizeof (Tracename));
+  bin_addcol (&tables[1], "name", GPTLBIN_STRING, namelen, &names[0].name, sizeof (Tracename));
+  tables[1].cols[1].indirect = true;
+
+  tables[2].name = "events";
+  tables[2].nrows = pt->ntrace;
+  bin_addcol (&tables[2], "time", GPTLBIN_FLOAT64, 1, &pt->trace[0].time, sizeof (Tracerec));
+  bin_addcol (&tables[2], "id", GPTLBIN_INT32, 1, &pt->trace[0].id, sizeof (Tracerec));
+  bin_addcol (&tables[2], "kind", GPTLBIN_INT32, 1, &pt->trace[0].kind, sizeof (Tracerec));
+
+  /* Threads take turns appending to the one file */
+
+#if ( defined THREADED_PTHREADS )
+  if (lock_mutex () < 0) {
+    free (names);
+    return GPTLerror ("%s: mutex lock failure\n", thisfunc);
+  }
+#elif ( defined THREADED_OMP )
+#pragma omp critical (GPTLtrace)
+#endif
+  {
+    if ( ! tracepath) {
+      if ((rank = get_world_rank ()) >= 0)
+	snprintf (name, sizeof (name), "timing.trace.%d%s", rank, GPTLBIN_SUFFIX);
+      else
+	snprintf (name, sizeof (name), "timing.trace%s", GPTLBIN_SUFFIX);
+      if ((tracepath = (char *) GPTLallocate ((outdir ? strlen (outdir) + 1 : 0) + strlen (name) + 1))) {
+	tracepath[0] = '\0';
+	if (outdir) {
+	  strcpy (tracepath, outdir);
+	  strcat (tracepath, "/");
+	}
+	strcat (tracepath, name);
+      }
+    }
+    if ( ! tracepath)
+      ret = GPTLerror ("%s: memory allocation failed\n", thisfunc);
+    else
+      ret = bin_write (tracepath, GPTLBIN_TRACE, 1, 3, tables, trace_opened);
+    trace_opened = true;
+  }
+#if ( defined THREADED_PTHREADS )
+  if (unlock_mutex () < 0)
+    ret = GPTLerror ("%s: mutex unlock failure\n", thisfunc);
+#endif
+
+  free (names);
+  pt->trace_named = named;
+  pt->ntraced += pt->ntrace;
+  pt->ntrace = 0;
+  ++pt->nflush;
+  pt->flushtime += (*ptr2wtimefunc) () - tp1;
+  return ret;
+}
+
+/*
+** GPTLtrace_sync: give the event traces of all tasks in comm a common time
+**   origin. Each task leaves an MPI barrier and notes its own clock; trace
+**   segments written afterwards carry that time as "epoch" in their info
+**   table, and readers subtract it to line up the ranks (to within the spread
+**   of the barrier exit). Must be called by all tasks in comm, after
+**   GPTLinitialize.
+**
+** Input arguments:
+**   comm: communicator (e.g. MPI_COMM_WORLD)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+#ifdef HAVE_MPI
+int GPTLtrace_sync (MPI_Comm comm)
+#else
+int GPTLtrace_sync (int comm)
+#endif
+{
+  static const char *thisfunc = "GPTLtrace_sync";
+#ifdef HAVE_MPI
+  int ret;
+#endif
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+
+#ifdef HAVE_MPI
+  if ((ret = MPI_Barrier (comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s: Bad return from MPI_Barrier=%d", thisfunc, ret);
+#endif
+  traceepoch = (*ptr2wtimefunc) ();
+  trace_synced = true;
+  return 0;
+}
+
+/*
+** GPTLsnapshot_file: set the file GPTLsnapshot appends to. The default is
+**   timing.snapshot.<rank> for MPI codes, else timing.snapshot.
+**
+** Input arguments:
+**   outfile: name of output file
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLsnapshot_file (const char *outfile)
+{
+  static const char *thisfunc = "GPTLsnapshot_file";
+
+  if (snapfd >= 0)
+    return GPTLerror ("%s: must be called before the first GPTLsnapshot\n", thisfunc);
+
+  free (snapfile);
+  snapfile = (char *) GPTLallocate (strlen (outfile) + 1);
+  strcpy (snapfile, outfile);
+  return 0;
+}
+
+/*
+** GPTLsnapshot: Record, for every timer of every thread, the calls and
+**   wallclock time accumulated since the previous snapshot, and append them
+**   to the snapshot file. Timers with no change are skipped. Other threads
+**   may keep timing while this runs; their numbers are then approximate for
+**   this snapshot, and the difference shows up in the next one. Call from
+**   one thread at a time.
+**
+** Input arguments:
+**   tag: label written with the snapshot (e.g. the model step)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLsnapshot (const char *tag)
+{
+  Timer *ptr;               /* linked list pointer */
+  Snaprec rec;              /* record being copied into the ring */
+  unsigned long count;      /* current count */
+  double accum;             /* current wallclock accumulation */
+  int t;                    /* thread index */
+  static const char *thisfunc = "GPTLsnapshot";
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+
+  if ( ! snapring && snap_open () != 0)
+    return GPTLerror ("%s: Error in snap_open\n", thisfunc);
+
+  rec.seq = snapseq;
+  rec.thread = -1;
+  rec.count = 0;
+  rec.wall = (*ptr2wtimefunc) ();
+  strncpy (rec.name, tag, MAX_CHARS);
+  rec.name[MAX_CHARS] = '\0';
+  if (snap_push (&rec) != 0)
+    return GPTLerror ("%s: Error in snap_push\n", thisfunc);
+
+  for (t = 0; t < nthreads; ++t) {
+    rec.thread = t;
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+      count = ptr->count;
+      accum = ptr->wall.accum;
+      if (count == ptr->snap_count && accum == ptr->snap_accum)
+	continue;
+      rec.count = count - ptr->snap_count;
+      rec.wall = accum - ptr->snap_accum;
+      strcpy (rec.name, ptr->name);
+      ptr->snap_count = count;
+      ptr->snap_accum = accum;
+      if (snap_push (&rec) != 0)
+	return GPTLerror ("%s: Error in snap_push\n", thisfunc);
+    }
+  }
+  ++snapseq;
+
+#ifdef SNAP_WRITER
+  (void) pthread_mutex_lock (&snap_mutex);
+  (void) pthread_cond_broadcast (&snap_cond);
+  (void) pthread_mutex_unlock (&snap_mutex);
+#else
+  if (snap_write (snaptail, snaphead) != 0)
+    return GPTLerror ("%s: Error in snap_write\n", thisfunc);
+  snaptail = snaphead;
+#endif
+  return 0;
+}
+
+/*
+** snap_open: Allocate the snapshot ring, open the snapshot file, append a
+**   header line that starts this session's records, and (with SNAP_WRITER)
+**   start the writer thread. The header is
+**     # gptl snapshots pid=<pid> t0=<time stamp of GPTLinitialize>
+**   and snapshot numbers restart at 0 after it.
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int snap_open (void)
+{
+  char name[32];            /* default file name */
+  const char *file;         /* file name */
+  char *outpath;            /* outdir/file */
+  char header[96];          /* session header line */
+  int rank;
+  int totlen;
+  int len;
+  static const char *thisfunc = "snap_open";
+
+  if (snapfile) {
+    file = snapfile;
+  } else {
+    if ((rank = get_world_rank ()) >= 0)
+      snprintf (name, sizeof (name), "timing.snapshot.%d", rank);
+    else
+      strcpy (name, "timing.snapshot");
+    file = name;
+  }
+
+  /* 2 is for "/" plus null */
+  if (outdir)
+    totlen = strlen (outdir) + strlen (file) + 2;
+  else
+    totlen = strlen (file) + 2;
+
+  outpath = (char *) GPTLallocate (totlen);
+
+  if (outdir) {
+    strcpy (outpath, outdir);
+    strcat (outpath, "/");
+    strcat (outpath, file);
+  } else {
+    strcpy (outpath, file);
+  }
+
+  snapfd = open (outpath, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  free (outpath);
+  if (snapfd < 0)
+    return GPTLerror ("%s: Cannot open %s\n", thisfunc, file);
+
+  len = snprintf (header, sizeof (header), "# gptl snapshots pid=%ld t0=%.6f\n",
+		  (long) getpid (), snapinit);
+  if (write (snapfd, header, len) != len) {
+    (void) GPTLerror ("%s: write to %s failed\n", thisfunc, file);
+    goto fail;
+  }
+
+  if ( ! (snapring = (Snaprec *) malloc (snapring_size * sizeof (Snaprec)))) {
+    (void) GPTLerror ("%s: malloc failure for %d records\n", thisfunc, snapring_size);
+    goto fail;
+  }
+  snaphead = 0;
+  snaptail = 0;
+  snaplast = snapinit;
+
+#ifdef SNAP_WRITER
+  snapstop = false;
+  if (pthread_create (&snapthread, NULL, snap_writer, NULL) != 0) {
+    (void) GPTLerror ("%s: pthread_create failure\n", thisfunc);
+    goto fail;
+  }
+#endif
+  return 0;
+
+  /* Leave no half-open session behind: the next snapshot starts over */
+ fail:
+  free (snapring);
+  snapring = 0;
+  (void) close (snapfd);
+  snapfd = -1;
+  return -1;
+}
+
+/*
+** snap_push: Copy one record into the snapshot ring. When the ring is full,
+**   wait for the writer thread to make room, or (without it) write out the
+**   ring first.
+**
+** Input arguments:
+**   rec: record to copy
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int snap_push (const Snaprec *rec)
+{
+#ifndef SNAP_WRITER
+  static const char *thisfunc = "snap_push";
+#endif
+
+#ifdef SNAP_WRITER
+  (void) pthread_mutex_lock (&snap_mutex);
+  while (snaphead - snaptail >= snapring_size) {
+    (void) pthread_cond_broadcast (&snap_cond);
+    (void) pthread_cond_wait (&snap_cond, &snap_mutex);
+  }
+  snapring[snaphead % snapring_size] = *rec;
+  ++snaphead;
+  (void) pthread_mutex_unlock (&snap_mutex);
+#else
+  if (snaphead - snaptail >= snapring_size) {
+    if (snap_write (snaptail, snaphead) != 0)
+      return GPTLerror ("%s: Error in snap_write\n", thisfunc);
+    snaptail = snaphead;
+  }
+  snapring[snaphead % snapring_size] = *rec;
+  ++snaphead;
+#endif
+  return 0;
+}
+
+/*
+** snap_write: Format ring records [from, to) and append them to the
+**   snapshot file with one write(). Each snapshot is a line
+**     # snapshot <seq> "<tag>" t=<time stamp> dt=<seconds since previous>
+**   (since GPTLinitialize for the first) followed by one line per changed
+**   timer:
+**     <seq> <thread> <calls> <wallclock> <name>
+**
+** Input arguments:
+**   from, to: range of records (the ring slots are not reused meanwhile)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int snap_write (const long from, const long to)
+{
+  const Snaprec *rec;       /* record being formatted */
+  char *buf;                /* formatted records */
+  size_t len = 0;           /* bytes in buf */
+  ssize_t nw;               /* bytes written by write() */
+  size_t done;              /* bytes written so far */
+  long n;
+  static const char *thisfunc = "snap_write";
+
+  if (to <= from)
+    return 0;
+
+  /* A line is at most a name or tag plus 2 ints, an unsigned long and 2 doubles */
+
+  buf = (char *) GPTLallocate ((to - from) * (MAX_CHARS + 128));
+  for (n = from; n < to; ++n) {
+    rec = &snapring[n % snapring_size];
+    if (rec->thread < 0) {
+      len += sprintf (buf + len, "# snapshot %d \"%s\" t=%.6f dt=%.6f\n",
+		      rec->seq, rec->name, rec->wall, rec->wall - snaplast);
+      snaplast = rec->wall;
+    } else {
+      len += sprintf (buf + len, "%d %d %lu %.6e %s\n",
+		      rec->seq, rec->thread, rec->count, rec->wall, rec->name);
+    }
+  }
+
+  for (done = 0; done < len; done += nw)
+    if ((nw = write (snapfd, buf + done, len - done)) <= 0) {
+      free (buf);
+      return GPTLerror ("%s: write to snapshot file failed\n", thisfunc);
+    }
+
+  free (buf);
+  return 0;
+}
+
+#ifdef SNAP_WRITER
+/*
+** snap_writer: Writer thread. Waits for records in the ring, writes them
+**   without holding the lock, then frees their slots. Exits once told to
+**   stop and the ring is empty.
+*/
+
+static void *snap_writer (void *arg)
+{
+  long head;                /* records available when the lock was dropped */
+
+  (void) pthread_mutex_lock (&snap_mutex);
+  for (;;) {
+    while (snaphead == snaptail && ! snapstop)
+      (void) pthread_cond_wait (&snap_cond, &snap_mutex);
+    if (snaphead == snaptail)
+      break;
+    head = snaphead;
+    (void) pthread_mutex_unlock (&snap_mutex);
+    (void) snap_write (snaptail, head);
+    (void) pthread_mutex_lock (&snap_mutex);
+    snaptail = head;
+    (void) pthread_cond_broadcast (&snap_cond);
+  }
+  (void) pthread_mutex_unlock (&snap_mutex);
+  return 0;
+}
+#endif
+
+/*
+** snap_close: Write any snapshot records still in the ring, stop the
+**   writer thread and close the snapshot file
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int snap_close (void)
+{
+  int ret = 0;
+  static const char *thisfunc = "snap_close";
+
+  if (snapring) {
+#ifdef SNAP_WRITER
+    (void) pthread_mutex_lock (&snap_mutex);
+    snapstop = true;
+    (void) pthread_cond_broadcast (&snap_cond);
+    (void) pthread_mutex_unlock (&snap_mutex);
+    if (pthread_join (snapthread, NULL) != 0)
+      ret = GPTLerror ("%s: pthread_join failure\n", thisfunc);
+#else
+    ret = snap_write (snaptail, snaphead);
+#endif
+    free (snapring);
+    snapring = 0;
+  }
+  if (snapfd >= 0 && close (snapfd) != 0)
+    ret = GPTLerror ("%s: close of snapshot file failed\n", thisfunc);
+
+  snapfd = -1;
+  free (snapfile);
+  snapfile = 0;
+  snaphead = 0;
+  snaptail = 0;
+  snapseq = 0;
+  return ret;
+}
+
+/*
+** GPTLprint_mode_set: set output mode to use for
+** GPTLpr_file and GPTLpr_summary_file
+*/
+
+int GPTLprint_mode_set (int pr_mode)
+{
+  print_mode = (PRMode) pr_mode;
+  return 0;
+}
+
+/*
+** GPTLprint_mode_query: query output mode used
+** for GPTLpr_file and GPTLpr_summary_file
+*/
+
+int GPTLprint_mode_query (void)
+{
+  return (int) print_mode;
+}
+
+/*
+** GPTLpr: Print values of all timers
+**
+** Input arguments:
+**   id: integer to append to string "timing."
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLpr (const int id)   /* output file will be named "timing.<id>" */
+{
+  char outfile[14];         /* name of output file: timing.xxxxxx */
+  static const char *thisfunc = "GPTLpr";
+
+  if (id < 0 || id > 999999)
+    return GPTLerror ("%s: bad id=%d for output file. Must be >= 0 and < 1000000\n", thisfunc, id);
+
+  sprintf (outfile, "timing.%d", id);
+
+  if (GPTLpr_file (outfile) != 0)
+    return GPTLerror ("%s: Error in GPTLpr_file\n", thisfunc);
+
+  return 0;
+}
+
+/*
+** GPTLpr_file: Print values of all timers. If GPTLdopr_binary is set, also
+**   write them to <outfile>.gptb (see gptl_binary.h).
+**
+** Input arguments:
+**   outfile: Name of output file to write
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLpr_file (const char *outfile) /* output file to write */
+{
+  FILE *fp;                 /* file handle to write to */
+  char *outpath;            /* path to output file: outdir/timing.xxxxxx */
+  int totlen;               /* length for malloc */
+  int ret;                  /* return from pr_report */
+
+  static const char *thisfunc = "GPTLpr_file";
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize() has not been called\n", thisfunc);
+
+  /* 2 is for "/" plus null */
+  if (outdir)
+    totlen = strlen (outdir) + strlen (outfile) + 2;
+  else
+    totlen = strlen (outfile) + 2;
+
+  outpath = (char *) GPTLallocate (totlen);
+
+  if (outdir) {
+     strcpy (outpath, outdir);
+     strcat (outpath, "/");
+     strcat (outpath, outfile);
+  } else {
+     strcpy (outpath, outfile);
+  }
+
+  if (print_mode == GPTLprint_append){
+    if ( ! (fp = fopen (outpath, "a")))
+      fp = stderr;
+  }
+  else{
+    if ( ! (fp = fopen (outpath, "w")))
+      fp = stderr;
+  }
+
+  ret = pr_report (fp);
+
+  if (fclose (fp) != 0)
+    fprintf (stderr, "Attempt to close %s failed\n", outfile);
+
+  if (ret == 0 && dopr_binary)
+    ret = pr_binary (outpath);
+
+  free (outpath);
+
+  pr_has_been_called = true;
+  return ret;
+}
+
+/*
+** GPTLpr_file_mpiio: Write every rank's GPTLpr_file report into one shared
+**   file with a single collective write, instead of ranks taking turns.
+**   Each rank formats its report in memory. Offsets come from an exclusive
+**   prefix sum of the report lengths, and rank 0 writes an index of
+**   (rank, offset, length) in front of the reports. MPI counts are ints,
+**   so the write is issued in pieces of at most MPIIO_PIECE bytes; every
+**   rank makes as many collective calls as the rank with the most pieces.
+**   As with GPTLpr_file, print_mode decides whether the file is overwritten
+**   or appended to. Must be called by all ranks in comm.
+**
+** Input arguments:
+**   comm:    communicator (0 or MPI_COMM_NULL means MPI_COMM_WORLD)
+**   outfile: name of output file to write
+**   header:  text written before this rank's report
+**   dowrite: whether this rank contributes a report (0 means an empty slice)
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+#define MPIIO_PIECE (1 << 30) /* most bytes per MPI_File_write_at_all */
+
+#ifdef HAVE_MPI
+int GPTLpr_file_mpiio (MPI_Comm comm, const char *outfile, const char *header, const int dowrite)
+#else
+int GPTLpr_file_mpiio (int comm, const char *outfile, const char *header, const int dowrite)
+#endif
 {
-  double tp1 = 0.0;          /* time stamp */
-  Timer *ptr;                /* linked list pointer */
-  int t;                     /* thread number for this process */
-  int c;                      /* character index */
-  unsigned int indx;         /* index into hash table */
-  long usr = 0;              /* user time (returned from get_cpustamp) */
-  long sys = 0;              /* system time (returned from get_cpustamp) */
-  int numchars;              /* number of characters to copy */
-  char strname[MAX_CHARS+1]; /* null terminated version of name */
-  double tpa = 0.0;          /* time stamp */
-  double tpb = 0.0;          /* time stamp */
-  static const char *thisfunc = "GPTLstopf_handle";
+  FILE *fp;                 /* in-memory stream holding this rank's report */
+  char *buf = 0;            /* this rank's report */
+  size_t size = 0;          /* length of buf */
+  char *outpath = 0;        /* path to output file: outdir/outfile */
+  int totlen;               /* length for malloc */
+  int failed = 0;           /* 1: this rank could not format or write its report */
+  int ret = 0;
 
-  if (disabled)
-    return 0;
+  static const char *thisfunc = "GPTLpr_file_mpiio";
+
+#ifdef HAVE_MPI
+  int iam = 0, nproc;
+  int r;
+  int piece, npieces;       /* write_at_all calls made so far, and needed */
+  int indexlen;             /* bytes in the index at the top of the file */
+  int linelen;              /* bytes per rank in the index */
+  char title[128];          /* first line of the index */
+  char *index = 0;          /* index followed by rank 0's report (rank 0) */
+  char *wbuf;               /* what this rank writes */
+  long long wlen;           /* bytes this rank writes */
+  long long nbytes;         /* bytes in the current piece */
+  MPI_Offset woff;          /* where this rank writes */
+  long long mylen;          /* length of this rank's report */
+  long long myoff = 0;      /* exclusive prefix sum of report lengths */
+  long long *lens = 0;      /* all report lengths (rank 0) */
+  long long off;            /* running offset while building the index */
+  MPI_Offset base = 0;      /* where the index starts in the file */
+  MPI_File fh;
+  bool fh_open = false;     /* fh needs closing */
+  MPI_Status status;
+#else
+  FILE *fpout;
+#endif
 
   if ( ! initialized)
-    return 0;
+    return GPTLerror ("%s: GPTLinitialize() has not been called\n", thisfunc);
 
-  if ((t = get_thread_num ()) < 0)
-    return GPTLerror ("%s: bad return from get_thread_num\n", thisfunc);
+  /* 2 is for "/" plus null */
+  if (outdir)
+    totlen = strlen (outdir) + strlen (outfile) + 2;
+  else
+    totlen = strlen (outfile) + 2;
+
+  if ( ! (outpath = (char *) GPTLallocate (totlen)))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+
+  if (outdir) {
+    strcpy (outpath, outdir);
+    strcat (outpath, "/");
+    strcat (outpath, outfile);
+  } else {
+    strcpy (outpath, outfile);
+  }
 
   /*
-  ** If prefix string is defined, then call GPTLstopf and
-  ** return a handle of 0. Otherwise a change in the prefix
-  ** might be ignored if the handle has already been set.
+  ** Format this rank's report in memory. A rank that fails here still takes
+  ** part in every collective below, with an empty slice.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
-    *handle = 0;
-    return GPTLstopf (name, namelen);
+  if (dowrite) {
+#ifndef NO_OPEN_MEMSTREAM
+    if ( ! (fp = open_memstream (&buf, &size))) {
+      (void) GPTLerror ("%s: open_memstream failed\n", thisfunc);
+      failed = 1;
+    }
+#else
+    if ( ! (fp = tmpfile ())) {
+      (void) GPTLerror ("%s: tmpfile failed\n", thisfunc);
+      failed = 1;
+    }
+#endif
+    if ( ! failed) {
+      fputs (header, fp);
+      if (pr_report (fp) != 0) {
+	(void) GPTLerror ("%s: Error in pr_report\n", thisfunc);
+	failed = 1;
+      }
+#ifndef NO_OPEN_MEMSTREAM
+      (void) fclose (fp);
+#else
+      size = ftell (fp);
+      rewind (fp);
+      if ( ! (buf = (char *) GPTLallocate (size + 1)) || fread (buf, 1, size, fp) != size) {
+	(void) GPTLerror ("%s: reading back tmpfile failed\n", thisfunc);
+	failed = 1;
+      }
+      (void) fclose (fp);
+#endif
+    }
+    if (failed) {
+      free (buf);
+      buf = 0;
+      size = 0;
+    }
   }
+  pr_has_been_called = true;
 
-  /* Get the timestamp */
+#ifdef HAVE_MPI
+  comm = comm_or_world (comm);
 
-  if (wallstats.enabled) {
-    tp1 = (*ptr2wtimefunc) ();
+  if ((ret = MPI_Comm_rank (comm, &iam)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s: Bad return from MPI_Comm_rank=%d\n", thisfunc, ret);
+    goto cleanup;
+  }
+  if ((ret = MPI_Comm_size (comm, &nproc)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s: Bad return from MPI_Comm_size=%d\n", thisfunc, ret);
+    goto cleanup;
   }
 
-  if (cpustats.enabled && get_cpustamp (&usr, &sys) < 0)
-    return GPTLerror (0);
+  /* Every rank can size the index: its lines are fixed width */
 
-  /*
-  ** If current depth exceeds a user-specified limit for print, just
-  ** decrement and return
-  */
+  snprintf (title, sizeof (title), "GPTL timing output for %d MPI tasks. Byte offsets of each task's report:\n"
+	    "%8s %20s %20s\n", nproc, "task", "offset", "length");
+  linelen = 8 + 1 + 20 + 1 + 20 + 1;
+  indexlen = strlen (title) + nproc * linelen + 1;
 
-  if (stackidx[t].val > depthlimit) {
-    --stackidx[t].val;
-    return 0;
+  mylen = (long long) size;
+  if ((ret = MPI_Exscan (&mylen, &myoff, 1, MPI_LONG_LONG, MPI_SUM, comm)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s rank %d: Bad return from MPI_Exscan=%d\n", thisfunc, iam, ret);
+    goto cleanup;
   }
-
-  if (wallstats.enabled && profileovhd.enabled){
-    if (t == 0){
-      /* dummy clock call, to capture earlier tp1 call */
-      tpa = (*ptr2wtimefunc) ();
-    }
+  if (iam == 0) {
+    myoff = 0;
+    lens = (long long *) GPTLallocate (nproc * sizeof (long long));
+  }
+  if ((ret = MPI_Gather (&mylen, 1, MPI_LONG_LONG, lens, 1, MPI_LONG_LONG, 0, comm)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s rank %d: Bad return from MPI_Gather=%d\n", thisfunc, iam, ret);
+    goto cleanup;
   }
 
-  /*
-  ** If on input, handle references a non-zero value, assume it's a previously returned Timer*
-  ** passed in by the user. If zero, generate the hash entry and return it to the user.
-  */
+  if ((ret = MPI_File_open (comm, outpath, MPI_MODE_WRONLY | MPI_MODE_CREATE,
+			    MPI_INFO_NULL, &fh)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s rank %d: Cannot open %s: MPI_File_open=%d\n", thisfunc, iam, outpath, ret);
+    goto cleanup;
+  }
+  fh_open = true;
 
-  if (*handle) {
-    ptr = (Timer *) *handle;
-  } else {
-    if ( ! (ptr = getentryf (hashtable[t], name, namelen, &indx))){
-      numchars = MIN (namelen, MAX_CHARS);
-      //pw      strncpy (strname, name, numchars);
-      for (c = 0; c < numchars; c++) {
-        strname[c] = name[c];
-      }
-      strname[numchars] = '\0';
-      return GPTLerror ("%s thread %d: timer for %s had not been started.\n", thisfunc, t, strname);
+  if (print_mode == GPTLprint_append) {
+    if (iam == 0)
+      (void) MPI_File_get_size (fh, &base);
+    if ((ret = MPI_Bcast (&base, 1, MPI_OFFSET, 0, comm)) != MPI_SUCCESS) {
+      ret = GPTLerror ("%s rank %d: Bad return from MPI_Bcast=%d\n", thisfunc, iam, ret);
+      goto cleanup;
     }
+  } else if ((ret = MPI_File_set_size (fh, 0)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s rank %d: Bad return from MPI_File_set_size=%d\n", thisfunc, iam, ret);
+    goto cleanup;
   }
 
-  if ( ! ptr->onflg )
-    return GPTLerror ("%s: timer %s was already off.\n", thisfunc, ptr->name);
+  /* Rank 0 writes the index followed by its own report */
 
-  ++ptr->count;
+  if (iam == 0) {
+    index = (char *) GPTLallocate (indexlen + size + 1);
+    strcpy (index, title);
+    off = base + indexlen;
+    for (r = 0; r < nproc; ++r) {
+      sprintf (index + strlen (index), "%8d %20lld %20lld\n", r, lens[r] ? off : -1LL, lens[r]);
+      off += lens[r];
+    }
+    strcat (index, "\n");
+    if (size > 0)
+      memcpy (index + indexlen, buf, size);
+    wbuf = index;
+    wlen = indexlen + (long long) size;
+    woff = base;
+  } else {
+    wbuf = buf;
+    wlen = (long long) size;
+    woff = base + indexlen + myoff;
+  }
 
-  /*
-  ** Recursion => decrement depth in recursion and return.  We need to return
-  ** because we don't want to stop the timer.  We want the reported time for
-  ** the timer to reflect the outermost layer of recursion.
-  */
+  npieces = (int) ((wlen + MPIIO_PIECE - 1) / MPIIO_PIECE);
+  if ((ret = MPI_Allreduce (MPI_IN_PLACE, &npieces, 1, MPI_INT, MPI_MAX, comm)) != MPI_SUCCESS) {
+    ret = GPTLerror ("%s rank %d: Bad return from MPI_Allreduce=%d\n", thisfunc, iam, ret);
+    goto cleanup;
+  }
 
-  if (ptr->recurselvl > 0) {
-    ++ptr->nrecurse;
-    --ptr->recurselvl;
+  /* After a failed piece this rank writes nothing more, but keeps calling */
 
-    if (wallstats.enabled && profileovhd.enabled){
-      if (t == 0){
-        /* second caliper timestamp */
-        tpb = (*ptr2wtimefunc) ();
-        /* subtract out additional overhead from caliper timing calls */
-        overhead_est += ((tpb - tp1) - overhead_utr);
-        /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
-        overhead_bound += ((tpb - tp1) + 2*overhead_utr);
-      }
+  for (piece = 0; piece < npieces; ++piece) {
+    nbytes = MIN (wlen, (long long) MPIIO_PIECE);
+    if ((ret = MPI_File_write_at_all (fh, woff, wbuf, (int) nbytes, MPI_CHAR, &status)) != MPI_SUCCESS) {
+      (void) GPTLerror ("%s rank %d: Bad return from MPI_File_write_at_all=%d\n", thisfunc, iam, ret);
+      failed = 1;
+      nbytes = wlen;
     }
+    wbuf += nbytes;
+    wlen -= nbytes;
+    woff += nbytes;
+  }
 
-    return 0;
+  fh_open = false;
+  if ((ret = MPI_File_close (&fh)) != MPI_SUCCESS) {
+    (void) GPTLerror ("%s rank %d: Bad return from MPI_File_close=%d\n", thisfunc, iam, ret);
+    failed = 1;
   }
 
-  if (update_stats (ptr, tp1, usr, sys, t) != 0)
-    return GPTLerror ("%s: error from update_stats\n", thisfunc);
+  /* All ranks return an error if any rank failed */
 
-  /*
-  ** If on input, *handle was 0, return the pointer to the timer for future input
-  */
+  ret = 0;
+  if (MPI_Allreduce (MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm) != MPI_SUCCESS || failed)
+    ret = GPTLerror ("%s rank %d: the report of at least one task was not written\n", thisfunc, iam);
 
-  if ( ! *handle)
-    *handle = (void *) ptr;
+ cleanup:
+  if (fh_open)
+    (void) MPI_File_close (&fh);
+  free (lens);
+  free (index);
+#else
+  /* Without MPI there is just the one report */
 
-  if (wallstats.enabled && profileovhd.enabled){
-    if (t == 0){
-      /* second caliper timestamp */
-      tpb = (*ptr2wtimefunc) ();
-      /* subtract out additional overhead from caliper timing calls */
-      overhead_est += ((tpb - tp1) - overhead_utr);
-      /* add in additional overhead due to caliper timing calls (probaby 2X what necessary) */
-      overhead_bound += ((tpb - tp1) + 2*overhead_utr);
+  if ( ! failed) {
+    if ( ! (fpout = fopen (outpath, (print_mode == GPTLprint_append) ? "a" : "w"))) {
+      ret = GPTLerror ("%s: Cannot open %s\n", thisfunc, outpath);
+    } else {
+      if (size > 0 && fwrite (buf, 1, size, fpout) != size)
+	fprintf (stderr, "%s: short write to %s\n", thisfunc, outpath);
+      if (fclose (fpout) != 0)
+	fprintf (stderr, "%s: Attempt to close %s failed\n", thisfunc, outpath);
     }
+  } else {
+    ret = -1;
   }
+#endif
 
-  return 0;
+  free (buf);
+  free (outpath);
+  return ret;
 }
 
 /*
-** update_stats: update stats inside ptr. Called by GPTLstop(f), GPTLstop_instr,
-**               GPTLstop(f)_handle
+** pr_binary: Write every thread's timers and parent/child edges as a task
+**   segment of <path>.gptb (see gptl_binary.h)
 **
 ** Input arguments:
-**   ptr: pointer to timer
-**   tp1: input time stapm
-**   usr: user time
-**   sys: system time
-**   t: thread index
+**   path: path of the text output file
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-static inline int update_stats (Timer *ptr,
-				const double tp1,
-				const long usr,
-				const long sys,
-				const int t)
+static int pr_binary (const char *path)
 {
-  double delta;       /* difference */
-  static const char *thisfunc = "update_stats";
-
-  ptr->onflg = false;
-  --stackidx[t].val;
-  if (stackidx[t].val < -1) {
-    stackidx[t].val = -1;
-    return GPTLerror ("%s: tree depth has become negative.\n", thisfunc);
-  }
-
-#ifdef HAVE_PAPI
-  if (dousepapi && GPTL_PAPIstop (t, &ptr->aux) < 0)
-    return GPTLerror ("%s: error from GPTL_PAPIstop\n", thisfunc);
-#endif
-
-  if (wallstats.enabled) {
-    delta = tp1 - ptr->wall.last;
+  Timer *ptr;               /* walk through linked lists */
+  Timer *rows;              /* copy of each timer, in table order */
+  int *thread;              /* thread of each row */
+  int *onflg;               /* onflg of each row */
+  double *cpu = 0;          /* usr and sys time of each row (GPTLcpu) */
+  unsigned long *hists = 0; /* histogram of each row (GPTLhistogram) */
+  Binaddr *addr;            /* rows sorted by address, to resolve parents */
+  Binaddr key;              /* bsearch key */
+  Binaddr *found;           /* bsearch result */
+  int *edges;               /* thread, parent, child, count of each edge */
+  char utr[32];             /* name of underlying timing routine */
+  double utr_overhead;      /* overhead of calling underlying timing routine */
+  char evnames[MAX_AUX][64];/* PAPI event names */
+  Bintable tables[4];
+  int ntables;
+  int nrows = 0;
+  int nedges = 0;
+  int e, n, r, t;
+  char *binpath;
+  int ret;
+  static const char *thisfunc = "pr_binary";
 
-    if (delta < 0.) {
-      fprintf (stderr, "%s: negative delta=%g\n", thisfunc, delta);
-      delta = 0.0;
+  for (t = 0; t < nthreads; ++t)
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+      ++nrows;
+      nedges += ptr->nparent;
     }
 
-    ptr->wall.accum += delta;
-    ptr->wall.latest = delta;
-
-    if (ptr->count == 1) {
-      ptr->wall.max = delta;
+  rows   = (Timer *) GPTLallocate (MAX (nrows, 1) * sizeof (Timer));
+  thread = (int *) GPTLallocate (MAX (nrows, 1) * sizeof (int));
+  onflg  = (int *) GPTLallocate (MAX (nrows, 1) * sizeof (int));
+  addr   = (Binaddr *) GPTLallocate (MAX (nrows, 1) * sizeof (Binaddr));
+  edges  = (int *) GPTLallocate (MAX (nedges, 1) * 4 * sizeof (int));
+  if (cpustats.enabled)
+    cpu = (double *) GPTLallocate (MAX (nrows, 1) * 2 * sizeof (double));
+  if (dohist && ! (hists = (unsigned long *) calloc (MAX (nrows, 1) * HIST_NBINS, sizeof (unsigned long))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
 
-      ptr->wall.prev_min = FLT_MAX;
-      ptr->wall.min = delta;
-      ptr->wall.latest_is_min = 1;
-    } else {
-      if (delta > ptr->wall.max)
-	ptr->wall.max = delta;
-      if (delta < ptr->wall.min){
-        ptr->wall.prev_min = ptr->wall.min;
-	ptr->wall.min = delta;
-        ptr->wall.latest_is_min = 1;
-      } else {
-        ptr->wall.latest_is_min = 0;
+  r = 0;
+  for (t = 0; t < nthreads; ++t) {
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+      rows[r] = *ptr;
+      thread[r] = t;
+      onflg[r] = ptr->onflg ? 1 : 0;
+      if (cpu) {
+	cpu[2*r]   = ptr->cpu.accum_utime / (double) ticks_per_sec;
+	cpu[2*r+1] = ptr->cpu.accum_stime / (double) ticks_per_sec;
       }
+      if (hists && ptr->hist)
+	memcpy (hists + r*HIST_NBINS, ptr->hist, HIST_NBINS * sizeof (unsigned long));
+      addr[r].ptr = ptr;
+      addr[r].row = r;
+      ++r;
     }
   }
+  qsort (addr, nrows, sizeof (Binaddr), bin_addrcmp);
 
-  if (cpustats.enabled) {
-    ptr->cpu.accum_utime += usr - ptr->cpu.last_utime;
-    ptr->cpu.accum_stime += sys - ptr->cpu.last_stime;
-    ptr->cpu.last_utime   = usr;
-    ptr->cpu.last_stime   = sys;
-  }
-  return 0;
-}
-
-/*
-** GPTLenable: enable timers
-**
-** Return value: 0 (success)
-*/
+  /* Parents not found are the per-thread roots, i.e. the top level */
 
-int GPTLenable (void)
-{
-  disabled = false;
-  return (0);
-}
+  e = 0;
+  for (r = 0; r < nrows; ++r) {
+    for (n = 0; n < (int) rows[r].nparent; ++n) {
+      key.ptr = rows[r].parent[n];
+      found = (Binaddr *) bsearch (&key, addr, nrows, sizeof (Binaddr), bin_addrcmp);
+      edges[4*e]   = thread[r];
+      edges[4*e+1] = found ? found->row : -1;
+      edges[4*e+2] = r;
+      edges[4*e+3] = rows[r].parent_count[n];
+      ++e;
+    }
+  }
 
-/*
-** GPTLdisable: disable timers
-**
-** Return value: 0 (success)
-*/
+  memset (tables, 0, sizeof (tables));
+  memset (utr, 0, sizeof (utr));
+  strncpy (utr, funclist[funcidx].name, sizeof (utr) - 1);
+  utr_overhead = utr_getoverhead ();
+  tables[0].name = "info";
+  tables[0].nrows = 1;
+  bin_addcol (&tables[0], "utr",          GPTLBIN_STRING,  sizeof (utr), utr, 0);
+  bin_addcol (&tables[0], "utr_overhead", GPTLBIN_FLOAT64, 1, &utr_overhead, 0);
+
+  tables[1].name = "timers";
+  tables[1].nrows = nrows;
+  bin_addcol (&tables[1], "thread",     GPTLBIN_INT32,   1, thread, sizeof (int));
+  bin_addcol (&tables[1], "name",       GPTLBIN_STRING,  MAX_CHARS+1, rows[0].name, sizeof (Timer));
+  bin_addcol (&tables[1], "onflg",      GPTLBIN_INT32,   1, onflg, sizeof (int));
+  bin_addcol (&tables[1], "count",      GPTLBIN_UINT64,  1, &rows[0].count, sizeof (Timer));
+  bin_addcol (&tables[1], "nrecurse",   GPTLBIN_UINT64,  1, &rows[0].nrecurse, sizeof (Timer));
+  bin_addcol (&tables[1], "norphan",    GPTLBIN_INT32,   1, &rows[0].norphan, sizeof (Timer));
+  bin_addcol (&tables[1], "wall_accum", GPTLBIN_FLOAT64, 1, &rows[0].wall.accum, sizeof (Timer));
+  bin_addcol (&tables[1], "wall_max",   GPTLBIN_FLOAT32, 1, &rows[0].wall.max, sizeof (Timer));
+  bin_addcol (&tables[1], "wall_min",   GPTLBIN_FLOAT32, 1, &rows[0].wall.min, sizeof (Timer));
+  if (selftop > 0)
+    bin_addcol (&tables[1], "self_wall",   GPTLBIN_FLOAT64, 1, &rows[0].self_wall, sizeof (Timer));
+  if (domemory) {
+    bin_addcol (&tables[1], "rss_delta",   GPTLBIN_INT64,   1, &rows[0].rss_delta, sizeof (Timer));
+    bin_addcol (&tables[1], "rss_peak",    GPTLBIN_INT64,   1, &rows[0].rss_peak, sizeof (Timer));
+  }
+#ifdef ENABLE_PMPI
+  bin_addcol (&tables[1], "nbytes",     GPTLBIN_FLOAT64, 1, &rows[0].nbytes, sizeof (Timer));
+#endif
+  if (doexclusive) {
+    bin_addcol (&tables[1], "child_wall",  GPTLBIN_FLOAT64, 1, &rows[0].child_wall, sizeof (Timer));
+    bin_addcol (&tables[1], "nchildcalls", GPTLBIN_UINT64,  1, &rows[0].nchildcalls, sizeof (Timer));
+    bin_addcol (&tables[1], "ndesc",       GPTLBIN_UINT64,  1, &rows[0].ndesc, sizeof (Timer));
+  }
+  if (nsampling > 0) {
+    bin_addcol (&tables[1], "sample",   GPTLBIN_INT32,   1, &rows[0].sample, sizeof (Timer));
+    bin_addcol (&tables[1], "nsampled", GPTLBIN_UINT64,  1, &rows[0].samp.n, sizeof (Timer));
+  }
+  if (cpu) {
+    bin_addcol (&tables[1], "usr", GPTLBIN_FLOAT64, 1, cpu,   2 * sizeof (double));
+    bin_addcol (&tables[1], "sys", GPTLBIN_FLOAT64, 1, cpu+1, 2 * sizeof (double));
+  }
+  if (hists)
+    bin_addcol (&tables[1], "hist", GPTLBIN_UINT64, HIST_NBINS, hists, HIST_NBINS * sizeof (unsigned long));
+#ifdef HAVE_PAPI
+  if (nevents > 0)
+    bin_addcol (&tables[1], "papi", GPTLBIN_INT64, nevents, rows[0].aux.accum, sizeof (Timer));
+#endif
 
-int GPTLdisable (void)
-{
-  disabled = true;
-  return (0);
+  tables[2].name = "edges";
+  tables[2].nrows = nedges;
+  bin_addcol (&tables[2], "thread", GPTLBIN_INT32, 1, edges,   4 * sizeof (int));
+  bin_addcol (&tables[2], "parent", GPTLBIN_INT32, 1, edges+1, 4 * sizeof (int));
+  bin_addcol (&tables[2], "child",  GPTLBIN_INT32, 1, edges+2, 4 * sizeof (int));
+  bin_addcol (&tables[2], "count",  GPTLBIN_INT32, 1, edges+3, 4 * sizeof (int));
+  ntables = 3;
+
+  if (nevents > 0) {
+    memset (evnames, 0, sizeof (evnames));
+    for (n = 0; n < nevents; ++n)
+      strncpy (evnames[n], eventlist[n].namestr, sizeof (evnames[n]) - 1);
+    tables[3].name = "events";
+    tables[3].nrows = nevents;
+    bin_addcol (&tables[3], "name", GPTLBIN_STRING, sizeof (evnames[0]), evnames, sizeof (evnames[0]));
+    ntables = 4;
+  }
+
+  binpath = (char *) GPTLallocate (strlen (path) + strlen (GPTLBIN_SUFFIX) + 1);
+  strcpy (binpath, path);
+  strcat (binpath, GPTLBIN_SUFFIX);
+  ret = bin_write (binpath, GPTLBIN_TASK, nthreads, ntables, tables,
+		   print_mode == GPTLprint_append);
+
+  free (binpath);
+  free (rows);
+  free (thread);
+  free (onflg);
+  free (addr);
+  free (edges);
+  free (cpu);
+  free (hists);
+
+  if (ret != 0)
+    return GPTLerror ("%s: Error in bin_write\n", thisfunc);
+  return 0;
 }
 
 /*
-** GPTLstamp: Compute timestamp of usr, sys, and wallclock time (seconds)
+** bin_addcol: Append a column to a binary output table
 **
+** Input arguments:
+**   name:   column name
+**   type:   GPTLBIN_ type code
+**   width:  values per row
+**   data:   first value of the first row
+**   stride: bytes between rows in memory
 ** Output arguments:
-**   wall: wallclock
-**   usr:  user time
-**   sys:  system time
-**
-** Return value: 0 (success) or GPTLerror (failure)
+**   table: table to add the column to
 */
 
-int GPTLstamp (double *wall, double *usr, double *sys)
+static void bin_addcol (Bintable *table, const char *name, const int type,
+			const int width, const void *data, const size_t stride)
 {
-  struct tms buf;            /* argument to times */
-
-  if ( ! initialized)
-    return GPTLerror ("GPTLstamp: GPTLinitialize has not been called\n");
-
-#ifdef HAVE_TIMES
-  *usr = 0;
-  *sys = 0;
-
-  if (times (&buf) == -1)
-    return GPTLerror ("GPTLstamp: times() failed. Results bogus\n");
-
-  *usr = buf.tms_utime / (double) ticks_per_sec;
-  *sys = buf.tms_stime / (double) ticks_per_sec;
-#endif
-  *wall = (*ptr2wtimefunc) ();
-  return 0;
+  Bincol *col;
+
+  assert (table->ncols < MAX_BINCOLS);
+  col = &table->cols[table->ncols++];
+  col->name   = name;
+  col->type   = type;
+  col->width  = width;
+  col->data   = data;
+  col->stride = stride;
+  col->indirect = false;
 }
 
 /*
-** GPTLreset: reset all timers to 0
+** bin_write: Write (or append) one segment of a binary output file. The
+**   layout is described in gptl_binary.h.
+**
+** Input arguments:
+**   path:    file to write
+**   kind:    GPTLBIN_TASK, GPTLBIN_SUMMARY or GPTLBIN_TRACE
+**   nthr:    number of threads
+**   ntables: number of tables
+**   tables:  the tables
+**   append:  append to path rather than overwrite it
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-int GPTLreset (void)
+static int bin_write (const char *path, const int kind, const int nthr,
+		      const int ntables, const Bintable *tables, const bool append)
 {
-  int t;             /* index over threads */
-  Timer *ptr;        /* linked list index */
-  static const char *thisfunc = "GPTLreset";
+  FILE *fp;
+  GPTLbin_header header;
+  GPTLbin_table tdesc;
+  GPTLbin_column cdesc;
+  const Bincol *col;
+  const char *src;              /* current row of the column being written */
+  const char *str;              /* string of an indirect column */
+  size_t len;                   /* bytes of str written */
+  static const char zeros[8] = {0};
+  unsigned long long val;
+  long long offset;             /* running offset from the segment start */
+  size_t size;                  /* bytes per stored value */
+  size_t nbytes;                /* bytes in a column */
+  long long r;
+  int c, i, w;
+  bool ok = true;
+  static const char *thisfunc = "bin_write";
+
+  if ( ! (fp = fopen (path, append ? "ab" : "wb")))
+    return GPTLerror ("%s: Cannot open %s\n", thisfunc, path);
+
+  /* The column data starts after the header and the table directory */
+
+  offset = sizeof (GPTLbin_header);
+  for (i = 0; i < ntables; ++i)
+    offset += sizeof (GPTLbin_table) + tables[i].ncols * sizeof (GPTLbin_column);
+
+  memset (&header, 0, sizeof (header));
+  strcpy (header.magic, GPTLBIN_MAGIC);
+  header.version   = GPTLBIN_VERSION;
+  header.byteorder = GPTLBIN_BYTEORDER;
+  header.kind      = kind;
+  header.rank      = get_world_rank ();
+  header.nthreads  = nthr;
+  header.ntables   = ntables;
+  header.size      = offset;
+  for (i = 0; i < ntables; ++i)
+    for (c = 0; c < tables[i].ncols; ++c) {
+      col = &tables[i].cols[c];
+      size = bin_typesize (col->type);
+      header.size += (tables[i].nrows * col->width * size + 7) & ~7LL;
+    }
+  ok = fwrite (&header, sizeof (header), 1, fp) == 1;
+
+  /* Table directory */
+
+  for (i = 0; i < ntables && ok; ++i) {
+    memset (&tdesc, 0, sizeof (tdesc));
+    strncpy (tdesc.name, tables[i].name, sizeof (tdesc.name) - 1);
+    tdesc.nrows = tables[i].nrows;
+    tdesc.ncols = tables[i].ncols;
+    ok = fwrite (&tdesc, sizeof (tdesc), 1, fp) == 1;
+    for (c = 0; c < tables[i].ncols && ok; ++c) {
+      col = &tables[i].cols[c];
+      size = bin_typesize (col->type);
+      memset (&cdesc, 0, sizeof (cdesc));
+      strncpy (cdesc.name, col->name, sizeof (cdesc.name) - 1);
+      cdesc.type   = col->type;
+      cdesc.width  = col->width;
+      cdesc.offset = offset;
+      ok = fwrite (&cdesc, sizeof (cdesc), 1, fp) == 1;
+      offset += (tables[i].nrows * col->width * size + 7) & ~7LL;
+    }
+  }
 
-  if ( ! initialized)
-    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+  /* Column data. Only unsigned long needs converting to its stored size */
 
-  for (t = 0; t < nthreads; t++) {
-    for (ptr = timers[t]; ptr; ptr = ptr->next) {
-      ptr->onflg = false;
-      ptr->count = 0;
-      memset (&ptr->wall, 0, sizeof (ptr->wall));
-      memset (&ptr->cpu, 0, sizeof (ptr->cpu));
-#ifdef HAVE_PAPI
-      memset (&ptr->aux, 0, sizeof (ptr->aux));
-#endif
+  for (i = 0; i < ntables && ok; ++i) {
+    for (c = 0; c < tables[i].ncols && ok; ++c) {
+      col = &tables[i].cols[c];
+      size = bin_typesize (col->type);
+      nbytes = tables[i].nrows * col->width * size;
+      src = (const char *) col->data;
+      for (r = 0; r < tables[i].nrows && ok; ++r, src += col->stride) {
+	if (col->type == GPTLBIN_UINT64) {
+	  for (w = 0; w < col->width && ok; ++w) {
+	    val = ((const unsigned long *) src)[w];
+	    ok = fwrite (&val, sizeof (val), 1, fp) == 1;
+	  }
+	} else if (col->indirect) {
+	  str = *(const char * const *) src;
+	  len = MIN (strlen (str), (size_t) col->width);
+	  ok = fwrite (str, 1, len, fp) == len;
+	  for (w = len; w < col->width && ok; ++w)
+	    ok = fputc ('\0', fp) != EOF;
+	} else {
+	  ok = fwrite (src, size, col->width, fp) == (size_t) col->width;
+	}
+      }
+      if (ok && (nbytes & 7))
+	ok = fwrite (zeros, 1, 8 - (nbytes & 7), fp) == 8 - (nbytes & 7);
     }
   }
 
-  if (verbose)
-    printf ("%s: accumulators for all timers set to zero\n", thisfunc);
-
+  if (fclose (fp) != 0)
+    ok = false;
+  if ( ! ok)
+    return GPTLerror ("%s: Error writing %s\n", thisfunc, path);
   return 0;
 }
 
 /*
-** GPTLprint_mode_set: set output mode to use for
-** GPTLpr_file and GPTLpr_summary_file
+** bin_typesize: Stored size in bytes of one value of a GPTLBIN_ type
 */
 
-int GPTLprint_mode_set (int pr_mode)
+static size_t bin_typesize (const int type)
 {
-  print_mode = (PRMode) pr_mode;
-  return 0;
+  switch (type) {
+  case GPTLBIN_STRING:
+    return 1;
+  case GPTLBIN_INT32:
+  case GPTLBIN_FLOAT32:
+    return 4;
+  default:
+    return 8;
+  }
 }
 
 /*
-** GPTLprint_mode_query: query output mode used
-** for GPTLpr_file and GPTLpr_summary_file
+** get_world_rank: MPI rank in MPI_COMM_WORLD, if MPI is running
+**
+** Return value: rank, or -1 if not built with MPI or MPI is not running
 */
 
-int GPTLprint_mode_query (void)
+static int get_world_rank (void)
 {
-  return (int) print_mode;
+  int rank = -1;
+#ifdef HAVE_MPI
+  int flag, done;
+
+  if (MPI_Initialized (&flag) == MPI_SUCCESS && flag &&
+      MPI_Finalized (&done) == MPI_SUCCESS && ! done)
+    (void) MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+#endif
+  return rank;
 }
 
+#ifdef HAVE_MPI
 /*
-** GPTLpr: Print values of all timers
+** comm_or_world: the communicator to use for a comm argument documented as
+**   "0 means MPI_COMM_WORLD". Whether MPI_Comm is an int or a pointer
+**   depends on the MPI library, so compare rather than cast.
 **
 ** Input arguments:
-**   id: integer to append to string "timing."
+**   comm: communicator passed by the caller
 **
-** Return value: 0 (success) or GPTLerror (failure)
+** Return value: MPI_COMM_WORLD if comm is 0 or MPI_COMM_NULL, else comm
 */
 
-int GPTLpr (const int id)   /* output file will be named "timing.<id>" */
+static MPI_Comm comm_or_world (MPI_Comm comm)
 {
-  char outfile[14];         /* name of output file: timing.xxxxxx */
-  static const char *thisfunc = "GPTLpr";
-
-  if (id < 0 || id > 999999)
-    return GPTLerror ("%s: bad id=%d for output file. Must be >= 0 and < 1000000\n", thisfunc, id);
-
-  sprintf (outfile, "timing.%d", id);
+  if (comm == (MPI_Comm) 0 || comm == MPI_COMM_NULL)
+    return MPI_COMM_WORLD;
+  return comm;
+}
+#endif
 
-  if (GPTLpr_file (outfile) != 0)
-    return GPTLerror ("%s: Error in GPTLpr_file\n", thisfunc);
+/*
+** bin_addrcmp: Order Binaddr entries by timer address, for qsort and bsearch
+*/
 
-  return 0;
+static int bin_addrcmp (const void *pa, const void *pb)
+{
+  const Timer *x = ((const Binaddr *) pa)->ptr;
+  const Timer *y = ((const Binaddr *) pb)->ptr;
+  return (x > y) - (x < y);
 }
 
 /*
-** GPTLpr_file: Print values of all timers
+** pr_report: Print values of all timers: the body of GPTLpr_file
 **
 ** Input arguments:
-**   outfile: Name of output file to write
+**   fp: open stream to write the report to
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-int GPTLpr_file (const char *outfile) /* output file to write */
+static int pr_report (FILE *fp)
 {
-  FILE *fp;                 /* file handle to write to */
   Timer *ptr;               /* walk through master thread linked list */
   Timer *tptr;              /* walk through slave threads linked lists */
   Timer sumstats;           /* sum of same timer stats over threads */
-  int i, ii, n, t;          /* indices */
-  int totent;               /* per-thread collision count (diagnostic) */
-  int nument;               /* per-index collision count (diagnostic) */
-  int totlen;               /* length for malloc */
+  unsigned long sumhist[HIST_NBINS]; /* sum of histograms over threads */
+  int i, n, t;              /* indices */
+  int totent;               /* per-thread extra probe count (diagnostic) */
+  int nument;               /* per-entry probe distance (diagnostic) */
   unsigned long totcount;   /* total timer invocations */
-  char *outpath;            /* path to output file: outdir/timing.xxxxxx */
   float *sum;               /* sum of overhead values (per thread) */
   float osum;               /* sum of overhead over threads */
   double utr_overhead;      /* overhead of calling underlying timing routine */
@@ -2505,50 +5351,26 @@ int GPTLpr_file (const char *outfile) /* output file to write */
   /*
   ** Diagnostics for collisions and GPTL memory usage
   */
-  int num_zero;             /* number of buckets with 0 collisions */
-  int num_one;              /* number of buckets with 1 collision */
-  int num_two;              /* number of buckets with 2 collisions */
-  int num_more;             /* number of buckets with more than 2 collisions */
-  int most;                 /* biggest collision count */
+  int num_zero;             /* number of entries in their home slot */
+  int num_one;              /* number of entries 1 slot from home */
+  int num_two;              /* number of entries 2 slots from home */
+  int num_more;             /* number of entries more than 2 slots from home */
+  int most;                 /* biggest probe distance */
   int numtimers = 0;        /* number of timers */
   float hashmem;            /* hash table memory usage */
+  float edgemem;            /* edge table memory usage */
   float regionmem;          /* timer memory usage */
   float papimem;            /* PAPI stats memory usage */
   float pchmem;             /* parent/child array memory usage */
   float gptlmem;            /* total per-thread GPTL memory usage estimate */
   float totmem;             /* sum of gptlmem across threads */
 
-  static const char *thisfunc = "GPTLpr_file";
-
-  if ( ! initialized)
-    return GPTLerror ("%s: GPTLinitialize() has not been called\n", thisfunc);
-
-  /* 2 is for "/" plus null */
-  if (outdir)
-    totlen = strlen (outdir) + strlen (outfile) + 2;
-  else
-    totlen = strlen (outfile) + 2;
-
-  outpath = (char *) GPTLallocate (totlen);
-
-  if (outdir) {
-     strcpy (outpath, outdir);
-     strcat (outpath, "/");
-     strcat (outpath, outfile);
-  } else {
-     strcpy (outpath, outfile);
-  }
-
-  if (print_mode == GPTLprint_append){
-    if ( ! (fp = fopen (outpath, "a")))
-      fp = stderr;
-  }
-  else{
-    if ( ! (fp = fopen (outpath, "w")))
-      fp = stderr;
-  }
+  /* Write out the event traces first, so the file has everything up to now */
 
-  free (outpath);
+  if (tracecap > 0)
+    for (t = 0; t < nthreads; ++t)
+      if (trace_flush (t) != 0)
+	fprintf (stderr, "pr_report: error writing trace of thread %d\n", t);
 
   fprintf (fp, "$Id: gptl.c,v 1.157 2011-03-28 20:55:18 rosinski Exp $\n");
 
@@ -2558,7 +5380,9 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 
 #ifdef HAVE_NANOTIME
   if (funclist[funcidx].option == GPTLnanotime) {
-    fprintf (fp, "Clock rate = %f MHz\n", cpumhz);
+    fprintf (fp, "Clock rate = %f MHz (%s)\n", cpumhz,
+	     tsc_calibrated ? "calibrated against CLOCK_MONOTONIC" : "from /proc/cpuinfo");
+    fprintf (fp, "  TSC invariant=%s\n", tsc_is_invariant () ? "true" : "false");
 #ifdef BIT64
     fprintf (fp, "  BIT64 was true\n");
 #else
@@ -2613,6 +5437,15 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 
   utr_overhead = utr_getoverhead ();
   fprintf (fp, "Underlying timing routine was %s.\n", funclist[funcidx].name);
+  if (autoutr) {
+    fprintf (fp, "  Chosen automatically. Effective cost per call (max of overhead, resolution):\n");
+    for (i = 0; i < nfuncentries; i++) {
+      if (utr_cost[i] >= 0.)
+	fprintf (fp, "    %-28s %g sec.\n", funclist[i].name, utr_cost[i]);
+      else
+	fprintf (fp, "    %-28s unavailable\n", funclist[i].name);
+    }
+  }
   if (wallstats.enabled && profileovhd.enabled){
     fprintf (fp, "Per-call utr overhead est (at init): %g sec.\n", overhead_utr);
     fprintf (fp, "Per-call utr overhead est (at end): %g sec.\n", utr_overhead);
@@ -2630,6 +5463,21 @@ int GPTLpr_file (const char *outfile) /* output file to write */
   }
 #endif
   tot_overhead = utr_overhead + papi_overhead;
+
+  /*
+  ** Cost of a start/stop pair for the exclusive column: the 2 utr calls, or
+  ** with GPTLprofile_ovhd the cost measured directly on thread 0, which also
+  ** covers the name lookup and bookkeeping
+  */
+
+  pair_overhead = 2 * tot_overhead;
+  if (doexclusive && wallstats.enabled && profileovhd.enabled) {
+    totcount = 0;
+    for (ptr = perthread[0].timers->next; ptr; ptr = ptr->next)
+      totcount += ptr->count;
+    if (totcount > 0)
+      pair_overhead = overhead_est / totcount + 2 * overhead_utr;
+  }
   if (dopr_preamble) {
     fprintf (fp, "If overhead stats are printed, roughly half the estimated number is\n"
 	     "embedded in the wallclock stats for each timer.\n"
@@ -2657,21 +5505,23 @@ int GPTLpr_file (const char *outfile) /* output file to write */
     ** AFTER construct_tree() because it relies on the per-parent children arrays being complete.
     */
 
-    if (construct_tree (timers[t], method) != 0)
+    if (construct_tree (perthread[t].timers, method, &perthread[t].arena, &perthread[t].edges) != 0)
       printf ("GPTLpr_file: failure from construct_tree: output will be incomplete\n");
-    max_depth[t] = get_max_depth (timers[t], 0);
+    perthread[t].max_depth = get_max_depth (perthread[t].timers, 0);
+    if (selftop > 0)
+      compute_self (perthread[t].timers);
 
     if (t > 0)
       fprintf (fp, "\n");
     fprintf (fp, "Stats for thread %d:\n", t);
 
-    for (n = 0; n < max_depth[t]+1; ++n)    /* +1 to always indent timer name */
+    for (n = 0; n < perthread[t].max_depth+1; ++n)    /* +1 to always indent timer name */
       fprintf (fp, "  ");
     if (dopr_quotes){
-      for (n = 0; n < max_name_len[t]+2; ++n) /* longest timer name + quotes */
+      for (n = 0; n < perthread[t].max_name_len+2; ++n) /* longest timer name + quotes */
         fprintf (fp, " ");
     } else {
-      for (n = 0; n < max_name_len[t]; ++n)   /* longest timer name */
+      for (n = 0; n < perthread[t].max_name_len; ++n)   /* longest timer name */
         fprintf (fp, " ");
     }
 
@@ -2683,12 +5533,21 @@ int GPTLpr_file (const char *outfile) /* output file to write */
       fprintf (fp, "%s", cpustats.str);
     if (wallstats.enabled) {
       fprintf (fp, "%s", wallstats.str);
-      if (percent && timers[0]->next)
-	fprintf (fp, "%%_of_%5.5s ", timers[0]->next->name);
+      if (dohist)
+	fprintf (fp, "%s", histstr);
+      if (selftop > 0)
+	fprintf (fp, "%s", selfstr);
+      if (percent && perthread[0].timers->next)
+	fprintf (fp, "%%_of_%5.5s ", perthread[0].timers->next->name);
       if (overheadstats.enabled)
 	fprintf (fp, "%s", overheadstats.str);
+      if (doexclusive)
+	fprintf (fp, "%s", exclstr);
     }
 
+    if (domemory)
+      fprintf (fp, "%s", memstr);
+
 #ifdef ENABLE_PMPI
     fprintf (fp, "AVG_MPI_BYTES ");
 #endif
@@ -2704,7 +5563,7 @@ int GPTLpr_file (const char *outfile) /* output file to write */
     ** avoid printing dummy outermost timer, and initialize the depth.
     */
 
-    printself_andchildren (timers[t], fp, t, -1, tot_overhead);
+    printself_andchildren (perthread[t].timers, fp, t, -1, tot_overhead);
 
     /*
     ** Sum of overhead across timers is meaningful.
@@ -2713,8 +5572,8 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 
     sum[t]     = 0;
     totcount   = 0;
-    for (ptr = timers[t]->next; ptr; ptr = ptr->next) {
-      sum[t]     += ptr->count * 2 * tot_overhead;
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+      sum[t]     += nstamped (ptr) * 2 * tot_overhead;
       totcount   += ptr->count;
     }
     fprintf (fp, "\n");
@@ -2731,15 +5590,23 @@ int GPTLpr_file (const char *outfile) /* output file to write */
       fprintf (fp, "Total calls  = %lu\n", totcount);
     else
       fprintf (fp, "Total calls  = %9.3e\n", (float) totcount);
+    if (tracecap > 0)
+      fprintf (fp, "Trace events = %lu in %s (%lu flushes, %9.3g wallclock seconds)\n",
+	       perthread[t].ntraced, tracepath ? tracepath : "(none)", perthread[t].nflush,
+	       perthread[t].flushtime);
   }
 
+  if (selftop > 0)
+    for (t = 0; t < nthreads; ++t)
+      print_flat_profile (fp, t);
+
   /* Print per-name stats for all threads */
 
   if (dopr_threadsort && nthreads > 1) {
     fprintf (fp, "\nSame stats sorted by timer for threaded regions (for timers active on thread 0):\n");
     fprintf (fp, "Thd ");
 
-    for (n = 0; n < max_name_len[0]; ++n) /* longest timer name */
+    for (n = 0; n < perthread[0].max_name_len; ++n) /* longest timer name */
       fprintf (fp, " ");
 
     fprintf (fp, " On  Called Recurse");
@@ -2748,12 +5615,21 @@ int GPTLpr_file (const char *outfile) /* output file to write */
       fprintf (fp, "%s", cpustats.str);
     if (wallstats.enabled) {
       fprintf (fp, "%s", wallstats.str);
-      if (percent && timers[0]->next)
-	fprintf (fp, "%%_of_%5.5s ", timers[0]->next->name);
+      if (dohist)
+	fprintf (fp, "%s", histstr);
+      if (selftop > 0)
+	fprintf (fp, "%s", selfstr);
+      if (percent && perthread[0].timers->next)
+	fprintf (fp, "%%_of_%5.5s ", perthread[0].timers->next->name);
       if (overheadstats.enabled)
 	fprintf (fp, "%s", overheadstats.str);
+      if (doexclusive)
+	fprintf (fp, "%s", exclstr);
     }
 
+    if (domemory)
+      fprintf (fp, "%s", memstr);
+
 #ifdef HAVE_PAPI
     GPTL_PAPIprstr (fp);
 #endif
@@ -2762,7 +5638,7 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 
     /* Start at next to skip dummy */
 
-    for (ptr = timers[0]->next; ptr; ptr = ptr->next) {
+    for (ptr = perthread[0].timers->next; ptr; ptr = ptr->next) {
 
       /*
       ** To print sum stats, first create a new timer then copy thread 0
@@ -2772,9 +5648,13 @@ int GPTLpr_file (const char *outfile) /* output file to write */
       foundany = false;
       first = true;
       sumstats = *ptr;
+      if (ptr->hist) {
+	memcpy (sumhist, ptr->hist, sizeof (sumhist));
+	sumstats.hist = sumhist;
+      }
       for (t = 1; t < nthreads; ++t) {
 	found = false;
-	for (tptr = timers[t]->next; tptr && ! found; tptr = tptr->next) {
+	for (tptr = perthread[t].timers->next; tptr && ! found; tptr = tptr->next) {
 	  if (STRMATCH (ptr->name, tptr->name)) {
 
 	    /* Only print thread 0 when this timer found for other threads */
@@ -2813,12 +5693,42 @@ int GPTLpr_file (const char *outfile) /* output file to write */
     }
   }
 
+  /* Print the error of the wallclock estimates of sampled timers */
+
+  if (nsampling > 0 && wallstats.enabled) {
+    bool explained = ! dopr_preamble;  /* preamble already printed (or not wanted) */
+    for (t = 0; t < nthreads; ++t) {
+      first = true;
+      for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+	if (ptr->sample < 2)
+	  continue;
+	if (first) {
+	  first = false;
+	  fprintf (fp, "\nSampled timers for thread %d:\n", t);
+	  if ( ! explained)
+	    fprintf (fp, "Only 1 in N calls of these timers read the clocks. Their Called counts\n"
+		     "are exact; Wallclock above is scaled up from the Timed calls, with the\n"
+		     "standard error of that estimate given here.\n");
+	  explained = true;
+	  fprintf (fp, "%-*s %8s %12s %12s %12s %12s\n", perthread[t].max_name_len, "name",
+		   "N", "Called", "Timed", "Wallclock", "Std err");
+	}
+	fprintf (fp, "%-*s %8u %12lu %12lu %12.6f ", perthread[t].max_name_len, ptr->name,
+		 ptr->sample, ptr->count, ptr->samp.n, ptr->wall.accum);
+	if (ptr->samp.n > 1)
+	  fprintf (fp, "%12.6f\n", sample_stderr (ptr));
+	else
+	  fprintf (fp, "%12s\n", "-");
+      }
+    }
+  }
+
   /* Print info about timers with multiple parents */
 
   if (dopr_multparent) {
     for (t = 0; t < nthreads; ++t) {
       bool some_multparents = false;   /* thread has entries with multiple parents? */
-      for (ptr = timers[t]->next; ptr; ptr = ptr->next) {
+      for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
 	if (ptr->nparent > 1) {
 	  some_multparents = true;
 	  break;
@@ -2836,14 +5746,17 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 		   "listed parents.\n\n");
 	}
 
-	for (ptr = timers[t]->next; ptr; ptr = ptr->next)
+	for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next)
 	  if (ptr->nparent > 1)
 	    print_multparentinfo (fp, ptr);
       }
     }
   }
 
-  /* Print hash table stats */
+  /*
+  ** Print hash table stats. A collision is an entry which is not in its home
+  ** slot: nument is how many slots past home it lies (its probe distance)
+  */
 
   if (dopr_collision) {
     for (t = 0; t < nthreads; t++) {
@@ -2854,20 +5767,18 @@ int GPTLpr_file (const char *outfile) /* output file to write */
       num_two  = 0;
       num_more = 0;
       most     = 0;
-      numtimers= 0;
 
-      for (i = 0; i < tablesize; i++) {
-	nument = hashtable[t][i].nument;
-	if (nument > 1) {
-	  totent += nument-1;
+      for (i = 0; i < perthread[t].hashtable.size; i++) {
+	if ( ! (ptr = perthread[t].hashtable.slots[i].entry))
+	  continue;
+	nument = (i - perthread[t].hashtable.slots[i].hash) & (perthread[t].hashtable.size - 1);
+	if (nument > 0) {
+	  totent += nument;
 	  if (first) {
 	    first = false;
 	    fprintf (fp, "\nthread %d had some hash collisions:\n", t);
 	  }
-	  fprintf (fp, "hashtable[%d][%d] had %d entries:", t, i, nument);
-	  for (ii = 0; ii < nument; ii++)
-	    fprintf (fp, " %s", hashtable[t][i].entries[ii]->name);
-	  fprintf (fp, "\n");
+	  fprintf (fp, "hashtable[%d][%d] holds %s, %d slots from its home\n", t, i, ptr->name, nument);
 	}
 	switch (nument) {
 	case 0:
@@ -2884,12 +5795,12 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 	  break;
 	}
 	most = MAX (most, nument);
-	numtimers += nument;
       }
 
       if (totent > 0) {
-	fprintf (fp, "Total collisions thread %d = %d\n", t, totent);
-	fprintf (fp, "Entry information:\n");
+	fprintf (fp, "Total extra probes thread %d = %d\n", t, totent);
+	fprintf (fp, "Entry information (table size %u, %u entries):\n",
+		 perthread[t].hashtable.size, perthread[t].hashtable.nument);
 	fprintf (fp, "num_zero = %d num_one = %d num_two = %d num_more = %d\n",
 		 num_zero, num_one, num_two, num_more);
 	fprintf (fp, "Most = %d\n", most);
@@ -2901,7 +5812,9 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 
   totmem = 0.;
   for (t = 0; t < nthreads; t++) {
-    hashmem = (float) sizeof (Hashentry) * tablesize;
+    numtimers = perthread[t].hashtable.nument;
+    hashmem = (float) sizeof (Hashslot) * perthread[t].hashtable.size;
+    edgemem = (float) sizeof (Edgeslot) * perthread[t].edges.size;
     regionmem = (float) numtimers * sizeof (Timer);
 #ifdef HAVE_PAPI
     papimem = (float) numtimers * sizeof (Papistats);
@@ -2909,28 +5822,28 @@ int GPTLpr_file (const char *outfile) /* output file to write */
     papimem = 0.;
 #endif
     pchmem = 0.;
-    for (ptr = timers[t]->next; ptr; ptr = ptr->next)
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next)
       pchmem += (float) (sizeof (Timer *)) * (ptr->nchildren + ptr->nparent);
 
-    gptlmem = hashmem + regionmem + pchmem;
+    /* Timers and parent/child arrays live in the arena, which also holds unused space */
+
+    gptlmem = hashmem + edgemem + (float) perthread[t].arena.nbytes;
     totmem += gptlmem;
     fprintf (fp, "\n");
     fprintf (fp, "Thread %d total memory usage = %g KB\n", t, gptlmem*.001);
     fprintf (fp, "  Hashmem                   = %g KB\n"
+	         "  Edge table                = %g KB (%u edges)\n"
+	         "  Arena                     = %g KB\n"
 	         "  Regionmem                 = %g KB (papimem portion = %g KB)\n"
 	         "  Parent/child arrays       = %g KB\n",
-	     hashmem*.001, regionmem*.001, papimem*.001, pchmem*.001);
+	     hashmem*.001, edgemem*.001, perthread[t].edges.nument, perthread[t].arena.nbytes*.001,
+	     regionmem*.001, papimem*.001, pchmem*.001);
   }
   fprintf (fp, "\n");
   fprintf (fp, "Total memory usage all threads = %g KB\n", totmem*0.001);
 
   print_threadmapping (fp);
   free (sum);
-
-  if (fclose (fp) != 0)
-    fprintf (stderr, "Attempt to close %s failed\n", outfile);
-
-  pr_has_been_called = true;
   return 0;
 }
 
@@ -2941,11 +5854,13 @@ int GPTLpr_file (const char *outfile) /* output file to write */
 ** Input arguments:
 **   timerst: Linked list of timers
 **   method:  method to be used to define the links
+**   arena:   arena holding the timers, for the children arrays
+**   edges:   call graph edges of the thread
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-int construct_tree (Timer *timerst, Method method)
+int construct_tree (Timer *timerst, Method method, Arena *arena, Edgetable *edges)
 {
   Timer *ptr;       /* loop through linked list */
   Timer *pptr = 0;  /* parent (init to NULL to avoid compiler warning) */
@@ -2963,14 +5878,14 @@ int construct_tree (Timer *timerst, Method method)
     case GPTLfirst_parent:
       if (ptr->nparent > 0) {
 	pptr = ptr->parent[0];
-	if (newchild (pptr, ptr) != 0);
+	if (newchild (pptr, ptr, arena, edges) != 0);
       }
       break;
     case GPTLlast_parent:
       if (ptr->nparent > 0) {
 	nparent = ptr->nparent;
 	pptr = ptr->parent[nparent-1];
-	if (newchild (pptr, ptr) != 0);
+	if (newchild (pptr, ptr, arena, edges) != 0);
       }
       break;
     case GPTLmost_frequent:
@@ -2982,7 +5897,7 @@ int construct_tree (Timer *timerst, Method method)
 	}
       }
       if (maxcount > 0) {   /* not an orphan */
-	if (newchild (pptr, ptr) != 0);
+	if (newchild (pptr, ptr, arena, edges) != 0);
       }
       break;
     case GPTLfull_tree:
@@ -2991,7 +5906,7 @@ int construct_tree (Timer *timerst, Method method)
       */
       for (n = 0; n < ptr->nparent; ++n) {
 	pptr = ptr->parent[n];
-	if (newchild (pptr, ptr) != 0);
+	if (newchild (pptr, ptr, arena, edges) != 0);
       }
       break;
     default:
@@ -3045,15 +5960,17 @@ static char *methodstr (Method method)
 ** Input arguments:
 **   parent: parent node
 **   child:  child to be added
+**   arena:  arena for the children array
+**   edges:  call graph edges, which record the children already added
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-static int newchild (Timer *parent, Timer *child)
+static int newchild (Timer *parent, Timer *child, Arena *arena, Edgetable *edges)
 {
   int nchildren;     /* number of children (temporary) */
   Timer **chptr;     /* array of pointers to children */
-  int n;             /* loop over nchildren */
+  Edgeslot *edge;    /* edge from parent to child */
 
   static const char *thisfunc = "newchild";
 
@@ -3065,14 +5982,10 @@ static int newchild (Timer *parent, Timer *child)
   ** is not a known child
   */
 
-  for (n = 0; n < parent->nchildren; ++n) {
-     if (parent->children[n] == child){
-        n = parent->nchildren + 1;
-     }
-  }
-  if (n > parent->nchildren){
+  if ( ! (edge = find_edge (edges, parent, child)))
+    return GPTLerror ("%s: %s was never called from %s\n", thisfunc, child->name, parent->name);
+  if (edge->linked)
     return 0;
-  }
 
   /*
   ** To guarantee no loops, ensure that proposed parent isn't already a descendant of
@@ -3088,17 +6001,47 @@ static int newchild (Timer *parent, Timer *child)
 
   /* Safe to add the child to the parent's list of children */
 
-  ++parent->nchildren;
   nchildren = parent->nchildren;
-  chptr = (Timer **) realloc (parent->children, nchildren * sizeof (Timer *));
+  chptr = (Timer **) grow_array (arena, parent->children, nchildren, sizeof (Timer *));
   if ( ! chptr)
-    return GPTLerror ("%s: realloc error\n", thisfunc);
+    return GPTLerror ("%s: grow_array error\n", thisfunc);
   parent->children = chptr;
-  parent->children[nchildren-1] = child;
+  parent->children[nchildren] = child;
+  ++parent->nchildren;
+  edge->linked = true;
 
   return 0;
 }
 
+/*
+** grow_array: Make room to append one element to an arena-allocated array.
+**   The capacity of an array holding n elements is implicitly the smallest
+**   power of 2 (at least 4) not less than n, so a larger copy is made only
+**   when n reaches a power of 2. The old copy is left in the arena.
+**
+** Input arguments:
+**   arena:  arena to allocate from
+**   array:  current array (NULL if n is 0)
+**   n:      number of elements currently in array
+**   elsize: size of each element
+**
+** Return value: array with room for n+1 elements (NULL on failure)
+*/
+
+static void *grow_array (Arena *arena, void *array, const int n, const size_t elsize)
+{
+  void *newarray;   /* return value when a larger copy is needed */
+
+  if (n > 0 && (n < 4 || (n & (n-1)) != 0))
+    return array;
+
+  if ( ! (newarray = GPTLarena_alloc (arena, (n > 0 ? 2*n : 4) * elsize, elsize)))
+    return 0;
+  if (n > 0)
+    memcpy (newarray, array, n * elsize);
+  return newarray;
+}
+
 /*
 ** get_max_depth: Determine the maximum call tree depth by traversing the
 **   tree recursively
@@ -3156,10 +6099,31 @@ static int num_descendants (Timer *ptr)
 ** Return value: true or false
 */
 
-static int is_descendant (const Timer *node1, const Timer *node2)
+static int is_descendant (Timer *node1, const Timer *node2)
+{
+  static unsigned int visitgen = 0;  /* number of the current search */
+
+  return find_descendant (node1, node2, ++visitgen);
+}
+
+/*
+** find_descendant: recursive part of is_descendant. A timer reached through
+**   several parents (GPTLfull_tree) is searched only once per search
+**
+** Input arguments:
+**   node1: starting node
+**   node2: node to be searched for
+**   gen:   number of this search, marked on every node visited
+**
+** Return value: true or false
+*/
+
+static int find_descendant (Timer *node1, const Timer *node2, const unsigned int gen)
 {
   int n;
 
+  node1->visitmark = gen;
+
   /* Breadth before depth for efficiency */
 
   for (n = 0; n < node1->nchildren; ++n)
@@ -3167,7 +6131,7 @@ static int is_descendant (const Timer *node1, const Timer *node2)
       return 1;
 
   for (n = 0; n < node1->nchildren; ++n)
-    if (is_descendant (node1->children[n], node2))
+    if (node1->children[n]->visitmark != gen && find_descendant (node1->children[n], node2, gen))
       return 1;
 
   return 0;
@@ -3233,6 +6197,7 @@ static void printstats (const Timer *timer,
   float wallmax;       /* max wall time */
   float wallmin;       /* min wall time */
   float ratio;         /* percentage calc */
+  double excl;         /* exclusive, overhead corrected wallclock */
 
   /* Flag regions having multiple parents with a "*" in column 1 */
 
@@ -3256,14 +6221,14 @@ static void printstats (const Timer *timer,
 
   /* Pad to length of longest name */
 
-  extraspace = max_name_len[t] - strlen (timer->name);
+  extraspace = perthread[t].max_name_len - strlen (timer->name);
   for (i = 0; i < extraspace; ++i)
     fprintf (fp, " ");
 
   /* Pad to max indent level */
 
   if (doindent)
-    for (indent = depth; indent < max_depth[t]; ++indent)
+    for (indent = depth; indent < perthread[t].max_depth; ++indent)
       fprintf (fp, "  ");
 
   if (timer->onflg)
@@ -3296,10 +6261,23 @@ static void printstats (const Timer *timer,
     wallmin = timer->wall.min;
     fprintf (fp, "%12.6f %12.6f %12.6f ", elapse, wallmax, wallmin);
 
-    if (percent && timers[0]->next) {
+    if (dohist) {
+      if (timer->hist)
+	fprintf (fp, "%12.6f %12.6f %12.6f ",
+		 hist_percentile (timer->hist, 0.50, wallmin, wallmax),
+		 hist_percentile (timer->hist, 0.95, wallmin, wallmax),
+		 hist_percentile (timer->hist, 0.99, wallmin, wallmax));
+      else
+	fprintf (fp, "%12s %12s %12s ", "-", "-", "-");
+    }
+
+    if (selftop > 0)
+      fprintf (fp, "%12.6f ", timer->self_wall);
+
+    if (percent && perthread[0].timers->next) {
       ratio = 0.;
-      if (timers[0]->next->wall.accum > 0.)
-	ratio = (timer->wall.accum * 100.) / timers[0]->next->wall.accum;
+      if (perthread[0].timers->next->wall.accum > 0.)
+	ratio = (timer->wall.accum * 100.) / perthread[0].timers->next->wall.accum;
       fprintf (fp, " %9.2f ", ratio);
     }
 
@@ -3308,10 +6286,24 @@ static void printstats (const Timer *timer,
     */
 
     if (overheadstats.enabled) {
-      fprintf (fp, "%16.6f ", timer->count * 2 * tot_overhead);
+      fprintf (fp, "%16.6f ", nstamped (timer) * 2 * tot_overhead);
+    }
+
+    /*
+    ** Exclusive time: less the time in the timers directly inside this one,
+    ** and the instrumentation cost of those calls charged to this timer.
+    ** Overhead inside deeper descendants is part of the children's time.
+    */
+
+    if (doexclusive) {
+      excl = timer->wall.accum - timer->child_wall - timer->nchildcalls * pair_overhead;
+      fprintf (fp, "%12lu %12.6f ", timer->ndesc, MAX (0., excl));
     }
   }
 
+  if (domemory)
+    fprintf (fp, "%13lld %13lld ", timer->rss_delta, timer->rss_peak);
+
 #ifdef ENABLE_PMPI
   if (timer->nbytes == 0.)
     fprintf (fp, "      -       ");
@@ -3357,6 +6349,183 @@ void print_multparentinfo (FILE *fp,
     fprintf (fp, "%8.1e   %-32s\n\n", (float) ptr->count, ptr->name);
 }
 
+/*
+** sample_stderr: standard error of the wallclock estimate of a sampled timer,
+**   treating its timed calls as a random sample of all its calls
+**
+** Input arguments:
+**   ptr: timer with at least 2 timed calls
+**
+** Return value: standard error (seconds)
+*/
+
+static double sample_stderr (const Timer *ptr)
+{
+  double n = (double) ptr->samp.n;   /* timed calls */
+  double ncalls = (double) ptr->count;
+  double mean;
+  double var;                        /* sample variance of a timed call */
+
+  mean = ptr->samp.sum / n;
+  var = MAX (0., (ptr->samp.sumsq - n * mean * mean) / (n - 1.));
+
+  /* Finite population correction: the error vanishes when every call is timed */
+
+  return ncalls * sqrt (var / n * MAX (0., 1. - n / ncalls));
+}
+
+/*
+** compute_self: set self_wall of each timer in a thread's list: its wallclock
+**   less that of the timers called from it. A timer with several parents
+**   is split between them in proportion to the calls each made, so the
+**   result does not depend on the print method used by construct_tree. With
+**   GPTLexclusive the time spent in children was measured directly.
+**
+** Input arguments:
+**   timers: linked list of timers (starting with the dummy GPTL_ROOT)
+*/
+
+static void compute_self (Timer *timers)
+{
+  Timer *ptr;
+  int n;              /* index over parents */
+  double ncalls;      /* calls of ptr from all its parents */
+
+  for (ptr = timers; ptr; ptr = ptr->next)
+    ptr->self_wall = doexclusive ? ptr->wall.accum - ptr->child_wall : ptr->wall.accum;
+
+  if ( ! doexclusive) {
+    for (ptr = timers->next; ptr; ptr = ptr->next) {
+      ncalls = 0.;
+      for (n = 0; n < ptr->nparent; ++n)
+	ncalls += ptr->parent_count[n];
+      for (n = 0; n < ptr->nparent; ++n)
+	if (ptr->parent[n] != ptr)
+	  ptr->parent[n]->self_wall -= ptr->wall.accum * (ptr->parent_count[n] / ncalls);
+    }
+  }
+
+  /* Rounding in the clock can leave a slightly negative result */
+
+  for (ptr = timers; ptr; ptr = ptr->next)
+    ptr->self_wall = MAX (0., ptr->self_wall);
+}
+
+/*
+** cmp_self: qsort comparison of Timer pointers, largest self time first
+*/
+
+static int cmp_self (const void *a, const void *b)
+{
+  const Timer *x = *(const Timer * const *) a;
+  const Timer *y = *(const Timer * const *) b;
+
+  return (x->self_wall < y->self_wall) - (x->self_wall > y->self_wall);
+}
+
+/*
+** print_flat_profile: print the selftop timers of thread t with the most
+**   self time, with their share of the thread's total self time
+**
+** Input arguments:
+**   fp: output file
+**   t:  thread index
+*/
+
+static void print_flat_profile (FILE *fp, const int t)
+{
+  Timer **list;       /* the thread's timers, sorted by self time */
+  Timer *ptr;
+  int n;
+  int nlist = 0;
+  double total = 0.;  /* self time of all timers */
+  double cum = 0.;    /* self time of the timers printed so far */
+
+  if (perthread[t].hashtable.nument == 0 ||
+      ! (list = (Timer **) GPTLallocate (perthread[t].hashtable.nument * sizeof (Timer *))))
+    return;
+
+  for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+    list[nlist++] = ptr;
+    total += ptr->self_wall;
+  }
+  qsort (list, nlist, sizeof (Timer *), cmp_self);
+
+  fprintf (fp, "\nFlat profile for thread %d: top %d timers by self time\n", t, MIN (selftop, nlist));
+  fprintf (fp, "%-*s %12s %12s %7s %7s %12s\n", perthread[t].max_name_len, "name",
+	   "Called", "Self", "%self", "cum%", "Wallclock");
+  for (n = 0; n < nlist && n < selftop; ++n) {
+    cum += list[n]->self_wall;
+    fprintf (fp, "%-*s %12lu %12.6f %7.2f %7.2f %12.6f\n", perthread[t].max_name_len, list[n]->name,
+	     list[n]->count, list[n]->self_wall,
+	     total > 0. ? 100. * list[n]->self_wall / total : 0.,
+	     total > 0. ? 100. * cum / total : 0., list[n]->wall.accum);
+  }
+  free (list);
+}
+
+/*
+** cmp_selftotal: qsort comparison of Summarystats pointers, largest total
+**   self time first
+*/
+
+static int cmp_selftotal (const void *a, const void *b)
+{
+  const Summarystats *x = *(const Summarystats * const *) a;
+  const Summarystats *y = *(const Summarystats * const *) b;
+
+  return (x->selftotal < y->selftotal) - (x->selftotal > y->selftotal);
+}
+
+/*
+** print_summary_flat: print the selftop timers with the most self time
+**   summed over all processes and threads
+**
+** Input arguments:
+**   fp:      output file
+**   names:   timer names
+**   storage: summary stats, one per name
+**   count:   number of names
+*/
+
+static void print_summary_flat (FILE *fp, const char **names, const Summarystats *storage,
+				const int count)
+{
+  const Summarystats **list;  /* storage entries sorted by total self time */
+  int k;
+  int len;
+  int namelen = 4;            /* strlen ("name") */
+  double total = 0.;
+  double cum = 0.;
+
+  if (count == 0 ||
+      ! (list = (const Summarystats **) GPTLallocate (count * sizeof (Summarystats *))))
+    return;
+
+  for (k = 0; k < count; ++k) {
+    list[k] = &storage[k];
+    total += storage[k].selftotal;
+  }
+  qsort (list, count, sizeof (Summarystats *), cmp_selftotal);
+  for (k = 0; k < count && k < selftop; ++k)
+    if ((len = strlen (names[list[k] - storage])) > namelen)
+      namelen = len;
+
+  fprintf (fp, "Flat profile: top %d timers by self time over all processes and threads\n",
+	   MIN (selftop, count));
+  fprintf (fp, "%-*s %12s %7s %7s %12s %12s\n", namelen, "name",
+	   "selftotal", "%self", "cum%", "selfmax", "walltotal");
+  for (k = 0; k < count && k < selftop; ++k) {
+    cum += list[k]->selftotal;
+    fprintf (fp, "%-*s %12.6e %7.2f %7.2f %12.6f %12.6e\n", namelen, names[list[k] - storage],
+	     list[k]->selftotal,
+	     total > 0. ? 100. * list[k]->selftotal / total : 0.,
+	     total > 0. ? 100. * cum / total : 0., list[k]->selfmax, list[k]->walltotal);
+  }
+  fprintf (fp, "\n");
+  free ((void *) list);
+}
+
 /*
 ** add: add the contents of tin to tout
 **
@@ -3369,6 +6538,8 @@ void print_multparentinfo (FILE *fp,
 static void add (Timer *tout,
 		 const Timer *tin)
 {
+  int n;    /* histogram bin index */
+
   tout->count += tin->count;
 
   if (wallstats.enabled) {
@@ -3376,90 +6547,185 @@ static void add (Timer *tout,
 
     tout->wall.max = MAX (tout->wall.max, tin->wall.max);
     tout->wall.min = MIN (tout->wall.min, tin->wall.min);
+
+    tout->self_wall   += tin->self_wall;
+    tout->rss_delta   += tin->rss_delta;
+    tout->rss_peak     = MAX (tout->rss_peak, tin->rss_peak);
+    tout->child_wall  += tin->child_wall;
+    tout->nchildcalls += tin->nchildcalls;
+    tout->ndesc       += tin->ndesc;
+
+    if (tout->hist && tin->hist)
+      for (n = 0; n < HIST_NBINS; ++n)
+	tout->hist[n] += tin->hist[n];
   }
 
   if (cpustats.enabled) {
     tout->cpu.accum_utime += tin->cpu.accum_utime;
     tout->cpu.accum_stime += tin->cpu.accum_stime;
   }
+#ifdef ENABLE_PMPI
+  tout->nbytes += tin->nbytes;
+#endif
 #ifdef HAVE_PAPI
   GPTL_PAPIadd (&tout->aux, &tin->aux);
 #endif
 }
 
 /*
-** GPTLpr_summary: Gather and print summary stats across
-**                 threads and MPI tasks
+** GPTLpr_summary: Gather and print summary stats across
+**                 threads and MPI tasks
+**
+** Input arguments:
+**   comm: commuicator (e.g. MPI_COMM_WORLD). If zero, use MPI_COMM_WORLD
+*/
+
+#ifdef HAVE_MPI
+int GPTLpr_summary (MPI_Comm comm)
+#else
+int GPTLpr_summary (int comm)
+#endif
+{
+  const char *outfile = "timing.summary";
+  int ret;
+
+  ret = GPTLpr_summary_file(comm, outfile);
+  return 0;
+}
+
+/*
+** GPTLpr_summary_file: Gather and print summary stats across threads and
+**   MPI tasks. Same as GPTLpr_summary_begin followed by GPTLpr_summary_end.
+**
+** Input arguments:
+**   comm:    communicator (e.g. MPI_COMM_WORLD). If zero, use MPI_COMM_WORLD
+**   outfile: name of the output file
+*/
+
+#ifdef HAVE_MPI
+int GPTLpr_summary_file (MPI_Comm comm,
+                         const char *outfile)
+#else
+int GPTLpr_summary_file (int comm,
+                         const char *outfile)
+#endif
+{
+  static const char *thisfunc = "GPTLpr_summary_file";
+
+  if (GPTLpr_summary_begin (comm) != 0)
+    return GPTLerror ("%s: GPTLpr_summary_begin failed\n", thisfunc);
+  return GPTLpr_summary_end (outfile);
+}
+
+/*
+** GPTLpr_summary_begin: Start gathering summary stats across threads and
+**   MPI tasks, from the timer values at the time of the call. Ranks agree
+**   on the set of timers before returning, but the reductions of the stats
+**   are posted as non-blocking collectives (if the MPI library is MPI-3),
+**   so they can progress while the caller goes on, e.g. finalizing model
+**   components. Every rank of comm must then call GPTLpr_summary_end, and
+**   do so before GPTLfinalize. Only one summary can be in progress.
 **
 ** Input arguments:
-**   comm: commuicator (e.g. MPI_COMM_WORLD). If zero, use MPI_COMM_WORLD
+**   comm: communicator (e.g. MPI_COMM_WORLD). If zero or MPI_COMM_NULL, use
+**         MPI_COMM_WORLD
+**
+** Return value: 0 (success) or GPTLerror (failure)
 */
 
 #ifdef HAVE_MPI
-int GPTLpr_summary (MPI_Comm comm)
+int GPTLpr_summary_begin (MPI_Comm comm)
 #else
-int GPTLpr_summary (int comm)
+int GPTLpr_summary_begin (int comm)
 #endif
 {
-  const char *outfile = "timing.summary";
-  int ret;
+  int iam = 0;                     /* MPI rank: default master */
+  static const char *thisfunc = "GPTLpr_summary_begin";
 
-  ret = GPTLpr_summary_file(comm, outfile);
-  return 0;
-}
+#ifdef HAVE_MPI
+  int ret;                         /* return code */
 
+  comm = comm_or_world (comm);
+
+  if ((ret = MPI_Comm_rank (comm, &iam)) != MPI_SUCCESS)
+    return GPTLerror ("%s: Bad return from MPI_Comm_rank=%d\n", thisfunc, ret);
+#endif
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize() has not been called\n", thisfunc);
+  if (sumreq.active)
+    return GPTLerror ("%s: previous summary has not been ended\n", thisfunc);
+
+  memset (&sumreq, 0, sizeof (sumreq));
+  sumreq.iam = iam;
 #ifdef HAVE_MPI
-int GPTLpr_summary_file (MPI_Comm comm,
-                         const char *outfile)
-#else
-int GPTLpr_summary_file (int comm,
-                         const char *outfile)
+  sumreq.comm = comm;
 #endif
+
+  /*
+  ** Each process gathers stats for its threads.
+  ** Reductions over processes are started, and finished by
+  ** GPTLpr_summary_end, where the master prints results.
+  */
+
+  if ((sumreq.count = merge_thread_data (iam, &sumreq.names, &sumreq.storage, &sumreq.hist)) < 0)
+    return GPTLerror ("%s: merge_thread_data failed\n", thisfunc);
+
+  if (collect_begin (&sumreq) != 0)
+    return GPTLerror ("%s: collect_begin failed\n", thisfunc);
+
+  sumreq.active = true;
+  return 0;
+}
+
+/*
+** GPTLpr_summary_end: Finish gathering the summary stats started by
+**   GPTLpr_summary_begin, and print them (master only)
+**
+** Input arguments:
+**   outfile: name of the output file
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+int GPTLpr_summary_end (const char *outfile)
 {
-  int iam = 0;                     /* MPI rank: default master */
+  int iam;                         /* MPI rank */
   int n;                           /* index */
   int extraspace;                  /* for padding to length of longest name */
   int totlen;                      /* length for malloc */
-  char *outpath;                   /* path to output file: outdir/outfile */
+  char *outpath = 0;               /* path to output file: outdir/outfile */
+  char *binpath;                   /* path to binary output file (GPTLdopr_binary) */
+  Bintable table;                  /* binary summary table */
   FILE *fp = 0;                    /* output file */
 
   int count;                       /* number of timers */
+  const char **names;              /* names of all timers */
   Summarystats *storage;           /* storage for data from all timers */
+  unsigned long *hist;             /* latency histograms for all timers (GPTLhistogram) */
 
-  int x;                           /* pointer increment */
   int k;                           /* counter */
-  char *tempname;                  /* event name workspace */
   int max_name_length;
   int len;
   float temp;
   int ret;                                  /* return code */
 
-  static const char *thisfunc = "GPTLpr_summary_file";
-
-#ifdef HAVE_MPI
-  int nproc;                                /* number of procs in MPI communicator */
-
-  char name[MAX_CHARS+1];                   /* timer name requested by master */
-
-  if (((int) comm) == 0)
-    comm = MPI_COMM_WORLD;
-
-  if ((ret = MPI_Comm_rank (comm, &iam)) != MPI_SUCCESS)
-    return GPTLerror ("%s: Bad return from MPI_Comm_rank=%d\n", thisfunc, ret);
-
-  if ((ret = MPI_Comm_size (comm, &nproc)) != MPI_SUCCESS)
-    return GPTLerror ("%s rank %d: Bad return from MPI_Comm_size=%d\n", thisfunc, iam, ret);
-
-#endif
+  static const char *thisfunc = "GPTLpr_summary_end";
 
   if ( ! initialized)
     return GPTLerror ("%s: GPTLinitialize() has not been called\n", thisfunc);
+  if ( ! sumreq.active)
+    return GPTLerror ("%s: GPTLpr_summary_begin has not been called\n", thisfunc);
 
-  /*
-  ** Each process gathers stats for its threads.
-  ** Binary tree used combine results.
-  ** Master prints results.
-  */
+  sumreq.active = false;
+  if ( (ret = collect_end (&sumreq) ) != 0 )
+    return GPTLerror ("%s: collect_end failed\n", thisfunc);
+
+  iam     = sumreq.iam;
+  count   = sumreq.count;
+  names   = sumreq.names;
+  storage = sumreq.storage;
+  hist    = sumreq.hist;
 
   if (iam == 0) {
 
@@ -3488,8 +6754,6 @@ int GPTLpr_summary_file (int comm,
         fp = stderr;
     }
 
-    free (outpath);
-
     fprintf (fp, "$Id: gptl.c,v 1.157 2011-03-28 20:55:18 rosinski Exp $\n");
     fprintf (fp, "'count' is cumulative. All other stats are max/min\n");
     fprintf (fp, "'on' indicates whether the timer was active during output, and so stats are lower or upper bounds.\n");
@@ -3499,25 +6763,11 @@ int GPTLpr_summary_file (int comm,
 #endif
     fprintf (fp, "\n");
 
-    count = merge_thread_data(); /*merges events from all threads*/
-
-    if( !( tempname = (char*)malloc((MAX_CHARS + 1) * sizeof(char) ) ) )
-      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-
-    /* allocate storage for data for all timers */
-    if( !( storage = malloc( sizeof(Summarystats) * count ) ) && count )
-      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-
-    if ( (ret = collect_data( iam, comm, &count, &storage) ) != 0 )
-      return GPTLerror ("%s: master collect_data failed\n", thisfunc);
-
-    x = 0; /*finds max timer name length*/
-    max_name_length = 0;
+    max_name_length = 0; /*finds max timer name length*/
     for( k = 0; k < count; k++ ) {
-        len = strlen( timerlist[0] + x );
+        len = strlen( names[k] );
         if( len > max_name_length )
             max_name_length = len;
-        x += MAX_CHARS + 1;
     }
 
     /* Print heading */
@@ -3532,6 +6782,12 @@ int GPTLpr_summary_file (int comm,
       fprintf (fp, " ");
     fprintf (fp, " on  processes  threads        count");
     fprintf (fp, "      walltotal   wallmax (proc   thrd  )   wallmin (proc   thrd  )");
+    if (dohist)
+      fprintf (fp, "        p50        p95        p99");
+    if (selftop > 0)
+      fprintf (fp, "      selftotal   selfmax");
+    if (domemory)
+      fprintf (fp, "  rssdeltamax  rssdeltamin   rsspeakmax   rsspeakmin");
 
     for (n = 0; n < nevents; ++n) {
       fprintf (fp, "    %8.8stotal", eventlist[n].str8);
@@ -3541,20 +6797,15 @@ int GPTLpr_summary_file (int comm,
 
     fprintf (fp, "\n");
 
-    x = 0;
     for( k = 0; k < count; k++ ) {
 
       /* Print the results for this timer */
-      memset( tempname, 0, (MAX_CHARS + 1) * sizeof(char) );
-      memcpy( tempname, timerlist[0] + x, (MAX_CHARS + 1) * sizeof(char) );
-
-      x += (MAX_CHARS + 1);
       if (dopr_quotes){
-        fprintf (fp, "\"%s\"", tempname);
+        fprintf (fp, "\"%s\"", names[k]);
       } else {
-        fprintf (fp, "%s", tempname);
+        fprintf (fp, "%s", names[k]);
       }
-      extraspace = max_name_length - strlen (tempname);
+      extraspace = max_name_length - strlen (names[k]);
       for (n = 0; n < extraspace; ++n)
         fprintf (fp, " ");
       if (storage[k].onflgs > 0)
@@ -3568,6 +6819,16 @@ int GPTLpr_summary_file (int comm,
 	       storage[k].walltotal,
 	       storage[k].wallmax, storage[k].wallmax_p, storage[k].wallmax_t,
 	       storage[k].wallmin, storage[k].wallmin_p, storage[k].wallmin_t);
+      if (dohist)
+	fprintf (fp, " %10.3e %10.3e %10.3e",
+		 hist_percentile (hist + k*HIST_NBINS, 0.50, storage[k].callmin, storage[k].callmax),
+		 hist_percentile (hist + k*HIST_NBINS, 0.95, storage[k].callmin, storage[k].callmax),
+		 hist_percentile (hist + k*HIST_NBINS, 0.99, storage[k].callmin, storage[k].callmax));
+      if (selftop > 0)
+	fprintf (fp, "  %12.6e %9.3f", storage[k].selftotal, storage[k].selfmax);
+      if (domemory)
+	fprintf (fp, " %12lld %12lld %12lld %12lld", storage[k].rssdeltamax, storage[k].rssdeltamin,
+		 storage[k].rsspeakmax, storage[k].rsspeakmin);
 #ifdef HAVE_PAPI
       for (n = 0; n < nevents; ++n) {
           fprintf (fp, "     %12.6e", storage[k].papitotal[n]);
@@ -3585,565 +6846,650 @@ int GPTLpr_summary_file (int comm,
     }
 
     fprintf (fp, "\n");
-    free(tempname);
-
-  }
-  else {   /* iam != 0 (slave) */
-#ifdef HAVE_MPI
-    /* count number of timers from linked list */
-    count = merge_thread_data();
-
-    /*allocate storage for data for all timers */
-    if( !( storage = malloc( sizeof(Summarystats) * count ) ) && count )
-      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
 
-    if ( (ret = collect_data( iam, comm, &count, &storage ) ) != 0 )
-      return GPTLerror ("%s: slave collect_data failed\n", thisfunc);
+    if (selftop > 0)
+      print_summary_flat (fp, names, storage, count);
+
+    /* Same table, by column, in <outpath>.gptb */
+
+    if (dopr_binary) {
+      memset (&table, 0, sizeof (table));
+      table.name = "summary";
+      table.nrows = count;
+      bin_addcol (&table, "name",      GPTLBIN_STRING,  MAX_CHARS+1, names, sizeof (char *));
+      table.cols[0].indirect = true;
+      bin_addcol (&table, "on",        GPTLBIN_INT32,   1, &storage[0].onflgs,    sizeof (Summarystats));
+      bin_addcol (&table, "processes", GPTLBIN_INT32,   1, &storage[0].processes, sizeof (Summarystats));
+      bin_addcol (&table, "threads",   GPTLBIN_INT32,   1, &storage[0].threads,   sizeof (Summarystats));
+      bin_addcol (&table, "count",     GPTLBIN_UINT64,  1, &storage[0].count,     sizeof (Summarystats));
+      bin_addcol (&table, "walltotal", GPTLBIN_FLOAT64, 1, &storage[0].walltotal, sizeof (Summarystats));
+      bin_addcol (&table, "wallmax",   GPTLBIN_FLOAT64, 1, &storage[0].wallmax,   sizeof (Summarystats));
+      bin_addcol (&table, "wallmax_p", GPTLBIN_INT32,   1, &storage[0].wallmax_p, sizeof (Summarystats));
+      bin_addcol (&table, "wallmax_t", GPTLBIN_INT32,   1, &storage[0].wallmax_t, sizeof (Summarystats));
+      bin_addcol (&table, "wallmin",   GPTLBIN_FLOAT64, 1, &storage[0].wallmin,   sizeof (Summarystats));
+      bin_addcol (&table, "wallmin_p", GPTLBIN_INT32,   1, &storage[0].wallmin_p, sizeof (Summarystats));
+      bin_addcol (&table, "wallmin_t", GPTLBIN_INT32,   1, &storage[0].wallmin_t, sizeof (Summarystats));
+      if (dohist) {
+	bin_addcol (&table, "callmax", GPTLBIN_FLOAT32, 1, &storage[0].callmax, sizeof (Summarystats));
+	bin_addcol (&table, "callmin", GPTLBIN_FLOAT32, 1, &storage[0].callmin, sizeof (Summarystats));
+	bin_addcol (&table, "hist",    GPTLBIN_UINT64,  HIST_NBINS, hist, HIST_NBINS * sizeof (unsigned long));
+      }
+      if (selftop > 0) {
+	bin_addcol (&table, "selftotal", GPTLBIN_FLOAT64, 1, &storage[0].selftotal, sizeof (Summarystats));
+	bin_addcol (&table, "selfmax",   GPTLBIN_FLOAT64, 1, &storage[0].selfmax,   sizeof (Summarystats));
+      }
+      if (domemory) {
+	bin_addcol (&table, "rssdeltamax", GPTLBIN_INT64, 1, &storage[0].rssdeltamax, sizeof (Summarystats));
+	bin_addcol (&table, "rssdeltamin", GPTLBIN_INT64, 1, &storage[0].rssdeltamin, sizeof (Summarystats));
+	bin_addcol (&table, "rsspeakmax",  GPTLBIN_INT64, 1, &storage[0].rsspeakmax,  sizeof (Summarystats));
+	bin_addcol (&table, "rsspeakmin",  GPTLBIN_INT64, 1, &storage[0].rsspeakmin,  sizeof (Summarystats));
+      }
+#ifdef HAVE_PAPI
+      if (nevents > 0) {
+	bin_addcol (&table, "papitotal", GPTLBIN_FLOAT64, nevents, storage[0].papitotal, sizeof (Summarystats));
+	bin_addcol (&table, "papimax",   GPTLBIN_FLOAT64, nevents, storage[0].papimax,   sizeof (Summarystats));
+	bin_addcol (&table, "papimax_p", GPTLBIN_INT32,   nevents, storage[0].papimax_p, sizeof (Summarystats));
+	bin_addcol (&table, "papimax_t", GPTLBIN_INT32,   nevents, storage[0].papimax_t, sizeof (Summarystats));
+	bin_addcol (&table, "papimin",   GPTLBIN_FLOAT64, nevents, storage[0].papimin,   sizeof (Summarystats));
+	bin_addcol (&table, "papimin_p", GPTLBIN_INT32,   nevents, storage[0].papimin_p, sizeof (Summarystats));
+	bin_addcol (&table, "papimin_t", GPTLBIN_INT32,   nevents, storage[0].papimin_t, sizeof (Summarystats));
+      }
 #endif
+      binpath = (char *) GPTLallocate (strlen (outpath) + strlen (GPTLBIN_SUFFIX) + 1);
+      strcpy (binpath, outpath);
+      strcat (binpath, GPTLBIN_SUFFIX);
+      ret = bin_write (binpath, GPTLBIN_SUMMARY, nthreads, 1, &table,
+		     print_mode == GPTLprint_append);
+      free (binpath);
+      if (ret != 0)
+	return GPTLerror ("%s: Error in bin_write\n", thisfunc);
+    }
   }
 
-  free(timerlist[0]);
-  free(timerlist);
-  free(storage);
+  free_summaryreq (&sumreq);
+  free(outpath);
   if (iam == 0 && fclose (fp) != 0)
     fprintf (stderr, "%s: Attempt to close %s failed\n", thisfunc, outfile);
   return 0;
 }
 
 /*
-** merge_thread_data: returns number of events in merged list
+** 64-bit FNV-1a hash of a timer name. Threads are merged by looking these
+** up, and ranks agree on the global timer index by exchanging these instead
+** of the names themselves.
 */
 
-static int merge_thread_data()
-{
-  int n, k, x;                     /*counters*/
-  int t;                           /*current thread*/
-  int num_newtimers;
-  int compare;
-  int *count;
-  int max_count;                   /* largest number of timers among non-thread-0 threads */
-  char **newtimers;
-  int length = MAX_CHARS + 1;
-  char ***sort;
-  int count_r;                     /* count to be returned, allows *count to be free()ed */
-  Timer *ptr;
-
-  static const char *thisfunc = "merge_thread_data";
-
-  if( nthreads == 1 ) { /* merging is not needed since only 1 thread */
-
-    /* count timers for thread 0 */
-    count_r = 0;
-    for (ptr = timers[0]->next; ptr; ptr = ptr->next) count_r++;
+#define FNV64_OFFSET 14695981039346656037ULL
+#define FNV64_PRIME  1099511628211ULL
 
-    timerlist    = (char **) GPTLallocate( sizeof (char *));
-    if( !( timerlist[0] = (char *)malloc( count_r * length * sizeof (char)) ) && count_r)
-      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-
-    x = 0;
-    for (ptr = timers[0]->next; ptr; ptr = ptr->next) {
-      strcpy((timerlist[0] + x), ptr->name);
-      x += length;
-    }
-
-    return count_r;
+static unsigned long long namehash64 (const char *name)
+{
+  const unsigned char *c;
+  unsigned long long hash = FNV64_OFFSET;
 
+  for (c = (const unsigned char *) name; *c; ++c) {
+    hash ^= *c;
+    hash *= FNV64_PRIME;
   }
+  return hash;
+}
 
-  timerlist = (char **)  GPTLallocate( nthreads * sizeof (char *));
-  count     = (int *)    GPTLallocate( nthreads * sizeof (int));
-  sort      = (char ***) GPTLallocate( nthreads * sizeof (void *));
-
-  max_count = 0;
-  for (t = 0; t < nthreads; t++) {
-
-    /* count timers for thread */
-    count[t] = 0;
-    for (ptr = timers[t]->next; ptr; ptr = ptr->next) count[t]++;
-
-    if( count[t] > max_count || max_count == 0 ) max_count = count[t];
-
-    if( !( sort[t] = (char **)malloc( count[t] * sizeof (char *)) ) && count[t])
-      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-
-    /* allocate memory to hold list of timer names */
-    if( !( timerlist[t] = (char *)malloc( length * count[t] * sizeof (char)) ) && count[t])
-      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-    memset( timerlist[t], 0, length  * count[t] * sizeof (char) );
-
-    x = 0;
-    for (ptr = timers[t]->next; ptr; ptr = ptr->next) {
-      strcpy((timerlist[t] + x), ptr->name);
-      x += length;
-    }
-
-    x = 0;
-    for (k = 0; k < count[t]; k++) {
-      sort[t][k] = timerlist[t] + x;
-      x += length;
-    }
+static int cmp_hash64 (const void *pa, const void *pb)
+{
+  const unsigned long long x = *(const unsigned long long *) pa;
+  const unsigned long long y = *(const unsigned long long *) pb;
+  return (x > y) - (x < y);
+}
 
-    qsort( sort[t], count[t], sizeof (char *), cmp );
+/*
+** merge_thread_data: Merge the timers of all threads into one list in a
+**   single pass over each thread's linked list. Each timer is looked up in a
+**   name-index hash table shared by all threads, appended the first time its
+**   name is seen (so thread 0's timers come first, then those only later
+**   threads have, in the order of the first thread having them), and its
+**   stats are accumulated straight into its entry. Names are not copied:
+**   the entries point at the names in the timers.
+**
+** Input arguments:
+**   iam: MPI process id
+** Output arguments:
+**   names: name of each merged timer (allocated here)
+**   summarystats: max/min stats over all threads of each merged timer
+**                 (allocated here)
+**   hist: latency histograms summed over threads, HIST_NBINS per timer
+**         (allocated here; NULL unless GPTLhistogram)
+**
+** Return value: number of merged timers, or GPTLerror (failure)
+*/
 
-  }
+static int merge_thread_data (const int iam,
+			      const char ***names,
+			      Summarystats **summarystats,
+			      unsigned long **hist)
+{
+  int t;                           /* thread index */
+  int k;                           /* merged timer index */
+  int n = 0;                       /* number of merged timers */
+  int maxn;                        /* allocated length of the output arrays */
+  unsigned int nslots;             /* size of the name-index table (power of 2) */
+  unsigned int s;                  /* slot in the name-index table */
+  int *slots;                      /* merged timer index of each slot (-1 if empty) */
+  unsigned long long *hashes;      /* name hash of each merged timer */
+  unsigned long long h;
+  Timer *ptr;
+  static const char *thisfunc = "merge_thread_data";
 
-  if( !( newtimers = (char **)malloc( max_count * sizeof (char *)) ) && max_count)
+  maxn = 0;
+  for (ptr = perthread[0].timers->next; ptr; ptr = ptr->next)
+    ++maxn;
+  maxn = MAX (maxn, 64);
+  for (nslots = 128; nslots < 2 * (unsigned int) maxn; nslots *= 2);
+
+  *names        = (const char **) GPTLallocate (maxn * sizeof (char *));
+  *summarystats = (Summarystats *) GPTLallocate (maxn * sizeof (Summarystats));
+  hashes        = (unsigned long long *) GPTLallocate (maxn * sizeof (unsigned long long));
+  slots         = (int *) GPTLallocate (nslots * sizeof (int));
+  *hist = 0;
+  if (dohist)
+    *hist = (unsigned long *) GPTLallocate (maxn * HIST_NBINS * sizeof (unsigned long));
+  if ( ! *names || ! *summarystats || ! hashes || ! slots || (dohist && ! *hist))
     return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  memset (slots, -1, nslots * sizeof (int));
 
-  for (t = 1; t < nthreads; t++) {
-    memset( newtimers, 0, max_count * sizeof (char *) );
-    k = 0;
-    n = 0;
-    num_newtimers = 0;
-    while( k < count[0] && n < count[t] ) {
-      /* linear comparison of timers */
-      compare = strcmp( sort[0][k], sort[t][n]  );
-
-      if( compare == 0 ) {
-        /* both have, nothing needs to be done */
-        k++;
-        n++;
-        continue;
-      }
+  for (t = 0; t < nthreads; ++t) {
+    if (selftop > 0)
+      compute_self (perthread[t].timers);
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next) {
+      h = namehash64 (ptr->name);
+      for (s = h & (nslots-1); (k = slots[s]) >= 0; s = (s+1) & (nslots-1))
+	if (hashes[k] == h && STRMATCH ((*names)[k], ptr->name))
+	  break;
 
-      if( compare < 0 ) {
-        /* event that only master has, nothing needs to be done */
-        k++;
-        continue;
-      }
+      if (k < 0) {
+	if (n == maxn) {
+	  maxn *= 2;
+	  if ( ! (*names = (const char **) realloc (*names, maxn * sizeof (char *))) ||
+	       ! (*summarystats = (Summarystats *) realloc (*summarystats, maxn * sizeof (Summarystats))) ||
+	       ! (hashes = (unsigned long long *) realloc (hashes, maxn * sizeof (unsigned long long))) ||
+	       (dohist && ! (*hist = (unsigned long *) realloc (*hist, maxn * HIST_NBINS * sizeof (unsigned long)))))
+	    return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
+
+	  /* Keep the table at most half full */
+
+	  nslots *= 2;
+	  free (slots);
+	  if ( ! (slots = (int *) GPTLallocate (nslots * sizeof (int))))
+	    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+	  memset (slots, -1, nslots * sizeof (int));
+	  for (k = 0; k < n; ++k) {
+	    for (s = hashes[k] & (nslots-1); slots[s] >= 0; s = (s+1) & (nslots-1));
+	    slots[s] = k;
+	  }
+	  for (s = h & (nslots-1); slots[s] >= 0; s = (s+1) & (nslots-1));
+	}
 
-      if( compare > 0 ) {
-        /* event that only slave thread has, need to add */
-        newtimers[num_newtimers] = sort[t][n];
-        n++;
-        num_newtimers++;
+	k = slots[s] = n++;
+	(*names)[k] = ptr->name;
+	hashes[k] = h;
+	memset (&(*summarystats)[k], 0, sizeof (Summarystats));
+	(*summarystats)[k].filled = 1;
+	(*summarystats)[k].wallmax_p = iam;
+	(*summarystats)[k].wallmin_p = iam;
+	if (*hist)
+	  memset (*hist + k*HIST_NBINS, 0, HIST_NBINS * sizeof (unsigned long));
       }
-    }
 
-    while( n < count[t] ) {
-      /* adds any remaining timers, since we know that all the rest
-         are new since have checked all master thread timers */
-      newtimers[num_newtimers] = sort[t][n];
-      num_newtimers++;
-      n++;
+      add_threadstats (iam, t, ptr, &(*summarystats)[k], *hist ? *hist + k*HIST_NBINS : 0);
     }
+  }
 
-    if( num_newtimers ) {
-      /* sorts by memory address to restore original order */
-      qsort( newtimers, num_newtimers, sizeof(char*), ncmp );
+  for (k = 0; k < n; ++k)
+    if ((*summarystats)[k].count)
+      (*summarystats)[k].processes = 1;
 
-      /* reallocate memory to hold additional timers */
-      if( !( sort[0] = realloc( sort[0], (count[0] + num_newtimers) * sizeof (char *)) ) )
-        return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
-      if( !(timerlist[0] = realloc(timerlist[0], length * (count[0] + num_newtimers) * sizeof (char)) ) )
-        return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
+  free (slots);
+  free (hashes);
+  return n;
+}
 
-      k = count[0];
-      for (n = 0; n < num_newtimers; n++) {
-        /* add new found timers */
-        memcpy( timerlist[0] + (count[0] + n) *  length, newtimers[n], length * sizeof (char) );
-      }
+#ifdef HAVE_MPI
+/*
+** merge_hashes: Union of two sorted arrays of distinct hashes
+**
+** Input arguments:
+**   a, na: first array and its length
+**   b, nb: second array and its length
+** Output arguments:
+**   out: newly allocated sorted union (caller frees)
+**
+** Return value: length of the union (or -1 on allocation failure)
+*/
 
-      count[0] += num_newtimers;
+static int merge_hashes (const unsigned long long *a, const int na,
+			 const unsigned long long *b, const int nb,
+			 unsigned long long **out)
+{
+  int i = 0, j = 0, n = 0;
 
-      /* reassign pointers in sort since realloc will have broken them if it moved the memory. */
-      x = 0;
-      for (k = 0; k < count[0]; k++) {
-        sort[0][k] = timerlist[0] + x;
-        x += length;
-      }
+  if ( ! (*out = (unsigned long long *) malloc ((na + nb + 1) * sizeof (unsigned long long))))
+    return -1;
 
-      qsort( sort[0], count[0], sizeof (char *), cmp );
+  while (i < na && j < nb) {
+    if (a[i] < b[j])
+      (*out)[n++] = a[i++];
+    else if (a[i] > b[j])
+      (*out)[n++] = b[j++];
+    else {
+      (*out)[n++] = a[i++];
+      ++j;
     }
   }
+  while (i < na)
+    (*out)[n++] = a[i++];
+  while (j < nb)
+    (*out)[n++] = b[j++];
+  return n;
+}
 
-  free(newtimers);
-  free(sort[0]);
-  /* don't free timerlist[0], since needed for subsequent steps in gathering global statistics */
-  for (t = 1; t < nthreads; t++) {
-    free(sort[t]);
-    free(timerlist[t]);
-  }
+/*
+** summary_op: MPI reduction operator combining Summarystats records. It is
+**   registered as non-commutative, so invec always comes from lower ranks and
+**   wins ties, exactly as the master did in the old pairwise exchange.
+**   Records of processes without the timer were never filled and are skipped.
+*/
 
-  free(sort);
-  count_r = count[0];
-  free(count);
+static void summary_op (void *invec, void *inoutvec, int *len, MPI_Datatype *datatype)
+{
+  Summarystats *in    = (Summarystats *) invec;
+  Summarystats *inout = (Summarystats *) inoutvec;
+  Summarystats tmp;
+  int i;
 
-  return count_r;
+  for (i = 0; i < *len; ++i) {
+    if ( ! in[i].filled)
+      continue;
+    if ( ! inout[i].filled) {
+      inout[i] = in[i];
+      continue;
+    }
+    tmp = in[i];
+    get_summarystats (&tmp, &inout[i]);
+    inout[i] = tmp;
+  }
 }
+#endif
 
 /*
-** collect data: compute global stats using tree reduction algorithm
-** returns pointer to new summarystats list
+** collect_begin, collect_end: compute global stats over all processes and
+**   threads
+**
+** Ranks first agree on a global timer index: the sorted set of 64-bit name
+** hashes is merged up a binomial tree and broadcast back. Each rank then
+** fills one fixed-size Summarystats record per global timer, and a single
+** reduction with a custom operator combines them. Message sizes depend only
+** on the number of distinct timers. Finally the root gathers the names of
+** timers it does not have itself, from the lowest rank that has each one.
+**
+** collect_begin does the index agreement and posts the reductions, which
+** are non-blocking with an MPI-3 library. collect_end waits for them and
+** gathers the names.
 **
-** Input arguments:
-**   iam:   process id
-**   comm:  MPI communicator
 ** Input/Output arguments:
-**   summarystats: max/min/etc stats over all processes and threads
-**   count: number of events
-**   timerlist:  list of all timer names (global variable)
+**   sr: summary state, with iam, comm and the local names, storage, hist
+**       and count from merge_thread_data. On output from collect_end on the
+**       root they are over all processes and threads, with names found only
+**       on other ranks appended (stored in sr->namebuf)
 **
 ** Return value: 0 (success) or GPTLerror (failure)
 */
 
-#ifdef HAVE_MPI
-static int collect_data(const int iam,
-                        MPI_Comm comm,
-                        int *count,
-                        Summarystats **summarystats_cumul )
-#else
-static int collect_data(const int iam,
-                        int comm,
-                        int *count,
-                        Summarystats **summarystats_cumul )
-#endif
+static int collect_begin (Summaryreq *sr)
 {
-  int step;                        /* spacing beween active processes */
-  int mstep;                       /* spacing between active masters */
-  int procid;                      /* process to communicate with */
-  int ret;
-  int nproc;
-  int signal = 1;
-  int x, k, n;                     /* counters */
-  char *tempname;
-  int s = (MAX_CHARS + 1 );        /* spacing between timer names */
-  int length = MAX_CHARS + 1;
-  int compare;
-  int num_newtimers;
-  int count_slave;
-  char *timers_slave;              /* slave timerlist */
-  char **newtimers;
-  char **sort_slave;               /* slave sorted list */
-  char **sort_master;              /* master sorted list */
-  int m_index, s_index;
-  Summarystats *summarystats;      /* stats collected on master */
-
-  static const char *thisfunc = "collect_data";
-
 #ifdef HAVE_MPI
-  Summarystats *summarystats_slave; /* stats sent to master */
-  const int taga =  99;
-  const int tagb = 100;
-  const int tagc = 101;
+  const int iam = sr->iam;
+  const int tag = 99;
+  int ret;
+  int step;                        /* spacing between active processes */
+  int procid;                      /* process to communicate with */
+  int g, k;                        /* global and local timer index */
+  int nglobal;                     /* number of distinct timers over all ranks */
+  int nin;                         /* number of hashes received from a child */
+  unsigned long long *hashes;      /* local, then global sorted hashes */
+  unsigned long long *inhashes;    /* hashes received from a child */
+  unsigned long long *merged;      /* union of hashes */
+  unsigned long long h;            /* hash of a local timer */
+  unsigned long long *found;       /* bsearch result */
   MPI_Status status;
-  MPI_Request rcvreq1;
-  MPI_Request rcvreq2;
-  MPI_Request rcvreq3;
+  static const char *thisfunc = "collect_begin";
 
-  if ((ret = MPI_Comm_size (comm, &nproc)) != MPI_SUCCESS)
-    return GPTLerror ("%s rank %d: Bad return from MPI_Comm_size=%d\n", thisfunc, iam, ret);
+  for (k = 0; k < 3; ++k)
+    sr->req[k] = MPI_REQUEST_NULL;
 
-#endif
+  if ((ret = MPI_Comm_size (sr->comm, &sr->nproc)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Comm_size=%d\n", thisfunc, iam, ret);
+  if (sr->nproc < 2)
+    return 0;
 
-  summarystats = *summarystats_cumul;
+  /* Sorted, distinct hashes of the local timer names */
 
-  if (!( tempname = (char*)malloc((MAX_CHARS +1) * sizeof(char) ) ))
+  if ( ! (hashes = (unsigned long long *) malloc (MAX (sr->count, 1) * sizeof (unsigned long long))))
     return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  for (k = 0; k < sr->count; k++)
+    hashes[k] = namehash64 (sr->names[k]);
+  qsort (hashes, sr->count, sizeof (unsigned long long), cmp_hash64);
+  for (nglobal = 0, k = 0; k < sr->count; k++)
+    if (nglobal == 0 || hashes[k] != hashes[nglobal-1])
+      hashes[nglobal++] = hashes[k];
 
-  x = 0;
-  for (k = 0; k < *count; k++) {
-    memcpy( tempname, timerlist[0] + x, (MAX_CHARS + 1) * sizeof (char) );
-    /* calculate individual stats */
-    get_threadstats( iam, tempname, &summarystats[k]);
-    x += (MAX_CHARS + 1);
-  }
+  /* Merge up a binomial tree to the root, then broadcast the union */
 
-#ifdef HAVE_MPI
-  step = 1;
-  mstep = 2;
-  while( step < nproc ) {
+  for (step = 1; step < sr->nproc; step *= 2) {
+    if ((iam % (2*step)) == 0) {
+      procid = iam + step;
+      if (procid < sr->nproc) {
+	if ((ret = MPI_Probe (procid, tag, sr->comm, &status)) != MPI_SUCCESS)
+	  return GPTLerror ("%s rank %d: Bad return from MPI_Probe=%d\n", thisfunc, iam, ret);
+	(void) MPI_Get_count (&status, MPI_UNSIGNED_LONG_LONG, &nin);
+	if ( ! (inhashes = (unsigned long long *) malloc (MAX (nin, 1) * sizeof (unsigned long long))))
+	  return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+	if ((ret = MPI_Recv (inhashes, nin, MPI_UNSIGNED_LONG_LONG, procid, tag, sr->comm,
+			     MPI_STATUS_IGNORE)) != MPI_SUCCESS)
+	  return GPTLerror ("%s rank %d: Bad return from MPI_Recv=%d\n", thisfunc, iam, ret);
+	if ((nglobal = merge_hashes (hashes, nglobal, inhashes, nin, &merged)) < 0)
+	  return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+	free (hashes);
+	free (inhashes);
+	hashes = merged;
+      }
+    } else {
+      procid = iam - step;
+      if ((ret = MPI_Send (hashes, nglobal, MPI_UNSIGNED_LONG_LONG, procid, tag, sr->comm)) != MPI_SUCCESS)
+	return GPTLerror ("%s rank %d: Bad return from MPI_Send=%d\n", thisfunc, iam, ret);
+      break;
+    }
+  }
 
-    if ((iam % mstep) == 0) {
-       /* find new masters at the current level, which are at every n*step starting with 0 */
+  if ((ret = MPI_Bcast (&nglobal, 1, MPI_INT, 0, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Bcast=%d\n", thisfunc, iam, ret);
+  if ( ! (hashes = (unsigned long long *) realloc (hashes, MAX (nglobal, 1) * sizeof (unsigned long long))))
+    return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
+  if ((ret = MPI_Bcast (hashes, nglobal, MPI_UNSIGNED_LONG_LONG, 0, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Bcast=%d\n", thisfunc, iam, ret);
 
-      procid = iam + step;
-      if (procid < nproc) {
-        /* prevent lone master wanting data from nonexistent process problem */
-
-        /* prepare for receive */
-        if ((ret = MPI_Irecv (&count_slave, 1, MPI_INTEGER, procid, taga, comm, &rcvreq2)) != MPI_SUCCESS)
-          return GPTLerror ("%s rank %d: Bad return from MPI_Irecv=%d\n", thisfunc, iam, ret);
-
-        /* handshake with slave */
-        if ((ret = MPI_Send (&signal, 1, MPI_INTEGER, procid, taga, comm)) != MPI_SUCCESS)
-          return GPTLerror ("%s rank %d: Bad return from MPI_Send=%d\n", thisfunc, iam, ret);
-
-        /* wait for message from slave */
-        if ((ret = MPI_Wait (&rcvreq2, MPI_STATUS_IGNORE)) != MPI_SUCCESS)
-          return GPTLerror ("%s rank %d: Bad return from MPI_Wait=%d\n", thisfunc, iam, ret);
-
-        if (count_slave != 0) { /* if slave had no events, then nothing needs to be done*/
-
-          if (!(sort_master = (char **) malloc( (*count) * sizeof (char *) ) ) && (*count))
-            return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-          if (!(newtimers = (char **) malloc( count_slave * sizeof (char *) ) ))
-            return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-          if (!(sort_slave = (char **) malloc( count_slave * sizeof (char *) ) ))
-            return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-          if (!(summarystats_slave = (Summarystats *) malloc( count_slave * sizeof (Summarystats) ) ))
-            return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-          if (!(timers_slave = (char *) malloc( count_slave * (MAX_CHARS + 1) * sizeof (char) ) ))
-            return GPTLerror ("%s: memory allocation failed\n", thisfunc);
-
-          if ((ret = MPI_Irecv (timers_slave, count_slave * (MAX_CHARS + 1), MPI_CHAR, procid, tagb, comm, &rcvreq3)) != MPI_SUCCESS)
-            return GPTLerror ("%s rank %d: Bad return from MPI_Irecv=%d\n", thisfunc, iam, ret);
-          if ((ret = MPI_Irecv (summarystats_slave, count_slave * sizeof(Summarystats), MPI_BYTE, procid, tagc, comm, &rcvreq1)) != MPI_SUCCESS)
-            return GPTLerror ("%s rank %d: Bad return from MPI_Irecv=%d\n", thisfunc, iam, ret);
-          if ((ret = MPI_Send (&signal, 1, MPI_INT, procid, tagb, comm)) != MPI_SUCCESS)
-            return GPTLerror ("%s rank %d: Bad return from MPI_Send=%d\n", thisfunc, iam, ret);
-          if ((ret = MPI_Wait (&rcvreq1, MPI_STATUS_IGNORE)) != MPI_SUCCESS)
-            return GPTLerror ("%s rank %d: Bad return from MPI_Wait=%d\n", thisfunc, iam, ret);
-          if ((ret = MPI_Wait (&rcvreq3, MPI_STATUS_IGNORE)) != MPI_SUCCESS)
-            return GPTLerror ("%s rank %d: Bad return from MPI_Wait=%d\n", thisfunc, iam, ret);
-
-          x = 0;
-          for (k = 0; k < count_slave; k++) {
-            sort_slave[k] = timers_slave + x;
-            x += MAX_CHARS + 1;
-          }
-          x = 0;
-          for (k = 0; k < *count; k++) {
-            sort_master[k] = timerlist[0] + x;
-            x += MAX_CHARS + 1;
-          }
-
-          qsort(sort_master, *count, sizeof(char*), cmp);
-          qsort(sort_slave, count_slave, sizeof(char*), cmp);
-
-          num_newtimers = 0;
-          n = 0;
-          k = 0;
-          while (k < *count && n < count_slave)
-          {
-            compare = strcmp(sort_master[k], sort_slave[n]);
-
-            if (compare == 0) {
-              /* matching timers found */
-
-              /* find element number of the name in original timerlist so that it can be matched with its summarystats */
-              m_index = get_index( timerlist[0], sort_master[k] );
-
-              s_index = get_index( timers_slave, sort_slave[n] );
-              get_summarystats (&summarystats[m_index], &summarystats_slave[s_index]);
-              k++;
-              n++;
-              continue;
-            }
-
-            if (compare > 0) {
-              /* s1 >s2 . slave has event; master does not */
-              newtimers[num_newtimers] = sort_slave[n];
-              num_newtimers++;
-              n++;
-              continue;
-            }
-
-            if (compare < 0) /* only master has event; nothing needs to be done */
-              k++;
-          }
-
-          while (n < count_slave) {
-            /* add all remaining timers which only the slave has */
-            newtimers[num_newtimers] = sort_slave[n];
-            num_newtimers++;
-            n++;
-          }
-
-          /* sort by memory address to get original order */
-          qsort (newtimers, num_newtimers, sizeof(char*), ncmp);
-
-          /* reallocate to hold new timer names and summary stats from slave */
-          if (!(timerlist[0] = realloc( timerlist[0], length * (*count + num_newtimers) * sizeof (char) ) ))
-            return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
-          if (!(summarystats = realloc( summarystats, (*count + count_slave ) * sizeof (Summarystats) ) ))
-            return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
-
-          k = *count;
-          x = *count * (MAX_CHARS + 1);
-          for (n = 0; n < num_newtimers; n++) {
-            /* copy new timers names and new timer data */
-            memcpy(timerlist[0] + x, newtimers[n], length * sizeof (char));
-            s_index = get_index( timers_slave, newtimers[n] );
-            memcpy(&summarystats[k], &summarystats_slave[s_index], sizeof (Summarystats));
-            k++;
-            x += MAX_CHARS + 1;
-          }
-          *count += num_newtimers;
-
-          free(timers_slave);
-          free(summarystats_slave);
-          free(newtimers);
-          free(sort_slave);
-          free(sort_master);
-        }
+  /* Map local timers into the global index, and fill the fixed-layout records */
 
-      }
+  sr->nglobal = nglobal;
+  sr->gidx   = (int *) GPTLallocate (MAX (sr->count, 1) * sizeof (int));
+  sr->lidx   = (int *) GPTLallocate (MAX (nglobal, 1) * sizeof (int));
+  sr->owner  = (int *) GPTLallocate (MAX (nglobal, 1) * sizeof (int));
+  sr->global = (Summarystats *) GPTLallocate (MAX (nglobal, 1) * sizeof (Summarystats));
+  if ( ! sr->gidx || ! sr->lidx || ! sr->owner || ! sr->global)
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  if (dohist && ! (sr->ghist = (unsigned long *) calloc (MAX (nglobal, 1) * HIST_NBINS, sizeof (unsigned long))))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
 
-    }
-    else if ( (iam % step) == 0 ) {
-      /* non masters send data */
+  memset (sr->global, 0, nglobal * sizeof (Summarystats));
+  for (g = 0; g < nglobal; g++) {
+    sr->lidx[g] = -1;
+    sr->owner[g] = sr->nproc;
+  }
+  for (k = 0; k < sr->count; k++) {
+    h = namehash64 (sr->names[k]);
+    found = (unsigned long long *) bsearch (&h, hashes, nglobal, sizeof (unsigned long long), cmp_hash64);
+    g = sr->gidx[k] = found - hashes;
+    sr->lidx[g] = k;
+    sr->owner[g] = iam;
+    sr->global[g] = sr->storage[k];
+    if (sr->ghist)
+      memcpy (sr->ghist + g*HIST_NBINS, sr->hist + k*HIST_NBINS, HIST_NBINS * sizeof (unsigned long));
+  }
+  free (hashes);
+
+  if ((ret = MPI_Type_contiguous (sizeof (Summarystats), MPI_BYTE, &sr->rectype)) != MPI_SUCCESS ||
+      (ret = MPI_Type_commit (&sr->rectype)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Type_contiguous=%d\n", thisfunc, iam, ret);
+  if ((ret = MPI_Op_create (summary_op, 0, &sr->op)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Op_create=%d\n", thisfunc, iam, ret);
 
-      procid = iam - step;
+  /*
+  ** The stats records, the histograms and the lowest rank having each timer
+  ** (to name it) are independent, so all three are in flight at once
+  */
 
-      /* wait for ready signal from master */
-      if ((ret = MPI_Recv (&signal, 1, MPI_INTEGER, procid, taga, comm, MPI_STATUS_IGNORE)) != MPI_SUCCESS)
-        return GPTLerror ("%s rank %d: Bad return from MPI_Recv=%d\n", thisfunc, iam, ret);
+#if MPI_VERSION >= 3
+  if ((ret = MPI_Ireduce (iam == 0 ? MPI_IN_PLACE : sr->global, sr->global, nglobal, sr->rectype,
+			  sr->op, 0, sr->comm, &sr->req[0])) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Ireduce=%d\n", thisfunc, iam, ret);
+  if (sr->ghist &&
+      (ret = MPI_Ireduce (iam == 0 ? MPI_IN_PLACE : sr->ghist, sr->ghist, nglobal*HIST_NBINS,
+			  MPI_UNSIGNED_LONG, MPI_SUM, 0, sr->comm, &sr->req[1])) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Ireduce=%d\n", thisfunc, iam, ret);
+  if ((ret = MPI_Iallreduce (MPI_IN_PLACE, sr->owner, nglobal, MPI_INT, MPI_MIN, sr->comm,
+			     &sr->req[2])) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Iallreduce=%d\n", thisfunc, iam, ret);
+#else
+  if ((ret = MPI_Reduce (iam == 0 ? MPI_IN_PLACE : sr->global, sr->global, nglobal, sr->rectype,
+			 sr->op, 0, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Reduce=%d\n", thisfunc, iam, ret);
+  if (sr->ghist &&
+      (ret = MPI_Reduce (iam == 0 ? MPI_IN_PLACE : sr->ghist, sr->ghist, nglobal*HIST_NBINS,
+			 MPI_UNSIGNED_LONG, MPI_SUM, 0, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Reduce=%d\n", thisfunc, iam, ret);
+  if ((ret = MPI_Allreduce (MPI_IN_PLACE, sr->owner, nglobal, MPI_INT, MPI_MIN, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Allreduce=%d\n", thisfunc, iam, ret);
+#endif
+#endif
+  return 0;
+}
 
-      if ((ret = MPI_Send (count, 1, MPI_INTEGER, procid, taga, comm)) != MPI_SUCCESS)
-        return GPTLerror ("%s rank %d: Bad return from MPI_Send=%d\n", thisfunc, iam, ret);
+static int collect_end (Summaryreq *sr)
+{
+#ifdef HAVE_MPI
+  const int iam = sr->iam;
+  const int nglobal = sr->nglobal;
+  const int length = MAX_CHARS + 1; /* spacing between timer names sent to root */
+  int ret;
+  int n, g, k, r;                  /* counters */
+  int nsend;                       /* number of names this rank sends to root */
+  int nnew;                        /* number of names root receives */
+  int *rcounts = 0;                /* per-rank receive counts (root) */
+  int *displs = 0;                 /* per-rank receive displacements (root) */
+  int *order;                      /* global index of each output entry (root) */
+  char *sendnames;                 /* names this rank owns but root lacks */
+  char *newnames = 0;              /* names root lacks (root) */
+  static const char *thisfunc = "collect_end";
+
+  if (sr->nproc < 2)
+    return 0;
 
-      if ( count != 0) {
-        if ((ret = MPI_Recv (&signal, 1, MPI_INTEGER, procid, tagb, comm, MPI_STATUS_IGNORE)) != MPI_SUCCESS)
-          return GPTLerror ("%s rank %d: Bad return from MPI_Recv=%d\n", thisfunc, iam, ret);
-        if ((ret = MPI_Send (timerlist[0], (*count) * (MAX_CHARS + 1), MPI_CHAR, procid, tagb, comm)) != MPI_SUCCESS)
-          return GPTLerror ("%s rank %d: Bad return from MPI_Send=%d\n", thisfunc, iam, ret);
-        if ((ret = MPI_Send (summarystats, (*count) * sizeof(Summarystats), MPI_BYTE, procid, tagc, comm)) != MPI_SUCCESS)
-          return GPTLerror ("%s rank %d: Bad return from MPI_Send=%d\n", thisfunc, iam, ret);
-      }
-      free(tempname);
-      *summarystats_cumul = summarystats;
-      return 0;
+  ret = MPI_Waitall (3, sr->req, MPI_STATUSES_IGNORE);
+  (void) MPI_Op_free (&sr->op);
+  (void) MPI_Type_free (&sr->rectype);
+  if (ret != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Waitall=%d\n", thisfunc, iam, ret);
 
-    }
+  /*
+  ** Names: root already has its own. Every other timer is named by the
+  ** lowest rank having it, sending names in increasing global index order.
+  */
 
-    step = mstep;
-    mstep = 2 * mstep;
+  for (nsend = 0, g = 0; g < nglobal; g++)
+    if (sr->owner[g] == iam && iam != 0)
+      ++nsend;
+  if ( ! (sendnames = (char *) malloc (MAX (nsend, 1) * length)))
+    return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  for (n = 0, g = 0; g < nglobal; g++)
+    if (sr->owner[g] == iam && iam != 0)
+      strncpy (sendnames + (n++)*length, sr->names[sr->lidx[g]], length);
 
+  if (iam == 0) {
+    rcounts = (int *) GPTLallocate (sr->nproc * sizeof (int));
+    displs  = (int *) GPTLallocate (sr->nproc * sizeof (int));
+    if ( ! rcounts || ! displs)
+      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
   }
+  nsend *= length;
+  if ((ret = MPI_Gather (&nsend, 1, MPI_INT, rcounts, 1, MPI_INT, 0, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Gather=%d\n", thisfunc, iam, ret);
 
-#endif
-
-  free(tempname);
-  *summarystats_cumul = summarystats;
-  return 0;
-}
+  nnew = 0;
+  if (iam == 0) {
+    for (r = 0; r < sr->nproc; r++) {
+      displs[r] = nnew;
+      nnew += rcounts[r];
+    }
+    if ( ! (newnames = (char *) malloc (MAX (nnew, 1))))
+      return GPTLerror ("%s: memory allocation failed\n", thisfunc);
+  }
+  if ((ret = MPI_Gatherv (sendnames, nsend, MPI_CHAR, newnames, rcounts, displs, MPI_CHAR,
+			  0, sr->comm)) != MPI_SUCCESS)
+    return GPTLerror ("%s rank %d: Bad return from MPI_Gatherv=%d\n", thisfunc, iam, ret);
 
-/*
-** get_index: calculates the index number of an element in a list
-** based on the start memory address and memory address of the element
-** where each element is MAX_CHARS+1 long
-**
-** Input arguments:
-**   list: start address of list
-**   element: start address of element
-**
-** Return value: index of element in list
-*/
+  /*
+  ** Root output order: its own timers in their usual order, then the rest
+  ** grouped by the rank that named them.
+  */
 
-int get_index( const char * list,
-               const char * element )
-{
-  return (( element - list ) / ( MAX_CHARS  + 1 ));
-}
+  if (iam == 0) {
+    order = (int *) GPTLallocate (MAX (nglobal, 1) * sizeof (int));
+    if ( ! (sr->names = (const char **) realloc (sr->names, MAX (nglobal, 1) * sizeof (char *))) ||
+	 ! (sr->storage = (Summarystats *) realloc (sr->storage, MAX (nglobal, 1) * sizeof (Summarystats))))
+      return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
+    if (dohist && ! (sr->hist = (unsigned long *) realloc (sr->hist, MAX (nglobal, 1) * HIST_NBINS * sizeof (unsigned long))))
+      return GPTLerror ("%s: memory reallocation failed\n", thisfunc);
+
+    for (k = 0; k < sr->count; k++)
+      order[k] = sr->gidx[k];
+    n = 0;
+    for (r = 1; r < sr->nproc; r++)
+      for (g = 0; g < nglobal; g++)
+	if (sr->owner[g] == r) {
+	  order[k] = g;
+	  sr->names[k] = newnames + (n++)*length;
+	  ++k;
+	}
+    sr->count = k;
+    sr->namebuf = newnames;
 
+    for (k = 0; k < sr->count; k++) {
+      sr->storage[k] = sr->global[order[k]];
+      if (dohist)
+	memcpy (sr->hist + k*HIST_NBINS, sr->ghist + order[k]*HIST_NBINS, HIST_NBINS * sizeof (unsigned long));
+    }
 
-/*
-** cmp: returns value from strcmp. for use with qsort
-*/
+    free (order);
+    free (rcounts);
+    free (displs);
+  }
 
-static int cmp(const void *pa, const void *pb)
-{
-  const char** x = (const char**)pa;
-  const char** y = (const char**)pb;
-  return strcmp(*x, *y);
+  free (sendnames);
+#endif
+  return 0;
 }
 
-
 /*
-** ncmp: compares values of memory adresses pointed to by a pointer. for use with qsort
+** free_summaryreq: Free the space held by a summary
 */
 
-static int ncmp( const void *pa, const void *pb )
+static void free_summaryreq (Summaryreq *sr)
 {
-  static const char *thisfunc = "GPTLsetoption";
-  const char** x = (const char**)pa;
-  const char** y = (const char**)pb;
-
-  if( *x > *y )
-    return 1;
-  if( *x < *y )
-    return -1;
-  if( *x == *y )
-    GPTLerror("%s: shared memory address between timers\n", thisfunc);
+  free (sr->names);
+  free (sr->namebuf);
+  free (sr->storage);
+  free (sr->hist);
+#ifdef HAVE_MPI
+  free (sr->gidx);
+  free (sr->lidx);
+  free (sr->owner);
+  free (sr->global);
+  free (sr->ghist);
+#endif
+  memset (sr, 0, sizeof (Summaryreq));
 }
 
 /*
-** get_threadstats: gather stats for timer "name" over all threads
+** add_threadstats: add the stats of one thread's timer to the stats of that
+**   timer over all threads
 **
 ** Input arguments:
 **   iam:   MPI process id
-**   name:  timer name
-** Output arguments:
-**   summarystats: max/min stats over all threads
+**   t:     thread index
+**   ptr:   timer on thread t
+** Input/Output arguments:
+**   summarystats: max/min stats over the threads added so far
+**   hist: if not NULL, the timer's latency histograms summed over threads
 */
 
-void get_threadstats (const int iam,
-                      const char *name,
-		      Summarystats *summarystats)
+static void add_threadstats (const int iam,
+			     const int t,
+			     const Timer *ptr,
+			     Summarystats *summarystats,
+			     unsigned long *hist)
 {
-#ifdef HAVE_PAPI
-  int n;                /* event index */
-#endif
-  int t;                /* thread index */
-  unsigned int indx;    /* returned from getentry() */
-  Timer *ptr;           /* timer */
-
-  /*
-  ** This memset fortuitiously initializes the process values (_p) to master (0)
-  */
-
-  memset (summarystats, 0, sizeof (Summarystats));
-
-  summarystats->wallmax_p = iam;
-  summarystats->wallmin_p = iam;
-
-  for (t = 0; t < nthreads; ++t) {
-    if ((ptr = getentry (hashtable[t], name, &indx))) {
+  int n;                /* event or histogram bin index */
+
+  if (ptr->onflg)
+    summarystats->onflgs++;
+
+  if (ptr->count > 0) {
+    summarystats->threads++;
+    summarystats->walltotal += ptr->wall.accum;
+    summarystats->selftotal += ptr->self_wall;
+    summarystats->selfmax = MAX (summarystats->selfmax, ptr->self_wall);
+    if (summarystats->threads == 1) {
+      summarystats->rssdeltamax = summarystats->rssdeltamin = ptr->rss_delta;
+      summarystats->rsspeakmax  = summarystats->rsspeakmin  = ptr->rss_peak;
+    } else {
+      summarystats->rssdeltamax = MAX (summarystats->rssdeltamax, ptr->rss_delta);
+      summarystats->rssdeltamin = MIN (summarystats->rssdeltamin, ptr->rss_delta);
+      summarystats->rsspeakmax  = MAX (summarystats->rsspeakmax,  ptr->rss_peak);
+      summarystats->rsspeakmin  = MIN (summarystats->rsspeakmin,  ptr->rss_peak);
+    }
+  }
+  summarystats->count += ptr->count;
 
-      if (ptr->onflg)
-        summarystats->onflgs++;
+  if (ptr->wall.accum > summarystats->wallmax) {
+    summarystats->wallmax   = ptr->wall.accum;
+    summarystats->wallmax_t = t;
+  }
 
-      if (ptr->count > 0) {
-        summarystats->threads++;
-        summarystats->walltotal += ptr->wall.accum;
-      }
-      summarystats->count += ptr->count;
+  if (ptr->wall.accum < summarystats->wallmin || summarystats->wallmin == 0.) {
+    summarystats->wallmin   = ptr->wall.accum;
+    summarystats->wallmin_t = t;
+  }
 
-      if (ptr->wall.accum > summarystats->wallmax) {
-	summarystats->wallmax   = ptr->wall.accum;
-	summarystats->wallmax_t = t;
-      }
+  if (ptr->count > 0) {
+    if (ptr->wall.max > summarystats->callmax)
+      summarystats->callmax = ptr->wall.max;
+    if (ptr->wall.min < summarystats->callmin || summarystats->threads == 1)
+      summarystats->callmin = ptr->wall.min;
+  }
 
-      if (ptr->wall.accum < summarystats->wallmin || summarystats->wallmin == 0.) {
-	summarystats->wallmin   = ptr->wall.accum;
-	summarystats->wallmin_t = t;
-      }
+  if (hist && ptr->hist)
+    for (n = 0; n < HIST_NBINS; ++n)
+      hist[n] += ptr->hist[n];
 #ifdef HAVE_PAPI
-      for (n = 0; n < nevents; ++n) {
-	double value;
-	if (GPTL_PAPIget_eventvalue (eventlist[n].namestr, &ptr->aux, &value) != 0) {
-	  fprintf (stderr, "Bad return from GPTL_PAPIget_eventvalue\n");
-	  return;
-	}
-        summarystats->papimax_p[n] = iam;
-        summarystats->papimin_p[n] = iam;
+  for (n = 0; n < nevents; ++n) {
+    double value;
+    if (GPTL_PAPIget_eventvalue (eventlist[n].namestr, &ptr->aux, &value) != 0) {
+      fprintf (stderr, "Bad return from GPTL_PAPIget_eventvalue\n");
+      return;
+    }
+    summarystats->papimax_p[n] = iam;
+    summarystats->papimin_p[n] = iam;
 
-	if (value > summarystats->papimax[n]) {
-	  summarystats->papimax[n]   = value;
-	  summarystats->papimax_t[n] = t;
-	}
+    if (value > summarystats->papimax[n]) {
+      summarystats->papimax[n]   = value;
+      summarystats->papimax_t[n] = t;
+    }
 
-	if (value < summarystats->papimin[n] || summarystats->papimin[n] == 0.) {
-	  summarystats->papimin[n]   = value;
-	  summarystats->papimin_t[n] = t;
-	}
-	summarystats->papitotal[n] += value;
-      }
-#endif
+    if (value < summarystats->papimin[n] || summarystats->papimin[n] == 0.) {
+      summarystats->papimin[n]   = value;
+      summarystats->papimin_t[n] = t;
     }
+    summarystats->papitotal[n] += value;
   }
-  if ( summarystats->count ) summarystats->processes = 1;
+#endif
 }
 
 /*
@@ -4159,9 +7505,15 @@ void get_threadstats (const int iam,
 void get_summarystats (Summarystats *summarystats,
 		       const Summarystats *summarystats_slave)
 {
+  /* Timers left on, and where they exist, count even if never stopped */
+  summarystats->onflgs    += summarystats_slave->onflgs;
+  summarystats->processes += summarystats_slave->processes;
+  summarystats->threads   += summarystats_slave->threads;
+
   if (summarystats_slave->count == 0) return;
 
-  if (summarystats_slave->wallmax > summarystats->wallmax) {
+  if ((summarystats_slave->wallmax > summarystats->wallmax) ||
+      (summarystats->count == 0)) {
     summarystats->wallmax   = summarystats_slave->wallmax;
     summarystats->wallmax_p = summarystats_slave->wallmax_p;
     summarystats->wallmax_t = summarystats_slave->wallmax_t;
@@ -4178,7 +7530,8 @@ void get_summarystats (Summarystats *summarystats,
   {
     int n;
     for (n = 0; n < nevents; ++n) {
-      if (summarystats_slave->papimax[n] > summarystats->papimax[n]) {
+      if ((summarystats_slave->papimax[n] > summarystats->papimax[n]) ||
+          (summarystats->count == 0)) {
 	summarystats->papimax[n]   = summarystats_slave->papimax[n];
 	summarystats->papimax_p[n] = summarystats_slave->papimax_p[n];
 	summarystats->papimax_t[n] = summarystats_slave->papimax_t[n];
@@ -4195,11 +7548,29 @@ void get_summarystats (Summarystats *summarystats,
   }
 #endif
 
-  summarystats->onflgs    += summarystats_slave->onflgs;
+  if ((summarystats_slave->callmax > summarystats->callmax) ||
+      (summarystats->count == 0))
+    summarystats->callmax = summarystats_slave->callmax;
+  if ((summarystats_slave->callmin < summarystats->callmin) ||
+      (summarystats->count == 0))
+    summarystats->callmin = summarystats_slave->callmin;
+
+  if (summarystats->count == 0) {
+    summarystats->rssdeltamax = summarystats_slave->rssdeltamax;
+    summarystats->rssdeltamin = summarystats_slave->rssdeltamin;
+    summarystats->rsspeakmax  = summarystats_slave->rsspeakmax;
+    summarystats->rsspeakmin  = summarystats_slave->rsspeakmin;
+  } else {
+    summarystats->rssdeltamax = MAX (summarystats->rssdeltamax, summarystats_slave->rssdeltamax);
+    summarystats->rssdeltamin = MIN (summarystats->rssdeltamin, summarystats_slave->rssdeltamin);
+    summarystats->rsspeakmax  = MAX (summarystats->rsspeakmax,  summarystats_slave->rsspeakmax);
+    summarystats->rsspeakmin  = MIN (summarystats->rsspeakmin,  summarystats_slave->rsspeakmin);
+  }
+
   summarystats->count     += summarystats_slave->count;
   summarystats->walltotal += summarystats_slave->walltotal;
-  summarystats->processes += summarystats_slave->processes;
-  summarystats->threads   += summarystats_slave->threads;
+  summarystats->selftotal += summarystats_slave->selftotal;
+  summarystats->selfmax    = MAX (summarystats->selfmax, summarystats_slave->selfmax);
 }
 
 /*
@@ -4312,7 +7683,7 @@ int GPTLquery (const char *timername,
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -4320,7 +7691,7 @@ int GPTLquery (const char *timername,
     name = timername;
   }
 
-  ptr = getentry (hashtable[t], name, &indx);
+  ptr = getentry (&perthread[t].hashtable, name, &indx);
   if ( !ptr)
     return GPTLerror ("%s: requested timer %s does not have a name hash\n", thisfunc, name);
 
@@ -4380,7 +7751,7 @@ int GPTLquerycounters (const char *timername,
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -4388,7 +7759,7 @@ int GPTLquerycounters (const char *timername,
     name = timername;
   }
 
-  ptr = getentry (hashtable[t], name, &indx);
+  ptr = getentry (&perthread[t].hashtable, name, &indx);
   if ( !ptr)
     return GPTLerror ("%s: requested timer %s does not have a name hash\n", thisfunc, name);
 
@@ -4447,7 +7818,7 @@ int GPTLget_wallclock (const char *timername,
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -4460,11 +7831,11 @@ int GPTLget_wallclock (const char *timername,
   ** *_instr() or not, so try both possibilities
   */
 
-  ptr = getentry (hashtable[t], name, &indx);
+  ptr = getentry (&perthread[t].hashtable, name, &indx);
   if ( !ptr) {
     if (sscanf (timername, "%lx", (unsigned long *) &self) < 1)
       return GPTLerror ("%s: requested timer %s does not exist\n", thisfunc, timername);
-    ptr = getentry_instr (hashtable[t], self, &indx);
+    ptr = getentry_instr (&perthread[t].hashtable, self, &indx);
     if ( !ptr)
       return GPTLerror ("%s: requested timer %s does not exist\n", thisfunc, timername);
   }
@@ -4518,7 +7889,7 @@ int GPTLstartstop_vals (const char *timername, /* timer name */
   ** and assign the name pointer to the new string.
   ** Otherwise assign the name pointer to the original string.
   */
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -4527,7 +7898,10 @@ int GPTLstartstop_vals (const char *timername, /* timer name */
   }
 
   /* Find out if the timer already exists */
-  ptr = getentry (hashtable[t], name, &indx);
+  ptr = getentry (&perthread[t].hashtable, name, &indx);
+
+  if (ptr && ptr->filtered)
+    return 0;
 
   if (ptr) {
     /*
@@ -4548,8 +7922,10 @@ int GPTLstartstop_vals (const char *timername, /* timer name */
       return GPTLerror ("%s: Error from GPTLstop\n", thisfunc);
 
     /* start/stop pair just called should guarantee ptr will be found */
-    if ( ! (ptr = getentry (hashtable[t], name, &indx)))
+    if ( ! (ptr = getentry (&perthread[t].hashtable, name, &indx)))
       return GPTLerror ("%s: Unexpected error from getentry\n", thisfunc);
+    if (ptr->filtered)
+      return 0;
 
     /*
     ** If add_count >= 0, then set count to desired value.
@@ -4688,7 +8064,7 @@ int GPTLstartstop_valsf (const char *timername,  /* timer name */
   ** and assign the name pointer to the new string.
   ** Otherwise assign the name pointer to the original string.
   */
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
   } else {
@@ -4697,7 +8073,10 @@ int GPTLstartstop_valsf (const char *timername,  /* timer name */
   }
 
   /* Find out if the timer already exists */
-  ptr = getentryf (hashtable[t], name, numchars, &indx);
+  ptr = getentryf (&perthread[t].hashtable, name, numchars, &indx);
+
+  if (ptr && ptr->filtered)
+    return 0;
 
   if (ptr) {
     /*
@@ -4718,8 +8097,10 @@ int GPTLstartstop_valsf (const char *timername,  /* timer name */
       return GPTLerror ("%s: Error from GPTLstop\n", thisfunc);
 
     /* start/stop pair just called should guarantee ptr will be found */
-    if ( ! (ptr = getentryf (hashtable[t], name, numchars, &indx)))
+    if ( ! (ptr = getentryf (&perthread[t].hashtable, name, numchars, &indx)))
       return GPTLerror ("%s: Unexpected error from getentry\n", thisfunc);
+    if (ptr->filtered)
+      return 0;
 
     /*
     ** If add_count >= 0, then set count to desired value.
@@ -4859,7 +8240,7 @@ int GPTLget_eventvalue (const char *timername,
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -4872,11 +8253,11 @@ int GPTLget_eventvalue (const char *timername,
   ** *_instr() or not, so try both possibilities
   */
 
-  ptr = getentry (hashtable[t], name, &indx);
+  ptr = getentry (&perthread[t].hashtable, name, &indx);
   if ( !ptr) {
     if (sscanf (timername, "%lx", (unsigned long *) &self) < 1)
       return GPTLerror ("%s: requested timer %s does not exist\n", thisfunc, timername);
-    ptr = getentry_instr (hashtable[t], self, &indx);
+    ptr = getentry_instr (&perthread[t].hashtable, self, &indx);
     if ( !ptr)
       return GPTLerror ("%s: requested timer %s does not exist\n", thisfunc, timername);
   }
@@ -4920,7 +8301,7 @@ int GPTLget_nregions (int t,
   }
 
   *nregions = 0;
-  for (ptr = timers[t]->next; ptr; ptr = ptr->next)
+  for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next)
     ++*nregions;
 
   return 0;
@@ -4963,7 +8344,7 @@ int GPTLget_regionname (int t,      /* thread number */
       return GPTLerror ("%s: requested thread %d is too big\n", thisfunc, t);
   }
 
-  ptr = timers[t]->next;
+  ptr = perthread[t].timers->next;
   for (i = 0; i < region; i++) {
     if ( ! ptr)
       return GPTLerror ("%s: timer number %d does not exist in thread %d\n", thisfunc, region, t);
@@ -4986,6 +8367,84 @@ int GPTLget_regionname (int t,      /* thread number */
   return 0;
 }
 
+/*
+** GPTLquery_all: return the stats of every timer on every thread in one call,
+**   by walking the per-thread timer lists instead of looking each name up in
+**   the hash tables. Results are stored as a struct of arrays: row i
+**   describes one timer on thread thread[i]. Rows are ordered by thread, and
+**   within a thread in the same order as GPTLget_regionname.
+**
+** Input args:
+**   maxtimers: number of rows the output arrays can hold. If 0, only ntimers
+**              is returned, so the caller can size the arrays
+**   nc:        number of chars in each name (names has maxtimers*nc chars)
+**
+** Output args:
+**   ntimers:   number of timers summed over all threads
+**   thread:    thread number of each timer
+**   names:     timer names, nc chars each (null padded if shorter than nc).
+**              May be NULL if the caller already has the names
+**   count:     number of start/stop calls
+**   accum:     accumulated wallclock time
+**   max:       longest start/stop interval
+**   min:       shortest start/stop interval
+**   onflg:     whether the timer is currently on
+**
+** Return value: 0 (success) or GPTLerror (e.g. maxtimers too small)
+*/
+
+int GPTLquery_all (int maxtimers,
+		   int *ntimers,
+		   int *thread,
+		   char *names,
+		   int nc,
+		   int *count,
+		   double *accum,
+		   double *max,
+		   double *min,
+		   int *onflg)
+{
+  Timer *ptr;  /* walk through linked list */
+  int t;       /* thread index */
+  int n;       /* row index */
+  int ncpy;    /* number of characters to copy */
+  static const char *thisfunc = "GPTLquery_all";
+
+  if ( ! initialized)
+    return GPTLerror ("%s: GPTLinitialize has not been called\n", thisfunc);
+
+  n = 0;
+  for (t = 0; t < nthreads; ++t)
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next)
+      ++n;
+  *ntimers = n;
+
+  if (maxtimers == 0)
+    return 0;
+  if (n > maxtimers)
+    return GPTLerror ("%s: %d timers do not fit in maxtimers=%d\n", thisfunc, n, maxtimers);
+  if (names && nc < 1)
+    return GPTLerror ("%s: nc=%d must be positive\n", thisfunc, nc);
+
+  n = 0;
+  for (t = 0; t < nthreads; ++t) {
+    for (ptr = perthread[t].timers->next; ptr; ptr = ptr->next, ++n) {
+      thread[n] = t;
+      count[n]  = ptr->count;
+      accum[n]  = ptr->wall.accum;
+      max[n]    = ptr->wall.max;
+      min[n]    = ptr->wall.min;
+      onflg[n]  = ptr->onflg;
+      if (names) {
+	ncpy = MIN (nc, strlen (ptr->name));
+	memcpy (names + (size_t) n * nc, ptr->name, ncpy);
+	memset (names + (size_t) n * nc + ncpy, '\0', nc - ncpy);
+      }
+    }
+  }
+  return 0;
+}
+
 /*
 ** GPTLis_initialized: Return whether GPTL has been initialized
 */
@@ -4995,85 +8454,97 @@ int GPTLis_initialized (void)
   return (int) initialized;
 }
 
+/*
+** Timer names are hashed with 32-bit FNV-1a, which mixes all characters into
+** every bit of the result, so names differing only in a suffix (comp_run_atm,
+** comp_run_lnd, ...) spread evenly over the table. The full hash value is
+** stored with each entry so most non-matching probes avoid a string compare.
+*/
+
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME  16777619U
+
 /*
 ** getentry_instr: find hash table entry and return a pointer to it
 **
 ** Input args:
-**   hashtable: the hashtable (array)
+**   hashtable: the hash table for this thread
 **   self:      input address (from -finstrument-functions)
 ** Output args:
-**   indx:      hashtable index
+**   indx:      hash value (input to update_ll_hash when entry not found)
 **
 ** Return value: pointer to the entry, or NULL if not found
 */
 
-static inline Timer *getentry_instr (const Hashentry *hashtable, /* hash table */
+static inline Timer *getentry_instr (const Hashtable *hashtable, /* hash table */
 				     void *self,                 /* address */
-				     unsigned int *indx)         /* hash index */
+				     unsigned int *indx)         /* hash value */
 {
-  int i;
-  Timer *ptr = 0;  /* return value when entry not found */
+  unsigned int i;                 /* slot index */
+  unsigned int mask;              /* hash table size minus 1 */
+  unsigned long addr;             /* address to hash */
+  const Hashslot *slot;           /* slot being probed */
 
   /*
-  ** Hash index is timer address modulo the table size
-  ** On most machines, right-shifting the address helps because linkers often
-  ** align functions on even boundaries
+  ** Hash the bytes of the address. Right-shifting first helps because
+  ** linkers often align functions on even boundaries
   */
 
-  *indx = (((unsigned long) self) >> 4) % tablesize;
-  for (i = 0; i < hashtable[*indx].nument; ++i) {
-    if (hashtable[*indx].entries[i]->address == self) {
-      ptr = hashtable[*indx].entries[i];
-      break;
-    }
+  *indx = FNV_OFFSET;
+  addr = ((unsigned long) self) >> 4;
+  for (i = 0; i < sizeof (addr); ++i, addr >>= 8) {
+    *indx ^= (addr & 0xff);
+    *indx *= FNV_PRIME;
   }
-  return ptr;
+
+  mask = hashtable->size - 1;
+  for (i = *indx & mask; (slot = &hashtable->slots[i])->entry; i = (i + 1) & mask) {
+    if (slot->hash == *indx && slot->entry->address == self)
+      return slot->entry;
+  }
+  return 0;
 }
 
 /*
 ** getentry: find the entry in the hash table and return a pointer to it.
 **
 ** Input args:
-**   hashtable: the hashtable (array)
-**   name:      string to be hashed on (specifically, summed)
+**   hashtable: the hash table for this thread
+**   name:      string to be hashed on
 ** Output args:
-**   indx:      hashtable index
+**   indx:      hash value (input to update_ll_hash when entry not found)
 **
 ** Return value: pointer to the entry, or NULL if not found
 */
 
-static inline Timer *getentry (const Hashentry *hashtable, /* hash table */
+static inline Timer *getentry (const Hashtable *hashtable, /* hash table */
 			       const char *name,           /* name to hash */
-			       unsigned int *indx)         /* hash index */
+			       unsigned int *indx)         /* hash value */
 {
-  int i;                      /* multiplier for hashing; loop index */
+  int i;                      /* character count */
+  unsigned int n;             /* slot index */
+  unsigned int mask;          /* hash table size minus 1 */
   const unsigned char *c;     /* pointer to elements of "name" */
-  Timer *ptr = 0;             /* return value when entry not found */
+  const Hashslot *slot;       /* slot being probed */
 
-  /*
-  ** Hash value is sum of: chars times their 1-based position index, modulo tablesize
-  */
-
-  *indx = 0;
+  *indx = FNV_OFFSET;
   c = (unsigned char *) name;
-  for (i = 1; *c && i < MAX_CHARS+1; ++c, ++i) {
-    *indx += (*c) * i;
+  for (i = 0; *c && i < MAX_CHARS; ++c, ++i) {
+    *indx ^= *c;
+    *indx *= FNV_PRIME;
   }
 
-  *indx %= tablesize;
-
   /*
-  ** If nument exceeds 1 there was a hash collision and we must search
-  ** linearly through an array for a match
+  ** Linear probing: search forward from the home slot until the entry or
+  ** an empty slot is found. The table is never more than half full.
   */
 
-  for (i = 0; i < hashtable[*indx].nument; i++) {
-    if (STRMATCH (name, hashtable[*indx].entries[i]->name)) {
-      ptr = hashtable[*indx].entries[i];
-      break;
-    }
+  mask = hashtable->size - 1;
+  for (n = *indx & mask; (slot = &hashtable->slots[n])->entry; n = (n + 1) & mask) {
+    if (slot->hash == *indx && STRMATCH (name, slot->entry->name))
+      return slot->entry;
   }
-  return ptr;
+  return 0;
 }
 
 /*
@@ -5082,51 +8553,45 @@ static inline Timer *getentry (const Hashentry *hashtable, /* hash table */
 **  may not be null terminated)
 **
 ** Input args:
-**   hashtable: the hashtable (array)
-**   name:      string to be hashed on (specifically, summed)
+**   hashtable: the hash table for this thread
+**   name:      string to be hashed on
 **   namelen:   number of characters in string
 ** Output args:
-**   indx:      hashtable index
+**   indx:      hash value (input to update_ll_hash when entry not found)
 **
 ** Return value: pointer to the entry, or NULL if not found
 */
 
-static inline Timer *getentryf (const Hashentry *hashtable, /* hash table */
+static inline Timer *getentryf (const Hashtable *hashtable, /* hash table */
 			        const char *name,           /* name to hash */
 			        const int  namelen,         /* length of name */
-			        unsigned int *indx)         /* hash index */
+			        unsigned int *indx)         /* hash value */
 {
-  int i;                      /* multiplier for hashing; loop index */
+  int i;                      /* character count */
   int numchars;               /* maximum number of characters to examine */
+  unsigned int n;             /* slot index */
+  unsigned int mask;          /* hash table size minus 1 */
   const unsigned char *c;     /* pointer to elements of "name" */
-  Timer *ptr = 0;             /* return value when entry not found */
+  const Hashslot *slot;       /* slot being probed */
 
   numchars = MIN (namelen, MAX_CHARS);
 
-  /*
-  ** Hash value is sum of: chars times their 1-based position index, modulo tablesize
-  */
+  /* Must produce the same value as getentry for the null terminated name */
 
-  *indx = 0;
+  *indx = FNV_OFFSET;
   c = (unsigned char *) name;
-  for (i = 1; i < numchars+1; ++c, ++i) {
-    *indx += (*c) * i;
+  for (i = 0; i < numchars; ++c, ++i) {
+    *indx ^= *c;
+    *indx *= FNV_PRIME;
   }
 
-  *indx %= tablesize;
-
-  /*
-  ** If nument exceeds 1 there was a hash collision and we must search
-  ** linearly through an array for a match
-  */
-
-  for (i = 0; i < hashtable[*indx].nument; i++) {
-    if (STRNMATCH (name, hashtable[*indx].entries[i]->name,numchars)) {
-      ptr = hashtable[*indx].entries[i];
-      break;
-    }
+  mask = hashtable->size - 1;
+  for (n = *indx & mask; (slot = &hashtable->slots[n])->entry; n = (n + 1) & mask) {
+    if (slot->hash == *indx && STRNMATCH (name, slot->entry->name, numchars) &&
+	slot->entry->name[numchars] == '\0')
+      return slot->entry;
   }
-  return ptr;
+  return 0;
 }
 
 /*
@@ -5226,6 +8691,57 @@ static float get_clockfreq ()
 
   return -1.;
 }
+
+/*
+** calibrate_clockfreq: Measure the TSC rate against CLOCK_MONOTONIC over a
+**   short interval. Unlike "cpu MHz" in /proc/cpuinfo, this is right on CPUs
+**   whose core clock scales with load.
+**
+** Return value: clock rate in MHz (or -1 on failure)
+*/
+
+static float calibrate_clockfreq ()
+{
+#ifdef HAVE_LIBRT
+  static const double interval = 0.01;  /* seconds to count cycles over */
+  struct timespec tp1, tp2;             /* CLOCK_MONOTONIC at start and end */
+  unsigned long long c1, c2;            /* TSC at start and end */
+  double delta;                         /* elapsed monotonic time */
+
+  if (clock_gettime (CLOCK_MONOTONIC, &tp1) != 0)
+    return -1.;
+  c1 = nanotime ();
+  do {
+    (void) clock_gettime (CLOCK_MONOTONIC, &tp2);
+    delta = (tp2.tv_sec - tp1.tv_sec) + 1.e-9*(tp2.tv_nsec - tp1.tv_nsec);
+  } while (delta < interval);
+  c2 = nanotime ();
+
+  if (c2 <= c1)
+    return -1.;
+  return (float) (1.e-6 * (c2 - c1) / delta);
+#else
+  return -1.;
+#endif
+}
+
+/*
+** tsc_is_invariant: Ask CPUID whether the TSC runs at a constant rate in all
+**   P-, C- and T-states (CPUID.80000007H:EDX bit 8)
+**
+** Return value: true if the TSC is known to be invariant
+*/
+
+static bool tsc_is_invariant ()
+{
+#ifdef HAVE_CPUID
+  unsigned int eax, ebx, ecx, edx;
+
+  if (__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx))
+    return (edx & (1U << 8)) != 0;
+#endif
+  return false;
+}
 #endif
 
 /*
@@ -5238,11 +8754,16 @@ static int init_nanotime ()
 {
   static const char *thisfunc = "init_nanotime";
 #ifdef HAVE_NANOTIME
-  if ((cpumhz = get_clockfreq ()) < 0)
+  if (verbose && ! tsc_is_invariant ())
+    printf ("%s: TSC is not known to be invariant: timings may drift\n", thisfunc);
+
+  tsc_calibrated = ((cpumhz = calibrate_clockfreq ()) > 0);
+  if ( ! tsc_calibrated && (cpumhz = get_clockfreq ()) < 0)
     return GPTLerror ("%s: Can't get clock freq\n", thisfunc);
 
   if (verbose)
-    printf ("%s: Clock rate = %f MHz\n", thisfunc, cpumhz);
+    printf ("%s: Clock rate = %f MHz (%s)\n", thisfunc, cpumhz,
+	    tsc_calibrated ? "calibrated" : "from /proc/cpuinfo");
 
   cyc2sec = 1./(cpumhz * 1.e6);
   return 0;
@@ -5349,6 +8870,40 @@ static inline double utr_clock_gettime ()
 #endif
 }
 
+/*
+** Same as clock_gettime, but immune to clock steps: CLOCK_MONOTONIC_RAW where
+** the system has it. Served from the vDSO without a syscall on recent kernels.
+*/
+
+static int init_clock_monotonic ()
+{
+  static const char *thisfunc = "init_clock_monotonic";
+#ifdef HAVE_LIBRT
+  struct timespec tp;
+  if (clock_gettime (GPTL_CLOCK_MONOTONIC, &tp) != 0)
+    return GPTLerror ("%s: clock_gettime failed\n", thisfunc);
+  ref_clock_monotonic = tp.tv_sec;
+  if (verbose)
+    printf ("%s: ref_clock_monotonic=%ld\n", thisfunc, (long) ref_clock_monotonic);
+  return 0;
+#else
+  return GPTLerror ("%s: not enabled\n", thisfunc);
+#endif
+}
+
+static inline double utr_clock_monotonic ()
+{
+#ifdef HAVE_LIBRT
+  struct timespec tp;
+  (void) clock_gettime (GPTL_CLOCK_MONOTONIC, &tp);
+  return (tp.tv_sec - ref_clock_monotonic) + 1.e-9*tp.tv_nsec;
+#else
+  static const char *thisfunc = "utr_clock_monotonic";
+  (void) GPTLerror ("%s: not enabled\n", thisfunc);
+  return -1.;
+#endif
+}
+
 /*
 ** High-res timer on AIX: read_real_time
 */
@@ -5429,6 +8984,201 @@ static double utr_getoverhead ()
   return 0.001 * (val2[1000] - val2[0]);
 }
 
+/*
+** utr_getresolution: Smallest step the underlying timing routine reports.
+**   Waits for one tick boundary, then measures the length of the next tick.
+**
+** Return value: resolution in seconds (or -1 if the clock never advanced)
+*/
+
+static double utr_getresolution ()
+{
+  static const int maxtries = 10000000;
+  double t0, t1;
+  int i;
+
+  t0 = (*ptr2wtimefunc)();
+  for (i = 0; i < maxtries && (t1 = (*ptr2wtimefunc)()) <= t0; ++i);
+  if (i == maxtries)
+    return -1.;
+
+  for (i = 0; i < maxtries && (t0 = (*ptr2wtimefunc)()) <= t1; ++i);
+  if (i == maxtries)
+    return -1.;
+
+  return t0 - t1;
+}
+
+/*
+** utr_is_usable: Whether an underlying timing routine can be a GPTLautoutr
+**   candidate, checked without calling its init routine (which would report
+**   an error when it is not available)
+**
+** Input arguments:
+**   option: underlying timing routine
+**
+** Return value: true if the timing routine can be used
+*/
+
+static bool utr_is_usable (const Funcoption option)
+{
+#ifdef HAVE_MPI
+  int flag = 0;
+#endif
+
+  switch (option) {
+  case GPTLgettimeofday:
+#ifdef HAVE_GETTIMEOFDAY
+    return true;
+#else
+    return false;
+#endif
+  case GPTLnanotime:
+#ifdef HAVE_NANOTIME
+    return tsc_is_invariant ();   /* a varying TSC rate is not reliable */
+#else
+    return false;
+#endif
+  case GPTLmpiwtime:
+#ifdef HAVE_MPI
+    return (MPI_Initialized (&flag) == MPI_SUCCESS && flag);
+#else
+    return false;
+#endif
+  case GPTLclockgettime:
+  case GPTLclockmonotonic:
+#ifdef HAVE_LIBRT
+    return true;
+#else
+    return false;
+#endif
+  case GPTLpapitime:
+#ifdef HAVE_PAPI
+    return true;
+#else
+    return false;
+#endif
+  case GPTLread_real_time:
+#ifdef _AIX
+    return true;
+#else
+    return false;
+#endif
+  default:
+    return false;
+  }
+}
+
+/*
+** select_utr: Initialize and time every usable underlying timing routine,
+**   and leave funcidx pointing at the one with the lowest effective cost.
+**   Ties go to the earlier entry in funclist.
+**
+** Return value: 0 (success) or -1 (no usable timing routine)
+*/
+
+static int select_utr ()
+{
+  int i, n;
+  double overhead;    /* per-call cost: best of 3 trials */
+  double resolution;  /* clock step */
+  double best = -1.;  /* lowest cost found so far */
+
+  for (i = 0; i < nfuncentries; i++) {
+    utr_cost[i] = -1.;
+    if ( ! utr_is_usable (funclist[i].option) || (*funclist[i].funcinit)() < 0)
+      continue;
+
+    ptr2wtimefunc = funclist[i].func;
+    if ((resolution = utr_getresolution ()) <= 0.)
+      continue;
+
+    overhead = utr_getoverhead ();
+    for (n = 1; n < 3; n++)
+      overhead = MIN (overhead, utr_getoverhead ());
+
+    utr_cost[i] = MAX (overhead, resolution);
+    if (verbose)
+      printf ("select_utr: %s overhead=%g resolution=%g sec\n",
+	      funclist[i].name, overhead, resolution);
+
+    if (best < 0. || utr_cost[i] < best) {
+      best = utr_cost[i];
+      funcidx = i;
+    }
+  }
+
+  return (best < 0.) ? -1 : 0;
+}
+
+/*
+** hist_bin: Histogram bin for a start/stop interval. frexp splits delta into
+**   a power of 2 (the octave) and a mantissa in [0.5,1), which picks the
+**   linear sub-bucket within the octave.
+**
+** Input arguments:
+**   delta: interval in seconds
+**
+** Return value: bin index in [0, HIST_NBINS)
+*/
+
+static inline int hist_bin (const double delta)
+{
+  int e;        /* exponent: delta is in [2^(e-1), 2^e) */
+  int bin;
+  double m;     /* mantissa */
+
+  if (delta <= 0.)
+    return 0;
+
+  m = frexp (delta, &e);
+  bin = (e - 1 - HIST_EMIN) * HIST_NSUB + (int) ((2.*m - 1.) * HIST_NSUB);
+  return (bin < 0) ? 0 : ((bin >= HIST_NBINS) ? HIST_NBINS-1 : bin);
+}
+
+/*
+** hist_percentile: Estimate a percentile from a histogram as the midpoint of
+**   the bin containing it, clamped to the observed min and max so a timer
+**   whose calls all take the same time reports that time.
+**
+** Input arguments:
+**   hist: histogram
+**   frac: percentile as a fraction (e.g. 0.95)
+**   vmin: shortest interval seen
+**   vmax: longest interval seen
+**
+** Return value: estimated percentile in seconds (0 for an empty histogram)
+*/
+
+static double hist_percentile (const unsigned long *hist,
+			       const double frac,
+			       const double vmin,
+			       const double vmax)
+{
+  int n;
+  unsigned long total = 0;   /* number of samples */
+  unsigned long target;      /* rank of the requested percentile */
+  unsigned long cum = 0;     /* running sum of bin counts */
+  double lo, width;          /* lower edge and width of the bin */
+  double val;
+
+  for (n = 0; n < HIST_NBINS; ++n)
+    total += hist[n];
+  if (total == 0)
+    return 0.;
+
+  target = (unsigned long) ceil (frac * total);
+  if (target < 1)
+    target = 1;
+
+  for (n = 0; n < HIST_NBINS-1 && (cum += hist[n]) < target; ++n);
+
+  width = ldexp (1., n / HIST_NSUB + HIST_EMIN) / HIST_NSUB;
+  lo = ldexp (1., n / HIST_NSUB + HIST_EMIN) + (n % HIST_NSUB) * width;
+  val = lo + 0.5 * width;
+  return (val < vmin) ? vmin : ((val > vmax) ? vmax : val);
+}
+
 /*
 ** printself_andchildren: Recurse through call tree, printing stats for self, then children
 */
@@ -5463,7 +9213,7 @@ Timer *GPTLgetentry (const char *timername)
   int namelen;                /* number of characters in timer name */
   unsigned int indx;          /* returned from getentry (unused) */
   char new_name[MAX_CHARS+1]; /* timer name with prefix, if there is one */
-  char *name;                 /* pointer to timer name */
+  const char *name;           /* pointer to timer name */
   static const char *thisfunc = "GPTLgetentry";
 
   if ( ! initialized) {
@@ -5482,7 +9232,7 @@ Timer *GPTLgetentry (const char *timername)
   ** Otherwise assign the name pointer to the original string.
   */
 
-  if ((prefix_len[t] > 0) || (prefix_len_nt > 0)){
+  if ((perthread[t].prefix_len > 0) || (prefix_len_nt > 0)){
     namelen = strlen(timername);
     numchars = add_prefix(new_name, timername, namelen, t);
     name = new_name;
@@ -5490,7 +9240,7 @@ Timer *GPTLgetentry (const char *timername)
     name = timername;
   }
 
-  return (getentry (hashtable[t], name, &indx));
+  return (getentry (&perthread[t].hashtable, name, &indx));
 }
 
 /*
@@ -5751,6 +9501,18 @@ static int threadinit (void)
     return GPTLerror ("PTHREADS %s: mutex init failure: ret=%d\n", thisfunc, ret);
 #endif
 
+  /*
+  ** Invalidate logical thread numbers cached by threads during any previous
+  ** GPTLinitialize/GPTLfinalize cycle.
+  */
+
+#ifdef THREAD_LOCAL
+  ++generation;
+#else
+  if ((ret = pthread_key_create (&threadkey, NULL)) != 0)
+    return GPTLerror ("PTHREADS %s: key create failure: ret=%d\n", thisfunc, ret);
+#endif
+
   /*
   ** Allocate the threadid array which maps physical thread IDs to logical IDs
   */
@@ -5792,6 +9554,10 @@ static void threadfinalize ()
 #ifdef MUTEX_API
   if ((ret = pthread_mutex_destroy ((pthread_mutex_t *) &t_mutex)) != 0)
     printf ("threadfinalize: failed attempt to destroy t_mutex: ret=%d\n", ret);
+#endif
+#ifndef THREAD_LOCAL
+  if ((ret = pthread_key_delete (threadkey)) != 0)
+    printf ("threadfinalize: failed attempt to delete threadkey: ret=%d\n", ret);
 #endif
   free ((void *) threadid);
   threadid = 0;
@@ -5801,6 +9567,8 @@ static void threadfinalize ()
 ** get_thread_num: Determine zero-based thread number of the calling thread.
 **                 Update nthreads and maxthreads if necessary.
 **                 Start PAPI counters if enabled and first call for this thread.
+**                 After the first call by a thread, its number is read from
+**                 thread-local storage. No lock is taken unless PAPI is in use.
 **
 ** Output results:
 **   nthreads: Updated number of threads
@@ -5813,98 +9581,98 @@ static inline int get_thread_num (void)
 {
   int t;                   /* logical thread number, defined by array index of found threadid */
   pthread_t mythreadid;    /* thread id from pthreads library */
-  int retval;              /* value to return to caller */
-  bool foundit = false;    /* thread id found in list */
+#ifndef THREAD_LOCAL
+  void *val;               /* thread-specific value: logical thread number + 1 */
+#endif
   static const char *thisfunc = "get_thread_num";
 
+#ifdef THREAD_LOCAL
+  if (mygeneration == generation)
+    return mythreadnum;
+#else
+  if ((val = pthread_getspecific (threadkey)))
+    return (int) ((long) val) - 1;
+#endif
+
   mythreadid = pthread_self ();
 
   /*
-  ** If our thread number has already been set in the list, we are done
-  ** VECTOR code should run a bit faster on vector machines.
+  ** First call by this thread. A thread whose id is already in the list
+  ** (e.g. a new thread which reuses the id of one that has exited) keeps the
+  ** existing logical number. Slots claimed by other threads but not yet filled
+  ** in hold -1, which never matches.
   */
-#define VECTOR
-#ifdef VECTOR
-  for (t = 0; t < nthreads; ++t)
-    if (pthread_equal (mythreadid, threadid[t])) {
-      foundit = true;
-      retval = t;
-    }
 
-  if (foundit)
-    return retval;
-#else
   for (t = 0; t < nthreads; ++t)
     if (pthread_equal (mythreadid, threadid[t]))
-      return t;
-#endif
-
-  /*
-  ** Thread id not found. Define a critical region, then start PAPI counters if
-  ** necessary and modify threadid[] with our id.
-  */
-
-  if (lock_mutex () < 0)
-    return GPTLerror ("PTHREADS %s: mutex lock failure\n", thisfunc);
+      return set_thread_num (t);
 
   /*
-  ** If our thread id is not in the known list, add to it after checking that
-  ** we do not have too many threads.
+  ** Otherwise claim the next slot atomically and fill in our id.
   */
 
-  if (nthreads >= MAX_THREADS) {
-    if (unlock_mutex () < 0)
-      fprintf (stderr, "PTHREADS %s: mutex unlock failure\n", thisfunc);
-
+  if ((t = claim_index (&nthreads, MAX_THREADS)) < 0)
     return GPTLerror ("PTHREADS %s: nthreads=%d is too big. Recompile "
 		      "with larger value of MAX_THREADS\n", thisfunc, nthreads);
-  }
 
-  threadid[nthreads] = mythreadid;
+  threadid[t] = mythreadid;
 
 #ifdef VERBOSE
   printf ("PTHREADS %s: 1st call threadid=%lu maps to location %d\n",
-	  thisfunc, (unsigned long) mythreadid, nthreads);
+	  thisfunc, (unsigned long) mythreadid, t);
 #endif
 
 #ifdef HAVE_PAPI
 
   /*
   ** When HAVE_PAPI is true, if 1 or more PAPI events are enabled,
-  ** create and start an event set for the new thread.
+  ** create and start an event set for the new thread. PAPI calls are
+  ** serialized with the mutex.
   */
 
   if (GPTLget_npapievents () > 0) {
 #ifdef VERBOSE
     printf ("PTHREADS get_thread_num: Starting EventSet threadid=%lu location=%d\n",
-	    (unsigned long) mythreadid, nthreads);
+	    (unsigned long) mythreadid, t);
 #endif
-    if (GPTLcreate_and_start_events (nthreads) < 0) {
+    if (lock_mutex () < 0)
+      return GPTLerror ("PTHREADS %s: mutex lock failure\n", thisfunc);
+
+    if (GPTLcreate_and_start_events (t) < 0) {
       if (unlock_mutex () < 0)
 	fprintf (stderr, "PTHREADS %s: mutex unlock failure\n", thisfunc);
 
       return GPTLerror ("PTHREADS %s: error from GPTLcreate_and_start_events for thread %d\n",
-			thisfunc, nthreads);
+			thisfunc, t);
     }
+
+    if (unlock_mutex () < 0)
+      return GPTLerror ("PTHREADS %s: mutex unlock failure\n", thisfunc);
   }
 #endif
 
-  /*
-  ** IMPORTANT to set return value before unlocking the mutex!!!!
-  ** "return nthreads-1" fails occasionally when another thread modifies
-  ** nthreads after it gets the mutex!
-  */
+  return set_thread_num (t);
+}
 
-  retval = nthreads++;
+/*
+** set_thread_num: Cache the logical thread number of the calling thread
+**
+** Input arguments:
+**   t: logical thread number
+**
+** Return value: t (success) or GPTLerror (failure)
+*/
 
-#ifdef VERBOSE
-  printf ("PTHREADS get_thread_num: nthreads bumped to %d\n", nthreads);
+static int set_thread_num (const int t)
+{
+#ifdef THREAD_LOCAL
+  mythreadnum = t;
+  mygeneration = generation;
+#else
+  if (pthread_setspecific (threadkey, (void *) ((long) t + 1)) != 0)
+    return GPTLerror ("PTHREADS set_thread_num: pthread_setspecific failure\n");
 #endif
-
-  if (unlock_mutex () < 0)
-    return GPTLerror ("PTHREADS %s: mutex unlock failure\n", thisfunc);
-
-  return retval;
+  return t;
 }
 
 /*
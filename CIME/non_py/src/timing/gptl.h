@@ -63,8 +63,9 @@ typedef enum {
   GPTLprint_method    = 16, /* Tree print method: first parent, last parent
 			       most frequent, or full tree (most frequent) */
   GPTLprint_mode      = 50, /* Write mode for output file (overwrite, append) */
-  GPTLtablesize       = 51, /* per-thread size of hash table (1024) */
+  GPTLtablesize       = 51, /* initial per-thread size of hash table (2048) */
   GPTLmaxthreads      = 52, /* maximum number of threads */
+  GPTLsnapshot_ring   = 53, /* records in the GPTLsnapshot ring buffer (8192) */
   /*
   ** These are derived counters based on PAPI counters. All default to false
   */
@@ -82,7 +83,17 @@ typedef enum {
   ** New ESMF options for GPTL
   */
   GPTLprofile_ovhd   = 27, /* Direct measurement of profiling overhead (false) */
-  GPTLdopr_quotes    = 28  /* Add double quotes to timer names on output (false) */
+  GPTLdopr_quotes    = 28, /* Add double quotes to timer names on output (false) */
+  GPTLhistogram      = 29, /* Keep a latency histogram per timer, print percentiles (false) */
+  GPTLdopr_binary    = 30, /* Also write binary <file>.gptb output for GPTLpr_file and
+			      GPTLpr_summary_file (false) */
+  GPTLexclusive      = 31, /* Add descendant call counts and an exclusive, overhead
+			      corrected wallclock column (false) */
+  GPTLselftime       = 32, /* Add a self (exclusive) wallclock column, and a flat
+			      profile of the given number of timers (0) */
+  GPTLtrace          = 33, /* Record every start and stop in per-thread buffers of the
+			      given number of events, written to timing.trace[.<rank>].gptb (0) */
+  GPTLmemory         = 34  /* Add resident set size growth and peak columns (false) */
 } Option;
 
 /*
@@ -97,7 +108,9 @@ typedef enum {
   GPTLmpiwtime       = 4, /* MPI_Wtime */
   GPTLclockgettime   = 5, /* clock_gettime */
   GPTLpapitime       = 6,  /* only if PAPI is available */
-  GPTLread_real_time = 3  /* AIX only */
+  GPTLread_real_time = 3, /* AIX only */
+  GPTLclockmonotonic = 7, /* clock_gettime with CLOCK_MONOTONIC_RAW */
+  GPTLautoutr        = 8  /* cheapest reliable timer, chosen by GPTLinitialize */
 } Funcoption;
 
 /*
@@ -136,10 +149,14 @@ extern int GPTLprefix_unset (void);
 extern int GPTLstart (const char *);
 extern int GPTLstart_handle (const char *, void **);
 extern int GPTLstartf (const char *, const int);
+extern int GPTLregister (const char *, int *);
+extern int GPTLregisterf (const char *, const int, int *);
+extern int GPTLstart_id (const int);
 extern int GPTLstartf_handle (const char *, const int, void **);
 extern int GPTLstop (const char *);
 extern int GPTLstopf (const char *, const int);
 extern int GPTLstop_handle (const char *, void **);
+extern int GPTLstop_id (const int);
 extern int GPTLstopf_handle (const char *, const int, void **);
 extern int GPTLstartstop_vals (const char *, double, int);
 extern int GPTLstartstop_valsf (const char *, const int, double, int);
@@ -148,24 +165,36 @@ extern int GPTLprint_mode_query (void);
 extern int GPTLprint_mode_set (const int);
 extern int GPTLpr (const int);
 extern int GPTLpr_file (const char *);
+extern int GPTLpr_summary_end (const char *);
 
 #ifdef HAVE_MPI
 extern int GPTLpr_summary (MPI_Comm comm);
 extern int GPTLpr_summary_file (MPI_Comm, const char *);
+extern int GPTLpr_summary_begin (MPI_Comm);
+extern int GPTLpr_file_mpiio (MPI_Comm, const char *, const char *, const int);
 extern int GPTLbarrier (MPI_Comm comm, const char *);
+extern int GPTLtrace_sync (MPI_Comm);
 #else
 extern int GPTLpr_summary (int);
 extern int GPTLpr_summary_file (int, const char *);
+extern int GPTLpr_summary_begin (int);
+extern int GPTLpr_file_mpiio (int, const char *, const char *, const int);
 extern int GPTLbarrier (int, const char *);
+extern int GPTLtrace_sync (int);
 #endif
 
 extern int GPTLreset (void);
+extern int GPTLsnapshot (const char *);
+extern int GPTLsnapshot_file (const char *);
 extern int GPTLfinalize (void);
 extern int GPTLget_memusage (int *, int *, int *, int *, int *);
 extern int GPTLprint_memusage (const char *);
 extern int GPTLenable (void);
 extern int GPTLdisable (void);
 extern int GPTLsetutr (const int);
+extern int GPTLset_sampling (const char *, const int);
+extern int GPTLselect_papi (const char *);
+extern int GPTLset_filter (const char *);
 extern int GPTLquery (const char *, int, int *, int *, double *, double *, double *,
 		      long long *, const int);
 extern int GPTLquerycounters (const char *, int, long long *);
@@ -173,6 +202,8 @@ extern int GPTLget_wallclock (const char *, int, double *);
 extern int GPTLget_eventvalue (const char *, const char *, int, double *);
 extern int GPTLget_nregions (int, int *);
 extern int GPTLget_regionname (int, int, char *, int);
+extern int GPTLquery_all (int, int *, int *, char *, int, int *, double *, double *,
+			  double *, int *);
 extern int GPTL_PAPIlibraryinit (void);
 extern int GPTLevent_name_to_code (const char *, int *);
 extern int GPTLevent_code_to_name (const int, char *);
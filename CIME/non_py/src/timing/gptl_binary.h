@@ -0,0 +1,95 @@
+/*
+** gptl_binary.h
+**
+** Layout of the binary timing files written when GPTLdopr_binary is set.
+** GPTLpr_file writes <outfile>.gptb next to its text output, and
+** GPTLpr_summary_file writes <outfile>.gptb next to the summary.
+**
+** A file is a sequence of self-contained segments, so segments appended by
+** successive calls in GPTLprint_append mode (e.g. one per MPI task taking
+** turns on a single file) can be read back one after another. Each segment
+** is
+**
+**   GPTLbin_header
+**   for each table:  GPTLbin_table, then ncols GPTLbin_column
+**   column data, each column 8-byte aligned
+**
+** Tables are stored by column: every column holds nrows * width values of
+** one type, so a reader can load a column with a single read. Column offsets
+** are relative to the start of the segment. Values are in the byte order of
+** the writer; readers detect a swapped file from the byteorder field.
+**
+** Task segments (GPTLBIN_TASK) hold the tables
+**   info:    1 row: utr (s), utr_overhead (d)
+**   timers:  1 row per timer per thread: thread, name, onflg, count,
+**            nrecurse, norphan, wall_accum, wall_max, wall_min, then
+**            usr, sys (GPTLcpu), hist (GPTLhistogram), papi (PAPI events)
+**   edges:   1 row per (parent, child) pair: thread, parent, child, count.
+**            parent and child are row numbers in "timers"; parent is -1
+**            for timers called from the top level
+**   events:  1 row per PAPI event: name (only if there are PAPI events)
+** Summary segments (GPTLBIN_SUMMARY) hold the single table
+**   summary: 1 row per timer: the columns of the GPTLpr_summary_file report
+** Trace segments (GPTLBIN_TRACE, in timing.trace[.<rank>].gptb with
+** GPTLtrace) each hold the events one thread recorded since its previous
+** segment:
+**   info:    1 row: thread, epoch (wallclock, s, at the GPTLtrace_sync
+**            barrier; only after GPTLtrace_sync)
+**   names:   1 row per timer new since the thread's previous segment: id, name
+**   events:  1 row per start or stop: time (wallclock, s), id, kind
+**            (GPTLBIN_TRACE_START or GPTLBIN_TRACE_STOP)
+*/
+
+#ifndef GPTL_BINARY_H
+#define GPTL_BINARY_H
+
+#define GPTLBIN_MAGIC     "GPTLBIN"   /* first 8 bytes of each segment (with the null) */
+#define GPTLBIN_VERSION   1
+#define GPTLBIN_BYTEORDER 0x01020304  /* as written by the writer */
+#define GPTLBIN_SUFFIX    ".gptb"     /* appended to the text file name */
+
+#define GPTLBIN_TASK      1           /* per-task, per-thread timers and call tree edges */
+#define GPTLBIN_SUMMARY   2           /* stats summarized over tasks and threads */
+#define GPTLBIN_TRACE     3           /* start/stop events of one thread */
+
+#define GPTLBIN_TRACE_START 0         /* event kinds in a trace segment */
+#define GPTLBIN_TRACE_STOP  1
+
+/*
+** Column types: the stored size of one value is 4 for 'i' and 'f', 8 for
+** 'd', 'q' and 'l', and 1 for 's' (a null padded string of width bytes)
+*/
+
+#define GPTLBIN_INT32   'i'
+#define GPTLBIN_FLOAT32 'f'
+#define GPTLBIN_FLOAT64 'd'
+#define GPTLBIN_INT64   'q'
+#define GPTLBIN_UINT64  'l'
+#define GPTLBIN_STRING  's'
+
+typedef struct {
+  char magic[8];            /* GPTLBIN_MAGIC */
+  int version;              /* GPTLBIN_VERSION */
+  int byteorder;            /* GPTLBIN_BYTEORDER */
+  int kind;                 /* GPTLBIN_TASK, GPTLBIN_SUMMARY or GPTLBIN_TRACE */
+  int rank;                 /* MPI rank in MPI_COMM_WORLD (-1 if unknown) */
+  int nthreads;             /* number of threads with timers */
+  int ntables;              /* number of tables in the segment */
+  long long size;           /* bytes in the segment, this header included */
+} GPTLbin_header;
+
+typedef struct {
+  char name[16];            /* table name */
+  long long nrows;          /* number of rows */
+  int ncols;                /* number of columns */
+  int pad;                  /* keeps the struct a multiple of 8 bytes */
+} GPTLbin_table;
+
+typedef struct {
+  char name[24];            /* column name */
+  int type;                 /* one of the GPTLBIN_ type codes */
+  int width;                /* values per row */
+  long long offset;         /* byte offset of the data from the segment start */
+} GPTLbin_column;
+
+#endif
@@ -155,7 +155,7 @@ static int *EventSet;                    /* list of events to be counted by PAPI
 static long_long **papicounters;         /* counters returned from PAPI */
 
 static const int BADCOUNT = -999999;     /* Set counters to this when they are bad */
-static bool is_multiplexed = false;      /* whether multiplexed (always start false)*/
+static bool is_multiplexed = false;      /* whether multiplexed: set by GPTL_PAPIinitialize, then only read */
 static bool narrowprint = true;          /* only use 8 digits not 16 for counter prints */
 static bool persec = true;               /* print PAPI stats per second */
 static bool enable_multiplexing = false; /* whether to try multiplexing */
@@ -169,6 +169,7 @@ static int papievent_is_enabled (int);
 static int already_enabled (int);
 static int enable (int);
 static int getderivedidx (int);
+static int choose_multiplexing (void);
 
 /*
 ** GPTL_PAPIsetoption: enable or disable PAPI event defined by "counter". Called
@@ -681,6 +682,52 @@ int GPTL_PAPIlibraryinit ()
   return 0;
 }
 
+/*
+** choose_multiplexing: Set is_multiplexed if the requested events cannot all
+**   be counted at once. Adds them to a trial event set, which is then
+**   destroyed. Called by GPTL_PAPIinitialize.
+**
+** Return value: 0 (success) or GPTLerror (failure)
+*/
+
+static int choose_multiplexing (void)
+{
+  int ret;                          /* return code */
+  int n;                            /* loop index over events */
+  int trial = PAPI_NULL;            /* trial event set */
+  char eventname[PAPI_MAX_STR_LEN]; /* returned from PAPI_event_code_to_name */
+
+  if ((ret = PAPI_create_eventset (&trial)) != PAPI_OK)
+    return GPTLerror ("choose_multiplexing: failure creating eventset: %s\n",
+		      PAPI_strerror (ret));
+
+  is_multiplexed = false;
+  for (n = 0; n < npapievents; n++) {
+    if ((ret = PAPI_add_event (trial, papieventlist[n])) != PAPI_OK) {
+      if (verbose) {
+	fprintf (stderr, "%s\n", PAPI_strerror (ret));
+	ret = PAPI_event_code_to_name (papieventlist[n], eventname);
+	fprintf (stderr, "choose_multiplexing: failure adding event:%s\n",
+		 eventname);
+      }
+      is_multiplexed = true;
+      break;
+    }
+  }
+
+  (void) PAPI_cleanup_eventset (trial);
+  if ((ret = PAPI_destroy_eventset (&trial)) != PAPI_OK)
+    return GPTLerror ("choose_multiplexing: %s\n", PAPI_strerror (ret));
+
+  if (is_multiplexed) {
+    if ( ! enable_multiplexing)
+      return GPTLerror ("enable_multiplexing is false: giving up\n");
+    if (verbose)
+      printf ("Trying multiplexing...\n");
+  }
+  return 0;
+}
+
 /*
 ** GPTL_PAPIinitialize(): Initialize the PAPI interface. Called from GPTLinitialize.
 **   PAPI_library_init must be called before any other PAPI routines.
@@ -722,6 +769,24 @@ int GPTL_PAPIinitialize (const int maxthreads,     /* number of threads */
     return GPTLerror ("GPTL_PAPIinitialize: PAPI_thread_init failure\n");
 #endif
 
+  /*
+  ** Multiplexing support is set up once here, not by each thread that needs
+  ** it in GPTLcreate_and_start_events
+  */
+
+  if (enable_multiplexing && (ret = PAPI_multiplex_init ()) != PAPI_OK)
+    return GPTLerror ("GPTL_PAPIinitialize: failure from PAPI_multiplex_init: %s\n",
+		      PAPI_strerror (ret));
+
+  /*
+  ** Whether the events need multiplexing is the same for every thread, so
+  ** decide it here, while serial, from a trial event set. Threads then only
+  ** read is_multiplexed.
+  */
+
+  if (npapievents > 0 && (ret = choose_multiplexing ()) != 0)
+    return GPTLerror ("GPTL_PAPIinitialize: choose_multiplexing failure\n");
+
   /* allocate and initialize static local space */
 
   EventSet     = (int *)        GPTLallocate (maxthreads * sizeof (int));
@@ -770,55 +835,19 @@ int GPTLcreate_and_start_events (const int t)  /* thread number */
   if (verbose)
     printf ("GPTLcreate_and_start_events: successfully created eventset for thread %d\n", t);
 
+  /* GPTL_PAPIinitialize has already decided whether to multiplex */
+
+  if (is_multiplexed && (ret = PAPI_set_multiplex (EventSet[t])) != PAPI_OK)
+    return GPTLerror ("GPTLcreate_and_start_events: failure from PAPI_set_multiplex: %s\n",
+		      PAPI_strerror (ret));
+
   /* Add requested events to the event set */
 
   for (n = 0; n < npapievents; n++) {
     if ((ret = PAPI_add_event (EventSet[t], papieventlist[n])) != PAPI_OK) {
-      if (verbose) {
-	fprintf (stderr, "%s\n", PAPI_strerror (ret));
-	ret = PAPI_event_code_to_name (papieventlist[n], eventname);
-	fprintf (stderr, "GPTLcreate_and_start_events: failure adding event:%s\n",
-		 eventname);
-      }
-
-      if (enable_multiplexing) {
-        if (verbose)
-	  printf ("Trying multiplexing...\n");
-	is_multiplexed = true;
-	break;
-      } else
-	return GPTLerror ("enable_multiplexing is false: giving up\n");
-    }
-  }
-
-  if (is_multiplexed) {
-
-    /* Cleanup the eventset for multiplexing */
-
-    if ((ret = PAPI_cleanup_eventset (EventSet[t])) != PAPI_OK)
-      return GPTLerror ("GPTLcreate_and_start_events: %s\n", PAPI_strerror (ret));
-
-    if ((ret = PAPI_destroy_eventset (&EventSet[t])) != PAPI_OK)
-      return GPTLerror ("GPTLcreate_and_start_events: %s\n", PAPI_strerror (ret));
-
-    if ((ret = PAPI_create_eventset (&EventSet[t])) != PAPI_OK)
-      return GPTLerror ("GPTLcreate_and_start_events: failure creating eventset: %s\n",
-			PAPI_strerror (ret));
-
-    if ((ret = PAPI_multiplex_init ()) != PAPI_OK)
-      return GPTLerror ("GPTLcreate_and_start_events: failure from PAPI_multiplex_init%s\n",
-			PAPI_strerror (ret));
-
-    if ((ret = PAPI_set_multiplex (EventSet[t])) != PAPI_OK)
-      return GPTLerror ("GPTLcreate_and_start_events: failure from PAPI_set_multiplex: %s\n",
-			PAPI_strerror (ret));
-
-    for (n = 0; n < npapievents; n++) {
-      if ((ret = PAPI_add_event (EventSet[t], papieventlist[n])) != PAPI_OK) {
-	ret = PAPI_event_code_to_name (papieventlist[n], eventname);
-	return GPTLerror ("GPTLcreate_and_start_events: failure adding event:%s\n"
-			  "  Error was: %s\n", eventname, PAPI_strerror (ret));
-      }
+      ret = PAPI_event_code_to_name (papieventlist[n], eventname);
+      return GPTLerror ("GPTLcreate_and_start_events: thread %d failure adding event:%s\n"
+			"  Error was: %s\n", t, eventname, PAPI_strerror (ret));
     }
   }
 
@@ -836,7 +865,10 @@ int GPTLcreate_and_start_events (const int t)  /* thread number */
 **   Called from GPTLstart.
 **
 ** Input args:
-**   t: thread number
+**   t:      thread number
+**   cached: papicounters[t] still holds the values read by the stop just
+**           before this start on the same thread, so skip the PAPI_read.
+**           Events between that stop and this start count for this timer.
 **
 ** Output args:
 **   aux: struct containing the counters
@@ -845,7 +877,8 @@ int GPTLcreate_and_start_events (const int t)  /* thread number */
 */
 
 int GPTL_PAPIstart (const int t,          /* thread number */
-		    Papistats *aux)       /* struct containing PAPI stats */
+		    Papistats *aux,       /* struct containing PAPI stats */
+		    const bool cached)    /* reuse the counters read by the previous stop */
 {
   int ret;  /* return code from PAPI lib calls */
   int n;    /* loop index */
@@ -857,7 +890,7 @@ int GPTL_PAPIstart (const int t,          /* thread number */
 
   /* Read the counters */
 
-  if ((ret = PAPI_read (EventSet[t], papicounters[t])) != PAPI_OK)
+  if ( ! cached && (ret = PAPI_read (EventSet[t], papicounters[t])) != PAPI_OK)
     return GPTLerror ("GPTL_PAPIstart: %s\n", PAPI_strerror (ret));
 
   /*
@@ -0,0 +1,684 @@
+/*
+** pmpi.c
+**
+** MPI profiling layer: wrappers which intercept MPI calls via the PMPI interface and time each
+** one with a GPTL timer of the same name (e.g. "MPI_Allreduce"), so communication shows up under
+** whatever region made the call. The bytes handed to each call accumulate in Timer.nbytes and
+** are printed as AVG_MPI_BYTES. For a send, reduction or gather that is the data this task
+** contributes; for a receive or scatter it is the posted receive buffer.
+**
+** With GPTLsetoption (GPTLsync_mpi, 1) each collective is preceded by a PMPI_Barrier timed as
+** "sync_<name>" (e.g. "sync_Allreduce"), which separates time spent waiting for the slowest task
+** from time spent in the collective itself.
+**
+** Test and Iprobe are deliberately not wrapped: they are typically called in polling loops where
+** the timer overhead would dominate. Fortran callers are covered by f_wrappers_pmpi.c.
+**
+** Compiled only when ENABLE_PMPI is defined.
+*/
+
+#ifdef ENABLE_PMPI
+
+#include "private.h"
+#include "gptl.h"
+
+#ifndef HAVE_MPI
+#error "ENABLE_PMPI requires HAVE_MPI"
+#endif
+
+#if ( MPI_VERSION >= 3 )
+#define CONST const
+#else
+#define CONST
+#endif
+
+static bool sync_mpi = false;    /* barrier before each collective (GPTLsync_mpi) */
+
+/*
+** GPTLpmpi_setoption: set an option specific to the PMPI layer. Called from GPTLsetoption
+**
+** Input arguments:
+**   option: option to be set
+**   val:    value to which option should be set (nonzero=true, zero=false)
+**
+** Return value: 0 (success) or 1 (option not handled here)
+*/
+
+int GPTLpmpi_setoption (const int option,
+			const int val)
+{
+  switch (option) {
+  case GPTLsync_mpi:
+    sync_mpi = (bool) val;
+    return 0;
+  default:
+    break;
+  }
+  return 1;
+}
+
+/*
+** GPTLpmpi_sync_enabled: whether GPTLsync_mpi is set. Used by f_wrappers_pmpi.c
+*/
+
+bool GPTLpmpi_sync_enabled (void)
+{
+  return sync_mpi;
+}
+
+/*
+** nbytes: number of bytes in count items of datatype
+**
+** Return value: byte count, 0 if count or datatype is empty
+*/
+
+static inline double nbytes (const int count,
+			     MPI_Datatype datatype)
+{
+  int size;
+
+  if (count <= 0 || datatype == MPI_DATATYPE_NULL || PMPI_Type_size (datatype, &size) != MPI_SUCCESS)
+    return 0.;
+  return (double) count * size;
+}
+
+/*
+** sumbytes: number of bytes in the n per-task counts of datatype of a "v" collective
+*/
+
+static inline double sumbytes (const int n,
+			       CONST int *counts,
+			       MPI_Datatype datatype)
+{
+  int i;
+  int size;
+  double total = 0.;   /* the summed counts can exceed INT_MAX */
+
+  if (datatype == MPI_DATATYPE_NULL || PMPI_Type_size (datatype, &size) != MPI_SUCCESS)
+    return 0.;
+  for (i = 0; i < n; ++i)
+    if (counts[i] > 0)
+      total += counts[i];
+  return total * size;
+}
+
+/*
+** commsize: number of tasks in comm
+*/
+
+static inline int commsize (MPI_Comm comm)
+{
+  int size;
+
+  if (PMPI_Comm_size (comm, &size) != MPI_SUCCESS)
+    return 0;
+  return size;
+}
+
+/*
+** addbytes: add bytes to the timer just stopped for an MPI call. Timers which were never
+**           started (GPTL not initialized or disabled) are skipped
+*/
+
+static inline void addbytes (const char *name,
+			     const double bytes)
+{
+  Timer *timer;
+
+  if (bytes > 0. && GPTLis_initialized () && (timer = GPTLgetentry (name)))
+    timer->nbytes += bytes;
+}
+
+/*
+** GPTLpmpi_addbytes: out-of-line addbytes for f_wrappers_pmpi.c
+*/
+
+void GPTLpmpi_addbytes (const char *name,
+			const double bytes)
+{
+  addbytes (name, bytes);
+}
+
+/*
+** sync_barrier: if GPTLsync_mpi is set, time a barrier on comm as syncname ahead of a collective
+*/
+
+static inline void sync_barrier (const char *syncname,
+				 MPI_Comm comm)
+{
+  if (sync_mpi) {
+    (void) GPTLstart (syncname);
+    (void) PMPI_Barrier (comm);
+    (void) GPTLstop (syncname);
+  }
+}
+
+/*
+** Point-to-point
+*/
+
+int MPI_Send (CONST void *buf, int count, MPI_Datatype datatype, int dest, int tag,
+	      MPI_Comm comm)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Send");
+  ret = PMPI_Send (buf, count, datatype, dest, tag, comm);
+  (void) GPTLstop ("MPI_Send");
+  addbytes ("MPI_Send", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Ssend (CONST void *buf, int count, MPI_Datatype datatype, int dest, int tag,
+	       MPI_Comm comm)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Ssend");
+  ret = PMPI_Ssend (buf, count, datatype, dest, tag, comm);
+  (void) GPTLstop ("MPI_Ssend");
+  addbytes ("MPI_Ssend", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Isend (CONST void *buf, int count, MPI_Datatype datatype, int dest, int tag,
+	       MPI_Comm comm, MPI_Request *request)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Isend");
+  ret = PMPI_Isend (buf, count, datatype, dest, tag, comm, request);
+  (void) GPTLstop ("MPI_Isend");
+  addbytes ("MPI_Isend", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Issend (CONST void *buf, int count, MPI_Datatype datatype, int dest, int tag,
+		MPI_Comm comm, MPI_Request *request)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Issend");
+  ret = PMPI_Issend (buf, count, datatype, dest, tag, comm, request);
+  (void) GPTLstop ("MPI_Issend");
+  addbytes ("MPI_Issend", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Recv (void *buf, int count, MPI_Datatype datatype, int source, int tag,
+	      MPI_Comm comm, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Recv");
+  ret = PMPI_Recv (buf, count, datatype, source, tag, comm, status);
+  (void) GPTLstop ("MPI_Recv");
+  addbytes ("MPI_Recv", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Irecv (void *buf, int count, MPI_Datatype datatype, int source, int tag,
+	       MPI_Comm comm, MPI_Request *request)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Irecv");
+  ret = PMPI_Irecv (buf, count, datatype, source, tag, comm, request);
+  (void) GPTLstop ("MPI_Irecv");
+  addbytes ("MPI_Irecv", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Sendrecv (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+		  void *recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+		  MPI_Comm comm, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Sendrecv");
+  ret = PMPI_Sendrecv (sendbuf, sendcount, sendtype, dest, sendtag,
+		       recvbuf, recvcount, recvtype, source, recvtag, comm, status);
+  (void) GPTLstop ("MPI_Sendrecv");
+  addbytes ("MPI_Sendrecv", nbytes (sendcount, sendtype) + nbytes (recvcount, recvtype));
+  return ret;
+}
+
+int MPI_Wait (MPI_Request *request, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Wait");
+  ret = PMPI_Wait (request, status);
+  (void) GPTLstop ("MPI_Wait");
+  return ret;
+}
+
+int MPI_Waitall (int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[])
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Waitall");
+  ret = PMPI_Waitall (count, array_of_requests, array_of_statuses);
+  (void) GPTLstop ("MPI_Waitall");
+  return ret;
+}
+
+int MPI_Waitany (int count, MPI_Request array_of_requests[], int *indx, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Waitany");
+  ret = PMPI_Waitany (count, array_of_requests, indx, status);
+  (void) GPTLstop ("MPI_Waitany");
+  return ret;
+}
+
+int MPI_Waitsome (int incount, MPI_Request array_of_requests[], int *outcount,
+		  int array_of_indices[], MPI_Status array_of_statuses[])
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Waitsome");
+  ret = PMPI_Waitsome (incount, array_of_requests, outcount, array_of_indices, array_of_statuses);
+  (void) GPTLstop ("MPI_Waitsome");
+  return ret;
+}
+
+int MPI_Probe (int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Probe");
+  ret = PMPI_Probe (source, tag, comm, status);
+  (void) GPTLstop ("MPI_Probe");
+  return ret;
+}
+
+/*
+** Collectives. A barrier is not preceded by a sync barrier: it would only measure itself
+*/
+
+int MPI_Barrier (MPI_Comm comm)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_Barrier");
+  ret = PMPI_Barrier (comm);
+  (void) GPTLstop ("MPI_Barrier");
+  return ret;
+}
+
+int MPI_Bcast (void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Bcast", comm);
+  (void) GPTLstart ("MPI_Bcast");
+  ret = PMPI_Bcast (buffer, count, datatype, root, comm);
+  (void) GPTLstop ("MPI_Bcast");
+  addbytes ("MPI_Bcast", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Reduce (CONST void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
+		MPI_Op op, int root, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Reduce", comm);
+  (void) GPTLstart ("MPI_Reduce");
+  ret = PMPI_Reduce (sendbuf, recvbuf, count, datatype, op, root, comm);
+  (void) GPTLstop ("MPI_Reduce");
+  addbytes ("MPI_Reduce", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Allreduce (CONST void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
+		   MPI_Op op, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Allreduce", comm);
+  (void) GPTLstart ("MPI_Allreduce");
+  ret = PMPI_Allreduce (sendbuf, recvbuf, count, datatype, op, comm);
+  (void) GPTLstop ("MPI_Allreduce");
+  addbytes ("MPI_Allreduce", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Reduce_scatter (CONST void *sendbuf, void *recvbuf, CONST int recvcounts[],
+			MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Reduce_scatter", comm);
+  (void) GPTLstart ("MPI_Reduce_scatter");
+  ret = PMPI_Reduce_scatter (sendbuf, recvbuf, recvcounts, datatype, op, comm);
+  (void) GPTLstop ("MPI_Reduce_scatter");
+  addbytes ("MPI_Reduce_scatter", sumbytes (commsize (comm), recvcounts, datatype));
+  return ret;
+}
+
+int MPI_Scan (CONST void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
+	      MPI_Op op, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Scan", comm);
+  (void) GPTLstart ("MPI_Scan");
+  ret = PMPI_Scan (sendbuf, recvbuf, count, datatype, op, comm);
+  (void) GPTLstop ("MPI_Scan");
+  addbytes ("MPI_Scan", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_Exscan (CONST void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
+		MPI_Op op, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Exscan", comm);
+  (void) GPTLstart ("MPI_Exscan");
+  ret = PMPI_Exscan (sendbuf, recvbuf, count, datatype, op, comm);
+  (void) GPTLstop ("MPI_Exscan");
+  addbytes ("MPI_Exscan", nbytes (count, datatype));
+  return ret;
+}
+
+/*
+** For the gather family an MPI_IN_PLACE send buffer means this task's contribution is already
+** in recvbuf, described by recvcount and recvtype
+*/
+
+int MPI_Gather (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype,
+		void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Gather", comm);
+  (void) GPTLstart ("MPI_Gather");
+  ret = PMPI_Gather (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  (void) GPTLstop ("MPI_Gather");
+  addbytes ("MPI_Gather", sendbuf == MPI_IN_PLACE ? nbytes (recvcount, recvtype)
+	                                           : nbytes (sendcount, sendtype));
+  return ret;
+}
+
+int MPI_Gatherv (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype,
+		 void *recvbuf, CONST int recvcounts[], CONST int displs[], MPI_Datatype recvtype,
+		 int root, MPI_Comm comm)
+{
+  int ret;
+  int rank;
+
+  sync_barrier ("sync_Gatherv", comm);
+  (void) GPTLstart ("MPI_Gatherv");
+  ret = PMPI_Gatherv (sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype,
+		      root, comm);
+  (void) GPTLstop ("MPI_Gatherv");
+  if (sendbuf == MPI_IN_PLACE) {
+    (void) PMPI_Comm_rank (comm, &rank);
+    addbytes ("MPI_Gatherv", nbytes (recvcounts[rank], recvtype));
+  } else {
+    addbytes ("MPI_Gatherv", nbytes (sendcount, sendtype));
+  }
+  return ret;
+}
+
+int MPI_Allgather (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype,
+		   void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Allgather", comm);
+  (void) GPTLstart ("MPI_Allgather");
+  ret = PMPI_Allgather (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+  (void) GPTLstop ("MPI_Allgather");
+  addbytes ("MPI_Allgather", sendbuf == MPI_IN_PLACE ? nbytes (recvcount, recvtype)
+	                                              : nbytes (sendcount, sendtype));
+  return ret;
+}
+
+int MPI_Allgatherv (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype,
+		    void *recvbuf, CONST int recvcounts[], CONST int displs[],
+		    MPI_Datatype recvtype, MPI_Comm comm)
+{
+  int ret;
+  int rank;
+
+  sync_barrier ("sync_Allgatherv", comm);
+  (void) GPTLstart ("MPI_Allgatherv");
+  ret = PMPI_Allgatherv (sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+  (void) GPTLstop ("MPI_Allgatherv");
+  if (sendbuf == MPI_IN_PLACE) {
+    (void) PMPI_Comm_rank (comm, &rank);
+    addbytes ("MPI_Allgatherv", nbytes (recvcounts[rank], recvtype));
+  } else {
+    addbytes ("MPI_Allgatherv", nbytes (sendcount, sendtype));
+  }
+  return ret;
+}
+
+int MPI_Scatter (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype,
+		 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Scatter", comm);
+  (void) GPTLstart ("MPI_Scatter");
+  ret = PMPI_Scatter (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  (void) GPTLstop ("MPI_Scatter");
+  addbytes ("MPI_Scatter", recvbuf == MPI_IN_PLACE ? nbytes (sendcount, sendtype)
+	                                            : nbytes (recvcount, recvtype));
+  return ret;
+}
+
+int MPI_Scatterv (CONST void *sendbuf, CONST int sendcounts[], CONST int displs[],
+		  MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype,
+		  int root, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Scatterv", comm);
+  (void) GPTLstart ("MPI_Scatterv");
+  ret = PMPI_Scatterv (sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype,
+		       root, comm);
+  (void) GPTLstop ("MPI_Scatterv");
+  if (recvbuf == MPI_IN_PLACE)
+    addbytes ("MPI_Scatterv", nbytes (sendcounts[root], sendtype));
+  else
+    addbytes ("MPI_Scatterv", nbytes (recvcount, recvtype));
+  return ret;
+}
+
+int MPI_Alltoall (CONST void *sendbuf, int sendcount, MPI_Datatype sendtype,
+		  void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Alltoall", comm);
+  (void) GPTLstart ("MPI_Alltoall");
+  ret = PMPI_Alltoall (sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+  (void) GPTLstop ("MPI_Alltoall");
+  addbytes ("MPI_Alltoall", commsize (comm) * (sendbuf == MPI_IN_PLACE
+					       ? nbytes (recvcount, recvtype)
+					       : nbytes (sendcount, sendtype)));
+  return ret;
+}
+
+int MPI_Alltoallv (CONST void *sendbuf, CONST int sendcounts[], CONST int sdispls[],
+		   MPI_Datatype sendtype, void *recvbuf, CONST int recvcounts[],
+		   CONST int rdispls[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+  int ret;
+
+  sync_barrier ("sync_Alltoallv", comm);
+  (void) GPTLstart ("MPI_Alltoallv");
+  ret = PMPI_Alltoallv (sendbuf, sendcounts, sdispls, sendtype,
+			recvbuf, recvcounts, rdispls, recvtype, comm);
+  (void) GPTLstop ("MPI_Alltoallv");
+  if (sendbuf == MPI_IN_PLACE)
+    addbytes ("MPI_Alltoallv", sumbytes (commsize (comm), recvcounts, recvtype));
+  else
+    addbytes ("MPI_Alltoallv", sumbytes (commsize (comm), sendcounts, sendtype));
+  return ret;
+}
+
+/*
+** MPI-IO. Bytes are those requested by the call
+*/
+
+int MPI_File_open (MPI_Comm comm, CONST char *filename, int amode, MPI_Info info, MPI_File *fh)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_open");
+  ret = PMPI_File_open (comm, filename, amode, info, fh);
+  (void) GPTLstop ("MPI_File_open");
+  return ret;
+}
+
+int MPI_File_close (MPI_File *fh)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_close");
+  ret = PMPI_File_close (fh);
+  (void) GPTLstop ("MPI_File_close");
+  return ret;
+}
+
+int MPI_File_sync (MPI_File fh)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_sync");
+  ret = PMPI_File_sync (fh);
+  (void) GPTLstop ("MPI_File_sync");
+  return ret;
+}
+
+int MPI_File_set_view (MPI_File fh, MPI_Offset disp, MPI_Datatype etype, MPI_Datatype filetype,
+		       CONST char *datarep, MPI_Info info)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_set_view");
+  ret = PMPI_File_set_view (fh, disp, etype, filetype, datarep, info);
+  (void) GPTLstop ("MPI_File_set_view");
+  return ret;
+}
+
+int MPI_File_read (MPI_File fh, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_read");
+  ret = PMPI_File_read (fh, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_read");
+  addbytes ("MPI_File_read", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_read_all (MPI_File fh, void *buf, int count, MPI_Datatype datatype,
+		       MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_read_all");
+  ret = PMPI_File_read_all (fh, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_read_all");
+  addbytes ("MPI_File_read_all", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_read_at (MPI_File fh, MPI_Offset offset, void *buf, int count,
+		      MPI_Datatype datatype, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_read_at");
+  ret = PMPI_File_read_at (fh, offset, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_read_at");
+  addbytes ("MPI_File_read_at", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_read_at_all (MPI_File fh, MPI_Offset offset, void *buf, int count,
+			  MPI_Datatype datatype, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_read_at_all");
+  ret = PMPI_File_read_at_all (fh, offset, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_read_at_all");
+  addbytes ("MPI_File_read_at_all", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_write (MPI_File fh, CONST void *buf, int count, MPI_Datatype datatype,
+		    MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_write");
+  ret = PMPI_File_write (fh, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_write");
+  addbytes ("MPI_File_write", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_write_all (MPI_File fh, CONST void *buf, int count, MPI_Datatype datatype,
+			MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_write_all");
+  ret = PMPI_File_write_all (fh, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_write_all");
+  addbytes ("MPI_File_write_all", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_write_at (MPI_File fh, MPI_Offset offset, CONST void *buf, int count,
+		       MPI_Datatype datatype, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_write_at");
+  ret = PMPI_File_write_at (fh, offset, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_write_at");
+  addbytes ("MPI_File_write_at", nbytes (count, datatype));
+  return ret;
+}
+
+int MPI_File_write_at_all (MPI_File fh, MPI_Offset offset, CONST void *buf, int count,
+			   MPI_Datatype datatype, MPI_Status *status)
+{
+  int ret;
+
+  (void) GPTLstart ("MPI_File_write_at_all");
+  ret = PMPI_File_write_at_all (fh, offset, buf, count, datatype, status);
+  (void) GPTLstop ("MPI_File_write_at_all");
+  addbytes ("MPI_File_write_at_all", nbytes (count, datatype));
+  return ret;
+}
+
+/*
+** MPI_Finalize: print the timers if GPTL is still active and nothing has printed them yet
+** (perf_mod users call t_prf and t_finalizef first, so this is a no-op for them)
+*/
+
+int MPI_Finalize (void)
+{
+  int rank;
+
+  if (GPTLis_initialized () && ! GPTLpr_has_been_called ()) {
+    if (PMPI_Comm_rank (MPI_COMM_WORLD, &rank) != MPI_SUCCESS)
+      rank = 0;
+    (void) GPTLpr (rank);
+  }
+  return PMPI_Finalize ();
+}
+
+#endif
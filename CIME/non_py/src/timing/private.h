@@ -7,6 +7,7 @@
 */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <sys/time.h>
 
 #ifndef NO_COMM_F2C
@@ -33,6 +34,16 @@
 /* Maximum allowed callstack depth */
 #define MAX_STACK 128
 
+/* Cache line size assumed when laying out data shared between threads */
+#define CACHE_LINE 64
+
+/* Align (and so pad) a type to CACHE_LINE, where the compiler allows it */
+#ifdef __GNUC__
+#define CACHE_ALIGNED __attribute__ ((aligned (CACHE_LINE)))
+#else
+#define CACHE_ALIGNED
+#endif
+
 /* longest timer name allowed (probably safe to just change) */
 #define MAX_CHARS 127
 
@@ -43,6 +54,17 @@
 */
 #define MAX_AUX 9
 
+/*
+** Latency histograms (GPTLhistogram): each power of 2 from 2^HIST_EMIN seconds
+** (about 60 ns) up to 2^(HIST_EMIN+HIST_NOCT) seconds (about 68 min) is split
+** into HIST_NSUB linear sub-buckets, as in HDR histograms. Times outside the
+** range go in the first or last bin.
+*/
+#define HIST_EMIN -24
+#define HIST_NOCT 36
+#define HIST_NSUB 4
+#define HIST_NBINS (HIST_NOCT*HIST_NSUB)
+
 #ifndef __cplusplus
 typedef enum {false = 0, true = 1} bool;  /* mimic C++ */
 #endif
@@ -64,6 +86,19 @@ typedef struct {
   int latest_is_min;        /* whether min is current latest (1) or not (0) */
 } Wallstats;
 
+/*
+** Timers sampled 1 in N calls (GPTLset_sampling) read the clocks only on the
+** sampled calls. Each sampled delta stands for itself and the unsampled calls
+** since the previous one, so wall.accum stays an estimate of the total.
+*/
+
+typedef struct {
+  unsigned long n;          /* number of calls that read the clocks */
+  unsigned long lastcount;  /* count at the previous sampled stop */
+  double sum;               /* sum of sampled deltas */
+  double sumsq;             /* sum of squared sampled deltas */
+} Samplestats;
+
 typedef struct {
   long long last[MAX_AUX];  /* array of saved counters from "start" */
   long long accum[MAX_AUX]; /* accumulator for counters */
@@ -83,45 +118,120 @@ typedef struct {
   int denomidx;     /* derived event: PAPI counter array index for denominator */
 } Pr_event;
 
+/*
+** Fields are grouped by how often the start/stop path touches them. The hot
+** group comes first and fits in one cache line (GPTLarena_alloc aligns timers
+** to CACHE_LINE); the name and tree metadata used for lookup and printing
+** follow it.
+*/
+
 typedef struct TIMER {
-  char name[MAX_CHARS+1];   /* timer name (user input) */
+  /* hot: read or written by every start/stop */
   bool onflg;               /* timer currently on or off */
-#ifdef ENABLE_PMPI
-  double nbytes;            /* number of bytes for MPI call */
-#endif
-#ifdef HAVE_PAPI
-  Papistats aux;            /* PAPI stats  */
-#endif
+  unsigned int recurselvl;  /* recursion level */
+  unsigned long count;      /* number of start/stop calls */
   Wallstats wall;           /* wallclock stats */
+  unsigned int sample;      /* read the clocks on 1 in sample calls (0 or 1: every call) */
+  unsigned char sampled;    /* current start read the clocks */
+  unsigned char filtered;   /* excluded by GPTLset_filter: never timed or printed */
+  /* warm: only used when the corresponding option is enabled */
   Cpustats cpu;             /* cpu stats */
-  unsigned long count;      /* number of start/stop calls */
   unsigned long nrecurse;   /* number of recursive start/stop calls */
+  unsigned long *hist;      /* HIST_NBINS latency bins (NULL unless GPTLhistogram) */
+  Samplestats samp;         /* stats of the sampled calls (sample > 1 only) */
+  double child_wall;        /* wallclock in timers started directly inside this one */
+  unsigned long nchildcalls;/* start/stop pairs of timers started directly inside this one */
+  unsigned long ndesc;      /* start/stop pairs of all timers started inside this one */
+  unsigned long descmark;   /* thread's pair count when this timer was started */
+  double self_wall;         /* wallclock less that of its children (set by compute_self) */
+  int traceid;              /* number of the timer in its thread, in creation order */
+  long long rss_last;       /* resident set size (KB) at the current start (GPTLmemory) */
+  long long rss_delta;      /* change in resident set size over all calls (KB) */
+  long long rss_peak;       /* largest resident set size seen at its start or stop (KB) */
+#ifdef HAVE_PAPI
+  bool dopapi;              /* read PAPI counters (see GPTLselect_papi) */
+  Papistats aux;            /* PAPI stats  */
+#endif
+#ifdef ENABLE_PMPI
+  double nbytes;            /* number of bytes for MPI call */
+#endif
+  /* cold: lookup, call tree and printing */
+  char name[MAX_CHARS+1];   /* timer name (user input) */
   void *address;            /* address of timer: used only by _instr routines */
   struct TIMER *next;       /* next timer in linked list */
   struct TIMER **parent;    /* array of parents */
   struct TIMER **children;  /* array of children */
   int *parent_count;        /* array of call counts, one for each parent */
-  unsigned int recurselvl;  /* recursion level */
   unsigned int nchildren;   /* number of children */
   unsigned int nparent;     /* number of parents */
   unsigned int norphan;     /* number of times this timer was an orphan */
   int num_desc;             /* number of descendants */
+  unsigned int visitmark;   /* last is_descendant search which visited this timer */
+  unsigned long snap_count; /* count at the previous GPTLsnapshot */
+  double snap_accum;        /* wall.accum at the previous GPTLsnapshot */
 } Timer;
 
 typedef struct {
-  Timer **entries;          /* array of timers hashed to the same value */
-  unsigned int nument;      /* number of entries hashed to the same value */
-} Hashentry;
+  unsigned int hash;        /* full hash value of the timer in this slot */
+  Timer *entry;             /* timer (NULL if the slot is empty) */
+} Hashslot;
+
+typedef struct {
+  Hashslot *slots;          /* open addressed (linear probing) array of slots */
+  unsigned int size;        /* number of slots: always a power of 2 */
+  unsigned int nument;      /* number of occupied slots */
+} Hashtable;
+
+/*
+** Per-thread table of call graph edges keyed by (parent, child). Each slot holds
+** the position of the parent in the child's parent arrays, so a start bumps the
+** right count without searching them.
+*/
+
+typedef struct {
+  unsigned int hash;        /* hash of the parent and child ids */
+  unsigned int n;           /* index of parent in child->parent and child->parent_count */
+  const Timer *parent;      /* caller (NULL if the slot is empty) */
+  const Timer *child;       /* callee */
+  bool linked;              /* construct_tree has put child in parent's children */
+} Edgeslot;
+
+typedef struct {
+  Edgeslot *slots;          /* open addressed (linear probing) array of slots */
+  unsigned int size;        /* number of slots: always a power of 2 */
+  unsigned int nument;      /* number of occupied slots */
+} Edgetable;
+
+/*
+** Per-thread memory pool: timers and their parent/child arrays are carved out
+** of large blocks, and the whole arena is released at once.
+*/
+
+typedef struct ARENABLOCK {
+  struct ARENABLOCK *next;  /* next (older) block */
+  size_t size;              /* usable bytes in this block */
+  size_t used;              /* bytes handed out so far */
+} Arenablock;
+
+typedef struct {
+  Arenablock *block;        /* block currently being filled (head of list) */
+  size_t nbytes;            /* total bytes obtained from malloc */
+} Arena;
 
 /* Function prototypes */
 
 extern int GPTLerror (const char *, ...);      /* print error msg and return */
 extern void GPTLset_abort_on_error (bool val); /* set flag to abort on error */
 extern void *GPTLallocate (const int);         /* malloc wrapper */
+extern void *GPTLarena_alloc (Arena *, const size_t, const size_t); /* zeroed space from an arena */
+extern void GPTLarena_free (Arena *);          /* release everything in an arena */
 
 extern int GPTLstart_instr (void *);           /* auto-instrumented start */
 extern int GPTLstop_instr (void *);            /* auto-instrumented stop */
-extern int GPTLis_initialized (void);          /* needed by MPI_Init wrapper */
+extern int GPTLis_initialized (void);          /* needed by MPI wrappers in pmpi.c */
+extern int GPTLget_rss (long long *);          /* current resident set size (KB) */
+extern int GPTLmemusage_open (void);           /* keep /proc/self/statm open (GPTLinitialize) */
+extern int GPTLmemusage_close (void);          /* close it again (GPTLfinalize) */
 
 #ifdef __cplusplus
 extern "C" {
@@ -143,7 +253,7 @@ extern void __cyg_profile_func_exit (void *, void *);
 #ifdef HAVE_PAPI
 extern int GPTL_PAPIsetoption (const int, const int);
 extern int GPTL_PAPIinitialize (const int, const bool, int *, Entry *);
-extern int GPTL_PAPIstart (const int, Papistats *);
+extern int GPTL_PAPIstart (const int, Papistats *, const bool);
 extern int GPTL_PAPIstop (const int, Papistats *);
 extern void GPTL_PAPIprstr (FILE *);
 extern void GPTL_PAPIpr (FILE *, const Papistats *, const int, const int, const double);
@@ -162,4 +272,6 @@ extern int GPTLcreate_and_start_events (const int);
 extern Timer *GPTLgetentry (const char *);
 extern int GPTLpmpi_setoption (const int, const int);
 extern int GPTLpr_has_been_called (void);      /* needed by MPI_Finalize wrapper*/
+extern bool GPTLpmpi_sync_enabled (void);      /* needed by f_wrappers_pmpi.c */
+extern void GPTLpmpi_addbytes (const char *, const double);
 #endif
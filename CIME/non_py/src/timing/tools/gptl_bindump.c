@@ -0,0 +1,285 @@
+/*
+** gptl_bindump.c
+**
+** Reader for the binary timing files (<file>.gptb) GPTL writes when the
+** GPTLdopr_binary option is set. The layout is described in gptl_binary.h.
+** Each table of each segment is printed as tab separated text with one
+** header line, so it can be fed to sort, awk or a spreadsheet. Columns with
+** more than one value per row (histograms, PAPI counters) are expanded into
+** name.0, name.1, ...
+**
+** Usage: gptl_bindump file.gptb [table ...]   (default: print all tables)
+**
+** Build: cc -I.. -o gptl_bindump gptl_bindump.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gptl_binary.h"
+
+typedef struct {
+  GPTLbin_column desc;     /* name, type, width, offset */
+  void *data;              /* nrows * width values, in host byte order */
+} Column;
+
+typedef struct {
+  GPTLbin_table desc;      /* name, nrows, ncols */
+  Column *cols;
+} Table;
+
+typedef struct {
+  GPTLbin_header header;
+  Table *tables;
+} Segment;
+
+static size_t typesize (const int type)
+{
+  switch (type) {
+  case GPTLBIN_STRING:
+    return 1;
+  case GPTLBIN_INT32:
+  case GPTLBIN_FLOAT32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+/*
+** swap: reverse the byte order of n values of size bytes each
+*/
+
+static void swap (void *buf, const size_t size, const size_t n)
+{
+  unsigned char *p = (unsigned char *) buf;
+  unsigned char tmp;
+  size_t i, j;
+
+  if (size < 2)
+    return;
+  for (i = 0; i < n; ++i, p += size)
+    for (j = 0; j < size/2; ++j) {
+      tmp = p[j];
+      p[j] = p[size-1-j];
+      p[size-1-j] = tmp;
+    }
+}
+
+static void free_segment (Segment *seg)
+{
+  int i, c;
+
+  if ( ! seg->tables)
+    return;
+  for (i = 0; i < seg->header.ntables; ++i) {
+    if ( ! seg->tables[i].cols)
+      continue;
+    for (c = 0; c < seg->tables[i].desc.ncols; ++c)
+      free (seg->tables[i].cols[c].data);
+    free (seg->tables[i].cols);
+  }
+  free (seg->tables);
+  seg->tables = 0;
+}
+
+/*
+** read_segment: read the segment starting at the current position of fp,
+**   and leave fp positioned at the next one
+**
+** Return value: 1 (segment read), 0 (end of file) or -1 (bad file)
+*/
+
+static int read_segment (FILE *fp, Segment *seg)
+{
+  GPTLbin_header *h = &seg->header;
+  Table *table;
+  Column *col;
+  long start;             /* file offset of the segment */
+  size_t nvals;
+  int doswap;
+  int i, c;
+
+  memset (seg, 0, sizeof (Segment));
+  start = ftell (fp);
+  if (fread (h, sizeof (GPTLbin_header), 1, fp) != 1)
+    return 0;
+  if (strncmp (h->magic, GPTLBIN_MAGIC, sizeof (h->magic)) != 0) {
+    fprintf (stderr, "read_segment: bad magic at offset %ld\n", start);
+    return -1;
+  }
+
+  doswap = (h->byteorder != GPTLBIN_BYTEORDER);
+  if (doswap) {
+    swap (&h->version, sizeof (int), 1);
+    swap (&h->byteorder, sizeof (int), 1);
+    swap (&h->kind, sizeof (int), 1);
+    swap (&h->rank, sizeof (int), 1);
+    swap (&h->nthreads, sizeof (int), 1);
+    swap (&h->ntables, sizeof (int), 1);
+    swap (&h->size, sizeof (long long), 1);
+  }
+  if (h->byteorder != GPTLBIN_BYTEORDER || h->version != GPTLBIN_VERSION) {
+    fprintf (stderr, "read_segment: unsupported version %d at offset %ld\n", h->version, start);
+    return -1;
+  }
+
+  if ( ! (seg->tables = (Table *) calloc (h->ntables, sizeof (Table))))
+    return -1;
+
+  for (i = 0; i < h->ntables; ++i) {
+    table = &seg->tables[i];
+    if (fread (&table->desc, sizeof (GPTLbin_table), 1, fp) != 1)
+      return -1;
+    if (doswap) {
+      swap (&table->desc.nrows, sizeof (long long), 1);
+      swap (&table->desc.ncols, sizeof (int), 1);
+    }
+    if ( ! (table->cols = (Column *) calloc (table->desc.ncols, sizeof (Column))))
+      return -1;
+    for (c = 0; c < table->desc.ncols; ++c) {
+      if (fread (&table->cols[c].desc, sizeof (GPTLbin_column), 1, fp) != 1)
+	return -1;
+      if (doswap) {
+	swap (&table->cols[c].desc.type, sizeof (int), 1);
+	swap (&table->cols[c].desc.width, sizeof (int), 1);
+	swap (&table->cols[c].desc.offset, sizeof (long long), 1);
+      }
+    }
+  }
+
+  /* Each column is one contiguous read */
+
+  for (i = 0; i < h->ntables; ++i) {
+    table = &seg->tables[i];
+    for (c = 0; c < table->desc.ncols; ++c) {
+      col = &table->cols[c];
+      nvals = table->desc.nrows * col->desc.width;
+      if ( ! (col->data = malloc (nvals * typesize (col->desc.type) + 1)))
+	return -1;
+      if (fseek (fp, start + col->desc.offset, SEEK_SET) != 0 ||
+	  fread (col->data, typesize (col->desc.type), nvals, fp) != nvals)
+	return -1;
+      if (doswap)
+	swap (col->data, typesize (col->desc.type), nvals);
+    }
+  }
+
+  if (fseek (fp, start + h->size, SEEK_SET) != 0)
+    return -1;
+  return 1;
+}
+
+/*
+** print_value: print value n of a column
+*/
+
+static void print_value (const Column *col, const long long n)
+{
+  const char *s;
+  int w;
+
+  switch (col->desc.type) {
+  case GPTLBIN_INT32:
+    printf ("%d", ((const int *) col->data)[n]);
+    break;
+  case GPTLBIN_FLOAT32:
+    printf ("%.9g", ((const float *) col->data)[n]);
+    break;
+  case GPTLBIN_FLOAT64:
+    printf ("%.17g", ((const double *) col->data)[n]);
+    break;
+  case GPTLBIN_INT64:
+    printf ("%lld", ((const long long *) col->data)[n]);
+    break;
+  case GPTLBIN_UINT64:
+    printf ("%llu", ((const unsigned long long *) col->data)[n]);
+    break;
+  case GPTLBIN_STRING:
+    s = (const char *) col->data + n * col->desc.width;
+    for (w = 0; w < col->desc.width && s[w]; ++w)
+      putchar (s[w]);
+    break;
+  }
+}
+
+static void print_table (const Segment *seg, const Table *table)
+{
+  const Column *col;
+  long long r;
+  int c, w, width;
+
+  printf ("# segment kind=%s rank=%d nthreads=%d table=%s rows=%lld\n",
+	  seg->header.kind == GPTLBIN_SUMMARY ? "summary" :
+	  seg->header.kind == GPTLBIN_TRACE ? "trace" : "task",
+	  seg->header.rank, seg->header.nthreads, table->desc.name, table->desc.nrows);
+
+  for (c = 0; c < table->desc.ncols; ++c) {
+    col = &table->cols[c];
+    width = (col->desc.type == GPTLBIN_STRING) ? 1 : col->desc.width;
+    for (w = 0; w < width; ++w) {
+      printf ("%s%s", c + w ? "\t" : "", col->desc.name);
+      if (width > 1)
+	printf (".%d", w);
+    }
+  }
+  printf ("\n");
+
+  for (r = 0; r < table->desc.nrows; ++r) {
+    for (c = 0; c < table->desc.ncols; ++c) {
+      col = &table->cols[c];
+      if (c > 0)
+	printf ("\t");
+      if (col->desc.type == GPTLBIN_STRING) {
+	print_value (col, r);
+      } else {
+	for (w = 0; w < col->desc.width; ++w) {
+	  if (w > 0)
+	    printf ("\t");
+	  print_value (col, r * col->desc.width + w);
+	}
+      }
+    }
+    printf ("\n");
+  }
+  printf ("\n");
+}
+
+int main (int argc, char **argv)
+{
+  FILE *fp;
+  Segment seg;
+  int i, t;
+  int found;
+  int ret;
+
+  if (argc < 2) {
+    fprintf (stderr, "Usage: %s file.gptb [table ...]\n", argv[0]);
+    return 1;
+  }
+  if ( ! (fp = fopen (argv[1], "rb"))) {
+    fprintf (stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+    return 1;
+  }
+
+  while ((ret = read_segment (fp, &seg)) == 1) {
+    for (t = 0; t < seg.header.ntables; ++t) {
+      found = (argc < 3);
+      for (i = 2; i < argc; ++i)
+	if (strcmp (argv[i], seg.tables[t].desc.name) == 0)
+	  found = 1;
+      if (found)
+	print_table (&seg, &seg.tables[t]);
+    }
+    free_segment (&seg);
+  }
+  free_segment (&seg);
+  (void) fclose (fp);
+
+  if (ret < 0) {
+    fprintf (stderr, "%s: %s is not a valid GPTL binary file\n", argv[0], argv[1]);
+    return 1;
+  }
+  return 0;
+}
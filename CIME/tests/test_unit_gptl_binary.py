@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+
+import os
+import shutil
+import struct
+import tempfile
+import unittest
+
+from CIME import gptl_binary
+
+
+def _segment(endian, kind, rank, tables):
+    """
+    Build one segment the way GPTL's bin_write does. tables is a list of
+    (name, nrows, [(colname, type, width, packed values)]).
+    """
+    hsize = struct.calcsize(endian + gptl_binary._HEADER)
+    offset = hsize
+    for _, _, cols in tables:
+        offset += struct.calcsize(endian + gptl_binary._TABLE)
+        offset += len(cols) * struct.calcsize(endian + gptl_binary._COLUMN)
+
+    directory = b""
+    body = b""
+    for name, nrows, cols in tables:
+        directory += struct.pack(
+            endian + gptl_binary._TABLE, name.encode(), nrows, len(cols), 0
+        )
+        for colname, typ, width, values in cols:
+            directory += struct.pack(
+                endian + gptl_binary._COLUMN,
+                colname.encode(),
+                ord(typ),
+                width,
+                offset + len(body),
+            )
+            body += values + b"\0" * (-len(values) % 8)
+    header = struct.pack(
+        endian + gptl_binary._HEADER,
+        gptl_binary.MAGIC,
+        gptl_binary.VERSION,
+        gptl_binary.BYTEORDER,
+        kind,
+        rank,
+        1,
+        len(tables),
+        hsize + len(directory) + len(body),
+    )
+    return header + directory + body
+
+
+def _summary(endian, names, processes, counts, wallmax, wallmin):
+    n = len(names)
+    cols = [
+        ("name", "s", 8, b"".join(x.encode().ljust(8, b"\0") for x in names)),
+        ("processes", "i", 1, struct.pack(endian + "{}i".format(n), *processes)),
+        ("count", "l", 1, struct.pack(endian + "{}Q".format(n), *counts)),
+        ("wallmax", "d", 1, struct.pack(endian + "{}d".format(n), *wallmax)),
+        ("wallmin", "d", 1, struct.pack(endian + "{}d".format(n), *wallmin)),
+    ]
+    return _segment(endian, gptl_binary.SUMMARY, 0, [("summary", n, cols)])
+
+
+class TestGPTLBinary(unittest.TestCase):
+    def setUp(self):
+        self._workdir = tempfile.mkdtemp()
+        self._path = os.path.join(self._workdir, "model_timing_stats.gptb")
+
+    def tearDown(self):
+        shutil.rmtree(self._workdir)
+
+    def test_summary(self):
+        """Summary rows are keyed by timer name"""
+        with open(self._path, "wb") as fd:
+            fd.write(
+                _summary(
+                    "<",
+                    ["CPL:RUN", "CPL:INIT"],
+                    [4, 2],
+                    [40, 2],
+                    [1.5, 3.0],
+                    [1.0, 2.5],
+                )
+            )
+
+        stats = gptl_binary.summary(self._path)
+
+        self.assertEqual(sorted(stats), ["CPL:INIT", "CPL:RUN"])
+        self.assertEqual(stats["CPL:RUN"]["processes"], 4)
+        self.assertEqual(stats["CPL:RUN"]["count"], 40)
+        self.assertEqual(stats["CPL:INIT"]["wallmax"], 3.0)
+        self.assertEqual(stats["CPL:INIT"]["wallmin"], 2.5)
+
+    def test_appended_segments(self):
+        """Segments appended to one file are read in order, first one wins"""
+        with open(self._path, "wb") as fd:
+            fd.write(_summary("<", ["a"], [1], [1], [1.0], [1.0]))
+            fd.write(_summary("<", ["a", "b"], [2, 2], [2, 2], [2.0, 2.0], [2.0, 2.0]))
+
+        self.assertEqual(len(gptl_binary.read(self._path)), 2)
+        stats = gptl_binary.summary(self._path)
+        self.assertEqual(stats["a"]["count"], 1)
+        self.assertEqual(stats["b"]["count"], 2)
+
+    def test_byte_swapped(self):
+        """A file written on a machine of the other byte order reads the same"""
+        with open(self._path, "wb") as fd:
+            fd.write(_summary(">", ["x"], [3], [7], [0.25], [0.125]))
+
+        stats = gptl_binary.summary(self._path)
+        self.assertEqual(stats["x"]["processes"], 3)
+        self.assertEqual(stats["x"]["count"], 7)
+        self.assertEqual(stats["x"]["wallmin"], 0.125)
+
+    def test_task_segment(self):
+        """Columns with several values per row come back one list per row"""
+        data = _segment(
+            "<",
+            gptl_binary.TASK,
+            5,
+            [
+                ("timers", 2, [("hist", "l", 3, struct.pack("<6Q", 1, 2, 3, 4, 5, 6))]),
+                ("edges", 1, [("parent", "i", 1, struct.pack("<i", -1))]),
+            ],
+        )
+
+        (segment,) = gptl_binary.read_segments(data)
+
+        self.assertEqual(segment.kind, gptl_binary.TASK)
+        self.assertEqual(segment.rank, 5)
+        hist = [list(x) for x in segment["timers"]["hist"]]
+        self.assertEqual(hist, [[1, 2, 3], [4, 5, 6]])
+        self.assertEqual(list(segment["edges"]["parent"]), [-1])
+
+    def test_chrome_trace(self):
+        """Trace segments of two ranks merge into one Chrome trace"""
+
+        def trace(rank, thread, names, events):
+            ids = [x[0] for x in names]
+            return _segment(
+                "<",
+                gptl_binary.TRACE,
+                rank,
+                [
+                    ("info", 1, [("thread", "i", 1, struct.pack("<i", thread))]),
+                    (
+                        "names",
+                        len(names),
+                        [
+                            ("id", "i", 1, struct.pack("<{}i".format(len(ids)), *ids)),
+                            (
+                                "name",
+                                "s",
+                                4,
+                                b"".join(x[1].encode().ljust(4, b"\0") for x in names),
+                            ),
+                        ],
+                    ),
+                    (
+                        "events",
+                        len(events),
+                        [
+                            (
+                                "time",
+                                "d",
+                                1,
+                                struct.pack(
+                                    "<{}d".format(len(events)), *[x[0] for x in events]
+                                ),
+                            ),
+                            (
+                                "id",
+                                "i",
+                                1,
+                                struct.pack(
+                                    "<{}i".format(len(events)), *[x[1] for x in events]
+                                ),
+                            ),
+                            (
+                                "kind",
+                                "i",
+                                1,
+                                struct.pack(
+                                    "<{}i".format(len(events)), *[x[2] for x in events]
+                                ),
+                            ),
+                        ],
+                    ),
+                ],
+            )
+
+        other = os.path.join(self._workdir, "timing.trace.1.gptb")
+        with open(self._path, "wb") as fd:
+            # Names come with the first segment that needs them
+            fd.write(trace(0, 0, [(0, "run")], [(10.0, 0, 0)]))
+            fd.write(trace(0, 0, [(1, "comm")], [(10.5, 1, 0), (11.0, 1, 1), (12.0, 0, 1)]))
+        with open(other, "wb") as fd:
+            fd.write(trace(1, 2, [(0, "wait")], [(10.25, 0, 0), (11.5, 0, 1)]))
+
+        events = gptl_binary.chrome_trace([self._path, other])["traceEvents"]
+
+        timed = [x for x in events if x["ph"] != "M"]
+        self.assertEqual(
+            [(x["pid"], x["tid"], x["name"], x["ph"], x["ts"]) for x in timed],
+            [
+                (0, 0, "run", "B", 0.0),
+                (0, 0, "comm", "B", 500000.0),
+                (0, 0, "comm", "E", 1000000.0),
+                (0, 0, "run", "E", 2000000.0),
+                (1, 2, "wait", "B", 250000.0),
+                (1, 2, "wait", "E", 1500000.0),
+            ],
+        )
+        self.assertEqual(
+            sorted(x["args"]["name"] for x in events if x["ph"] == "M"),
+            ["rank 0", "rank 1"],
+        )
+
+    def test_bad_magic(self):
+        """Anything that is not a GPTL binary file is rejected"""
+        with self.assertRaises(gptl_binary.GPTLBinaryError):
+            gptl_binary.read_segments(b"not a timing file, just text" * 2)
+
+
+if __name__ == "__main__":
+    unittest.main()